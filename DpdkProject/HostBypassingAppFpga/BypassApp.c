@@ -20,11 +20,20 @@
 #include <unistd.h>
 #include <string.h>
 #include <inttypes.h>
+#include <dirent.h>
+#include <limits.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <rte_flow.h>
 
 #include "../../drivers/net/ixgbe/ixgbe_ethdev.h"
 #include "../../drivers/net/ixgbe/base/ixgbe_osdep.h"
 #include "../../drivers/net/ixgbe/base/ixgbe_type.h"
+#include "../../drivers/net/ixgbe/ixgbe_rxtx.h"
 #include "rte_ethdev_driver.h"
+#include "pci_discovery.h" //GpuProject/pci_discovery.h, see HOST_BYPASSING_DIR in the Makefile
+#include "bypass_flow.h" //GpuProject/bypass_flow.h
 //#include "rte_ethdev.h"
 
 /**
@@ -37,13 +46,15 @@ The memory layout on the FPGA looks always as follows and all the areas are adja
 
 If the number of descriptors is smaller than 256, this layout is still the same but some memory regions are not used in operation
 
-for each packet in the rx/tx packet buffer 2048 bytes are reserved and always used --> memory addresses are base_address + n*2048 while n is the id of the packet.
+for each packet in the rx/tx packet buffer FPGA_BUF_SIZE (default 2048) bytes are reserved and always used --> memory addresses are base_address + n*FPGA_BUF_SIZE while n is the id of the packet.
+With 1024 bytes twice the descriptors fit into the packet bram, with 4096 or 9216 bytes the ring has to be shortened accordingly (e.g. 32 descriptors for 9216) but jumbo frames fit into a single buffer.
+Frames longer than FPGA_BUF_SIZE (up to FPGA_MAX_PKT_LEN) span several consecutive descriptors, only the last one has EOP set.
 The descriptor ring requires 16 byte for each descriptor. 4KB /16 --> 256 descriptors max. 64 seem to be sufficient on the FPGA. In Software more is better.
 
-Updating the addresses: 3 in total:
-1. fpga mem addr
-2. fpga bar file
-3. NIC base address (find out with "lspci -v | grep 82599 -A 6" --> the region 0 address of the NIC!!!)
+The addresses are discovered at startup:
+1. the fpga is found by its pci vendor/device id in sysfs (or given as first application argument, e.g. "-- 0000:65:00.0"),
+   its memory address is the region 0 address from the sysfs resource file.
+2. the NIC base address is the region 0 address of the pci device behind DPDK port 0.
 **/
 
 #define RX_RING_SIZE 64
@@ -53,28 +64,120 @@ Updating the addresses: 3 in total:
 #define MBUF_CACHE_SIZE 250
 #define BURST_SIZE 32
 
+#define BYPASS_RINGS 4 //the fpga receives on the queues 0..BYPASS_RINGS-1 (1, 2 or 4, nb_rx_queues in U200.tcl) and transmits on queue 0
+#define HOST_RINGS 0 //additional queues in host memory for control and exception traffic, see -f
+#define FPGA_HEAD_WB 0 //tx head write-back into the tx descriptor bram behind the ring, must match the HEAD_WB parameter of tx_desc_ctrl
+#define FPGA_HAIRPIN 0 //the fpga sends the received buffers without a copy, must match hairpin in U200.tcl, needs FPGA_HEAD_WB
+#define FPGA_MATCH_ACTION 0 //match-action stage in front of the network function, must match match_action in U200.tcl, see -d
+#define FPGA_BUF_SIZE 2048 //packet buffer per descriptor (1024, 2048, 4096 or 9216), must match the BUF_SIZE parameter of rx_desc_ctrl/tx_packet_handler
+#define FPGA_MAX_PKT_LEN RTE_ETHER_MAX_LEN //largest frame on the port, frames longer than FPGA_BUF_SIZE span several descriptors (e.g. 9018 for a 9000 byte mtu)
+
 
 #define COMMAND_REG  			0 //32bit register
 #define NIC_BASE_ADDR_REG  		1
 #define FPGA_BASE_ADDR_REG  	2
-
-//TODO: read this from sysfs or lspci instead of constant
-#define FPGA_MEM_ADDR 0xc6000000  //this has to be updated manually everytime fpga address changes (usually when fpga memory size or pcie port is changed)
-//TODO
-#define FPGA_BAR_FILE "/sys/bus/pci/devices/0000:65:00.0/resource0"
-#define FPGA_RX_MEM_ADDR FPGA_MEM_ADDR
-#define FPGA_TX_MEM_ADDR FPGA_RX_MEM_ADDR + 256 * 2048
-#define FPGA_RX_DESC_ADDR FPGA_TX_MEM_ADDR + 256 * 2048 
-#define FPGA_TX_DESC_ADDR FPGA_RX_DESC_ADDR + 4096
-#define FPGA_REGISTERS_ADDR FPGA_TX_DESC_ADDR + 4096
+#define NIC_BASE_ADDR_HI_REG  	3
+#define NIC_RDT_ADDR_REG  		4 //doorbells of the fpga queue, taken from the PMD
+#define NIC_RDT_ADDR_HI_REG  	5
+#define NIC_TDT_ADDR_REG  		6
+#define NIC_TDT_ADDR_HI_REG  	7
+#define NIC_RDT_ADDR_Q_REG(q)  	((q) == 0 ? NIC_RDT_ADDR_REG : 16 + 2*((q) - 1)) //doorbell of rx queue q, the high word follows
+#define ITR_TIME_REG  			8 //doorbell moderation of tailpointer_delay: timeout max 31:16, min 15:0 in 250 MHz cycles
+#define ITR_BATCH_REG  			9 //tail pointer updates per doorbell: max 31:16, min 15:0
+#define ITR_RATE_REG  			10 //updates per rate window: batch grows above 31:16, shrinks below 15:0
+#define ITR_CTRL_REG  			11 //16: adaptive, 15:0 rate window in 250 MHz cycles
+#define PERF_SNAPSHOT_REG  		12 //0: latch all perf counters, cleared by the fpga
+#define FPGA_NB_REGS 			22 //registers 0..21 incl. the doorbells of the queues 1-3, even as reset_bram clears 8 byte words
+#define PERF_CNT_REG  			64 //read-only snapshot of the perf counters behind the registers, 64bit each, low word first (perf_counters.v)
+#define MA_REG  				128 //registers of the match-action stage (match_action.v), the offsets below are relative to it
+#define LAT_REG  				256 //registers of the residence time histogram (latency_monitor.v), the offsets below are relative to it
+
+// match_action registers
+#define MA_KEY 					0 //10 words: staged key
+#define MA_MASK 				10 //10 words: staged mask of ternary entries
+#define MA_ACTION 				20
+#define MA_CMD 					24 //writes the staged entry: 15:0 index, 16 ternary, 17 valid
+#define MA_HASH 				27 //exact match index of the staged key
+#define MA_INFO 				28 //31:16 ternary entries, 15:0 exact match entries
+#define MA_DROPS 				32
+#define MA_MISSES 				33
+#define MA_EM_HITS 				34
+#define MA_TC_HITS 				35
+#define MA_RW_SKIPS 			36 //ipv4 rewrites skipped, tcp/udp checksum behind the parsed header
+#define MA_KEY_WORDS 			10
+#define MA_KEY_PORTS 			(1 << 23) //flags in key word 1, the ip protocol is in 7:0
+#define MA_KEY_IPV4 			(1 << 21)
+#define MA_CMD_TERNARY 			(1 << 16)
+#define MA_CMD_VALID 			(1 << 17)
+#define MA_ACT_DROP 			(1 << 0)
+
+// latency_monitor registers
+#define LAT_CTRL 				0 //0: stamping, 1: clear, 2: clear min/max
+#define LAT_STAMP_OFFS 			1
+#define LAT_CNT 				2
+#define LAT_MIN 				3
+#define LAT_MAX 				4
+#define LAT_SUM 				5 //64bit, low word first
+#define LAT_UNMATCHED 			8
+#define LAT_LOST 				9
+#define LAT_HIST 				32 //32 buckets, bucket b: 2^b to 2^(b+1)-1 cycles
+#define LAT_NB_BUCKETS 			32
+#define LAT_CTRL_STAMP 			(1 << 0)
+#define LAT_CTRL_CLEAR 			(1 << 1)
+#define LAT_CTRL_CLEAR_MINMAX 	(1 << 2)
+
+// index of the 64bit perf counters
+#define PERF_CYCLES 			0
+#define PERF_RX_PKTS 			1
+#define PERF_RX_BYTES 			2
+#define PERF_TX_PKTS 			3
+#define PERF_TX_BYTES 			4
+#define PERF_RX_DOORBELLS 		5
+#define PERF_TX_DOORBELLS 		6
+#define PERF_ARB_STALL 			7 //cycles with a tail pointer write waiting at the pcie arbiter
+#define PERF_RX_BACKPRESSURE 	8 //cycles with tvalid and no tready on the rx ethernet stream
+#define PERF_TX_BACKPRESSURE 	9
+#define PERF_RX_RING_MAX 		10 //max descriptors held by the fpga in one rx queue since the last snapshot
+#define PERF_TX_RING_MAX 		11 //max descriptors queued for the nic since the last snapshot (HEAD_WB only)
+#define PERF_POLL_STATE 		16 //16 counters: cycles in each poll_state of rx_desc_ctrl, summed over the BYPASS_RINGS queues
+#define PERF_NB_CNT 			32
+#define FPGA_CLK_HZ 			250000000
+
+// doorbell moderation: bursts raise batch and timeout up to the maxima, idle periods lower them to the minima
+#define FPGA_ITR_ADAPTIVE 1
+#define FPGA_ITR_TIME_MIN 125 //0.5us
+#define FPGA_ITR_TIME_MAX 1000 //4us
+#define FPGA_ITR_BATCH_MIN 1
+#define FPGA_ITR_BATCH_MAX 8
+#define FPGA_ITR_RATE_LOW 32 //per window, ~320 kpps
+#define FPGA_ITR_RATE_HIGH 256 //per window, ~2.5 Mpps
+#define FPGA_ITR_WINDOW 25000 //100us
+
+#define FPGA_VENDOR_ID 0x10ee
+#define FPGA_DEVICE_ID 0x9038
+
+#define FPGA_RX_MEM_OFFS 0
+#define FPGA_TX_MEM_OFFS FPGA_RX_MEM_OFFS + 256 * 2048
+#define FPGA_RX_DESC_OFFS FPGA_TX_MEM_OFFS + 256 * 2048 
+#define FPGA_TX_DESC_OFFS FPGA_RX_DESC_OFFS + 4096
+#define FPGA_REGISTERS_OFFS FPGA_TX_DESC_OFFS + 4096
+#define FPGA_RX_DESC_Q_OFFS(q) ((q) == 0 ? FPGA_RX_DESC_OFFS : FPGA_REGISTERS_OFFS + (q) * 4096) //the rx rings of the queues 1-3 are behind the registers
 
 
 
 #define FPGA_BAR_SIZE 2048*1024
-#define FPGA_MEM_SIZE (256+256)*2048 + 2*4096 + 3*4 // tx and rx packet bram + desc bram + 3 registers
-
-//TODO
-#define NIC_REG_ADDR 0xab780000 //this has to be updated manually everytime nic address changes (usually when pcie port is changed)
+#define FPGA_PKT_MEM_SIZE (256 * 2048) //size of each of the rx and tx packet brams
+
+#if BYPASS_RINGS * RX_RING_SIZE * FPGA_BUF_SIZE > FPGA_PKT_MEM_SIZE || TX_RING_SIZE * FPGA_BUF_SIZE > FPGA_PKT_MEM_SIZE
+#error "the packet buffers of the rings do not fit into the fpga packet bram, reduce RX_RING_SIZE/TX_RING_SIZE or FPGA_BUF_SIZE"
+#endif
+#if FPGA_HAIRPIN && !FPGA_HEAD_WB
+#error "the fpga returns the hairpinned rx buffers by the tx head write-back, set FPGA_HEAD_WB"
+#endif
+#if FPGA_HAIRPIN && FPGA_MATCH_ACTION
+#error "the match-action stage needs the ethernet stream, which is left out with hairpin"
+#endif
+#define FPGA_MEM_SIZE (256+256)*2048 + 2*4096 + FPGA_NB_REGS*4 // tx and rx packet bram + desc bram + registers
 
 #define IXGBE_ADV_TX_DESC_DTYP_DATA  3<<20
 #define IXGBE_ADV_TX_DESC_DCMD_EOP 1<<24
@@ -93,21 +196,57 @@ static const struct rte_eth_conf port_conf_default = {
 
 /* basicfwd.c: Basic DPDK skeleton forwarding example. */
 
+static uint64_t fpga_mem_addr;
+static uint64_t nic_reg_addr;
+
+static uint64_t rx_pkt_base_phy;
+static uint64_t rx_desc_base_phy;
+static uint64_t tx_pkt_base_phy;
+static uint64_t tx_desc_base_phy;
+
+static uint64_t nic_rdt_iova[BYPASS_RINGS]; //bus address of the RDT register of each fpga rx queue
+static uint64_t nic_tdt_iova; //bus address of the TDT register of the fpga tx queue
+
+static uint64_t* rx_pkt_base_virt;
+static uint64_t* tx_pkt_base_virt;
+static uint64_t* rx_desc_base_virt;
+static uint64_t* tx_desc_base_virt;
+
+/*
+ * Host Bypassing: mixed placement on one port, see GpuProject/bypass_flow.h.
+ * The queues 0..BYPASS_RINGS-1 are the bypass queues served by the fpga, the queues BYPASS_RINGS..BYPASS_RINGS+HOST_RINGS-1
+ * are normal host queues. A flow is given as "-f proto,src_ip,dst_ip,src_port,dst_port,queue", e.g. "-f udp,10.0.0.1,10.0.0.2,1234,5678,0"
+ * With FPGA_MATCH_ACTION "-d proto,src_ip,dst_ip,src_port,dst_port" drops an untagged IPv4 flow in the fpga.
+ */
+static struct bypass_flow bypass_flows[MAX_BYPASS_FLOWS];
+static unsigned int nb_bypass_flows;
+static struct bypass_flow drop_flows[MAX_BYPASS_FLOWS];
+static unsigned int nb_drop_flows;
+static int stamp_offs = -1; //-t: byte offset of the rx timestamp in the frames, -1 no stamping
+#if HOST_RINGS > 0
+static uint64_t host_pkts;
+#endif
+
 /*
  * Initializes a given port using global settings and with the RX buffers
  * coming from the mbuf_pool passed as a parameter.
+ * If bypass is set, the rx rings of the queues 0..BYPASS_RINGS-1 and the tx ring of queue 0 are placed in the fpga bram.
+ * Without host queues RSS spreads all flows over the bypass queues. Otherwise the HOST_RINGS host queues behind them
+ * keep their rings in host memory, RSS points to them and the bypass flows are steered to their bypass queue.
  */
 static inline int
-port_init(uint16_t port, struct rte_mempool *mbuf_pool)
+port_init(uint16_t port, struct rte_mempool *mbuf_pool, bool bypass)
 {
 	struct rte_eth_conf port_conf = port_conf_default;
-	const uint16_t rx_rings = 1, tx_rings = 1;
+	const uint16_t rx_rings = BYPASS_RINGS + HOST_RINGS, tx_rings = BYPASS_RINGS + HOST_RINGS;
 	uint16_t nb_rxd = RX_RING_SIZE;
 	uint16_t nb_txd = TX_RING_SIZE;
 	int retval;
 	uint16_t q;
 	struct rte_eth_dev_info dev_info;
 	struct rte_eth_txconf txconf;
+	struct rte_eth_rxconf rxconf;
+	struct rte_eth_ext_ring_conf ext_ring;
 
 	printf("RX-ring size: %d, TX-ring size %d\n",RX_RING_SIZE,TX_RING_SIZE );
 	if (!rte_eth_dev_is_valid_port(port))
@@ -118,6 +257,21 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool)
 		port_conf.txmode.offloads |=
 			DEV_TX_OFFLOAD_MBUF_FAST_FREE;
 
+	// jumbo frames, they span several buffers if they exceed FPGA_BUF_SIZE. Host queues fall back to scattered rx
+	if (FPGA_MAX_PKT_LEN > RTE_ETHER_MAX_LEN) {
+		port_conf.rxmode.offloads |= DEV_RX_OFFLOAD_JUMBO_FRAME;
+		port_conf.rxmode.max_rx_pkt_len = FPGA_MAX_PKT_LEN;
+	}
+
+	if (rx_rings > 1) {
+		port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
+		port_conf.rx_adv_conf.rss_conf.rss_key = NULL;
+		port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP | ETH_RSS_SCTP;
+		port_conf.rx_adv_conf.rss_conf.rss_hf &= dev_info.flow_type_rss_offloads;
+	}
+	// the bypass flows are matched by flow director perfect filters, which take precedence over RSS
+	if (bypass && nb_bypass_flows > 0)
+		port_conf.fdir_conf.mode = RTE_FDIR_MODE_PERFECT;
 
 	/* Configure the Ethernet device. */
 	retval = rte_eth_dev_configure(port, rx_rings, tx_rings, &port_conf);
@@ -128,12 +282,25 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool)
 	if (retval != 0)
 		return retval;
 
-	/* Allocate and set up 1 RX queue per Ethernet port. */
+	/* Allocate and set up the bypass and host RX queues per Ethernet port. */
+	rxconf = dev_info.default_rxconf;
+	rxconf.offloads = port_conf.rxmode.offloads;
 	for (q = 0; q < rx_rings; q++) {
+		rxconf.ext_ring = NULL;
+		if (bypass && q < BYPASS_RINGS) {
+			memset(&ext_ring, 0, sizeof(ext_ring));
+			ext_ring.ring_iova = fpga_mem_addr + FPGA_RX_DESC_Q_OFFS(q);
+			ext_ring.buf_size = FPGA_BUF_SIZE;
+			rxconf.ext_ring = &ext_ring;
+		}
 		retval = rte_eth_rx_queue_setup(port, q, nb_rxd,
-				rte_eth_dev_socket_id(port), NULL, mbuf_pool);
+				rte_eth_dev_socket_id(port), &rxconf,
+				rxconf.ext_ring != NULL ? NULL : mbuf_pool);
 		if (retval < 0)
 			return retval;
+		if (rxconf.ext_ring != NULL)
+			printf("rx queue %u: ring 0x%"PRIx64", doorbell 0x%"PRIx64"\n",
+				q, ext_ring.ring_iova, ext_ring.doorbell_iova);
 	}
 
 	txconf = dev_info.default_txconf;
@@ -147,12 +314,22 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool)
 	printf("hthresh: %d\n",txconf.tx_thresh.hthresh);
 	printf("wthresh: %d\n",txconf.tx_thresh.wthresh);
 	printf("rxmode.mq_mode: %x\n",port_conf.rxmode.mq_mode);
-	/* Allocate and set up 1 TX queue per Ethernet port. */
+	/* Allocate and set up the bypass and host TX queues per Ethernet port, the fpga only transmits on queue 0. */
 	for (q = 0; q < tx_rings; q++) {
+		txconf.ext_ring = NULL;
+		if (bypass && q == 0) {
+			memset(&ext_ring, 0, sizeof(ext_ring));
+			ext_ring.ring_iova = tx_desc_base_phy;
+			ext_ring.head_wb_iova = FPGA_HEAD_WB ? tx_desc_base_phy + TX_RING_SIZE * 16 : 0;
+			txconf.ext_ring = &ext_ring;
+		}
 		retval = rte_eth_tx_queue_setup(port, q, nb_txd,
 				rte_eth_dev_socket_id(port), &txconf);
 		if (retval < 0)
 			return retval;
+		if (txconf.ext_ring != NULL)
+			printf("tx queue %u: ring 0x%"PRIx64", doorbell 0x%"PRIx64"\n",
+				q, ext_ring.ring_iova, ext_ring.doorbell_iova);
 	}
 
 	/* Start the Ethernet port. */
@@ -173,6 +350,19 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool)
 	/* Enable RX in promiscuous mode for the Ethernet device. */
 	rte_eth_promiscuous_enable(port);
 
+	if (!bypass)
+		return 0;
+#if HOST_RINGS > 0
+	retval = reta_to_host_queues(port, dev_info.reta_size, BYPASS_RINGS, HOST_RINGS);
+	if (retval != 0)
+		return retval;
+#endif
+	for (unsigned int i = 0; i < nb_bypass_flows; i++) {
+		retval = add_bypass_flow(port, &bypass_flows[i]);
+		if (retval != 0)
+			return retval;
+	}
+
 	return 0;
 }
 
@@ -230,23 +420,13 @@ static void* bar_map(const char * resource, uint32_t size){
 }
 
 
-static uint64_t rx_pkt_base_phy;
-static uint64_t rx_desc_base_phy;
-static uint64_t tx_pkt_base_phy;
-static uint64_t tx_desc_base_phy;
-
-static uint64_t* rx_pkt_base_virt;
-static uint64_t* tx_pkt_base_virt;
-static uint64_t* rx_desc_base_virt;
-static uint64_t* tx_desc_base_virt;
-
 static int write_rx_descriptors(void){
 
 	volatile union ixgbe_adv_rx_desc* desc_bram = (volatile union ixgbe_adv_rx_desc*) rx_desc_base_virt;
 
 	for(int i = 0; i<RX_RING_SIZE;i++){
 
-		desc_bram[i].read.pkt_addr = rx_pkt_base_phy + 2048*i;
+		desc_bram[i].read.pkt_addr = rx_pkt_base_phy + FPGA_BUF_SIZE*i;
 		desc_bram[i].read.hdr_addr = 0;
 	}
 	return 0;
@@ -254,51 +434,66 @@ static int write_rx_descriptors(void){
 
 struct eth_pkt {
 	uint8_t header[14]; //6 Byte dst mac, 6 Byte src mac, 2 Byte type
-	uint8_t* payload; //max 1500 bytes
+	uint8_t* payload; //max FPGA_MAX_PKT_LEN - 14 bytes
 	uint32_t payload_len; //in Byte	
 };
 
-static void copy_pkt(struct eth_pkt* dst, volatile void* src,uint32_t len){
+/* appends the buffer of one rx descriptor to dst, the first buffer of a frame starts with the ethernet header */
+static void copy_pkt_seg(struct eth_pkt* dst, volatile void* src,uint32_t len){
 	volatile uint8_t* src_data = (volatile uint8_t*) src;
-	dst->payload_len = len-14;
-	for (int i = 0; i < 14; ++i)
-	{
-		dst->header[i] = src_data[i];
+	uint32_t offs = 0;
+	if(dst->payload_len == 0) {
+		for (int i = 0; i < 14; ++i)
+		{
+			dst->header[i] = src_data[i];
+		}
+		offs = 14;
 	}
-	for (uint32_t i = 0; i < len-14; ++i)
+	for (uint32_t i = offs; i < len && dst->payload_len < FPGA_MAX_PKT_LEN - 14; ++i)
 	{
-		dst->payload[i] = src_data[i+14];
+		dst->payload[dst->payload_len++] = src_data[i];
 	}
 }
 
-static void fpga_recv(volatile uint32_t *rxq_rdt_reg_addr,struct eth_pkt* rx_pkt){
+static uint32_t rx_pkt_index = 0;
+
+/*
+ * polls the fpga rx ring from the last position on. Frames longer than FPGA_BUF_SIZE span several descriptors,
+ * their buffers are appended to rx_pkt until the descriptor with EOP. Returns 1 if rx_pkt holds a complete frame.
+ */
+static int fpga_recv(volatile uint32_t *rxq_rdt_reg_addr,struct eth_pkt* rx_pkt){
 
 	volatile union ixgbe_adv_rx_desc *rx_ring = (volatile union ixgbe_adv_rx_desc* ) rx_desc_base_virt;
 	volatile union ixgbe_adv_rx_desc *rx_desc;
 	uint32_t staterr;
-	uint16_t pkt_len; 
-
+	uint16_t seg_len; 
+	volatile uint64_t* seg;
 
-	for(int i = 0;i<RX_RING_SIZE;i++) {
-		rx_desc = &rx_ring[i];
+	while(1) {
+		rx_desc = &rx_ring[rx_pkt_index];
 		staterr = rx_desc->wb.upper.status_error;
 
-		if(staterr&1) { //check for DD bit
+		if(!(staterr & IXGBE_RXDADV_STAT_DD))
+			return 0;
 
-			pkt_len = rx_desc->wb.upper.length;
+		seg_len = rx_desc->wb.upper.length;
+		seg = rx_pkt_base_virt + rx_pkt_index * FPGA_BUF_SIZE/8;
 
-			printf("new packet at desc: %d, packet length %d Bytes, status: %x\n",i,pkt_len,staterr );
+		printf("new buffer at desc: %d, length %d Bytes, status: %x\n",rx_pkt_index,seg_len,staterr );
 
-			copy_pkt(rx_pkt,rx_pkt_base_virt + i * 2048/8,pkt_len);
+		copy_pkt_seg(rx_pkt,seg,seg_len);
+		print_fpga_packet((void*) seg,seg_len);
 
-			rx_desc->read.hdr_addr = 0;
-			rx_desc->read.pkt_addr = rx_pkt_base_phy + 2048 * i;
-			print_fpga_packet(rx_pkt_base_virt + i * 2048/8,pkt_len);
+		rx_desc->read.hdr_addr = 0;
+		rx_desc->read.pkt_addr = rx_pkt_base_phy + FPGA_BUF_SIZE * rx_pkt_index;
+		IXGBE_PCI_REG_WRITE(rxq_rdt_reg_addr, rx_pkt_index); //advance tail pointer
 
+		rx_pkt_index++;
+		if(rx_pkt_index==RX_RING_SIZE)
+			rx_pkt_index=0;
 
-			IXGBE_PCI_REG_WRITE(rxq_rdt_reg_addr, i); //advance tail pointer
-			
-		 }
+		if(staterr & IXGBE_RXDADV_STAT_EOP)
+			return 1;
 	}
 }
 
@@ -307,24 +502,23 @@ static void fpga_recv(volatile uint32_t *rxq_rdt_reg_addr,struct eth_pkt* rx_pkt
 
 static uint32_t tx_pkt_index = 0;
 
-static void fpga_write_pkt_data(volatile void* fpga_tx_pkt_mem, struct eth_pkt* pkt_buffer){
+static void fpga_write_pkt_data(volatile void* fpga_tx_pkt_mem, const uint8_t* data, uint32_t len){
 	volatile uint8_t* pkt_mem = (volatile uint8_t*) fpga_tx_pkt_mem;
 
-	for (uint32_t i = 0; i < 14; ++i){
-		pkt_mem[i] = pkt_buffer->header[i];
-	}
-	for (uint32_t i = 0; i <pkt_buffer->payload_len ; ++i){
-		pkt_mem[14+i] = pkt_buffer->payload[i];
+	for (uint32_t i = 0; i < len; ++i){
+		pkt_mem[i] = data[i];
 	}
 }
 
-static void fpga_write_tx_desc(volatile void* fpga_tx_desc_mem,struct eth_pkt* pkt_buffer, uint64_t pkt_addr ){
+static void fpga_write_tx_desc(volatile void* fpga_tx_desc_mem, uint64_t pkt_addr, uint32_t seg_len, uint32_t pkt_len, bool eop){
 	union ixgbe_adv_tx_desc txd;
 	volatile union ixgbe_adv_tx_desc* tx_desc_ring = (volatile union ixgbe_adv_tx_desc*) fpga_tx_desc_mem;
 
 	txd.read.buffer_addr = pkt_addr;
-	txd.read.cmd_type_len = (pkt_buffer->payload_len+14) | IXGBE_ADV_TX_DESC_DTYP_DATA | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_DESC_DCMD_EOP | IXGBE_ADV_TX_DESC_DCMD_INS_FCS;
-	txd.read.olinfo_status = (pkt_buffer->payload_len+14) << IXGBE_ADV_TX_PAYLEN_SHIFT;
+	txd.read.cmd_type_len = seg_len | IXGBE_ADV_TX_DESC_DTYP_DATA | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_DESC_DCMD_INS_FCS;
+	if(eop)
+		txd.read.cmd_type_len |= IXGBE_ADV_TX_DESC_DCMD_EOP;
+	txd.read.olinfo_status = pkt_len << IXGBE_ADV_TX_PAYLEN_SHIFT;
 
 	tx_desc_ring[0].read.buffer_addr   = txd.read.buffer_addr;
 	tx_desc_ring[0].read.cmd_type_len  = txd.read.cmd_type_len;
@@ -332,19 +526,30 @@ static void fpga_write_tx_desc(volatile void* fpga_tx_desc_mem,struct eth_pkt* p
 
 }
 
+/* frames longer than FPGA_BUF_SIZE are written to several buffers with one descriptor each, the tail pointer is written once */
 static void fpga_xmit(struct eth_pkt* pkt_buffer,volatile uint32_t *txq_tdt_reg_addr){
+	uint32_t pkt_len = pkt_buffer->payload_len+14;
+	uint8_t frame[pkt_len];
+	uint32_t seg_len;
 
-	printf("writing packet index: %d, pkt_length: %d\n",tx_pkt_index,pkt_buffer->payload_len+14 );
-	//write packet data to fpga
-	fpga_write_pkt_data(tx_pkt_base_virt + tx_pkt_index * 2048,pkt_buffer);
-	
-	//write tx desc to fpga
-	fpga_write_tx_desc(tx_desc_base_virt + tx_pkt_index * 16,pkt_buffer, tx_pkt_base_phy + tx_pkt_index * 2048);
+	memcpy(frame,pkt_buffer->header,14);
+	memcpy(frame+14,pkt_buffer->payload,pkt_buffer->payload_len);
 
-	//increase local tx-tail
-	tx_pkt_index++;
-	if(tx_pkt_index==TX_RING_SIZE)
-		tx_pkt_index=0;
+	printf("writing packet index: %d, pkt_length: %d\n",tx_pkt_index,pkt_len );
+	for(uint32_t offs = 0; offs < pkt_len; offs += seg_len) {
+		seg_len = RTE_MIN(pkt_len - offs, (uint32_t) FPGA_BUF_SIZE);
+
+		//write packet data to fpga
+		fpga_write_pkt_data(tx_pkt_base_virt + tx_pkt_index * FPGA_BUF_SIZE/8,frame + offs,seg_len);
+
+		//write tx desc to fpga
+		fpga_write_tx_desc(tx_desc_base_virt + tx_pkt_index * 16/8, tx_pkt_base_phy + tx_pkt_index * FPGA_BUF_SIZE, seg_len, pkt_len, offs + seg_len == pkt_len);
+
+		//increase local tx-tail
+		tx_pkt_index++;
+		if(tx_pkt_index==TX_RING_SIZE)
+			tx_pkt_index=0;
+	}
 
 	//write tail pointer to nic
 	IXGBE_PCI_REG_WRITE(txq_tdt_reg_addr, tx_pkt_index);
@@ -354,8 +559,19 @@ static void fpga_xmit(struct eth_pkt* pkt_buffer,volatile uint32_t *txq_tdt_reg_
 
 static void init_fpga(volatile void* fpga_reg_bar){
 	volatile uint32_t* reg_mem = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4;
-	reg_mem[NIC_BASE_ADDR_REG]         = NIC_REG_ADDR;
-	reg_mem[FPGA_BASE_ADDR_REG]        = FPGA_MEM_ADDR;
+	reg_mem[NIC_BASE_ADDR_REG]         = (uint32_t) nic_reg_addr;
+	reg_mem[NIC_BASE_ADDR_HI_REG]      = (uint32_t) (nic_reg_addr >> 32);
+	reg_mem[FPGA_BASE_ADDR_REG]        = (uint32_t) fpga_mem_addr;
+	for (int q = 0; q < BYPASS_RINGS; ++q) {
+		reg_mem[NIC_RDT_ADDR_Q_REG(q)]     = (uint32_t) nic_rdt_iova[q];
+		reg_mem[NIC_RDT_ADDR_Q_REG(q) + 1] = (uint32_t) (nic_rdt_iova[q] >> 32);
+	}
+	reg_mem[NIC_TDT_ADDR_REG]          = (uint32_t) nic_tdt_iova;
+	reg_mem[NIC_TDT_ADDR_HI_REG]       = (uint32_t) (nic_tdt_iova >> 32);
+	reg_mem[ITR_TIME_REG]              = FPGA_ITR_TIME_MAX << 16 | FPGA_ITR_TIME_MIN;
+	reg_mem[ITR_BATCH_REG]             = FPGA_ITR_BATCH_MAX << 16 | FPGA_ITR_BATCH_MIN;
+	reg_mem[ITR_RATE_REG]              = FPGA_ITR_RATE_HIGH << 16 | FPGA_ITR_RATE_LOW;
+	reg_mem[ITR_CTRL_REG]              = FPGA_ITR_ADAPTIVE << 16 | FPGA_ITR_WINDOW;
 	reg_mem[COMMAND_REG]               = 3; //1:start and 0:init 
 
 	printf("\n");
@@ -363,8 +579,11 @@ static void init_fpga(volatile void* fpga_reg_bar){
 	printf("\n");
 	printf("fpga_reg_bar %x\n", *((volatile uint32_t *) fpga_reg_bar) );
 	printf("reg_mem %x\n", *reg_mem);
-	printf("NIC_REG_ADDR %x\n", NIC_REG_ADDR);
-	printf("FPGA_MEM_ADDR %x\n", FPGA_MEM_ADDR);
+	printf("nic_reg_addr %"PRIx64"\n", nic_reg_addr);
+	printf("fpga_mem_addr %"PRIx64"\n", fpga_mem_addr);
+	for (int q = 0; q < BYPASS_RINGS; ++q)
+		printf("rx queue %d: rdt %"PRIx64"\n", q, nic_rdt_iova[q]);
+	printf("tdt %"PRIx64"\n", nic_tdt_iova);
 	printf("reg_mem[NIC_BASE_ADDR_REG]  %x\n", reg_mem[NIC_BASE_ADDR_REG] );
 	printf("reg_mem[FPGA_BASE_ADDR_REG]  %x\n", reg_mem[FPGA_BASE_ADDR_REG] );
 }
@@ -404,13 +623,13 @@ static void software_driver_loop(volatile uint32_t* rxq_rdt_reg_addr,volatile ui
 	uint32_t tdh_reg_old = -1;
 	char print_char = 'o';
 	struct eth_pkt rx_pkt;
-	uint8_t rx_pkt_payload[1500];
+	uint8_t rx_pkt_payload[FPGA_MAX_PKT_LEN];
 	rx_pkt.payload = rx_pkt_payload;
+	rx_pkt.payload_len = 0;
 
 	while(1){
 
-		fpga_recv(rxq_rdt_reg_addr,&rx_pkt);
-		if(rx_pkt.payload_len>0){
+		if(fpga_recv(rxq_rdt_reg_addr,&rx_pkt)){
 			printf("SEND:\n");
 			fpga_xmit(&rx_pkt,txq_tdt_reg_addr);
 			rx_pkt.payload_len = 0;
@@ -517,19 +736,205 @@ static void print_tail_head_regs(void){
 }
 
 
+/*
+ * latches all fpga perf counters in the same clock cycle and reads the snapshot.
+ * The snapshot is complete once its cycle counter differs from the previous one, the register write may still be in flight at the first read.
+ */
+static void read_perf_counters(volatile void* fpga_reg_bar, uint64_t* cnt){
+	volatile uint32_t* reg_mem = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4;
+	uint32_t old_cycles = reg_mem[PERF_CNT_REG + 2*PERF_CYCLES];
+
+	reg_mem[PERF_SNAPSHOT_REG] = 1;
+	for (int i = 0; i < 1000 && reg_mem[PERF_CNT_REG + 2*PERF_CYCLES] == old_cycles; ++i)
+		;
+	for (int i = 0; i < PERF_NB_CNT; ++i)
+		cnt[i] = (uint64_t) reg_mem[PERF_CNT_REG + 2*i + 1] << 32 | reg_mem[PERF_CNT_REG + 2*i];
+}
+
+static uint64_t perf_old[PERF_NB_CNT];
+static void print_perf_counters(volatile void* fpga_reg_bar){
+	uint64_t cnt[PERF_NB_CNT];
+	uint64_t d[PERF_NB_CNT];
+
+	read_perf_counters(fpga_reg_bar, cnt);
+	for (int i = 0; i < PERF_NB_CNT; ++i)
+		d[i] = cnt[i] - perf_old[i];
+	memcpy(perf_old, cnt, sizeof(cnt));
+	if(cnt[PERF_CYCLES] < d[PERF_CYCLES]) //the counters were cleared by an init
+		return;
+	if(d[PERF_CYCLES] == 0)
+		return;
+
+	double sec = (double) d[PERF_CYCLES] / FPGA_CLK_HZ;
+	double cyc = (double) d[PERF_CYCLES] / 100;
+	printf("fpga rx: %.3f Mpps %.3f Gbit/s, tx: %.3f Mpps %.3f Gbit/s\n",
+			d[PERF_RX_PKTS] / sec / 1e6, d[PERF_RX_BYTES] * 8 / sec / 1e9,
+			d[PERF_TX_PKTS] / sec / 1e6, d[PERF_TX_BYTES] * 8 / sec / 1e9);
+	printf("fpga doorbells rx: %"PRIu64" tx: %"PRIu64", arbiter stall: %.2f%%, back-pressure rx: %.2f%% tx: %.2f%%, max ring rx: %"PRIu64" tx: %"PRIu64"\n",
+			d[PERF_RX_DOORBELLS], d[PERF_TX_DOORBELLS], d[PERF_ARB_STALL] / cyc,
+			d[PERF_RX_BACKPRESSURE] / cyc, d[PERF_TX_BACKPRESSURE] / cyc,
+			cnt[PERF_RX_RING_MAX], cnt[PERF_TX_RING_MAX]);
+	printf("fpga poll_state (all rx queues):");
+	for (int i = 0; i < PERF_NB_CNT - PERF_POLL_STATE; ++i)
+		if(d[PERF_POLL_STATE + i] != 0)
+			printf(" %d: %.2f%%", i, d[PERF_POLL_STATE + i] / cyc / BYPASS_RINGS);
+	printf("\n");
+}
+
+
+#if FPGA_MATCH_ACTION
+/*
+ * writes the drop flows into the exact match table of the match-action stage.
+ * The entry of a key is at the hash the fpga computes from the staged key, a flow whose slot is taken goes into the ternary table with a full mask.
+ */
+static int ma_load_drop_flows(volatile void* fpga_reg_bar){
+	volatile uint32_t* ma = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4 + MA_REG;
+	static bool em_used[1 << 16];
+	uint32_t em_entries = ma[MA_INFO] & 0xffff;
+	uint32_t tc_entries = ma[MA_INFO] >> 16;
+	uint32_t tc_ix = 0;
+
+	//the tables survive an init, delete the entries of a previous run
+	for (uint32_t ix = 0; ix < em_entries; ix++)
+		ma[MA_CMD] = ix;
+	for (uint32_t ix = 0; ix < tc_entries; ix++)
+		ma[MA_CMD] = MA_CMD_TERNARY | ix;
+
+	for (unsigned int i = 0; i < nb_drop_flows; i++) {
+		const struct bypass_flow *f = &drop_flows[i];
+		uint32_t key[MA_KEY_WORDS] = {0};
+
+		key[0] = (uint32_t) rte_be_to_cpu_16(f->src_port) << 16 | rte_be_to_cpu_16(f->dst_port);
+		key[1] = MA_KEY_PORTS | MA_KEY_IPV4 | f->proto;
+		key[2] = rte_be_to_cpu_32(f->src_ip);
+		key[6] = rte_be_to_cpu_32(f->dst_ip);
+		for (int w = 0; w < MA_KEY_WORDS; ++w) {
+			ma[MA_KEY + w]  = key[w];
+			ma[MA_MASK + w] = 0xffffffff;
+		}
+		ma[MA_ACTION] = MA_ACT_DROP;
+
+		uint32_t ix = ma[MA_HASH]; //the read also flushes the posted key writes
+		if(!em_used[ix]) {
+			em_used[ix] = true;
+			ma[MA_CMD] = MA_CMD_VALID | ix;
+		} else if(tc_ix < tc_entries) {
+			ma[MA_CMD] = MA_CMD_VALID | MA_CMD_TERNARY | tc_ix++;
+		} else {
+			printf("no free match-action entry for drop flow %u\n", i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void print_ma_counters(volatile void* fpga_reg_bar){
+	volatile uint32_t* ma = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4 + MA_REG;
+	printf("fpga match-action: drops %u, misses %u, exact hits %u, ternary hits %u, skipped rewrites %u\n",
+			ma[MA_DROPS], ma[MA_MISSES], ma[MA_EM_HITS], ma[MA_TC_HITS], ma[MA_RW_SKIPS]);
+}
+#endif
+
+
+// counters of the latency monitor at the last print, they are not cleared in between
+struct lat_counters {
+	uint32_t cnt;
+	uint64_t sum;
+	uint32_t unmatched;
+	uint32_t lost;
+	uint32_t hist[LAT_NB_BUCKETS];
+};
+static struct lat_counters lat_last;
+
+static void init_latency_monitor(volatile void* fpga_reg_bar){
+	volatile uint32_t* lat = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4 + LAT_REG;
+	if(stamp_offs >= 0)
+		lat[LAT_STAMP_OFFS] = stamp_offs;
+	lat[LAT_CTRL] = (stamp_offs >= 0 ? LAT_CTRL_STAMP : 0) | LAT_CTRL_CLEAR;
+	memset(&lat_last, 0, sizeof(lat_last));
+}
+
+/*
+ * prints the residence time of the frames in the fpga (rx descriptor write-back to tx doorbell) since the last call.
+ * The counters keep running and the differences to the last call are printed (32 bit wrap around), so frames
+ * measured while reading are counted in the next call. Only min and max are cleared.
+ * The buckets are printed as upper bound in ns.
+ */
+static void print_latency_histogram(volatile void* fpga_reg_bar){
+	volatile uint32_t* lat = (volatile uint32_t*) fpga_reg_bar + (256 + 256) * 2048 /4 + 2*4096/4 + LAT_REG;
+	uint32_t min = lat[LAT_MIN];
+	uint32_t max = lat[LAT_MAX];
+	lat[LAT_CTRL] = (stamp_offs >= 0 ? LAT_CTRL_STAMP : 0) | LAT_CTRL_CLEAR_MINMAX;
+
+	struct lat_counters now;
+	now.cnt = lat[LAT_CNT];
+	uint32_t sum_hi;
+	do { //the sum may carry into the high word between the two reads
+		sum_hi = lat[LAT_SUM + 1];
+		now.sum = (uint64_t) sum_hi << 32 | lat[LAT_SUM];
+	} while (sum_hi != lat[LAT_SUM + 1]);
+	now.unmatched = lat[LAT_UNMATCHED];
+	now.lost = lat[LAT_LOST];
+	for (int i = 0; i < LAT_NB_BUCKETS; ++i)
+		now.hist[i] = lat[LAT_HIST + i];
+
+	uint32_t cnt = now.cnt - lat_last.cnt;
+	uint64_t sum = now.sum - lat_last.sum;
+	uint32_t unmatched = now.unmatched - lat_last.unmatched;
+	uint32_t lost = now.lost - lat_last.lost;
+	uint32_t hist[LAT_NB_BUCKETS];
+	for (int i = 0; i < LAT_NB_BUCKETS; ++i)
+		hist[i] = now.hist[i] - lat_last.hist[i];
+	lat_last = now;
+
+	if(cnt == 0)
+		return;
+	double ns = 1e9 / FPGA_CLK_HZ;
+	printf("fpga residence time: %u frames, min %.0f ns, avg %.0f ns, max %.0f ns, unmatched %u, lost %u\n",
+			cnt, min * ns, (double) sum / cnt * ns, max * ns, unmatched, lost);
+	printf("fpga residence histogram:");
+	for (int i = 0; i < LAT_NB_BUCKETS; ++i)
+		if(hist[i] != 0)
+			printf(" <%.0fns: %u", (double) ((uint64_t) 2 << i) * ns, hist[i]);
+	printf("\n");
+}
+
+
 /**
-* This function is for monitoring/debugging only
+* This function is for monitoring/debugging only.
+* With host queues it also runs the host path of the port.
 **/
-static void hardware_loop(void* fpga_bar_virt){
+static void hardware_loop(void* fpga_bar_virt, uint16_t port){
+	uint64_t hz = rte_get_timer_hz();
+	uint64_t next = rte_get_timer_cycles() + hz;
 
 	reset_bram(fpga_bar_virt,FPGA_MEM_SIZE);
 
 	init_fpga(fpga_bar_virt);
-
+	init_latency_monitor(fpga_bar_virt);
+#if FPGA_MATCH_ACTION
+	if(ma_load_drop_flows(fpga_bar_virt) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot load the drop flows into the fpga\n");
+#endif
 
 	while(1){
-		 sleep(1);
+#if HOST_RINGS > 0
+		host_pkts += host_poll(port, BYPASS_RINGS, HOST_RINGS);
+		if(rte_get_timer_cycles() < next)
+			continue;
+		next += hz;
+		printf("host queues: %"PRIu64" pkts\n", host_pkts);
+#else
+		RTE_SET_USED(port);
+		RTE_SET_USED(next);
+		sleep(1);
+#endif
 		print_tail_head_regs();
+		print_perf_counters(fpga_bar_virt);
+		print_latency_histogram(fpga_bar_virt);
+#if FPGA_MATCH_ACTION
+		print_ma_counters(fpga_bar_virt);
+#endif
 	}
 }
 
@@ -552,11 +957,6 @@ main(int argc, char *argv[])
 
 	uint16_t port_id = 0;
 
-	struct ixgbe_hw     *hw;
-
-	struct rte_eth_dev* dev = eth_dev_get(port_id);
-	const struct rte_memzone *rz;
-
 	
 	
 
@@ -564,9 +964,43 @@ main(int argc, char *argv[])
 	argv += ret;
 
 
-	hw = IXGBE_DEV_PRIVATE_TO_HW(dev->data->dev_private);
+	char fpga_bdf[PATH_MAX];
+	char nic_bdf[PATH_MAX];
+	char fpga_bar_file[PATH_MAX];
+
+	int opt;
+	while ((opt = getopt(argc, argv, "f:d:t:")) != -1) {
+		if (opt == 'f' && nb_bypass_flows < MAX_BYPASS_FLOWS &&
+		    parse_bypass_flow(optarg, &bypass_flows[nb_bypass_flows], true, BYPASS_RINGS) == 0)
+			nb_bypass_flows++;
+		else if (opt == 'd' && FPGA_MATCH_ACTION && nb_drop_flows < MAX_BYPASS_FLOWS &&
+		    parse_bypass_flow(optarg, &drop_flows[nb_drop_flows], false, BYPASS_RINGS) == 0)
+			nb_drop_flows++;
+		else if (opt == 't' && !FPGA_HAIRPIN && sscanf(optarg, "%d", &stamp_offs) == 1 && stamp_offs >= 0 && stamp_offs <= UINT16_MAX)
+			;
+		else
+			rte_exit(EXIT_FAILURE, "usage: %s [EAL options] -- [-f proto,src_ip,dst_ip,src_port,dst_port,queue]... [-d proto,src_ip,dst_ip,src_port,dst_port]... [-t stamp offset] [fpga pci address]\n", argv[0]);
+	}
 
-	void* fpga_bar_virt = bar_map(FPGA_BAR_FILE,FPGA_BAR_SIZE);
+	if(optind < argc)
+		snprintf(fpga_bdf, sizeof(fpga_bdf), "%s", argv[optind]);
+	else if(sysfs_find_device(FPGA_VENDOR_ID, FPGA_DEVICE_ID, fpga_bdf, sizeof(fpga_bdf)) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot find fpga %04x:%04x\n", FPGA_VENDOR_ID, FPGA_DEVICE_ID);
+	if(sysfs_read_bar(fpga_bdf, 0, &fpga_mem_addr) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot read bar 0 of fpga %s\n", fpga_bdf);
+	if(fpga_mem_addr >> 32)
+		rte_exit(EXIT_FAILURE, "fpga bar 0 at 0x%"PRIx64" is above 4GB, the fpga only supports 32 bit buffer addresses\n", fpga_mem_addr);
+
+	if(port_pci_addr(port_id, nic_bdf, sizeof(nic_bdf)) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot get pci address of port %"PRIu16"\n", port_id);
+	if(sysfs_read_bar(nic_bdf, 0, &nic_reg_addr) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot read bar 0 of nic %s\n", nic_bdf);
+
+	printf("fpga %s: bar 0 at 0x%"PRIx64"\n", fpga_bdf, fpga_mem_addr);
+	printf("nic %s: bar 0 at 0x%"PRIx64"\n", nic_bdf, nic_reg_addr);
+
+	snprintf(fpga_bar_file, sizeof(fpga_bar_file), SYSFS_PCI_DEVICES "/%s/resource0", fpga_bdf);
+	void* fpga_bar_virt = bar_map(fpga_bar_file,FPGA_BAR_SIZE);
 	if(fpga_bar_virt==NULL){
 		printf("couldnt map bar 0\n");
 		return errno;
@@ -584,37 +1018,39 @@ main(int argc, char *argv[])
 	if (mbuf_pool == NULL)
 		rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
 
-	rz = rte_eth_dma_zone_reserve(dev, "custom_mem", 0,
-		512*1024,
-		128, rte_eth_dev_socket_id(0));
 	
-	rx_pkt_base_phy   = FPGA_RX_MEM_ADDR;  
-	tx_pkt_base_phy   = FPGA_TX_MEM_ADDR;  
-	rx_desc_base_phy  = FPGA_RX_DESC_ADDR; 
-	tx_desc_base_phy  = FPGA_TX_DESC_ADDR; 
+	rx_pkt_base_phy   = fpga_mem_addr + FPGA_RX_MEM_OFFS;  
+	tx_pkt_base_phy   = fpga_mem_addr + FPGA_TX_MEM_OFFS;  
+	rx_desc_base_phy  = fpga_mem_addr + FPGA_RX_DESC_OFFS; 
+	tx_desc_base_phy  = fpga_mem_addr + FPGA_TX_DESC_OFFS; 
 
 	rx_pkt_base_virt  = (uint64_t*) fpga_bar_virt;
 	tx_pkt_base_virt  = (uint64_t*) fpga_bar_virt + 256 * 2048/8; //divide by 8 because 8 bytes in 64bit, 2048bytes space per packet
 	rx_desc_base_virt = (uint64_t*) fpga_bar_virt + (256 + 256) * 2048/8; 
 	tx_desc_base_virt = (uint64_t*) fpga_bar_virt + (256 + 256) * 2048/8 + 4096/8;
 
-	hw->custom_addr_enable = true;
-	hw->custom_rx_desc_addr = rx_desc_base_phy;
-	hw->custom_tx_desc_addr = tx_desc_base_phy;
-
 
-	printf("rz_iova : 0x%"PRIx64"\n", rz->iova );
-	printf("rz_addr : %p\n", rz->addr );
 	/* Initialize all ports. */
 	RTE_ETH_FOREACH_DEV(portid)
-		if (port_init(portid, mbuf_pool) != 0)
+		if (port_init(portid, mbuf_pool, portid == port_id) != 0)
 			rte_exit(EXIT_FAILURE, "Cannot init port %"PRIu16 "\n",
 					portid);
 
+	/* the fpga rings the doorbells of its rx queues and of tx queue 0 by DMA */
+	struct ixgbe_queue_regs rx_regs, tx_regs;
+	for (uint16_t q = 0; q < BYPASS_RINGS; q++) {
+		if (ixgbe_dev_rx_queue_regs(eth_dev_get(port_id), q, &rx_regs) != 0)
+			rte_exit(EXIT_FAILURE, "Cannot get the doorbell of rx queue %"PRIu16" of port %"PRIu16"\n", q, port_id);
+		nic_rdt_iova[q] = rx_regs.tail_iova;
+	}
+	if (ixgbe_dev_tx_queue_regs(eth_dev_get(port_id), 0, &tx_regs) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot get the doorbells of port %"PRIu16"\n", port_id);
+	nic_tdt_iova = tx_regs.tail_iova;
+
 	if (rte_lcore_count() > 1)
 		printf("\nWARNING: Too many lcores enabled. Only 1 used.\n");
 	
-	hardware_loop(fpga_bar_virt);
+	hardware_loop(fpga_bar_virt, port_id);
 
 	if(false){software_driver_loop(0,0);}
 
@@ -35,6 +35,7 @@
 #include <rte_mbuf.h>
 #include <rte_ether.h>
 #include <rte_ethdev_driver.h>
+#include <rte_ethdev_pci.h>
 #include <rte_prefetch.h>
 #include <rte_udp.h>
 #include <rte_tcp.h>
@@ -2448,21 +2449,27 @@ ixgbe_reset_tx_queue(struct ixgbe_tx_queue *txq)
 	struct ixgbe_tx_entry *txe = txq->sw_ring;
 	uint16_t prev, i;
 
-	/* Zero out HW ring memory */
-	for (i = 0; i < txq->nb_tx_desc; i++) {
-		txq->tx_ring[i] = zeroed_desc;
-	}
+	/*
+	 * Host Bypassing: there is neither a host ring nor a SW ring,
+	 * the external producer initializes its ring itself.
+	 */
+	if (txq->tx_ring != NULL) {
+		/* Zero out HW ring memory */
+		for (i = 0; i < txq->nb_tx_desc; i++) {
+			txq->tx_ring[i] = zeroed_desc;
+		}
 
-	/* Initialize SW ring entries */
-	prev = (uint16_t) (txq->nb_tx_desc - 1);
-	for (i = 0; i < txq->nb_tx_desc; i++) {
-		volatile union ixgbe_adv_tx_desc *txd = &txq->tx_ring[i];
+		/* Initialize SW ring entries */
+		prev = (uint16_t) (txq->nb_tx_desc - 1);
+		for (i = 0; i < txq->nb_tx_desc; i++) {
+			volatile union ixgbe_adv_tx_desc *txd = &txq->tx_ring[i];
 
-		txd->wb.status = rte_cpu_to_le_32(IXGBE_TXD_STAT_DD);
-		txe[i].mbuf = NULL;
-		txe[i].last_id = i;
-		txe[prev].next_id = i;
-		prev = i;
+			txd->wb.status = rte_cpu_to_le_32(IXGBE_TXD_STAT_DD);
+			txe[i].mbuf = NULL;
+			txe[i].last_id = i;
+			txe[prev].next_id = i;
+			prev = i;
+		}
 	}
 
 	txq->tx_next_dd = (uint16_t)(txq->tx_rs_thresh - 1);
@@ -2562,6 +2569,74 @@ ixgbe_get_tx_port_offloads(struct rte_eth_dev *dev)
 	return tx_offload_capa;
 }
 
+/*
+ * Host Bypassing: bus address of a mapped register in BAR0 of the device,
+ * e.g. the tail register an external ring producer writes to by DMA.
+ */
+static uint64_t
+ixgbe_reg_bus_addr(struct rte_eth_dev *dev, volatile uint32_t *reg_addr)
+{
+	struct rte_pci_device *pci_dev = RTE_ETH_DEV_TO_PCI(dev);
+	struct ixgbe_hw *hw = IXGBE_DEV_PRIVATE_TO_HW(dev->data->dev_private);
+
+	return pci_dev->mem_resource[0].phys_addr +
+		((uintptr_t)reg_addr - (uintptr_t)hw->hw_addr);
+}
+
+/*
+ * Host Bypassing: packet buffer size of a RX queue with an external ring,
+ * IXGBE_EXT_RX_BUF_SIZE if size is 0. Returns 0 if size cannot be programmed
+ * into SRRCTL.BSIZEPACKET (1 KB resolution, up to 16 KB).
+ */
+static uint16_t
+ixgbe_ext_rx_buf_size(uint16_t size)
+{
+	if (size == 0)
+		return IXGBE_EXT_RX_BUF_SIZE;
+	if (size % (1 << IXGBE_SRRCTL_BSIZEPKT_SHIFT) != 0 ||
+	    size > IXGBE_EXT_RX_BUF_MAX)
+		return 0;
+	return size;
+}
+
+int
+ixgbe_dev_rx_queue_regs(struct rte_eth_dev *dev, uint16_t rx_queue_id,
+			struct ixgbe_queue_regs *regs)
+{
+	struct ixgbe_rx_queue *rxq;
+
+	if (rx_queue_id >= dev->data->nb_rx_queues)
+		return -EINVAL;
+	rxq = dev->data->rx_queues[rx_queue_id];
+	if (rxq == NULL)
+		return -EINVAL;
+
+	regs->head_addr = rxq->rdh_reg_addr;
+	regs->tail_addr = rxq->rdt_reg_addr;
+	regs->head_iova = ixgbe_reg_bus_addr(dev, regs->head_addr);
+	regs->tail_iova = ixgbe_reg_bus_addr(dev, regs->tail_addr);
+	return 0;
+}
+
+int
+ixgbe_dev_tx_queue_regs(struct rte_eth_dev *dev, uint16_t tx_queue_id,
+			struct ixgbe_queue_regs *regs)
+{
+	struct ixgbe_tx_queue *txq;
+
+	if (tx_queue_id >= dev->data->nb_tx_queues)
+		return -EINVAL;
+	txq = dev->data->tx_queues[tx_queue_id];
+	if (txq == NULL)
+		return -EINVAL;
+
+	regs->head_addr = txq->tdh_reg_addr;
+	regs->tail_addr = txq->tdt_reg_addr;
+	regs->head_iova = ixgbe_reg_bus_addr(dev, regs->head_addr);
+	regs->tail_iova = ixgbe_reg_bus_addr(dev, regs->tail_addr);
+	return 0;
+}
+
 int __rte_cold
 ixgbe_dev_tx_queue_setup(struct rte_eth_dev *dev,
 			 uint16_t queue_idx,
@@ -2697,19 +2772,6 @@ ixgbe_dev_tx_queue_setup(struct rte_eth_dev *dev,
 	if (txq == NULL)
 		return -ENOMEM;
 
-	/*
-	 * Allocate TX ring hardware descriptors. A memzone large enough to
-	 * handle the maximum ring size is allocated in order to allow for
-	 * resizing in later calls to the queue setup function.
-	 */
-	tz = rte_eth_dma_zone_reserve(dev, "tx_ring", queue_idx,
-			sizeof(union ixgbe_adv_tx_desc) * IXGBE_MAX_RING_DESC,
-			IXGBE_ALIGN, socket_id);
-	if (tz == NULL) {
-		ixgbe_tx_queue_release(txq);
-		return -ENOMEM;
-	}
-
 	txq->nb_tx_desc = nb_desc;
 	txq->tx_rs_thresh = tx_rs_thresh;
 	txq->tx_free_thresh = tx_free_thresh;
@@ -2735,10 +2797,63 @@ ixgbe_dev_tx_queue_setup(struct rte_eth_dev *dev,
 	    hw->mac.type == ixgbe_mac_X540_vf ||
 	    hw->mac.type == ixgbe_mac_X550_vf ||
 	    hw->mac.type == ixgbe_mac_X550EM_x_vf ||
-	    hw->mac.type == ixgbe_mac_X550EM_a_vf)
+	    hw->mac.type == ixgbe_mac_X550EM_a_vf) {
 		txq->tdt_reg_addr = IXGBE_PCI_REG_ADDR(hw, IXGBE_VFTDT(queue_idx));
-	else
+		txq->tdh_reg_addr = IXGBE_PCI_REG_ADDR(hw, IXGBE_VFTDH(queue_idx));
+	} else {
 		txq->tdt_reg_addr = IXGBE_PCI_REG_ADDR(hw, IXGBE_TDT(txq->reg_idx));
+		txq->tdh_reg_addr = IXGBE_PCI_REG_ADDR(hw, IXGBE_TDH(txq->reg_idx));
+	}
+
+	/* Host Bypassing: the NIC fetches descriptors from external memory */
+	if (tx_conf->ext_ring != NULL) {
+		if (tx_conf->ext_ring->ring_iova == 0 ||
+		    (tx_conf->ext_ring->ring_iova & (IXGBE_ALIGN - 1)) != 0) {
+			PMD_INIT_LOG(ERR, "external TX ring address 0x%"PRIx64
+				     " must be %d byte aligned (port=%d queue=%d)",
+				     tx_conf->ext_ring->ring_iova, IXGBE_ALIGN,
+				     (int)dev->data->port_id, (int)queue_idx);
+			ixgbe_tx_queue_release(txq);
+			return -EINVAL;
+		}
+		if ((tx_conf->ext_ring->head_wb_iova & 0x3) != 0) {
+			PMD_INIT_LOG(ERR, "TX head write-back address 0x%"PRIx64
+				     " must be 4 byte aligned (port=%d queue=%d)",
+				     tx_conf->ext_ring->head_wb_iova,
+				     (int)dev->data->port_id, (int)queue_idx);
+			ixgbe_tx_queue_release(txq);
+			return -EINVAL;
+		}
+		txq->ext_ring_iova = tx_conf->ext_ring->ring_iova;
+		txq->tx_ring_phys_addr = txq->ext_ring_iova;
+		txq->ext_head_wb_iova = tx_conf->ext_ring->head_wb_iova;
+		tx_conf->ext_ring->doorbell_iova =
+			ixgbe_reg_bus_addr(dev, txq->tdt_reg_addr);
+
+		/*
+		 * The host never touches descriptors or mbufs of this queue:
+		 * no ring memzone, no SW ring and the port-wide TX function
+		 * is left to the host queues.
+		 */
+		PMD_INIT_LOG(DEBUG, "external ring dma_addr=0x%"PRIx64,
+			     txq->tx_ring_phys_addr);
+		txq->ops->reset(txq);
+		dev->data->tx_queues[queue_idx] = txq;
+		return 0;
+	}
+
+	/*
+	 * Allocate TX ring hardware descriptors. A memzone large enough to
+	 * handle the maximum ring size is allocated in order to allow for
+	 * resizing in later calls to the queue setup function.
+	 */
+	tz = rte_eth_dma_zone_reserve(dev, "tx_ring", queue_idx,
+			sizeof(union ixgbe_adv_tx_desc) * IXGBE_MAX_RING_DESC,
+			IXGBE_ALIGN, socket_id);
+	if (tz == NULL) {
+		ixgbe_tx_queue_release(txq);
+		return -ENOMEM;
+	}
 
 	txq->tx_ring_phys_addr = tz->iova;
 	txq->tx_ring = (union ixgbe_adv_tx_desc *) tz->addr;
@@ -2757,6 +2872,7 @@ ixgbe_dev_tx_queue_setup(struct rte_eth_dev *dev,
 	/* set up vector or scalar TX function as appropriate */
 	ixgbe_set_tx_function(dev, txq);
 
+
 	txq->ops->reset(txq);
 
 	dev->data->tx_queues[queue_idx] = txq;
@@ -2795,6 +2911,10 @@ ixgbe_rx_queue_release_mbufs(struct ixgbe_rx_queue *rxq)
 {
 	unsigned i;
 
+	/* Host Bypassing: the buffers belong to the external consumer */
+	if (rxq->ext_ring_iova != 0)
+		return;
+
 	/* SSE Vector driver has a different way of releasing mbufs. */
 	if (rxq->rx_using_sse) {
 		ixgbe_rx_queue_release_mbufs_vec(rxq);
@@ -2906,21 +3026,27 @@ ixgbe_reset_rx_queue(struct ixgbe_adapter *adapter, struct ixgbe_rx_queue *rxq)
 		len += RTE_PMD_IXGBE_RX_MAX_BURST;
 
 	/*
-	 * Zero out HW ring memory. Zero out extra memory at the end of
-	 * the H/W ring so look-ahead logic in Rx Burst bulk alloc function
-	 * reads extra memory as zeros.
+	 * Host Bypassing: there is neither a host ring nor a SW ring,
+	 * the external consumer initializes its ring itself.
 	 */
-	for (i = 0; i < len; i++) {
-		rxq->rx_ring[i] = zeroed_desc;
-	}
+	if (rxq->rx_ring != NULL) {
+		/*
+		 * Zero out HW ring memory. Zero out extra memory at the end of
+		 * the H/W ring so look-ahead logic in Rx Burst bulk alloc function
+		 * reads extra memory as zeros.
+		 */
+		for (i = 0; i < len; i++) {
+			rxq->rx_ring[i] = zeroed_desc;
+		}
 
-	/*
-	 * initialize extra software ring entries. Space for these extra
-	 * entries is always allocated
-	 */
-	memset(&rxq->fake_mbuf, 0x0, sizeof(rxq->fake_mbuf));
-	for (i = rxq->nb_rx_desc; i < len; ++i) {
-		rxq->sw_ring[i].mbuf = &rxq->fake_mbuf;
+		/*
+		 * initialize extra software ring entries. Space for these extra
+		 * entries is always allocated
+		 */
+		memset(&rxq->fake_mbuf, 0x0, sizeof(rxq->fake_mbuf));
+		for (i = rxq->nb_rx_desc; i < len; ++i) {
+			rxq->sw_ring[i].mbuf = &rxq->fake_mbuf;
+		}
 	}
 
 	rxq->rx_nb_avail = 0;
@@ -3086,23 +3212,6 @@ ixgbe_dev_rx_queue_setup(struct rte_eth_dev *dev,
 	else
 		rxq->pkt_type_mask = IXGBE_PACKET_TYPE_MASK_82599;
 
-	/*
-	 * Allocate RX ring hardware descriptors. A memzone large enough to
-	 * handle the maximum ring size is allocated in order to allow for
-	 * resizing in later calls to the queue setup function.
-	 */
-	rz = rte_eth_dma_zone_reserve(dev, "rx_ring", queue_idx,
-				      RX_RING_SZ, IXGBE_ALIGN, socket_id);
-	if (rz == NULL) {
-		ixgbe_rx_queue_release(rxq);
-		return -ENOMEM;
-	}
-
-	/*
-	 * Zero init all the descriptors in the ring.
-	 */
-	memset(rz->addr, 0, RX_RING_SZ);
-
 	/*
 	 * Modified to setup VFRDT for Virtual Function
 	 */
@@ -3122,6 +3231,80 @@ ixgbe_dev_rx_queue_setup(struct rte_eth_dev *dev,
 			IXGBE_PCI_REG_ADDR(hw, IXGBE_RDH(rxq->reg_idx));
 	}
 
+	/* Host Bypassing: the NIC fetches descriptors from external memory */
+	if (rx_conf->ext_ring != NULL) {
+		if (rx_conf->ext_ring->ring_iova == 0 ||
+		    (rx_conf->ext_ring->ring_iova & (IXGBE_ALIGN - 1)) != 0) {
+			PMD_INIT_LOG(ERR, "external RX ring address 0x%"PRIx64
+				     " must be %d byte aligned (port=%d queue=%d)",
+				     rx_conf->ext_ring->ring_iova, IXGBE_ALIGN,
+				     (int)dev->data->port_id, (int)queue_idx);
+			ixgbe_rx_queue_release(rxq);
+			return -EINVAL;
+		}
+		if (rx_conf->ext_ring->hdr_buf_size % 64 != 0 ||
+		    rx_conf->ext_ring->hdr_buf_size > IXGBE_EXT_RX_HDR_BUF_MAX) {
+			PMD_INIT_LOG(ERR, "header buffer size %u must be a "
+				     "multiple of 64 up to %d (port=%d queue=%d)",
+				     rx_conf->ext_ring->hdr_buf_size,
+				     IXGBE_EXT_RX_HDR_BUF_MAX,
+				     (int)dev->data->port_id, (int)queue_idx);
+			ixgbe_rx_queue_release(rxq);
+			return -EINVAL;
+		}
+		rxq->ext_buf_size =
+			ixgbe_ext_rx_buf_size(rx_conf->ext_ring->buf_size);
+		if (rxq->ext_buf_size == 0) {
+			PMD_INIT_LOG(ERR, "packet buffer size %u must be a "
+				     "multiple of 1024 up to %d (port=%d queue=%d)",
+				     rx_conf->ext_ring->buf_size,
+				     IXGBE_EXT_RX_BUF_MAX,
+				     (int)dev->data->port_id, (int)queue_idx);
+			ixgbe_rx_queue_release(rxq);
+			return -EINVAL;
+		}
+		rxq->ext_ring_iova = rx_conf->ext_ring->ring_iova;
+		rxq->ext_hdr_buf_size = rx_conf->ext_ring->hdr_buf_size;
+		rxq->rx_ring_phys_addr = rxq->ext_ring_iova;
+		rx_conf->ext_ring->doorbell_iova =
+			ixgbe_reg_bus_addr(dev, rxq->rdt_reg_addr);
+
+		/*
+		 * The host never touches descriptors or mbufs of this queue:
+		 * no ring memzone, no SW rings, no mbufs and the queue does not
+		 * take part in the port-wide choice of the RX function.
+		 */
+		PMD_INIT_LOG(DEBUG, "external ring dma_addr=0x%"PRIx64,
+			     rxq->rx_ring_phys_addr);
+		dev->data->rx_queues[queue_idx] = rxq;
+		ixgbe_reset_rx_queue(adapter, rxq);
+		return 0;
+	}
+
+	if (mp == NULL) {
+		PMD_INIT_LOG(ERR, "RX queue %d needs a mempool",
+			     (int)queue_idx);
+		ixgbe_rx_queue_release(rxq);
+		return -EINVAL;
+	}
+
+	/*
+	 * Allocate RX ring hardware descriptors. A memzone large enough to
+	 * handle the maximum ring size is allocated in order to allow for
+	 * resizing in later calls to the queue setup function.
+	 */
+	rz = rte_eth_dma_zone_reserve(dev, "rx_ring", queue_idx,
+				      RX_RING_SZ, IXGBE_ALIGN, socket_id);
+	if (rz == NULL) {
+		ixgbe_rx_queue_release(rxq);
+		return -ENOMEM;
+	}
+
+	/*
+	 * Zero init all the descriptors in the ring.
+	 */
+	memset(rz->addr, 0, RX_RING_SZ);
+
 	rxq->rx_ring_phys_addr = rz->iova;
 	rxq->rx_ring = (union ixgbe_adv_rx_desc *) rz->addr;
 
@@ -3193,6 +3376,36 @@ ixgbe_dev_rx_queue_setup(struct rte_eth_dev *dev,
 	return 0;
 }
 
+/*
+ * Host Bypassing: the descriptors of a queue with an external ring are not
+ * visible to the host, its occupancy is taken from the head and tail
+ * registers instead. The external consumer returns descriptors by advancing
+ * the tail register, so the descriptors after the tail up to the head have
+ * been written by the NIC and not yet returned. This includes descriptors
+ * the consumer has processed but holds back, e.g. for tail write batching.
+ */
+static inline uint16_t
+ixgbe_ext_rxq_used(struct ixgbe_rx_queue *rxq)
+{
+	uint32_t rdh = ixgbe_read_addr(rxq->rdh_reg_addr);
+	uint32_t rdt = ixgbe_read_addr(rxq->rdt_reg_addr);
+
+	return (rdh + rxq->nb_rx_desc - rdt - 1) % rxq->nb_rx_desc;
+}
+
+/*
+ * Host Bypassing: number of descriptors after the tail register that the NIC
+ * has completed. Descriptors between TDH and TDT are still owned by the NIC.
+ */
+static inline uint16_t
+ixgbe_ext_txq_free(struct ixgbe_tx_queue *txq)
+{
+	uint32_t tdh = ixgbe_read_addr(txq->tdh_reg_addr);
+	uint32_t tdt = ixgbe_read_addr(txq->tdt_reg_addr);
+
+	return (tdh + txq->nb_tx_desc - tdt - 1) % txq->nb_tx_desc + 1;
+}
+
 uint32_t
 ixgbe_dev_rx_queue_count(struct rte_eth_dev *dev, uint16_t rx_queue_id)
 {
@@ -3202,6 +3415,8 @@ ixgbe_dev_rx_queue_count(struct rte_eth_dev *dev, uint16_t rx_queue_id)
 	uint32_t desc = 0;
 
 	rxq = dev->data->rx_queues[rx_queue_id];
+	if (rxq->ext_ring_iova != 0)
+		return ixgbe_ext_rxq_used(rxq);
 	rxdp = &(rxq->rx_ring[rxq->rx_tail]);
 
 	while ((desc < rxq->nb_rx_desc) &&
@@ -3226,6 +3441,8 @@ ixgbe_dev_rx_descriptor_done(void *rx_queue, uint16_t offset)
 
 	if (unlikely(offset >= rxq->nb_rx_desc))
 		return 0;
+	if (rxq->ext_ring_iova != 0)
+		return offset < ixgbe_ext_rxq_used(rxq);
 	desc = rxq->rx_tail + offset;
 	if (desc >= rxq->nb_rx_desc)
 		desc -= rxq->nb_rx_desc;
@@ -3244,6 +3461,18 @@ ixgbe_dev_rx_descriptor_status(void *rx_queue, uint16_t offset)
 
 	if (unlikely(offset >= rxq->nb_rx_desc))
 		return -EINVAL;
+	/*
+	 * Host Bypassing: offsets count from the first descriptor not yet
+	 * returned by the external consumer, the descriptor at the tail
+	 * itself is never owned by the NIC.
+	 */
+	if (rxq->ext_ring_iova != 0) {
+		if (offset >= rxq->nb_rx_desc - 1)
+			return RTE_ETH_RX_DESC_UNAVAIL;
+		if (offset < ixgbe_ext_rxq_used(rxq))
+			return RTE_ETH_RX_DESC_DONE;
+		return RTE_ETH_RX_DESC_AVAIL;
+	}
 
 #if defined(RTE_ARCH_X86) || defined(RTE_ARCH_ARM64)
 	if (rxq->rx_using_sse)
@@ -3274,6 +3503,12 @@ ixgbe_dev_tx_descriptor_status(void *tx_queue, uint16_t offset)
 
 	if (unlikely(offset >= txq->nb_tx_desc))
 		return -EINVAL;
+	/* Host Bypassing: offsets count from the tail written by the producer */
+	if (txq->ext_ring_iova != 0) {
+		if (offset < ixgbe_ext_txq_free(txq))
+			return RTE_ETH_TX_DESC_DONE;
+		return RTE_ETH_TX_DESC_FULL;
+	}
 
 	desc = txq->tx_tail + offset;
 	/* go to next desc that has the RS bit */
@@ -4431,6 +4666,19 @@ ixgbe_vmdq_tx_hw_configure(struct ixgbe_hw *hw)
 	IXGBE_WRITE_FLUSH(hw);
 }
 
+/*
+ * Size of the packet buffers of a queue, taken from the mempool of host
+ * queues or from the external ring configuration of bypass queues.
+ */
+static inline uint16_t
+ixgbe_rxq_buf_size(struct ixgbe_rx_queue *rxq)
+{
+	if (rxq->ext_ring_iova != 0) /* Host Bypassing */
+		return rxq->ext_buf_size;
+	return (uint16_t)(rte_pktmbuf_data_room_size(rxq->mb_pool) -
+		RTE_PKTMBUF_HEADROOM);
+}
+
 static int __rte_cold
 ixgbe_alloc_rx_queue_mbufs(struct ixgbe_rx_queue *rxq)
 {
@@ -4438,6 +4686,10 @@ ixgbe_alloc_rx_queue_mbufs(struct ixgbe_rx_queue *rxq)
 	uint64_t dma_addr;
 	unsigned int i;
 
+	/* Host Bypassing: the external consumer provides the buffers */
+	if (rxq->ext_ring_iova != 0)
+		return 0;
+
 	/* Initialize software ring entries */
 	for (i = 0; i < rxq->nb_rx_desc; i++) {
 		volatile union ixgbe_adv_rx_desc *rxd;
@@ -4652,17 +4904,14 @@ ixgbe_dev_mq_tx_configure(struct rte_eth_dev *dev)
  * Return the RSCCTL[n].MAXDESC for 82599 and x540 PF devices according to the
  * spec rev. 3.0 chapter 8.2.3.8.13.
  *
- * @pool Memory pool of the Rx queue
+ * @rxq Rx queue, its buffers come from a mempool or external memory
  */
 static inline uint32_t
-ixgbe_get_rscctl_maxdesc(struct rte_mempool *pool)
+ixgbe_get_rscctl_maxdesc(struct ixgbe_rx_queue *rxq)
 {
-	struct rte_pktmbuf_pool_private *mp_priv = rte_mempool_get_priv(pool);
-
 	/* MAXDESC * SRRCTL.BSIZEPKT must not exceed 64 KB minus one */
 	uint16_t maxdesc =
-		RTE_IPV4_MAX_PKT_LEN /
-			(mp_priv->mbuf_data_room_size - RTE_PKTMBUF_HEADROOM);
+		RTE_IPV4_MAX_PKT_LEN / ixgbe_rxq_buf_size(rxq);
 
 	if (maxdesc >= 16)
 		return IXGBE_RSCCTL_MAXDESC_16;
@@ -4923,7 +5172,8 @@ ixgbe_set_rsc(struct rte_eth_dev *dev)
 			IXGBE_READ_REG(hw, IXGBE_EITR(rxq->reg_idx));
 
 		/*
-		 * ixgbe PMD doesn't support header-split at the moment.
+		 * ixgbe PMD doesn't support header-split at the moment,
+		 * only queues with an external ring may use it.
 		 *
 		 * Following the 4.6.7.2.1 chapter of the 82599/x540
 		 * Spec if RSC is enabled the SRRCTL[n].BSIZEHEADER
@@ -4931,9 +5181,11 @@ ixgbe_set_rsc(struct rte_eth_dev *dev)
 		 * enabled. We will configure it 128 bytes following the
 		 * recommendation in the spec.
 		 */
-		srrctl &= ~IXGBE_SRRCTL_BSIZEHDR_MASK;
-		srrctl |= (128 << IXGBE_SRRCTL_BSIZEHDRSIZE_SHIFT) &
-					    IXGBE_SRRCTL_BSIZEHDR_MASK;
+		if (rxq->ext_hdr_buf_size == 0) {
+			srrctl &= ~IXGBE_SRRCTL_BSIZEHDR_MASK;
+			srrctl |= (128 << IXGBE_SRRCTL_BSIZEHDRSIZE_SHIFT) &
+						    IXGBE_SRRCTL_BSIZEHDR_MASK;
+		}
 
 		/*
 		 * TODO: Consider setting the Receive Descriptor Minimum
@@ -4942,7 +5194,12 @@ ixgbe_set_rsc(struct rte_eth_dev *dev)
 		 */
 
 		rscctl |= IXGBE_RSCCTL_RSCEN;
-		rscctl |= ixgbe_get_rscctl_maxdesc(rxq->mb_pool);
+		/*
+		 * Host Bypassing: queues with an external ring coalesce into
+		 * their external buffers as well. The consumer follows the
+		 * NEXTP field of non-EOP descriptors, see the Readme.
+		 */
+		rscctl |= ixgbe_get_rscctl_maxdesc(rxq);
 		psrtype |= IXGBE_PSRTYPE_TCPHDR;
 
 		/*
@@ -4981,6 +5238,69 @@ ixgbe_set_rsc(struct rte_eth_dev *dev)
 	return 0;
 }
 
+/*
+ * Programs base, length, head and tail of the descriptor ring of a RX queue.
+ * Also used to move a stopped bypass queue to a new external ring.
+ */
+static void
+ixgbe_rx_ring_regs_init(struct ixgbe_hw *hw, struct ixgbe_rx_queue *rxq)
+{
+	uint64_t bus_addr;
+
+	if (rxq->ext_ring_iova != 0) /* Host Bypassing */
+		bus_addr = rxq->ext_ring_iova;
+	else
+		bus_addr = rxq->rx_ring_phys_addr;
+	IXGBE_WRITE_REG(hw, IXGBE_RDBAL(rxq->reg_idx),
+			(uint32_t)(bus_addr & 0x00000000ffffffffULL));
+	IXGBE_WRITE_REG(hw, IXGBE_RDBAH(rxq->reg_idx),
+			(uint32_t)(bus_addr >> 32));
+	IXGBE_WRITE_REG(hw, IXGBE_RDLEN(rxq->reg_idx),
+			rxq->nb_rx_desc * sizeof(union ixgbe_adv_rx_desc));
+	IXGBE_WRITE_REG(hw, IXGBE_RDH(rxq->reg_idx), 0);
+	IXGBE_WRITE_REG(hw, IXGBE_RDT(rxq->reg_idx), 0);
+}
+
+/*
+ * Programs base, length, head, tail and head write-back of the descriptor
+ * ring of a TX queue.
+ */
+static void
+ixgbe_tx_ring_regs_init(struct ixgbe_hw *hw, struct ixgbe_tx_queue *txq)
+{
+	uint64_t bus_addr;
+
+	if (txq->ext_ring_iova != 0) /* Host Bypassing */
+		bus_addr = txq->ext_ring_iova;
+	else
+		bus_addr = txq->tx_ring_phys_addr;
+	IXGBE_WRITE_REG(hw, IXGBE_TDBAL(txq->reg_idx),
+			(uint32_t)(bus_addr & 0x00000000ffffffffULL));
+	IXGBE_WRITE_REG(hw, IXGBE_TDBAH(txq->reg_idx),
+			(uint32_t)(bus_addr >> 32));
+	IXGBE_WRITE_REG(hw, IXGBE_TDLEN(txq->reg_idx),
+			txq->nb_tx_desc * sizeof(union ixgbe_adv_tx_desc));
+	/* Setup the HW Tx Head and TX Tail descriptor pointers */
+	IXGBE_WRITE_REG(hw, IXGBE_TDH(txq->reg_idx), 0);
+	IXGBE_WRITE_REG(hw, IXGBE_TDT(txq->reg_idx), 0);
+
+	/*
+	 * Host Bypassing: head write-back to external memory.
+	 * The NIC then reports completed descriptors only by writing
+	 * its head index, the DD bit of the descriptors stays unset.
+	 */
+	if (txq->ext_head_wb_iova != 0) {
+		IXGBE_WRITE_REG(hw, IXGBE_TDWBAL(txq->reg_idx),
+			(uint32_t)(txq->ext_head_wb_iova & 0xfffffffcULL) |
+			IXGBE_TDWBAL_HEAD_WB_ENABLE);
+		IXGBE_WRITE_REG(hw, IXGBE_TDWBAH(txq->reg_idx),
+			(uint32_t)(txq->ext_head_wb_iova >> 32));
+	} else {
+		IXGBE_WRITE_REG(hw, IXGBE_TDWBAL(txq->reg_idx), 0);
+		IXGBE_WRITE_REG(hw, IXGBE_TDWBAH(txq->reg_idx), 0);
+	}
+}
+
 /*
  * Initializes Receive Unit.
  */
@@ -4989,7 +5309,6 @@ ixgbe_dev_rx_init(struct rte_eth_dev *dev)
 {
 	struct ixgbe_hw     *hw;
 	struct ixgbe_rx_queue *rxq;
-	uint64_t bus_addr;
 	uint32_t rxctrl;
 	uint32_t fctrl;
 	uint32_t hlreg0;
@@ -5075,25 +5394,33 @@ ixgbe_dev_rx_init(struct rte_eth_dev *dev)
 			rxq->crc_len = 0;
 
 		/* Setup the Base and Length of the Rx Descriptor Rings */
-		//bus_addr = rxq->rx_ring_phys_addr;
-		if(hw->custom_addr_enable)  //HOST BYPASSING
-			if(rxq->reg_idx>0)	//multi ring support
-				bus_addr = hw->custom_rx_desc_addr + rxq->reg_idx * hw->custom_desc_addr_offset;
-			else
-				bus_addr = hw->custom_rx_desc_addr;
-		else
-			bus_addr = rxq->rx_ring_phys_addr;
-		IXGBE_WRITE_REG(hw, IXGBE_RDBAL(rxq->reg_idx),
-				(uint32_t)(bus_addr & 0x00000000ffffffffULL));
-		IXGBE_WRITE_REG(hw, IXGBE_RDBAH(rxq->reg_idx),
-				(uint32_t)(bus_addr >> 32));
-		IXGBE_WRITE_REG(hw, IXGBE_RDLEN(rxq->reg_idx),
-				rxq->nb_rx_desc * sizeof(union ixgbe_adv_rx_desc));
-		IXGBE_WRITE_REG(hw, IXGBE_RDH(rxq->reg_idx), 0);
-		IXGBE_WRITE_REG(hw, IXGBE_RDT(rxq->reg_idx), 0);
+		ixgbe_rx_ring_regs_init(hw, rxq);
 
 		/* Configure the SRRCTL register */
-		srrctl = IXGBE_SRRCTL_DESCTYPE_ADV_ONEBUF;
+		if (rxq->ext_hdr_buf_size != 0) {
+			/*
+			 * Host Bypassing: header split into the header
+			 * buffers given by the external consumer.
+			 */
+			if (hw->mac.type == ixgbe_mac_82599EB) {
+				/* Must setup the PSRTYPE register */
+				uint32_t psrtype;
+
+				psrtype = IXGBE_PSRTYPE_TCPHDR |
+					IXGBE_PSRTYPE_UDPHDR   |
+					IXGBE_PSRTYPE_IPV4HDR  |
+					IXGBE_PSRTYPE_IPV6HDR  |
+					IXGBE_PSRTYPE_L2HDR;
+				IXGBE_WRITE_REG(hw,
+					IXGBE_PSRTYPE(rxq->reg_idx),
+					psrtype);
+			}
+			srrctl = ((rxq->ext_hdr_buf_size <<
+				IXGBE_SRRCTL_BSIZEHDRSIZE_SHIFT) &
+				IXGBE_SRRCTL_BSIZEHDR_MASK);
+			srrctl |= IXGBE_SRRCTL_DESCTYPE_HDR_SPLIT_ALWAYS;
+		} else
+			srrctl = IXGBE_SRRCTL_DESCTYPE_ADV_ONEBUF;
 
 		/* Set if packets are dropped when no descriptors available */
 		if (rxq->drop_en)
@@ -5105,8 +5432,7 @@ ixgbe_dev_rx_init(struct rte_eth_dev *dev)
 		 * The value is in 1 KB resolution. Valid values can be from
 		 * 1 KB to 16 KB.
 		 */
-		buf_size = (uint16_t)(rte_pktmbuf_data_room_size(rxq->mb_pool) -
-			RTE_PKTMBUF_HEADROOM);
+		buf_size = ixgbe_rxq_buf_size(rxq);
 		srrctl |= ((buf_size >> IXGBE_SRRCTL_BSIZEPKT_SHIFT) &
 			   IXGBE_SRRCTL_BSIZEPKT_MASK);
 
@@ -5115,10 +5441,22 @@ ixgbe_dev_rx_init(struct rte_eth_dev *dev)
 		buf_size = (uint16_t) ((srrctl & IXGBE_SRRCTL_BSIZEPKT_MASK) <<
 				       IXGBE_SRRCTL_BSIZEPKT_SHIFT);
 
-		/* It adds dual VLAN length for supporting dual VLAN */
-		if (dev->data->dev_conf.rxmode.max_rx_pkt_len +
+		/*
+		 * It adds dual VLAN length for supporting dual VLAN.
+		 * Queues with an external ring are not polled by the host
+		 * and do not select the scattered RX function.
+		 */
+		if (rxq->ext_ring_iova == 0 &&
+		    dev->data->dev_conf.rxmode.max_rx_pkt_len +
 					    2 * IXGBE_VLAN_TAG_SIZE > buf_size)
 			dev->data->scattered_rx = 1;
+		if (rxq->ext_ring_iova != 0 &&
+		    dev->data->dev_conf.rxmode.max_rx_pkt_len > buf_size)
+			PMD_INIT_LOG(DEBUG, "Rx Queue %d: frames up to %u "
+				     "bytes span several %u byte buffers of "
+				     "the external ring", rxq->queue_id,
+				     dev->data->dev_conf.rxmode.max_rx_pkt_len,
+				     buf_size);
 		if (rxq->offloads & DEV_RX_OFFLOAD_VLAN_STRIP)
 			rx_conf->offloads |= DEV_RX_OFFLOAD_VLAN_STRIP;
 	}
@@ -5173,7 +5511,6 @@ ixgbe_dev_tx_init(struct rte_eth_dev *dev)
 {
 	struct ixgbe_hw     *hw;
 	struct ixgbe_tx_queue *txq;
-	uint64_t bus_addr;
 	uint32_t hlreg0;
 	uint32_t txctrl;
 	uint16_t i;
@@ -5192,22 +5529,7 @@ ixgbe_dev_tx_init(struct rte_eth_dev *dev)
 	for (i = 0; i < dev->data->nb_tx_queues; i++) {
 		txq = dev->data->tx_queues[i];
 
-		if(hw->custom_addr_enable) //HOST Bypassing
-			if(txq->reg_idx>0)	//multi ring support
-				bus_addr = hw->custom_tx_desc_addr + txq->reg_idx * hw->custom_desc_addr_offset;
-			else
-				bus_addr = hw->custom_tx_desc_addr;
-		else
-			bus_addr = txq->tx_ring_phys_addr;
-		IXGBE_WRITE_REG(hw, IXGBE_TDBAL(txq->reg_idx),
-				(uint32_t)(bus_addr & 0x00000000ffffffffULL));
-		IXGBE_WRITE_REG(hw, IXGBE_TDBAH(txq->reg_idx),
-				(uint32_t)(bus_addr >> 32));
-		IXGBE_WRITE_REG(hw, IXGBE_TDLEN(txq->reg_idx),
-				txq->nb_tx_desc * sizeof(union ixgbe_adv_tx_desc));
-		/* Setup the HW Tx Head and TX Tail descriptor pointers */
-		IXGBE_WRITE_REG(hw, IXGBE_TDH(txq->reg_idx), 0);
-		IXGBE_WRITE_REG(hw, IXGBE_TDT(txq->reg_idx), 0);
+		ixgbe_tx_ring_regs_init(hw, txq);
 
 		/*
 		 * Disable Tx Head Writeback RO bit, since this hoses
@@ -5376,6 +5698,23 @@ ixgbe_dev_rxtx_start(struct rte_eth_dev *dev)
 	return 0;
 }
 
+/*
+ * Host Bypassing: sets or clears SRRCTL.DROP_EN of a single RX queue.
+ */
+static void
+ixgbe_rx_queue_drop_en(struct ixgbe_hw *hw, struct ixgbe_rx_queue *rxq,
+		       uint8_t on)
+{
+	uint32_t srrctl;
+
+	srrctl = IXGBE_READ_REG(hw, IXGBE_SRRCTL(rxq->reg_idx));
+	if (on)
+		srrctl |= IXGBE_SRRCTL_DROP_EN;
+	else
+		srrctl &= ~IXGBE_SRRCTL_DROP_EN;
+	IXGBE_WRITE_REG(hw, IXGBE_SRRCTL(rxq->reg_idx), srrctl);
+}
+
 /*
  * Start Receive Units for specified queue.
  */
@@ -5398,6 +5737,10 @@ ixgbe_dev_rx_queue_start(struct rte_eth_dev *dev, uint16_t rx_queue_id)
 			     rx_queue_id);
 		return -1;
 	}
+	/* Host Bypassing: restore the drop policy set up for the queue */
+	if (rxq->ext_ring_iova != 0)
+		ixgbe_rx_queue_drop_en(hw, rxq, rxq->drop_en);
+
 	rxdctl = IXGBE_READ_REG(hw, IXGBE_RXDCTL(rxq->reg_idx));
 	rxdctl |= IXGBE_RXDCTL_ENABLE;
 	IXGBE_WRITE_REG(hw, IXGBE_RXDCTL(rxq->reg_idx), rxdctl);
@@ -5435,6 +5778,14 @@ ixgbe_dev_rx_queue_stop(struct rte_eth_dev *dev, uint16_t rx_queue_id)
 
 	rxq = dev->data->rx_queues[rx_queue_id];
 
+	/*
+	 * Host Bypassing: packets which still arrive for a bypass queue while
+	 * it is switched to another ring are dropped, so they cannot hold up
+	 * the shared packet buffer of the queues which keep forwarding.
+	 */
+	if (rxq->ext_ring_iova != 0)
+		ixgbe_rx_queue_drop_en(hw, rxq, 1);
+
 	rxdctl = IXGBE_READ_REG(hw, IXGBE_RXDCTL(rxq->reg_idx));
 	rxdctl &= ~IXGBE_RXDCTL_ENABLE;
 	IXGBE_WRITE_REG(hw, IXGBE_RXDCTL(rxq->reg_idx), rxdctl);
@@ -5514,9 +5865,17 @@ ixgbe_dev_tx_queue_stop(struct rte_eth_dev *dev, uint16_t tx_queue_id)
 
 	txq = dev->data->tx_queues[tx_queue_id];
 
-	/* Wait until TX queue is empty */
-	if (hw->mac.type == ixgbe_mac_82599EB) {
-		poll_ms = RTE_IXGBE_REGISTER_POLL_WAIT_10_MS;
+	/*
+	 * Wait until TX queue is empty.
+	 * Host Bypassing: the external producer stops ringing the doorbell
+	 * first. A bypass queue which does not drain stays enabled and the
+	 * stop can be retried, so no descriptors of the old ring are lost.
+	 */
+	if (hw->mac.type == ixgbe_mac_82599EB || txq->ext_ring_iova != 0) {
+		if (txq->ext_ring_iova != 0)
+			poll_ms = IXGBE_EXT_TX_DRAIN_POLL;
+		else
+			poll_ms = RTE_IXGBE_REGISTER_POLL_WAIT_10_MS;
 		do {
 			rte_delay_us(RTE_IXGBE_WAIT_100_US);
 			txtdh = IXGBE_READ_REG(hw,
@@ -5524,10 +5883,13 @@ ixgbe_dev_tx_queue_stop(struct rte_eth_dev *dev, uint16_t tx_queue_id)
 			txtdt = IXGBE_READ_REG(hw,
 					       IXGBE_TDT(txq->reg_idx));
 		} while (--poll_ms && (txtdh != txtdt));
-		if (!poll_ms)
+		if (!poll_ms) {
 			PMD_INIT_LOG(ERR,
 				"Tx Queue %d is not empty when stopping.",
 				tx_queue_id);
+			if (txq->ext_ring_iova != 0)
+				return -EBUSY;
+		}
 	}
 
 	txdctl = IXGBE_READ_REG(hw, IXGBE_TXDCTL(txq->reg_idx));
@@ -5556,6 +5918,130 @@ ixgbe_dev_tx_queue_stop(struct rte_eth_dev *dev, uint16_t tx_queue_id)
 	return 0;
 }
 
+/*
+ * Host Bypassing: moves a stopped bypass RX queue to another external ring.
+ * Only the registers of this queue are touched, all other queues of the port
+ * keep forwarding.
+ */
+int __rte_cold
+ixgbe_dev_rx_queue_rebind(struct rte_eth_dev *dev, uint16_t rx_queue_id,
+			  uint16_t nb_rx_desc,
+			  struct rte_eth_ext_ring_conf *ext_ring)
+{
+	struct ixgbe_hw *hw = IXGBE_DEV_PRIVATE_TO_HW(dev->data->dev_private);
+	struct ixgbe_adapter *adapter = dev->data->dev_private;
+	struct ixgbe_rx_queue *rxq;
+	uint16_t buf_size;
+	uint32_t srrctl;
+
+	PMD_INIT_FUNC_TRACE();
+
+	if (rx_queue_id >= dev->data->nb_rx_queues || ext_ring == NULL)
+		return -EINVAL;
+	rxq = dev->data->rx_queues[rx_queue_id];
+	if (rxq == NULL || rxq->ext_ring_iova == 0) {
+		PMD_INIT_LOG(ERR, "Rx Queue %d has no external ring",
+			     rx_queue_id);
+		return -EINVAL;
+	}
+	if (dev->data->rx_queue_state[rx_queue_id] !=
+	    RTE_ETH_QUEUE_STATE_STOPPED) {
+		PMD_INIT_LOG(ERR, "Rx Queue %d must be stopped to rebind",
+			     rx_queue_id);
+		return -EBUSY;
+	}
+	if (ext_ring->ring_iova == 0 ||
+	    (ext_ring->ring_iova & (IXGBE_ALIGN - 1)) != 0 ||
+	    nb_rx_desc % IXGBE_RXD_ALIGN != 0 ||
+	    nb_rx_desc > IXGBE_MAX_RING_DESC ||
+	    nb_rx_desc < IXGBE_MIN_RING_DESC) {
+		PMD_INIT_LOG(ERR, "invalid external RX ring 0x%"PRIx64
+			     " with %u descriptors (queue=%d)",
+			     ext_ring->ring_iova, nb_rx_desc, rx_queue_id);
+		return -EINVAL;
+	}
+	buf_size = ixgbe_ext_rx_buf_size(ext_ring->buf_size);
+	if (buf_size == 0) {
+		PMD_INIT_LOG(ERR, "packet buffer size %u must be a multiple "
+			     "of 1024 up to %d (queue=%d)", ext_ring->buf_size,
+			     IXGBE_EXT_RX_BUF_MAX, rx_queue_id);
+		return -EINVAL;
+	}
+
+	rxq->ext_ring_iova = ext_ring->ring_iova;
+	rxq->rx_ring_phys_addr = rxq->ext_ring_iova;
+	rxq->nb_rx_desc = nb_rx_desc;
+	rxq->ext_buf_size = buf_size;
+	ext_ring->doorbell_iova = ixgbe_reg_bus_addr(dev, rxq->rdt_reg_addr);
+
+	ixgbe_rx_ring_regs_init(hw, rxq);
+	srrctl = IXGBE_READ_REG(hw, IXGBE_SRRCTL(rxq->reg_idx));
+	srrctl &= ~IXGBE_SRRCTL_BSIZEPKT_MASK;
+	srrctl |= ((buf_size >> IXGBE_SRRCTL_BSIZEPKT_SHIFT) &
+		   IXGBE_SRRCTL_BSIZEPKT_MASK);
+	IXGBE_WRITE_REG(hw, IXGBE_SRRCTL(rxq->reg_idx), srrctl);
+	ixgbe_reset_rx_queue(adapter, rxq);
+	PMD_INIT_LOG(DEBUG, "Rx Queue %d rebound to dma_addr=0x%"PRIx64
+		     " nb_desc=%u buf_size=%u", rx_queue_id, rxq->ext_ring_iova,
+		     nb_rx_desc, buf_size);
+
+	return 0;
+}
+
+/*
+ * Host Bypassing: moves a stopped bypass TX queue to another external ring.
+ */
+int __rte_cold
+ixgbe_dev_tx_queue_rebind(struct rte_eth_dev *dev, uint16_t tx_queue_id,
+			  uint16_t nb_tx_desc,
+			  struct rte_eth_ext_ring_conf *ext_ring)
+{
+	struct ixgbe_hw *hw = IXGBE_DEV_PRIVATE_TO_HW(dev->data->dev_private);
+	struct ixgbe_tx_queue *txq;
+
+	PMD_INIT_FUNC_TRACE();
+
+	if (tx_queue_id >= dev->data->nb_tx_queues || ext_ring == NULL)
+		return -EINVAL;
+	txq = dev->data->tx_queues[tx_queue_id];
+	if (txq == NULL || txq->ext_ring_iova == 0) {
+		PMD_INIT_LOG(ERR, "Tx Queue %d has no external ring",
+			     tx_queue_id);
+		return -EINVAL;
+	}
+	if (dev->data->tx_queue_state[tx_queue_id] !=
+	    RTE_ETH_QUEUE_STATE_STOPPED) {
+		PMD_INIT_LOG(ERR, "Tx Queue %d must be stopped to rebind",
+			     tx_queue_id);
+		return -EBUSY;
+	}
+	if (ext_ring->ring_iova == 0 ||
+	    (ext_ring->ring_iova & (IXGBE_ALIGN - 1)) != 0 ||
+	    (ext_ring->head_wb_iova & 0x3) != 0 ||
+	    nb_tx_desc % IXGBE_TXD_ALIGN != 0 ||
+	    nb_tx_desc > IXGBE_MAX_RING_DESC ||
+	    nb_tx_desc < IXGBE_MIN_RING_DESC) {
+		PMD_INIT_LOG(ERR, "invalid external TX ring 0x%"PRIx64
+			     " with %u descriptors (queue=%d)",
+			     ext_ring->ring_iova, nb_tx_desc, tx_queue_id);
+		return -EINVAL;
+	}
+
+	txq->ext_ring_iova = ext_ring->ring_iova;
+	txq->tx_ring_phys_addr = txq->ext_ring_iova;
+	txq->ext_head_wb_iova = ext_ring->head_wb_iova;
+	txq->nb_tx_desc = nb_tx_desc;
+	ext_ring->doorbell_iova = ixgbe_reg_bus_addr(dev, txq->tdt_reg_addr);
+
+	ixgbe_tx_ring_regs_init(hw, txq);
+	txq->ops->reset(txq);
+	PMD_INIT_LOG(DEBUG, "Tx Queue %d rebound to dma_addr=0x%"PRIx64
+		     " nb_desc=%u", tx_queue_id, txq->ext_ring_iova,
+		     nb_tx_desc);
+
+	return 0;
+}
+
 void
 ixgbe_rxq_info_get(struct rte_eth_dev *dev, uint16_t queue_id,
 	struct rte_eth_rxq_info *qinfo)
@@ -5682,8 +6168,7 @@ ixgbevf_dev_rx_init(struct rte_eth_dev *dev)
 		 * The value is in 1 KB resolution. Valid values can be from
 		 * 1 KB to 16 KB.
 		 */
-		buf_size = (uint16_t)(rte_pktmbuf_data_room_size(rxq->mb_pool) -
-			RTE_PKTMBUF_HEADROOM);
+		buf_size = ixgbe_rxq_buf_size(rxq);
 		srrctl |= ((buf_size >> IXGBE_SRRCTL_BSIZEPKT_SHIFT) &
 			   IXGBE_SRRCTL_BSIZEPKT_MASK);
 
@@ -57,6 +57,15 @@ extern uint64_t fpga_dma;
 
 #define IXGBE_TX_MIN_PKT_LEN		     14
 
+/* Host Bypassing: default packet buffer size of RX queues with an external ring */
+#define IXGBE_EXT_RX_BUF_SIZE               2048
+/* Host Bypassing: largest packet buffer of SRRCTL.BSIZEPACKET. */
+#define IXGBE_EXT_RX_BUF_MAX                16384
+/* Host Bypassing: largest header buffer of SRRCTL.BSIZEHEADER. */
+#define IXGBE_EXT_RX_HDR_BUF_MAX            1024
+/* Host Bypassing: TX drain wait of a bypass queue, in steps of 100us. */
+#define IXGBE_EXT_TX_DRAIN_POLL             1000
+
 #define IXGBE_PACKET_TYPE_MASK_82599        0X7F
 #define IXGBE_PACKET_TYPE_MASK_X550         0X10FF
 #define IXGBE_PACKET_TYPE_MASK_TUNNEL       0XFF
@@ -100,6 +109,12 @@ struct ixgbe_rx_queue {
 	struct rte_mempool  *mb_pool; /**< mbuf pool to populate RX ring. */
 	volatile union ixgbe_adv_rx_desc *rx_ring; /**< RX ring virtual address. */
 	uint64_t            rx_ring_phys_addr; /**< RX ring DMA address. */
+	/** Host Bypassing: RX ring bus address in external memory, 0 if unused. */
+	uint64_t            ext_ring_iova;
+	/** Host Bypassing: packet buffer size of the external ring. */
+	uint16_t            ext_buf_size;
+	/** Host Bypassing: header buffer size for header split, 0 if unused. */
+	uint16_t            ext_hdr_buf_size;
 	volatile uint32_t   *rdt_reg_addr; /**< RDT register address. */
 	volatile uint32_t   *rdh_reg_addr; /**< RDH register address. */
 	struct ixgbe_rx_entry *sw_ring; /**< address of RX software ring. */
@@ -200,11 +215,16 @@ struct ixgbe_tx_queue {
 	/** TX ring virtual address. */
 	volatile union ixgbe_adv_tx_desc *tx_ring;
 	uint64_t            tx_ring_phys_addr; /**< TX ring DMA address. */
+	/** Host Bypassing: TX ring bus address in external memory, 0 if unused. */
+	uint64_t            ext_ring_iova;
+	/** Host Bypassing: TX head write-back bus address, 0 if disabled. */
+	uint64_t            ext_head_wb_iova;
 	union {
 		struct ixgbe_tx_entry *sw_ring; /**< address of SW ring for scalar PMD. */
 		struct ixgbe_tx_entry_v *sw_ring_v; /**< address of SW ring for vector PMD */
 	};
 	volatile uint32_t   *tdt_reg_addr; /**< Address of TDT register. */
+	volatile uint32_t   *tdh_reg_addr; /**< Address of TDH register. */
 	uint16_t            nb_tx_desc;    /**< number of TX descriptors. */
 	uint16_t            tx_tail;       /**< current value of TDT reg. */
 	/**< Start freeing TX buffers if there are less free descriptors than
@@ -302,4 +322,52 @@ uint64_t ixgbe_get_rx_queue_offloads(struct rte_eth_dev *dev);
 uint64_t ixgbe_get_rx_port_offloads(struct rte_eth_dev *dev);
 uint64_t ixgbe_get_tx_queue_offloads(struct rte_eth_dev *dev);
 
+/**
+ * Host Bypassing: head and tail (doorbell) register of a queue.
+ * The bus addresses are used by external producers/consumers (FPGA, GPU)
+ * to access the registers by DMA, the virtual addresses by the host.
+ */
+struct ixgbe_queue_regs {
+	uint64_t head_iova;           /**< Bus address of RDH/TDH. */
+	uint64_t tail_iova;           /**< Bus address of RDT/TDT. */
+	volatile uint32_t *head_addr; /**< Virtual address of RDH/TDH. */
+	volatile uint32_t *tail_addr; /**< Virtual address of RDT/TDT. */
+};
+
+/**
+ * Fills *regs* with the addresses of the head and tail register of a queue
+ * that has been set up before. The register layout of the NIC (e.g. the
+ * second RDT block of the 82599 above queue 63) and VFs are handled here.
+ *
+ * @return 0 on success, -EINVAL if the queue is not set up.
+ */
+int ixgbe_dev_rx_queue_regs(struct rte_eth_dev *dev, uint16_t rx_queue_id,
+			    struct ixgbe_queue_regs *regs);
+int ixgbe_dev_tx_queue_regs(struct rte_eth_dev *dev, uint16_t tx_queue_id,
+			    struct ixgbe_queue_regs *regs);
+
+/**
+ * Host Bypassing: moves a stopped bypass queue to a new external ring with
+ * nb_desc descriptors, e.g. from a GPU to an FPGA consumer. Drain protocol:
+ * - RX: steer the flows of the queue away, stop it with
+ *   rte_eth_dev_rx_queue_stop() (packets still arriving are dropped), let
+ *   the old consumer process the descriptors with DD set, rebind, initialize
+ *   the descriptors of the new ring and start the queue again.
+ * - TX: let the old producer stop writing the tail register and stop the
+ *   queue with rte_eth_dev_tx_queue_stop(), which returns -EBUSY while the
+ *   NIC has not fetched all descriptors. Then rebind and start the queue.
+ * The other queues of the port are not touched. ext_ring->doorbell_iova is
+ * filled in as on queue setup, an RX queue also takes the packet buffer size
+ * of the new ring (ext_ring->buf_size).
+ *
+ * @return 0 on success, -EINVAL for a queue without external ring or an
+ * invalid ring, -EBUSY if the queue is not stopped.
+ */
+int ixgbe_dev_rx_queue_rebind(struct rte_eth_dev *dev, uint16_t rx_queue_id,
+			      uint16_t nb_rx_desc,
+			      struct rte_eth_ext_ring_conf *ext_ring);
+int ixgbe_dev_tx_queue_rebind(struct rte_eth_dev *dev, uint16_t tx_queue_id,
+			      uint16_t nb_tx_desc,
+			      struct rte_eth_ext_ring_conf *ext_ring);
+
 #endif /* _IXGBE_RXTX_H_ */
@@ -4198,11 +4198,6 @@ struct ixgbe_hw {
 	bool allow_unsupported_sfp;
 	bool wol_enabled;
 	bool need_crosstalk_fix;
-// Hot bypassing:
-	bool custom_addr_enable;
-	uint64_t custom_rx_desc_addr;
-	uint64_t custom_tx_desc_addr;
-	uint64_t custom_desc_addr_offset;
 };
 
 #define ixgbe_call_func(hw, func, params, error) \
@@ -829,6 +829,38 @@ struct rte_eth_txmode {
 	void *reserved_ptrs[2];   /**< Reserved for future fields */
 };
 
+/**
+ * Host Bypassing:
+ * A structure used to place the descriptor ring of a queue in external memory
+ * (e.g. FPGA BRAM or GPU memory) instead of a memzone allocated by the PMD.
+ * It is passed to rte_eth_rx_queue_setup()/rte_eth_tx_queue_setup() through
+ * the *ext_ring* field of struct rte_eth_rxconf/rte_eth_txconf.
+ * The PMD fills in the bus address of the tail register of the queue, so the
+ * external producer/consumer of the ring can ring the doorbell by DMA.
+ * For TX queues *head_wb_iova* enables head write-back: the NIC writes the
+ * 32 bit index of its TX head to this address instead of setting the DD bit
+ * in each descriptor, so completed descriptors are found with a single read.
+ * For RX queues *buf_size* sets the size of the packet buffer behind each
+ * descriptor (SRRCTL.BSIZEPACKET), independent of any host mempool. Frames
+ * longer than the buffer span several descriptors.
+ * For RX queues *hdr_buf_size* enables header split: the NIC writes the
+ * L2-L4 headers of each packet to the buffer at read.hdr_addr of the
+ * descriptor and the rest of the packet to read.pkt_addr.
+ * The PMD allocates neither a host ring, a software ring nor mbufs for such
+ * queues and they cannot be polled with rte_eth_rx_burst()/rte_eth_tx_burst().
+ * rte_eth_rx_queue_count() and rte_eth_rx/tx_descriptor_status() report the
+ * occupancy of such queues from the head and tail registers of the NIC.
+ */
+struct rte_eth_ext_ring_conf {
+	uint64_t ring_iova;     /**< Bus address of the descriptor ring. */
+	uint64_t doorbell_iova; /**< Out: bus address of the RDT/TDT register. */
+	uint64_t head_wb_iova;  /**< TX only: head write-back address, 0 to disable. */
+	/** RX only: packet buffer size, multiple of 1024 up to 16384, 0 for 2048. */
+	uint16_t buf_size;
+	/** RX only: header buffer size for header split, multiple of 64 up to 1024, 0 to disable. */
+	uint16_t hdr_buf_size;
+};
+
 /**
  * A structure used to configure an RX ring of an Ethernet port.
  */
@@ -843,9 +875,14 @@ struct rte_eth_rxconf {
 	 * fields on rte_eth_dev_info structure are allowed to be set.
 	 */
 	uint64_t offloads;
+	/**
+	 * Host Bypassing: descriptor ring in external memory,
+	 * NULL to use a ring allocated by the PMD.
+	 */
+	struct rte_eth_ext_ring_conf *ext_ring;
 
 	uint64_t reserved_64s[2]; /**< Reserved for future fields */
-	void *reserved_ptrs[2];   /**< Reserved for future fields */
+	void *reserved_ptrs[1];   /**< Reserved for future fields */
 };
 
 /**
@@ -864,9 +901,14 @@ struct rte_eth_txconf {
 	 * fields on rte_eth_dev_info structure are allowed to be set.
 	 */
 	uint64_t offloads;
+	/**
+	 * Host Bypassing: descriptor ring in external memory,
+	 * NULL to use a ring allocated by the PMD.
+	 */
+	struct rte_eth_ext_ring_conf *ext_ring;
 
 	uint64_t reserved_64s[2]; /**< Reserved for future fields */
-	void *reserved_ptrs[2];   /**< Reserved for future fields */
+	void *reserved_ptrs[1];   /**< Reserved for future fields */
 };
 
 /**
@@ -1861,6 +1903,7 @@ rte_eth_dev_is_removed(uint16_t port_id);
  * @param mb_pool
  *   The pointer to the memory pool from which to allocate *rte_mbuf* network
  *   memory buffers to populate each descriptor of the receive ring.
+ *   May be NULL if the ring is placed in external memory (rx_conf->ext_ring).
  * @return
  *   - 0: Success, receive queue correctly set up.
  *   - -EIO: if device is removed.
@@ -31,7 +31,27 @@ module configuration_registers #(
 	output wire                        start_o,
 	output wire                        init_o,
 	output wire[63:0]                  nic_base_addr_reg_o,
-	output wire[31:0]                  fpga_base_addr_reg_o
+	output wire[31:0]                  fpga_base_addr_reg_o,
+	output wire[63:0]                  nic_rdt_addr_reg_o, //doorbells of the bypass queue, from ixgbe_dev_rx_queue_regs()/ixgbe_dev_tx_queue_regs()
+	output wire[63:0]                  nic_tdt_addr_reg_o,
+	output wire[63:0]                  nic_rdt_addr1_reg_o, //doorbells of the rx queues 1-3
+	output wire[63:0]                  nic_rdt_addr2_reg_o,
+	output wire[63:0]                  nic_rdt_addr3_reg_o,
+	output wire[127:0]                 itr_cfg_reg_o, //doorbell moderation policy of tailpointer_delay
+
+	output wire                        perf_snapshot_o, //latches all counters of perf_counters
+	output wire[5:0]                   perf_addr_o,
+	input wire[31:0]                   perf_data_i,
+
+	output wire                        ma_wr_o, //tables and counters of match_action
+	output wire[6:0]                   ma_addr_o,
+	output wire[31:0]                  ma_data_o,
+	input wire[31:0]                   ma_data_i,
+
+	output wire                        lat_wr_o, //registers of latency_monitor
+	output wire[5:0]                   lat_addr_o,
+	output wire[31:0]                  lat_data_o,
+	input wire[31:0]                   lat_data_i
 
 		);
 
@@ -40,11 +60,50 @@ module configuration_registers #(
 reg[32-1:0] reg_0 = 0;
 reg[32-1:0] reg_1;
 reg[32-1:0] reg_2;
+reg[32-1:0] reg_3 = 0;
+reg[32-1:0] reg_4;
+reg[32-1:0] reg_5 = 0;
+reg[32-1:0] reg_6;
+reg[32-1:0] reg_7 = 0;
+// doorbell moderation of tailpointer_delay, the defaults are for the 250 MHz axi clock
+reg[32-1:0] reg_8  = {16'd1000, 16'd125};  //timeout in clock cycles: 31:16 max (throughput), 15:0 min (latency)
+reg[32-1:0] reg_9  = {16'd8,    16'd1};    //tail pointer updates per doorbell: 31:16 max, 15:0 min
+reg[32-1:0] reg_10 = {16'd256,  16'd32};   //updates per rate window: 31:16 above this the batch grows, 15:0 below this it shrinks
+reg[32-1:0] reg_11 = {15'd0, 1'b1, 16'd25000}; //16: adaptive (0: always max), 15:0 rate window in clock cycles
+reg[32-1:0] reg_12 = 0; //0: snapshot of the perf counters, cleared by hardware
+// doorbells (RDT register) of the rx queues 1-3, queue 0 is in reg_4/reg_5
+reg[32-1:0] reg_16 = 0;
+reg[32-1:0] reg_17 = 0;
+reg[32-1:0] reg_18 = 0;
+reg[32-1:0] reg_19 = 0;
+reg[32-1:0] reg_20 = 0;
+reg[32-1:0] reg_21 = 0;
+
+// byte offsets 0x000-0x07F hold the registers above, 0x100-0x1FF the read-only snapshot of perf_counters (32 x 64 bit, low word first),
+// 0x200-0x3FF the registers of match_action, 0x400-0x4FF the registers of latency_monitor
+wire reg_sel  = addr_i[11:7] == 5'h00;
+wire perf_sel = addr_i[11:8] == 4'h1;
+wire ma_sel   = addr_i[11:9] == 3'b001;
+wire lat_sel  = addr_i[11:8] == 4'h4;
 
 assign init_o = reg_0[0];
 assign start_o = reg_0[1];
-assign nic_base_addr_reg_o  = {32'b0, reg_1};
+assign nic_base_addr_reg_o  = {reg_3, reg_1};
 assign fpga_base_addr_reg_o = reg_2;
+assign nic_rdt_addr_reg_o   = {reg_5, reg_4};
+assign nic_tdt_addr_reg_o   = {reg_7, reg_6};
+assign nic_rdt_addr1_reg_o  = {reg_17, reg_16};
+assign nic_rdt_addr2_reg_o  = {reg_19, reg_18};
+assign nic_rdt_addr3_reg_o  = {reg_21, reg_20};
+assign itr_cfg_reg_o        = {reg_11, reg_10, reg_9, reg_8};
+assign perf_snapshot_o      = reg_12[0];
+assign perf_addr_o          = addr_i[7:2];
+assign ma_wr_o              = en_i & (|wea_i) & ma_sel;
+assign ma_addr_o            = addr_i[8:2];
+assign ma_data_o            = data_i;
+assign lat_wr_o             = en_i & (|wea_i) & lat_sel;
+assign lat_addr_o           = addr_i[7:2];
+assign lat_data_o           = data_i;
 
 always @(posedge clk_i) begin
 	if (~rst_i_n) begin
@@ -52,11 +111,12 @@ always @(posedge clk_i) begin
 		// s_axi_bvalid      <= 1'b0;
 		// s_axi_wready      <= 1'b0;
 		reg_0             <= 0;
+		reg_12            <= 0;
 		// w_state           <= IDLE;
 	end
 	else begin
-		case(addr_i[3:2])
-			2'b00 : begin
+		if(reg_sel) case(addr_i[6:2])
+			5'b00000 : begin
 				if(en_i) begin
 					if(wea_i[0]) reg_0[7:0]   <= data_i[7:0];
 					if(wea_i[1]) reg_0[15:8]  <= data_i[15:8];
@@ -64,7 +124,7 @@ always @(posedge clk_i) begin
 					if(wea_i[3]) reg_0[31:24] <= data_i[31:24];
 				end
 			end
-			2'b01 : begin
+			5'b00001 : begin
 				if(en_i) begin
 					if(wea_i[0]) reg_1[7:0]   <= data_i[7:0];
 					if(wea_i[1]) reg_1[15:8]  <= data_i[15:8];
@@ -72,7 +132,7 @@ always @(posedge clk_i) begin
 					if(wea_i[3]) reg_1[31:24] <= data_i[31:24];
 				end
 			end
-			2'b10 : begin
+			5'b00010 : begin
 				if(en_i) begin
 					if(wea_i[0]) reg_2[7:0]   <= data_i[7:0];
 					if(wea_i[1]) reg_2[15:8]  <= data_i[15:8];
@@ -80,6 +140,134 @@ always @(posedge clk_i) begin
 					if(wea_i[3]) reg_2[31:24] <= data_i[31:24];
 				end
 			end
+			5'b00011 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_3[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_3[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_3[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_3[31:24] <= data_i[31:24];
+				end
+			end
+			5'b00100 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_4[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_4[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_4[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_4[31:24] <= data_i[31:24];
+				end
+			end
+			5'b00101 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_5[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_5[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_5[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_5[31:24] <= data_i[31:24];
+				end
+			end
+			5'b00110 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_6[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_6[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_6[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_6[31:24] <= data_i[31:24];
+				end
+			end
+			5'b00111 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_7[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_7[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_7[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_7[31:24] <= data_i[31:24];
+				end
+			end
+			5'b01000 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_8[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_8[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_8[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_8[31:24] <= data_i[31:24];
+				end
+			end
+			5'b01001 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_9[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_9[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_9[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_9[31:24] <= data_i[31:24];
+				end
+			end
+			5'b01010 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_10[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_10[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_10[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_10[31:24] <= data_i[31:24];
+				end
+			end
+			5'b01011 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_11[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_11[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_11[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_11[31:24] <= data_i[31:24];
+				end
+			end
+			5'b01100 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_12[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_12[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_12[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_12[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10000 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_16[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_16[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_16[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_16[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10001 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_17[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_17[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_17[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_17[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10010 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_18[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_18[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_18[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_18[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10011 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_19[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_19[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_19[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_19[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10100 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_20[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_20[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_20[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_20[31:24] <= data_i[31:24];
+				end
+			end
+			5'b10101 : begin
+				if(en_i) begin
+					if(wea_i[0]) reg_21[7:0]   <= data_i[7:0];
+					if(wea_i[1]) reg_21[15:8]  <= data_i[15:8];
+					if(wea_i[2]) reg_21[23:16] <= data_i[23:16];
+					if(wea_i[3]) reg_21[31:24] <= data_i[31:24];
+				end
+			end
 			default: begin
 				
 			end
@@ -87,6 +275,8 @@ always @(posedge clk_i) begin
 
 		if(reg_0[0])
 			reg_0[0] <= 1'b0;
+		if(reg_12[0])
+			reg_12[0] <= 1'b0;
 	end
 end
 
@@ -94,19 +284,73 @@ end
 always @(posedge clk_i) begin
 	if(rst_i) begin
 		data_o <= 0;
-	end else begin		
-		case(addr_i[3:2])
-			2'b00 : begin
+	end else if(perf_sel) begin
+		if(en_i) data_o <= perf_data_i;
+	end else if(ma_sel) begin
+		if(en_i) data_o <= ma_data_i;
+	end else if(lat_sel) begin
+		if(en_i) data_o <= lat_data_i;
+	end else if(reg_sel) begin
+		case(addr_i[6:2])
+			5'b00000 : begin
 				if(en_i) data_o <= reg_0;
 			end
-			2'b01 : begin
+			5'b00001 : begin
 				if(en_i) data_o <= reg_1;
 			end
-			2'b10 : begin
+			5'b00010 : begin
 				if(en_i) data_o <= reg_2;
 			end
+			5'b00011 : begin
+				if(en_i) data_o <= reg_3;
+			end
+			5'b00100 : begin
+				if(en_i) data_o <= reg_4;
+			end
+			5'b00101 : begin
+				if(en_i) data_o <= reg_5;
+			end
+			5'b00110 : begin
+				if(en_i) data_o <= reg_6;
+			end
+			5'b00111 : begin
+				if(en_i) data_o <= reg_7;
+			end
+			5'b01000 : begin
+				if(en_i) data_o <= reg_8;
+			end
+			5'b01001 : begin
+				if(en_i) data_o <= reg_9;
+			end
+			5'b01010 : begin
+				if(en_i) data_o <= reg_10;
+			end
+			5'b01011 : begin
+				if(en_i) data_o <= reg_11;
+			end
+			5'b01100 : begin
+				if(en_i) data_o <= reg_12;
+			end
+			5'b10000 : begin
+				if(en_i) data_o <= reg_16;
+			end
+			5'b10001 : begin
+				if(en_i) data_o <= reg_17;
+			end
+			5'b10010 : begin
+				if(en_i) data_o <= reg_18;
+			end
+			5'b10011 : begin
+				if(en_i) data_o <= reg_19;
+			end
+			5'b10100 : begin
+				if(en_i) data_o <= reg_20;
+			end
+			5'b10101 : begin
+				if(en_i) data_o <= reg_21;
+			end
 			default : begin
-				
+				if(en_i) data_o <= 0;
 			end
 		endcase
 		if(en_i) begin
@@ -115,6 +359,8 @@ always @(posedge clk_i) begin
 			if(wea_i[2]) data_o[23:16] <= data_i[23:16];
 			if(wea_i[3]) data_o[31:24] <= data_i[31:24];
 		end
+	end else begin
+		if(en_i) data_o <= 0; //unmapped address
 	end
 end
 
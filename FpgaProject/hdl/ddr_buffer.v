@@ -0,0 +1,408 @@
+/*
+This module is a deep buffer for the rx ethernet stream in the on-board DDR4 memory.
+rx_packet_handler only returns an rx buffer to the NIC after it has been streamed, so a network function which stalls for longer
+than the buffers of the rx rings last makes the NIC drop frames. Behind this module the buffers are streamed on
+while the frames wait in a ring of 2^RING_SHIFT bytes in the DDR4 (MIG behind a smartconnect with clock conversion on m_axi).
+
+The decision is taken per frame before its first beat:
+	- bypass: nothing is stored and the output was ready in the previous cycle, the frame is passed through.
+	- spill: the frame is written into the ring. All following frames are spilled as well until the ring is empty again,
+	  so the frame order is kept. A frame is only spilled if MAX_FRAME bytes and a header entry are free, else the input waits.
+Spilled frames are stored back to back (beat aligned), the bursts never cross a CHUNK boundary (4KB, max. 256 beats).
+Length and tuser of each frame are kept in an on-chip header queue of HDR_DEPTH entries, which is written once the
+write responses of all bursts of the frame are in, so a frame is never read before it is in the DDR4.
+The frames are read back in order and streamed out with tkeep of the last beat from the stored length.
+Each frame takes one additional clock cycle for the decision.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module ddr_buffer #(
+	parameter AXIS_WIDTH = 64, //also the data width of m_axi
+	parameter M_AXI_ADDR_WIDTH = 34,
+	parameter RING_BASE = 0, //byte address of the ring in the DDR4
+	parameter RING_SHIFT = 30, //ring size 2^RING_SHIFT bytes
+	parameter HDR_DEPTH = 4096, //frames in the ring, power of two
+	parameter MAX_FRAME = 16384, //bytes reserved before a frame is spilled
+	parameter DEBUG_EN = 0
+)(
+(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axis_eth:m_axis_eth:m_axi, ASSOCIATED_RESET rst_i_n" *)
+	input wire                             clk_i,
+(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 rst_i_n RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	input wire                             rst_i_n,
+
+	input wire[AXIS_WIDTH-1:0]             s_axis_eth_tdata,
+	input wire[7:0]                        s_axis_eth_tuser,
+	input wire                             s_axis_eth_tlast,
+	input wire[AXIS_WIDTH/8-1:0]           s_axis_eth_tkeep,
+	input wire                             s_axis_eth_tvalid,
+	output reg                             s_axis_eth_tready,
+
+	output reg[AXIS_WIDTH-1:0]             m_axis_eth_tdata,
+	output reg[7:0]                        m_axis_eth_tuser,
+	output reg                             m_axis_eth_tlast,
+	output reg[AXIS_WIDTH/8-1:0]           m_axis_eth_tkeep,
+	output reg                             m_axis_eth_tvalid,
+	input wire                             m_axis_eth_tready,
+
+	output wire[0:0]                       m_axi_awid,
+	output wire[M_AXI_ADDR_WIDTH-1:0]      m_axi_awaddr,
+	output wire[7:0]                       m_axi_awlen,
+	output wire[2:0]                       m_axi_awsize,
+	output wire[1:0]                       m_axi_awburst,
+	output wire                            m_axi_awvalid,
+	input wire                             m_axi_awready,
+
+	output wire[AXIS_WIDTH-1:0]            m_axi_wdata,
+	output wire[AXIS_WIDTH/8-1:0]          m_axi_wstrb,
+	output wire                            m_axi_wlast,
+	output wire                            m_axi_wvalid,
+	input wire                             m_axi_wready,
+
+	input wire[0:0]                        m_axi_bid,
+	input wire[1:0]                        m_axi_bresp,
+	input wire                             m_axi_bvalid,
+	output wire                            m_axi_bready,
+
+	output wire[0:0]                       m_axi_arid,
+	output reg[M_AXI_ADDR_WIDTH-1:0]       m_axi_araddr,
+	output reg[7:0]                        m_axi_arlen,
+	output wire[2:0]                       m_axi_arsize,
+	output wire[1:0]                       m_axi_arburst,
+	output reg                             m_axi_arvalid,
+	input wire                             m_axi_arready,
+
+	input wire[0:0]                        m_axi_rid,
+	input wire[AXIS_WIDTH-1:0]             m_axi_rdata,
+	input wire[1:0]                        m_axi_rresp,
+	input wire                             m_axi_rlast,
+	input wire                             m_axi_rvalid,
+	output reg                             m_axi_rready
+	);
+
+localparam IN_SOF    = 0,
+           IN_BYPASS = 1,
+           IN_SPILL  = 2;
+
+localparam BEAT_BYTES  = AXIS_WIDTH/8;
+localparam BEAT_SHIFT  = $clog2(BEAT_BYTES);
+localparam CHUNK_BYTES = 256*BEAT_BYTES < 4096 ? 256*BEAT_BYTES : 4096;
+localparam CHUNK_BEATS = CHUNK_BYTES/BEAT_BYTES;
+localparam PTR_WIDTH   = RING_SHIFT + 1; //byte pointers into the ring with wrap bit
+localparam HDR_IX_WIDTH = $clog2(HDR_DEPTH);
+localparam WBUF_DEPTH  = 2*CHUNK_BEATS;
+localparam WBUF_IX_WIDTH = $clog2(WBUF_DEPTH);
+localparam Q_DEPTH     = 16; //bursts between input and write response
+localparam Q_IX_WIDTH  = 4;
+localparam RQ_DEPTH    = 8; //frames between read address and read data
+localparam RQ_IX_WIDTH = 3;
+
+assign m_axi_awid    = 0;
+assign m_axi_awsize  = BEAT_SHIFT;
+assign m_axi_awburst = 2'b01;   //INCR burst type
+assign m_axi_wstrb   = {(AXIS_WIDTH/8){1'b1}};
+assign m_axi_bready  = 1'b1;
+assign m_axi_arid    = 0;
+assign m_axi_arsize  = BEAT_SHIFT;
+assign m_axi_arburst = 2'b01;
+
+reg[1:0] in_state;
+
+// beats up to the next chunk boundary
+function [8:0] chunk_left(input [PTR_WIDTH-1:0] addr);
+	chunk_left = CHUNK_BEATS - addr[$clog2(CHUNK_BYTES)-1:BEAT_SHIFT];
+endfunction
+
+function [15:0] frame_beats(input [15:0] len);
+	frame_beats = (len >> BEAT_SHIFT) + (|len[BEAT_SHIFT-1:0]);
+endfunction
+
+reg[PTR_WIDTH-1:0]  w_addr;    //next beat of the input
+reg[PTR_WIDTH-1:0]  free_addr; //end of the frames read back
+reg[15:0]           frames;    //spilled frames until they have been streamed out
+
+wire[PTR_WIDTH-1:0] ring_used = w_addr - free_addr;
+wire ring_empty = frames == 0;
+wire ring_space = ring_used <= (1 << RING_SHIFT) - MAX_FRAME & frames < HDR_DEPTH;
+
+////////////////////////////////////////////////////////// write path
+
+// beats of the spilled frames, a burst is sent once all its beats are here
+reg[AXIS_WIDTH-1:0]   wbuf[0:WBUF_DEPTH-1];
+reg[WBUF_IX_WIDTH:0]  wbuf_wr;
+reg[WBUF_IX_WIDTH:0]  wbuf_rd;
+wire[WBUF_IX_WIDTH:0] wbuf_level = wbuf_wr - wbuf_rd;
+wire wbuf_full = wbuf_level == WBUF_DEPTH;
+
+// bursts: address, length, last burst of the frame with its length and tuser
+reg[PTR_WIDTH-1:0]    aw_addr[0:Q_DEPTH-1];
+reg[7:0]              aw_len[0:Q_DEPTH-1];
+reg                   aw_last[0:Q_DEPTH-1];
+reg[23:0]             aw_hdr[0:Q_DEPTH-1];
+reg[Q_IX_WIDTH:0]     aw_wr;
+reg[Q_IX_WIDTH:0]     aw_rd; //address channel
+reg[Q_IX_WIDTH:0]     w_rd;  //data channel
+reg[Q_IX_WIDTH:0]     b_rd;  //write response
+wire[Q_IX_WIDTH:0] aw_level = aw_wr - b_rd;
+wire aw_full = aw_level == Q_DEPTH;
+
+reg[PTR_WIDTH-1:0]    burst_addr;
+reg[8:0]              burst_beats;
+reg[15:0]             frame_len;
+reg[7:0]              frame_tuser;
+reg[7:0]              w_cnt;
+
+reg[BEAT_SHIFT:0] keep_bytes;
+integer k;
+always @(*) begin
+	keep_bytes = 0;
+	for(k = 0; k < BEAT_BYTES; k = k + 1)
+		keep_bytes = keep_bytes + s_axis_eth_tkeep[k];
+end
+
+wire       spill_hs   = in_state == IN_SPILL & s_axis_eth_tvalid & s_axis_eth_tready;
+wire[8:0]  beats_next = burst_beats + 1;
+wire[15:0] len_next   = frame_len + (s_axis_eth_tlast ? keep_bytes : BEAT_BYTES);
+
+assign m_axi_awaddr  = RING_BASE + aw_addr[aw_rd[Q_IX_WIDTH-1:0]][RING_SHIFT-1:0];
+assign m_axi_awlen   = aw_len[aw_rd[Q_IX_WIDTH-1:0]];
+assign m_axi_awvalid = aw_rd != aw_wr;
+
+assign m_axi_wdata   = wbuf[wbuf_rd[WBUF_IX_WIDTH-1:0]];
+assign m_axi_wvalid  = w_rd != aw_wr;
+assign m_axi_wlast   = w_cnt == aw_len[w_rd[Q_IX_WIDTH-1:0]];
+
+// header queue, length 15:0 and tuser 23:16 of the frames in the ddr
+reg[23:0]             hdr_mem[0:HDR_DEPTH-1];
+reg[HDR_IX_WIDTH:0]   hdr_wr;
+reg[HDR_IX_WIDTH:0]   hdr_rd;
+reg[23:0]             hdr_q;
+always @(posedge clk_i)
+	hdr_q <= hdr_mem[hdr_rd[HDR_IX_WIDTH-1:0]];
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		w_addr      <= 0;
+		burst_addr  <= 0;
+		burst_beats <= 0;
+		wbuf_wr     <= 0;
+		wbuf_rd     <= 0;
+		aw_wr       <= 0;
+		aw_rd       <= 0;
+		w_rd        <= 0;
+		b_rd        <= 0;
+		w_cnt       <= 0;
+		hdr_wr      <= 0;
+	end
+	else begin
+		if(in_state == IN_SOF) begin
+			frame_len   <= 0;
+			frame_tuser <= s_axis_eth_tuser;
+		end
+		if(spill_hs) begin
+			wbuf[wbuf_wr[WBUF_IX_WIDTH-1:0]] <= s_axis_eth_tdata;
+			wbuf_wr     <= wbuf_wr + 1;
+			w_addr      <= w_addr + BEAT_BYTES;
+			frame_len   <= len_next;
+			burst_beats <= beats_next;
+			if(beats_next == chunk_left(burst_addr) | s_axis_eth_tlast) begin
+				aw_addr[aw_wr[Q_IX_WIDTH-1:0]] <= burst_addr;
+				aw_len[aw_wr[Q_IX_WIDTH-1:0]]  <= beats_next - 1;
+				aw_last[aw_wr[Q_IX_WIDTH-1:0]] <= s_axis_eth_tlast;
+				aw_hdr[aw_wr[Q_IX_WIDTH-1:0]]  <= {frame_tuser, len_next};
+				aw_wr       <= aw_wr + 1;
+				burst_addr  <= w_addr + BEAT_BYTES;
+				burst_beats <= 0;
+			end
+		end
+
+		if(m_axi_awvalid & m_axi_awready)
+			aw_rd <= aw_rd + 1;
+
+		if(m_axi_wvalid & m_axi_wready) begin
+			wbuf_rd <= wbuf_rd + 1;
+			w_cnt   <= w_cnt + 1;
+			if(m_axi_wlast) begin
+				w_cnt <= 0;
+				w_rd  <= w_rd + 1;
+			end
+		end
+
+		// the frame is in the ddr with the response of its last burst
+		if(m_axi_bvalid & b_rd != aw_rd) begin
+			b_rd <= b_rd + 1;
+			if(aw_last[b_rd[Q_IX_WIDTH-1:0]]) begin
+				hdr_mem[hdr_wr[HDR_IX_WIDTH-1:0]] <= aw_hdr[b_rd[Q_IX_WIDTH-1:0]];
+				hdr_wr <= hdr_wr + 1;
+			end
+		end
+	end
+end
+
+////////////////////////////////////////////////////////// read path
+
+localparam AR_IDLE  = 0,
+           AR_HDR   = 1,
+           AR_BURST = 2;
+
+reg[1:0]            ar_state;
+reg[PTR_WIDTH-1:0]  r_addr;
+reg[15:0]           ar_left;
+
+// frames whose bursts are requested: length and tuser
+reg[23:0]           rq_hdr[0:RQ_DEPTH-1];
+reg[RQ_IX_WIDTH:0]  rq_wr;
+reg[RQ_IX_WIDTH:0]  rq_rd;
+wire rq_empty = rq_wr == rq_rd;
+wire[RQ_IX_WIDTH:0] rq_level = rq_wr - rq_rd;
+wire rq_full  = rq_level == RQ_DEPTH;
+
+wire[15:0] ar_n = ar_left < chunk_left(r_addr) ? ar_left : chunk_left(r_addr);
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		ar_state      <= AR_IDLE;
+		r_addr        <= 0;
+		hdr_rd        <= 0;
+		rq_wr         <= 0;
+		m_axi_arvalid <= 1'b0;
+	end
+	else begin
+		case(ar_state)
+			AR_IDLE : begin  //0
+				if(hdr_wr != hdr_rd & ~rq_full)
+					ar_state <= AR_HDR; //hdr_q is read
+			end
+			AR_HDR : begin  //1
+				rq_hdr[rq_wr[RQ_IX_WIDTH-1:0]] <= hdr_q;
+				rq_wr    <= rq_wr + 1;
+				hdr_rd   <= hdr_rd + 1;
+				ar_left  <= frame_beats(hdr_q[15:0]);
+				ar_state <= AR_BURST;
+			end
+			AR_BURST : begin  //2
+				if(~m_axi_arvalid) begin
+					m_axi_araddr  <= RING_BASE + r_addr[RING_SHIFT-1:0];
+					m_axi_arlen   <= ar_n - 1;
+					m_axi_arvalid <= 1'b1;
+					r_addr        <= r_addr + ar_n * BEAT_BYTES;
+					ar_left       <= ar_left - ar_n;
+				end else if(m_axi_arready) begin
+					m_axi_arvalid <= 1'b0;
+					if(ar_left == 0)
+						ar_state <= AR_IDLE;
+				end
+			end
+			default : begin
+				ar_state <= AR_IDLE;
+			end
+		endcase
+	end
+end
+
+reg[15:0] r_beat;
+wire[23:0] r_hdr   = rq_hdr[rq_rd[RQ_IX_WIDTH-1:0]];
+wire[15:0] r_beats = frame_beats(r_hdr[15:0]);
+wire       r_last  = r_beat == r_beats - 1;
+wire[AXIS_WIDTH/8-1:0] r_keep_last = r_hdr[BEAT_SHIFT-1:0] == 0 ? {(AXIS_WIDTH/8){1'b1}} : ~({(AXIS_WIDTH/8){1'b1}} << r_hdr[BEAT_SHIFT-1:0]);
+
+////////////////////////////////////////////////////////// stream
+
+reg m_ready_q; //the decision only depends on registered signals, tvalid must not depend on tready
+
+always @(*) begin
+	s_axis_eth_tready = 1'b0;
+	m_axis_eth_tdata  = s_axis_eth_tdata;
+	m_axis_eth_tuser  = s_axis_eth_tuser;
+	m_axis_eth_tlast  = s_axis_eth_tlast;
+	m_axis_eth_tkeep  = s_axis_eth_tkeep;
+	m_axis_eth_tvalid = 1'b0;
+	m_axi_rready      = 1'b0;
+	if(in_state == IN_BYPASS) begin
+		s_axis_eth_tready = m_axis_eth_tready;
+		m_axis_eth_tvalid = s_axis_eth_tvalid;
+	end else begin
+		if(in_state == IN_SPILL)
+			s_axis_eth_tready = ~wbuf_full & ~aw_full;
+		m_axis_eth_tdata  = m_axi_rdata;
+		m_axis_eth_tuser  = r_hdr[23:16];
+		m_axis_eth_tlast  = r_last;
+		m_axis_eth_tkeep  = r_last ? r_keep_last : {(AXIS_WIDTH/8){1'b1}};
+		m_axis_eth_tvalid = m_axi_rvalid & ~rq_empty;
+		m_axi_rready      = m_axis_eth_tready & ~rq_empty;
+	end
+end
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		in_state  <= IN_SOF;
+		m_ready_q <= 1'b0;
+		frames    <= 0;
+		free_addr <= 0;
+		rq_rd     <= 0;
+		r_beat    <= 0;
+	end
+	else begin
+		m_ready_q <= m_axis_eth_tready;
+		case(in_state)
+			IN_SOF : begin  //0
+				if(s_axis_eth_tvalid) begin
+					if(ring_empty & m_ready_q)
+						in_state <= IN_BYPASS;
+					else if(ring_space)
+						in_state <= IN_SPILL;
+				end
+			end
+			IN_BYPASS : begin  //1
+				if(s_axis_eth_tvalid & m_axis_eth_tready & s_axis_eth_tlast)
+					in_state <= IN_SOF;
+			end
+			IN_SPILL : begin  //2
+				if(spill_hs & s_axis_eth_tlast)
+					in_state <= IN_SOF;
+			end
+			default : begin
+				in_state <= IN_SOF;
+			end
+		endcase
+
+		if(in_state == IN_SOF & s_axis_eth_tvalid & ~(ring_empty & m_ready_q) & ring_space) begin
+			if(~(m_axi_rvalid & m_axi_rready & r_last))
+				frames <= frames + 1;
+		end else if(m_axi_rvalid & m_axi_rready & r_last) begin
+			frames <= frames - 1;
+		end
+
+		if(m_axi_rvalid & m_axi_rready) begin
+			r_beat <= r_beat + 1;
+			if(r_last) begin
+				r_beat    <= 0;
+				rq_rd     <= rq_rd + 1;
+				free_addr <= free_addr + r_beats * BEAT_BYTES;
+			end
+		end
+	end
+end
+
+
+generate
+if(DEBUG_EN) begin
+
+	(* MARK_DEBUG="true" *) reg[1:0]     in_state_debug;
+	(* MARK_DEBUG="true" *) reg[1:0]     ar_state_debug;
+	(* MARK_DEBUG="true" *) reg[15:0]    frames_debug;
+	(* MARK_DEBUG="true" *) reg[PTR_WIDTH-1:0] w_addr_debug;
+	(* MARK_DEBUG="true" *) reg[PTR_WIDTH-1:0] free_addr_debug;
+
+	always @(posedge clk_i) begin
+		in_state_debug  <= in_state;
+		ar_state_debug  <= ar_state;
+		frames_debug    <= frames;
+		w_addr_debug    <= w_addr;
+		free_addr_debug <= free_addr;
+	end
+
+end
+endgenerate
+
+endmodule
+`default_nettype wire
@@ -0,0 +1,305 @@
+/*
+This module measures the residence time of the frames in the bypass path and collects it in a histogram.
+ts_o is a free running 32 bit cycle counter (4 ns at 250 MHz). rx_desc_ctrl takes ts_o when it sees the dd bit of a descriptor
+and hands it on with the buffer (pkt_ts_o), the timestamp of a frame is the one of its first buffer.
+The residence time is ts_o at the tx doorbell of the frame (tx_desc_ctrl writes one tail pointer per frame) minus the rx timestamp,
+the doorbell moderation of tailpointer_delay behind tx_desc_ctrl is not included.
+
+The rx timestamps are queued in ring order, without stamping the n-th doorbell belongs to the n-th received frame.
+This only holds if the network function forwards every frame in order.
+With stamping the timestamp is written into each frame on the rx stream (big endian, 4 bytes at the programmable byte offset)
+and read back from the tx stream, so dropped frames do not mix up the measurement. Stamping needs the ethernet stream (no hairpin),
+the rx stream is passed through combinationally.
+
+Histogram bucket b counts the residence times from 2^b to 2^(b+1)-1 cycles, bucket 0 also 0 cycles.
+
+Register map (32 bit word index behind configuration_registers):
+	0       0: stamping enable, 1: clear the statistics, 2: clear min / max only (both cleared by hardware)
+	1       stamp offset in bytes from the start of the frame
+	2       measured frames
+	3/4     min / max residence time in cycles
+	5/6     sum of the residence times, low word first
+	7       ts_o (read only)
+	8       doorbells without rx timestamp
+	9       rx timestamps lost because the queue was full
+	32-63   histogram buckets
+The statistics are cleared with init_i or the clear bit, init_i also empties the timestamp queue.
+The counters wrap around, the host can take the differences between two reads instead of clearing them, so no frame
+is lost between reading and clearing. A frame measured in the cycle min / max are cleared starts the new min / max.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module latency_monitor #(
+	parameter AXIS_WIDTH = 64,
+	parameter TS_DEPTH = 256, //rx timestamps in flight, power of two
+	parameter DEBUG_EN = 0
+)(
+(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axis_eth:m_axis_eth:S_AXIS_TX_MON, ASSOCIATED_RESET rst_i_n" *)
+	input wire                             clk_i,
+(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 rst_i_n RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	input wire                             rst_i_n,
+
+	input wire                             init_i,
+	output reg[31:0]                       ts_o,
+
+	// rx buffers as handed to the packet handler (tx_desc_ctrl with hairpin)
+	input wire[31:0]                       rx_pkt_ts_i,
+	input wire                             rx_pkt_eop_i,
+	input wire                             rx_pkt_ack_i,
+
+	// tail pointer write of tx_desc_ctrl
+	input wire                             tx_db_valid_i,
+	input wire                             tx_db_ready_i,
+
+	// rx stream, stamped
+	input wire[AXIS_WIDTH-1:0]             s_axis_eth_tdata,
+	input wire[7:0]                        s_axis_eth_tuser,
+	input wire                             s_axis_eth_tlast,
+	input wire[AXIS_WIDTH/8-1:0]           s_axis_eth_tkeep,
+	input wire                             s_axis_eth_tvalid,
+	output wire                            s_axis_eth_tready,
+
+	output reg[AXIS_WIDTH-1:0]             m_axis_eth_tdata,
+	output wire[7:0]                       m_axis_eth_tuser,
+	output wire                            m_axis_eth_tlast,
+	output wire[AXIS_WIDTH/8-1:0]          m_axis_eth_tkeep,
+	output wire                            m_axis_eth_tvalid,
+	input wire                             m_axis_eth_tready,
+
+	// tx stream, the stamp is read back
+	(* X_INTERFACE_MODE = "monitor" *)
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TDATA" *)
+	input wire[AXIS_WIDTH-1:0]             tx_mon_tdata,
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TLAST" *)
+	input wire                             tx_mon_tlast,
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TVALID" *)
+	input wire                             tx_mon_tvalid,
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TREADY" *)
+	input wire                             tx_mon_tready,
+
+	// registers, 32 bit word index
+	input wire                             wr_i,
+	input wire[5:0]                        addr_i,
+	input wire[31:0]                       wr_data_i,
+	output reg[31:0]                       rd_data_o
+	);
+
+localparam BEAT_BYTES   = AXIS_WIDTH/8;
+localparam TS_IX_WIDTH  = $clog2(TS_DEPTH);
+localparam NB_BUCKETS   = 32;
+
+reg        stamp_en;
+reg        clear;
+reg        clear_mm;
+reg[15:0]  stamp_offs;
+
+reg[31:0]  lat_cnt;
+reg[31:0]  lat_min;
+reg[31:0]  lat_max;
+reg[63:0]  lat_sum;
+reg[31:0]  unmatched;
+reg[31:0]  lost;
+reg[31:0]  hist[0:NB_BUCKETS-1];
+
+always @(posedge clk_i) begin
+	if (~rst_i_n)
+		ts_o <= 0;
+	else
+		ts_o <= ts_o + 1;
+end
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		stamp_en   <= 1'b0;
+		clear      <= 1'b0;
+		clear_mm   <= 1'b0;
+		stamp_offs <= 0;
+	end
+	else begin
+		clear    <= 1'b0;
+		clear_mm <= 1'b0;
+		if(wr_i) case(addr_i)
+			6'd0 : begin
+				stamp_en <= wr_data_i[0];
+				clear    <= wr_data_i[1];
+				clear_mm <= wr_data_i[2];
+			end
+			6'd1 : stamp_offs <= wr_data_i[15:0];
+			default : begin
+			end
+		endcase
+	end
+end
+
+always @(*) begin
+	if(addr_i >= 32)
+		rd_data_o = hist[addr_i[4:0]];
+	else case(addr_i)
+		6'd0 : rd_data_o = {31'h0, stamp_en};
+		6'd1 : rd_data_o = {16'h0, stamp_offs};
+		6'd2 : rd_data_o = lat_cnt;
+		6'd3 : rd_data_o = lat_min;
+		6'd4 : rd_data_o = lat_max;
+		6'd5 : rd_data_o = lat_sum[31:0];
+		6'd6 : rd_data_o = lat_sum[63:32];
+		6'd7 : rd_data_o = ts_o;
+		6'd8 : rd_data_o = unmatched;
+		6'd9 : rd_data_o = lost;
+		default : rd_data_o = 0;
+	endcase
+end
+
+////////////////////////////////////////////////////////// stamping
+
+// byte position of the current beat in the frame, the first beat is at 0
+reg[15:0] rx_pos;
+reg[15:0] tx_pos;
+reg[31:0] frame_ts;
+
+wire       rx_hs = s_axis_eth_tvalid & m_axis_eth_tready;
+wire       tx_hs = tx_mon_tvalid & tx_mon_tready;
+wire[31:0] rx_ts = rx_pos == 0 ? rx_pkt_ts_i : frame_ts; //the first buffer of the frame is presented until its last beat
+
+assign s_axis_eth_tready = m_axis_eth_tready;
+assign m_axis_eth_tvalid = s_axis_eth_tvalid;
+assign m_axis_eth_tuser  = s_axis_eth_tuser;
+assign m_axis_eth_tlast  = s_axis_eth_tlast;
+assign m_axis_eth_tkeep  = s_axis_eth_tkeep;
+
+reg[31:0] tx_ts;
+reg[31:0] tx_ts_next;
+integer k;
+always @(*) begin
+	m_axis_eth_tdata = s_axis_eth_tdata;
+	tx_ts_next       = tx_ts;
+	for(k = 0; k < BEAT_BYTES; k = k + 1) begin
+		if(stamp_en & rx_pos + k >= stamp_offs & rx_pos + k < stamp_offs + 4)
+			m_axis_eth_tdata[k*8 +: 8] = rx_ts[(3 - (rx_pos + k - stamp_offs))*8 +: 8];
+		if(tx_pos + k >= stamp_offs & tx_pos + k < stamp_offs + 4)
+			tx_ts_next[(3 - (tx_pos + k - stamp_offs))*8 +: 8] = tx_mon_tdata[k*8 +: 8];
+	end
+end
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		rx_pos <= 0;
+		tx_pos <= 0;
+	end
+	else begin
+		if(rx_hs) begin
+			rx_pos <= s_axis_eth_tlast ? 16'h0 : rx_pos + BEAT_BYTES;
+			if(rx_pos == 0)
+				frame_ts <= rx_pkt_ts_i;
+		end
+		if(tx_hs) begin
+			tx_pos <= tx_mon_tlast ? 16'h0 : tx_pos + BEAT_BYTES;
+			tx_ts  <= tx_ts_next;
+		end
+	end
+end
+
+////////////////////////////////////////////////////////// timestamp queue
+
+reg[31:0] ts_mem[0:TS_DEPTH-1];
+reg[TS_IX_WIDTH:0] ts_wr;
+reg[TS_IX_WIDTH:0] ts_rd;
+wire[TS_IX_WIDTH:0] ts_level = ts_wr - ts_rd;
+wire ts_empty = ts_wr == ts_rd;
+wire ts_full  = ts_level == TS_DEPTH;
+
+reg rx_in_frame; //a buffer without EOP has been acknowledged
+
+// without stamping the timestamp of the first buffer of each frame, with stamping the one read back at the end of each tx frame
+wire       push    = stamp_en ? tx_hs & tx_mon_tlast : rx_pkt_ack_i & ~rx_in_frame;
+wire[31:0] push_ts = stamp_en ? tx_ts_next : rx_pkt_ts_i;
+wire       pop     = tx_db_valid_i & tx_db_ready_i;
+
+reg       lat_v;
+reg[31:0] lat;
+
+always @(posedge clk_i) begin
+	if (~rst_i_n || init_i) begin
+		ts_wr       <= 0;
+		ts_rd       <= 0;
+		rx_in_frame <= 1'b0;
+		lat_v       <= 1'b0;
+	end
+	else begin
+		if(rx_pkt_ack_i)
+			rx_in_frame <= ~rx_pkt_eop_i;
+		if(push & ~ts_full) begin
+			ts_mem[ts_wr[TS_IX_WIDTH-1:0]] <= push_ts;
+			ts_wr <= ts_wr + 1;
+		end
+		lat_v <= pop & ~ts_empty;
+		if(pop & ~ts_empty) begin
+			lat   <= ts_o - ts_mem[ts_rd[TS_IX_WIDTH-1:0]];
+			ts_rd <= ts_rd + 1;
+		end
+	end
+end
+
+////////////////////////////////////////////////////////// statistics
+
+reg[4:0] bucket;
+integer b;
+always @(*) begin
+	bucket = 0;
+	for(b = 1; b < NB_BUCKETS; b = b + 1)
+		if(lat[b])
+			bucket = b;
+end
+
+always @(posedge clk_i) begin
+	if (~rst_i_n || init_i || clear) begin
+		lat_cnt   <= 0;
+		lat_min   <= 32'hFFFFFFFF;
+		lat_max   <= 0;
+		lat_sum   <= 0;
+		unmatched <= 0;
+		lost      <= 0;
+		for(b = 0; b < NB_BUCKETS; b = b + 1)
+			hist[b] <= 0;
+	end
+	else begin
+		if(pop & ts_empty)
+			unmatched <= unmatched + 1;
+		if(push & ts_full)
+			lost <= lost + 1;
+		if(clear_mm) begin
+			lat_min <= 32'hFFFFFFFF;
+			lat_max <= 0;
+		end
+		if(lat_v) begin
+			lat_cnt      <= lat_cnt + 1;
+			lat_sum      <= lat_sum + lat;
+			hist[bucket] <= hist[bucket] + 1;
+			if(lat < lat_min | clear_mm)
+				lat_min <= lat;
+			if(lat > lat_max | clear_mm)
+				lat_max <= lat;
+		end
+	end
+end
+
+
+generate
+if(DEBUG_EN) begin
+
+	(* MARK_DEBUG="true" *) reg          push_debug;
+	(* MARK_DEBUG="true" *) reg          pop_debug;
+	(* MARK_DEBUG="true" *) reg[31:0]    lat_debug;
+	(* MARK_DEBUG="true" *) reg          lat_v_debug;
+
+	always @(posedge clk_i) begin
+		push_debug  <= push;
+		pop_debug   <= pop;
+		lat_debug   <= lat;
+		lat_v_debug <= lat_v;
+	end
+
+end
+endgenerate
+
+endmodule
+`default_nettype wire
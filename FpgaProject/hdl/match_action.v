@@ -0,0 +1,554 @@
+/*
+This module is a match-action stage on the ethernet stream between rx_packet_handler and the network function.
+The first 64 bytes of each frame are held back and parsed: ethernet, one VLAN tag, IPv4 (with options) or IPv6 (no extension headers)
+and the ports of TCP and UDP. The parser steps can be switched off in the parser register.
+The key of the frame is looked up in two tables:
+	- an exact match table of EM_ENTRIES entries in block ram, the entry of a key is at em_hash(key).
+	  The host writes the key into the staging registers and reads the hash back to get the index of the entry.
+	- a ternary table of TC_ENTRIES entries in registers, key and mask per entry, the lowest matching index wins.
+An exact match hit takes precedence over the ternary table, frames without a hit get the default action.
+After the action is applied the held back header is sent and the rest of the frame is passed through.
+Dropped frames are consumed without output.
+The rewritten header is handed to an output register, so the header of the next frame is captured while it is sent.
+A frame within the header takes the header beats plus four clock cycles: with a 64 bit stream a 64 byte frame needs 12 cycles
+(20.8 Mpps at 250 MHz), with 256 bit 6 cycles. Longer frames also wait for their header to be sent before the rest is passed through.
+
+Key (320 bit, 32 bit words as seen by the host, fields not present in the frame are 0):
+	0       31:16 source port, 15:0 destination port (TCP/UDP)
+	1       23: ports valid, 22: IPv6, 21: IPv4, 20: VLAN, 19:8 VLAN id, 7:0 IP protocol / next header
+	2-5     source address, IPv4 in word 2, IPv6 with the last 32 bit in word 2
+	6-9     destination address, same layout
+Action (32 bit):
+	0       drop
+	1/2     rewrite MAC with the entry MAC, 2: source (else destination)
+	3/4     rewrite IPv4 address with the entry IP, 4: source (else destination), header and TCP/UDP checksums are updated.
+	        If the TCP/UDP checksum is behind the header (long IPv4 options) the address is not rewritten.
+	5       set queue: 7:6 are output in tuser[1:0] of the frame
+	8       count the frame in counter 14:9
+
+Register map (32 bit word index behind configuration_registers):
+	0-9     staged key
+	10-19   staged mask, ternary entries only (1: bit is compared)
+	20      staged action
+	21/22   staged MAC (47:0, low word first)
+	23      staged IP
+	24      command (write only): 15:0 index, 16: ternary table (else exact match), 17: valid (0 deletes the entry)
+	25      parser: 0 VLAN, 1 IPv4, 2 IPv6, 3 TCP/UDP ports
+	26      default action for frames without hit, the rewrite bits are ignored
+	27      em_hash of the staged key (read only)
+	28      31:16 TC_ENTRIES, 15:0 EM_ENTRIES (read only)
+	32-35   dropped frames, frames without hit, exact match hits, ternary hits (read only)
+	36      skipped IPv4 rewrites, TCP/UDP checksum behind the header (read only)
+	64-127  frame counters of the count action (read only)
+All counters are cleared with init_i, the tables are kept.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module match_action #(
+	parameter AXIS_WIDTH = 64, //64, 128, 256 or 512
+	parameter EM_ENTRIES = 256, //power of two, up to 65536
+	parameter TC_ENTRIES = 16,
+	parameter DEBUG_EN = 0
+)(
+	(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 axi_clk CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axis_eth:m_axis_eth, ASSOCIATED_RESET axi_aresetn" *)
+	   input wire                            axi_clk,
+	(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 axi_aresetn RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	   input wire                            axi_aresetn,
+
+	   input wire[AXIS_WIDTH-1:0]            s_axis_eth_tdata,
+	   input wire[7:0]                       s_axis_eth_tuser,
+	   input wire                            s_axis_eth_tlast,
+	   input wire[AXIS_WIDTH/8-1:0]          s_axis_eth_tkeep,
+	   input wire                            s_axis_eth_tvalid,
+	   output reg                            s_axis_eth_tready,
+
+	   output reg[AXIS_WIDTH-1:0]            m_axis_eth_tdata,
+	   output reg[7:0]                       m_axis_eth_tuser,
+	   output reg                            m_axis_eth_tlast,
+	   output reg[AXIS_WIDTH/8-1:0]          m_axis_eth_tkeep,
+	   output reg                            m_axis_eth_tvalid,
+	   input wire                            m_axis_eth_tready,
+
+	   input wire                            init_i,
+
+	   // tables and counters, 32 bit word index
+	   input wire                            wr_i,
+	   input wire[6:0]                       addr_i,
+	   input wire[31:0]                      wr_data_i,
+	   output reg[31:0]                      rd_data_o
+	);
+
+localparam CAPTURE = 0,
+           PARSE   = 1,
+           LOOKUP  = 2,
+           MATCH   = 3,
+           REWRITE = 4,
+           EMIT    = 5,
+           PASS    = 6,
+           DROP    = 7;
+
+localparam HDR_BYTES   = 64;
+localparam HDR_BEATS   = HDR_BYTES*8/AXIS_WIDTH;
+localparam BEAT_BYTES  = AXIS_WIDTH/8;
+localparam BEAT_IX_WIDTH = HDR_BEATS > 1 ? $clog2(HDR_BEATS) : 1;
+localparam KEY_WIDTH   = 320;
+localparam EM_IX_WIDTH = $clog2(EM_ENTRIES);
+localparam NB_CNT      = 64;
+localparam[15:0] EM_ENTRIES_W = EM_ENTRIES;
+localparam[15:0] TC_ENTRIES_W = TC_ENTRIES;
+
+// action bits
+localparam A_DROP    = 0,
+           A_MAC     = 1,
+           A_MAC_SRC = 2,
+           A_IP      = 3,
+           A_IP_SRC  = 4,
+           A_QUEUE   = 5,
+           A_COUNT   = 8;
+
+reg[2:0] ma_state;
+
+////////////////////////////////////////////////////////// tables and registers
+
+reg[KEY_WIDTH-1:0] stage_key;
+reg[KEY_WIDTH-1:0] stage_mask;
+reg[31:0]          stage_act;
+reg[47:0]          stage_mac;
+reg[31:0]          stage_ip;
+reg[3:0]           parse_cfg = 4'hF;
+reg[31:0]          default_act = 0;
+
+// exact match entry: valid, ip, mac, action, key
+localparam EM_WIDTH = 1 + 32 + 48 + 32 + KEY_WIDTH;
+reg[EM_WIDTH-1:0] em_mem[0:EM_ENTRIES-1];
+
+reg                tc_valid[0:TC_ENTRIES-1];
+reg[KEY_WIDTH-1:0] tc_key[0:TC_ENTRIES-1]; //masked
+reg[KEY_WIDTH-1:0] tc_mask[0:TC_ENTRIES-1];
+reg[31:0]          tc_act[0:TC_ENTRIES-1];
+reg[47:0]          tc_mac[0:TC_ENTRIES-1];
+reg[31:0]          tc_ip[0:TC_ENTRIES-1];
+
+reg[31:0] drop_cnt;
+reg[31:0] miss_cnt;
+reg[31:0] em_hit_cnt;
+reg[31:0] tc_hit_cnt;
+reg[31:0] skip_cnt;
+reg[31:0] cnt[0:NB_CNT-1];
+
+integer i, k, p, r, t;
+initial begin
+	for(i = 0; i < EM_ENTRIES; i = i + 1)
+		em_mem[i] = 0;
+end
+
+// word-wise xor of the key, folded to the table index
+function [EM_IX_WIDTH-1:0] em_hash(input [KEY_WIDTH-1:0] k);
+	reg[31:0] h;
+	integer w;
+	begin
+		h = 0;
+		for(w = 0; w < KEY_WIDTH/32; w = w + 1)
+			h = {h[26:0], h[31:27]} ^ k[w*32 +: 32];
+		h = h ^ (h >> 16);
+		h = h ^ (h >> 8);
+		em_hash = h[EM_IX_WIDTH-1:0];
+	end
+endfunction
+
+wire[15:0] cmd_ix    = wr_data_i[15:0];
+wire       cmd_tc    = wr_data_i[16];
+wire       cmd_valid = wr_data_i[17];
+
+always @(posedge axi_clk) begin
+	if (~axi_aresetn) begin
+		parse_cfg   <= 4'hF;
+		default_act <= 0;
+		for(i = 0; i < TC_ENTRIES; i = i + 1)
+			tc_valid[i] <= 1'b0;
+	end
+	else if(wr_i) begin
+		if(addr_i < 10)
+			stage_key[addr_i*32 +: 32] <= wr_data_i;
+		else if(addr_i < 20)
+			stage_mask[(addr_i-10)*32 +: 32] <= wr_data_i;
+		case(addr_i)
+			7'd20 : stage_act        <= wr_data_i;
+			7'd21 : stage_mac[31:0]  <= wr_data_i;
+			7'd22 : stage_mac[47:32] <= wr_data_i[15:0];
+			7'd23 : stage_ip         <= wr_data_i;
+			7'd24 : begin
+				if(cmd_tc) begin
+					if(cmd_ix < TC_ENTRIES) begin
+						tc_valid[cmd_ix] <= cmd_valid;
+						tc_key[cmd_ix]   <= stage_key & stage_mask;
+						tc_mask[cmd_ix]  <= stage_mask;
+						tc_act[cmd_ix]   <= stage_act;
+						tc_mac[cmd_ix]   <= stage_mac;
+						tc_ip[cmd_ix]    <= stage_ip;
+					end
+				end else begin
+					em_mem[cmd_ix[EM_IX_WIDTH-1:0]] <= {cmd_valid, stage_ip, stage_mac, stage_act, stage_key};
+				end
+			end
+			7'd25 : parse_cfg   <= wr_data_i[3:0];
+			7'd26 : default_act <= wr_data_i;
+			default : begin
+			end
+		endcase
+	end
+end
+
+always @(*) begin
+	rd_data_o = 0;
+	if(addr_i < 10)
+		rd_data_o = stage_key[addr_i*32 +: 32];
+	else if(addr_i < 20)
+		rd_data_o = stage_mask[(addr_i-10)*32 +: 32];
+	else if(addr_i >= 64)
+		rd_data_o = cnt[addr_i[5:0]];
+	else case(addr_i)
+		7'd20 : rd_data_o = stage_act;
+		7'd21 : rd_data_o = stage_mac[31:0];
+		7'd22 : rd_data_o = {16'h0, stage_mac[47:32]};
+		7'd23 : rd_data_o = stage_ip;
+		7'd25 : rd_data_o = {28'h0, parse_cfg};
+		7'd26 : rd_data_o = default_act;
+		7'd27 : rd_data_o = em_hash(stage_key);
+		7'd28 : rd_data_o = {TC_ENTRIES_W, EM_ENTRIES_W};
+		7'd32 : rd_data_o = drop_cnt;
+		7'd33 : rd_data_o = miss_cnt;
+		7'd34 : rd_data_o = em_hit_cnt;
+		7'd35 : rd_data_o = tc_hit_cnt;
+		7'd36 : rd_data_o = skip_cnt;
+		default : rd_data_o = 0;
+	endcase
+end
+
+////////////////////////////////////////////////////////// header capture
+
+reg[HDR_BYTES*8-1:0]  hdr; //byte n of the frame in hdr[n*8 +: 8]
+reg[BEAT_IX_WIDTH:0]  hdr_beats;
+reg                   hdr_last; //the frame ends in the header
+reg[BEAT_BYTES-1:0]   last_keep;
+reg[7:0]              frame_tuser;
+
+// header being sent
+reg[HDR_BYTES*8-1:0]  o_hdr;
+reg[BEAT_IX_WIDTH:0]  o_beats;
+reg[BEAT_IX_WIDTH:0]  o_ix;
+reg                   o_last;
+reg[BEAT_BYTES-1:0]   o_keep;
+reg[7:0]              o_tuser;
+reg                   o_busy;
+
+reg[AXIS_WIDTH-1:0] keep_bits;
+always @(*) begin
+	for(k = 0; k < BEAT_BYTES; k = k + 1)
+		keep_bits[k*8 +: 8] = {8{s_axis_eth_tkeep[k]}};
+end
+
+function [7:0] hbyte(input [HDR_BYTES*8-1:0] h, input [6:0] off);
+	hbyte = off < HDR_BYTES ? h[off*8 +: 8] : 8'h00;
+endfunction
+
+////////////////////////////////////////////////////////// parser
+
+reg       vlan_c, ipv4_c, ipv6_c, ports_c, frag_c, l4_hdr_c;
+reg[11:0] vlan_id_c;
+reg[15:0] eth_type_c;
+reg[6:0]  l3_c, l4_c;
+reg[7:0]  proto_c;
+reg[127:0] src_c, dst_c;
+reg[KEY_WIDTH-1:0] key_c;
+
+always @(*) begin
+	eth_type_c = {hbyte(hdr, 12), hbyte(hdr, 13)};
+	vlan_c     = parse_cfg[0] & eth_type_c == 16'h8100;
+	vlan_id_c  = vlan_c ? {hbyte(hdr, 14), hbyte(hdr, 15)} : 12'h0;
+	if(vlan_c)
+		eth_type_c = {hbyte(hdr, 16), hbyte(hdr, 17)};
+	l3_c       = vlan_c ? 18 : 14;
+	ipv4_c     = parse_cfg[1] & eth_type_c == 16'h0800 & hbyte(hdr, l3_c) >> 4 == 4;
+	ipv6_c     = parse_cfg[2] & eth_type_c == 16'h86DD & hbyte(hdr, l3_c) >> 4 == 6;
+	l4_c       = ipv4_c ? l3_c + {hbyte(hdr, l3_c) & 8'h0F, 2'b00} : l3_c + 40;
+	proto_c    = ipv4_c ? hbyte(hdr, l3_c + 9) : ipv6_c ? hbyte(hdr, l3_c + 6) : 8'h00;
+	frag_c     = ipv4_c & {hbyte(hdr, l3_c + 6) & 8'h1F, hbyte(hdr, l3_c + 7)} != 0; //non-first fragment, no TCP/UDP header
+	l4_hdr_c   = ipv4_c & (proto_c == 8'd6 | proto_c == 8'd17) & ~frag_c; //TCP/UDP checksum over the IPv4 addresses
+	ports_c    = parse_cfg[3] & (ipv4_c | ipv6_c) & (proto_c == 8'd6 | proto_c == 8'd17) & l4_c + 4 <= HDR_BYTES & ~frag_c;
+	src_c = 0;
+	dst_c = 0;
+	if(ipv4_c) begin
+		for(p = 0; p < 4; p = p + 1) begin
+			src_c[(3-p)*8 +: 8] = hbyte(hdr, l3_c + 12 + p);
+			dst_c[(3-p)*8 +: 8] = hbyte(hdr, l3_c + 16 + p);
+		end
+	end else if(ipv6_c) begin
+		for(p = 0; p < 16; p = p + 1) begin
+			src_c[(15-p)*8 +: 8] = hbyte(hdr, l3_c + 8 + p);
+			dst_c[(15-p)*8 +: 8] = hbyte(hdr, l3_c + 24 + p);
+		end
+	end
+	key_c[31:0]    = ports_c ? {hbyte(hdr, l4_c), hbyte(hdr, l4_c + 1), hbyte(hdr, l4_c + 2), hbyte(hdr, l4_c + 3)} : 32'h0;
+	key_c[63:32]   = {8'h0, ports_c, ipv6_c, ipv4_c, vlan_c, vlan_id_c, proto_c};
+	key_c[191:64]  = src_c;
+	key_c[319:192] = dst_c;
+end
+
+reg[KEY_WIDTH-1:0] key;
+reg                ipv4;
+reg                l4_hdr;
+reg[6:0]           l3;
+reg[6:0]           l4;
+reg[7:0]           proto;
+
+////////////////////////////////////////////////////////// lookup
+
+reg[EM_WIDTH-1:0]  em_q;
+always @(posedge axi_clk)
+	em_q <= em_mem[em_hash(key)];
+
+wire               em_valid = em_q[EM_WIDTH-1];
+wire[KEY_WIDTH-1:0] em_key  = em_q[KEY_WIDTH-1:0];
+
+reg[TC_ENTRIES-1:0] tc_match;
+reg                 tc_any;
+reg[15:0]           tc_ix;
+always @(*) begin
+	tc_any = 1'b0;
+	tc_ix  = 0;
+	for(t = TC_ENTRIES-1; t >= 0; t = t - 1)
+		if(tc_match[t]) begin
+			tc_any = 1'b1;
+			tc_ix  = t;
+		end
+end
+
+reg        hit_em;
+reg        hit_tc;
+reg[31:0]  act;
+reg[47:0]  rw_mac;
+reg[31:0]  rw_ip;
+
+////////////////////////////////////////////////////////// rewrite
+
+// RFC 1624 incremental update of a one's complement checksum for a changed 32 bit word
+function [15:0] csum_upd(input [15:0] hc, input [31:0] old_w, input [31:0] new_w);
+	reg[19:0] s;
+	begin
+		s = {4'h0, ~hc} + {4'h0, ~old_w[31:16]} + {4'h0, ~old_w[15:0]} + {4'h0, new_w[31:16]} + {4'h0, new_w[15:0]};
+		s = {4'h0, s[15:0]} + {16'h0, s[19:16]};
+		s = {4'h0, s[15:0]} + {16'h0, s[19:16]};
+		csum_upd = ~s[15:0];
+	end
+endfunction
+
+reg[HDR_BYTES*8-1:0] hdr_rw;
+reg[6:0]  mac_off, ip_off, l4_csum_off;
+reg[31:0] ip_old;
+reg[15:0] ip_csum, l4_csum;
+reg       l4_csum_in, l4_csum_v, ip_skip;
+always @(*) begin
+	hdr_rw      = hdr;
+	mac_off     = act[A_MAC_SRC] ? 6 : 0;
+	ip_off      = l3 + (act[A_IP_SRC] ? 12 : 16);
+	ip_old      = {hbyte(hdr, ip_off), hbyte(hdr, ip_off + 1), hbyte(hdr, ip_off + 2), hbyte(hdr, ip_off + 3)};
+	ip_csum     = csum_upd({hbyte(hdr, l3 + 10), hbyte(hdr, l3 + 11)}, ip_old, rw_ip);
+	l4_csum_off = l4 + (proto == 8'd6 ? 16 : 6);
+	l4_csum_in  = l4_csum_off + 2 <= HDR_BYTES;
+	l4_csum     = {hbyte(hdr, l4_csum_off), hbyte(hdr, l4_csum_off + 1)};
+	l4_csum_v   = l4_hdr & l4_csum_in & ~(proto == 8'd17 & l4_csum == 0); //udp checksum 0: not used
+	l4_csum     = csum_upd(l4_csum, ip_old, rw_ip); //the addresses are part of the pseudo header
+	ip_skip     = act[A_IP] & ipv4 & l4_hdr & ~l4_csum_in; //the checksum can not be updated, the frame keeps its address
+	if(act[A_MAC]) begin
+		for(r = 0; r < 6; r = r + 1)
+			hdr_rw[(mac_off + r)*8 +: 8] = rw_mac[(5-r)*8 +: 8];
+	end
+	if(act[A_IP] & ipv4 & ~ip_skip) begin
+		for(r = 0; r < 4; r = r + 1)
+			hdr_rw[(ip_off + r)*8 +: 8] = rw_ip[(3-r)*8 +: 8];
+		hdr_rw[(l3 + 10)*8 +: 8] = ip_csum[15:8];
+		hdr_rw[(l3 + 11)*8 +: 8] = ip_csum[7:0];
+		if(l4_csum_v) begin
+			hdr_rw[l4_csum_off*8 +: 8]       = l4_csum[15:8];
+			hdr_rw[(l4_csum_off + 1)*8 +: 8] = l4_csum[7:0];
+		end
+	end
+end
+
+////////////////////////////////////////////////////////// stream
+
+wire      o_end   = o_ix == o_beats - 1;
+wire      o_done  = o_busy & m_axis_eth_tready & o_end;
+wire      rw_done = ma_state == REWRITE & (act[A_DROP] | ~o_busy | o_done); //the header is taken over by the output
+wire[7:0] tuser_rw = act[A_QUEUE] ? {6'h0, act[7:6]} : frame_tuser;
+
+always @(*) begin
+	s_axis_eth_tready = ma_state == CAPTURE | ma_state == DROP;
+	m_axis_eth_tvalid = 1'b0;
+	m_axis_eth_tdata  = s_axis_eth_tdata;
+	m_axis_eth_tkeep  = s_axis_eth_tkeep;
+	m_axis_eth_tlast  = s_axis_eth_tlast;
+	m_axis_eth_tuser  = frame_tuser;
+	if(o_busy) begin
+		m_axis_eth_tvalid = 1'b1;
+		m_axis_eth_tdata  = o_hdr[o_ix*AXIS_WIDTH +: AXIS_WIDTH];
+		m_axis_eth_tkeep  = o_end & o_last ? o_keep : {BEAT_BYTES{1'b1}};
+		m_axis_eth_tlast  = o_end & o_last;
+		m_axis_eth_tuser  = o_tuser;
+	end else if(ma_state == PASS) begin
+		s_axis_eth_tready = m_axis_eth_tready;
+		m_axis_eth_tvalid = s_axis_eth_tvalid;
+	end
+end
+
+always @(posedge axi_clk) begin
+	if (~axi_aresetn) begin
+		o_busy <= 1'b0;
+	end
+	else begin
+		if(o_busy & m_axis_eth_tready) begin
+			o_ix <= o_ix + 1;
+			if(o_end)
+				o_busy <= 1'b0;
+		end
+		if(rw_done & ~act[A_DROP]) begin
+			o_hdr   <= hdr_rw;
+			o_beats <= hdr_beats;
+			o_ix    <= 0;
+			o_last  <= hdr_last;
+			o_keep  <= last_keep;
+			o_tuser <= tuser_rw;
+			o_busy  <= 1'b1;
+		end
+	end
+end
+
+always @(posedge axi_clk) begin
+	if (~axi_aresetn) begin
+		ma_state  <= CAPTURE;
+		hdr_beats <= 0;
+	end
+	else begin
+		case(ma_state)
+			CAPTURE : begin  //0
+				if(s_axis_eth_tvalid) begin
+					if(hdr_beats == 0) begin
+						hdr         <= 0;
+						frame_tuser <= s_axis_eth_tuser;
+					end
+					hdr[hdr_beats*AXIS_WIDTH +: AXIS_WIDTH] <= s_axis_eth_tdata & keep_bits;
+					hdr_beats <= hdr_beats + 1;
+					hdr_last  <= s_axis_eth_tlast;
+					last_keep <= s_axis_eth_tkeep;
+					if(s_axis_eth_tlast | hdr_beats == HDR_BEATS-1)
+						ma_state <= PARSE;
+				end
+			end
+			PARSE : begin  //1
+				key      <= key_c;
+				ipv4     <= ipv4_c;
+				l4_hdr   <= l4_hdr_c;
+				l3       <= l3_c;
+				l4       <= l4_c;
+				proto    <= proto_c;
+				ma_state <= LOOKUP;
+			end
+			LOOKUP : begin  //2 em_q is read
+				for(i = 0; i < TC_ENTRIES; i = i + 1)
+					tc_match[i] <= tc_valid[i] & (key & tc_mask[i]) == tc_key[i];
+				ma_state <= MATCH;
+			end
+			MATCH : begin  //3
+				hit_em <= em_valid & em_key == key;
+				hit_tc <= 1'b0;
+				if(em_valid & em_key == key) begin
+					act    <= em_q[KEY_WIDTH +: 32];
+					rw_mac <= em_q[KEY_WIDTH+32 +: 48];
+					rw_ip  <= em_q[KEY_WIDTH+80 +: 32];
+				end else if(tc_any) begin
+					hit_tc <= 1'b1;
+					act    <= tc_act[tc_ix];
+					rw_mac <= tc_mac[tc_ix];
+					rw_ip  <= tc_ip[tc_ix];
+				end else begin
+					act    <= default_act & ~(32'h1 << A_MAC | 32'h1 << A_IP); //no rewrite without entry
+				end
+				ma_state <= REWRITE;
+			end
+			REWRITE : begin  //4 waits for the output to take the header
+				if(rw_done) begin
+					hdr_beats   <= 0;
+					frame_tuser <= tuser_rw;
+					ma_state    <= hdr_last ? CAPTURE : act[A_DROP] ? DROP : EMIT;
+				end
+			end
+			EMIT : begin  //5 the rest of the frame follows its header
+				if(o_done)
+					ma_state <= PASS;
+			end
+			PASS : begin  //6
+				if(s_axis_eth_tvalid & m_axis_eth_tready & s_axis_eth_tlast)
+					ma_state <= CAPTURE;
+			end
+			DROP : begin  //7
+				if(s_axis_eth_tvalid & s_axis_eth_tlast)
+					ma_state <= CAPTURE;
+			end
+			default : begin
+				hdr_beats <= 0;
+				ma_state  <= CAPTURE;
+			end
+		endcase
+	end
+end
+
+always @(posedge axi_clk) begin
+	if (~axi_aresetn || init_i) begin
+		drop_cnt   <= 0;
+		miss_cnt   <= 0;
+		em_hit_cnt <= 0;
+		tc_hit_cnt <= 0;
+		skip_cnt   <= 0;
+		for(i = 0; i < NB_CNT; i = i + 1)
+			cnt[i] <= 0;
+	end
+	else if(rw_done) begin
+		if(hit_em)
+			em_hit_cnt <= em_hit_cnt + 1;
+		else if(hit_tc)
+			tc_hit_cnt <= tc_hit_cnt + 1;
+		else
+			miss_cnt <= miss_cnt + 1;
+		if(act[A_DROP])
+			drop_cnt <= drop_cnt + 1;
+		else if(ip_skip)
+			skip_cnt <= skip_cnt + 1;
+		if(act[A_COUNT])
+			cnt[act[14:9]] <= cnt[act[14:9]] + 1;
+	end
+end
+
+
+generate
+if(DEBUG_EN) begin
+
+	(* MARK_DEBUG="true" *) reg[2:0]     ma_state_debug;
+	(* MARK_DEBUG="true" *) reg[63:0]    key_debug;
+	(* MARK_DEBUG="true" *) reg[31:0]    act_debug;
+	(* MARK_DEBUG="true" *) reg          hit_em_debug;
+	(* MARK_DEBUG="true" *) reg          hit_tc_debug;
+
+	always @(posedge axi_clk) begin
+		ma_state_debug <= ma_state;
+		key_debug      <= key[63:0];
+		act_debug      <= act;
+		hit_em_debug   <= hit_em;
+		hit_tc_debug   <= hit_tc;
+	end
+
+end
+endgenerate
+
+endmodule
+`default_nettype wire
@@ -0,0 +1,227 @@
+/*
+This module counts events of the rx and tx datapath for performance analysis on the host.
+All counters are 64 bit wide and free running, they are cleared with init_i.
+A pulse on snapshot_i latches all of them in the same clock cycle, the host reads the latched values over the register bar
+(configuration_registers maps them behind the command registers), so the values of one snapshot are always consistent.
+The ring occupancy counters are high-water marks, they restart with every snapshot.
+The rx ring and poll state counters cover the NB_QUEUES rx queues (one rx_desc_ctrl each), the inputs of unused queues are ignored.
+
+Counter index (64 bit words, the low half first):
+	0       clock cycles
+	1/2     rx buffers handed to the packet handler with EOP / rx bytes
+	3/4     tx buffers with EOP / tx bytes
+	5/6     rx / tx tail pointer writes granted by pcie_req_arbiter
+	7       cycles with a tail pointer write waiting at pcie_req_arbiter
+	8       cycles with back-pressure on the rx ethernet stream (m_axis_eth of rx_packet_handler)
+	9       cycles with back-pressure on the tx ethernet stream (s_axis_eth of tx_packet_handler)
+	10/11   max rx / tx ring occupancy: descriptors held by the fpga in the fullest rx queue, descriptors queued for the nic (tx, HEAD_WB only)
+	12-15   reserved, read as 0
+	16-31   cycles spent in each poll_state of rx_desc_ctrl (index 16 + state), summed over the rx queues
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module perf_counters #(
+	parameter NB_QUEUES = 4, //1 to 4
+	parameter DEBUG_EN = 0
+)(
+(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF S_AXIS_RX_MON:S_AXIS_TX_MON, ASSOCIATED_RESET rst_i_n" *)
+	input wire                             clk_i,
+(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 rst_i_n RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	input wire                             rst_i_n,
+
+	input wire                             init_i,
+	input wire                             snapshot_i,
+
+	// rx_desc_ctrl -> rx_packet_handler
+	input wire[15:0]                       rx_pkt_len_i,
+	input wire                             rx_pkt_eop_i,
+	input wire                             rx_pkt_ack_i,
+	input wire[3:0]                        rx_poll_state0_i, //poll_state_o and ring_level_o of each rx_desc_ctrl
+	input wire[15:0]                       rx_ring_level0_i,
+	input wire[3:0]                        rx_poll_state1_i,
+	input wire[15:0]                       rx_ring_level1_i,
+	input wire[3:0]                        rx_poll_state2_i,
+	input wire[15:0]                       rx_ring_level2_i,
+	input wire[3:0]                        rx_poll_state3_i,
+	input wire[15:0]                       rx_ring_level3_i,
+
+	// tx_packet_handler -> tx_desc_ctrl
+	input wire[15:0]                       tx_pkt_len_i,
+	input wire                             tx_pkt_eop_i,
+	input wire                             tx_xmit_req_i,
+	input wire                             tx_xmit_ack_i,
+	input wire[15:0]                       tx_ring_level_i,
+
+	// tail pointer writes at pcie_req_arbiter
+	input wire                             arb_valid0_i,
+	input wire                             arb_ready0_i,
+	input wire                             arb_valid1_i,
+	input wire                             arb_ready1_i,
+
+	(* X_INTERFACE_MODE = "monitor" *)
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_RX_MON TVALID" *)
+	input wire                             rx_mon_tvalid,
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_RX_MON TREADY" *)
+	input wire                             rx_mon_tready,
+	(* X_INTERFACE_MODE = "monitor" *)
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TVALID" *)
+	input wire                             tx_mon_tvalid,
+	(* X_INTERFACE_INFO = "xilinx.com:interface:axis:1.0 S_AXIS_TX_MON TREADY" *)
+	input wire                             tx_mon_tready,
+
+	// read port of the snapshot, 32 bit word index
+	input wire[5:0]                        rd_addr_i,
+	output wire[31:0]                      rd_data_o
+	);
+
+localparam NB_CNT = 32;
+
+reg[63:0] cycles;
+reg[63:0] rx_pkts;
+reg[63:0] rx_bytes;
+reg[63:0] tx_pkts;
+reg[63:0] tx_bytes;
+reg[63:0] rx_doorbells;
+reg[63:0] tx_doorbells;
+reg[63:0] arb_stall;
+reg[63:0] rx_backpressure;
+reg[63:0] tx_backpressure;
+reg[15:0] rx_ring_max;
+reg[15:0] tx_ring_max;
+reg[63:0] state_cycles[0:15];
+
+reg[63:0] snap[0:NB_CNT-1];
+
+wire rx_ack = rx_pkt_ack_i;
+wire tx_ack = tx_xmit_req_i & tx_xmit_ack_i;
+
+wire[3:0]  poll_state[0:3];
+wire[15:0] ring_level[0:3];
+assign poll_state[0] = rx_poll_state0_i;
+assign poll_state[1] = rx_poll_state1_i;
+assign poll_state[2] = rx_poll_state2_i;
+assign poll_state[3] = rx_poll_state3_i;
+assign ring_level[0] = rx_ring_level0_i;
+assign ring_level[1] = rx_ring_level1_i;
+assign ring_level[2] = rx_ring_level2_i;
+assign ring_level[3] = rx_ring_level3_i;
+
+	//level of the fullest rx queue and number of queues in each poll_state
+reg[15:0] rx_ring_level;
+reg[2:0]  state_queues[0:15];
+integer q, s;
+always @(*) begin
+	rx_ring_level = 0;
+	for(s = 0; s < 16; s = s + 1)
+		state_queues[s] = 0;
+	for(q = 0; q < NB_QUEUES; q = q + 1) begin
+		if(ring_level[q] > rx_ring_level)
+			rx_ring_level = ring_level[q];
+		state_queues[poll_state[q]] = state_queues[poll_state[q]] + 1;
+	end
+end
+
+integer i;
+always @(posedge clk_i) begin
+	if (~rst_i_n || init_i) begin
+		cycles          <= 0;
+		rx_pkts         <= 0;
+		rx_bytes        <= 0;
+		tx_pkts         <= 0;
+		tx_bytes        <= 0;
+		rx_doorbells    <= 0;
+		tx_doorbells    <= 0;
+		arb_stall       <= 0;
+		rx_backpressure <= 0;
+		tx_backpressure <= 0;
+		rx_ring_max     <= 0;
+		tx_ring_max     <= 0;
+		for(i = 0; i < 16; i = i + 1)
+			state_cycles[i] <= 0;
+	end
+	else begin
+		cycles <= cycles + 1;
+		if(rx_ack) begin
+			rx_bytes <= rx_bytes + rx_pkt_len_i;
+			if(rx_pkt_eop_i)
+				rx_pkts <= rx_pkts + 1;
+		end
+		if(tx_ack) begin
+			tx_bytes <= tx_bytes + tx_pkt_len_i;
+			if(tx_pkt_eop_i)
+				tx_pkts <= tx_pkts + 1;
+		end
+		if(arb_ready0_i)
+			rx_doorbells <= rx_doorbells + 1;
+		if(arb_ready1_i)
+			tx_doorbells <= tx_doorbells + 1;
+		if((arb_valid0_i & ~arb_ready0_i) | (arb_valid1_i & ~arb_ready1_i))
+			arb_stall <= arb_stall + 1;
+		if(rx_mon_tvalid & ~rx_mon_tready)
+			rx_backpressure <= rx_backpressure + 1;
+		if(tx_mon_tvalid & ~tx_mon_tready)
+			tx_backpressure <= tx_backpressure + 1;
+		for(i = 0; i < 16; i = i + 1)
+			state_cycles[i] <= state_cycles[i] + state_queues[i];
+
+		if(snapshot_i) begin
+			rx_ring_max <= rx_ring_level;
+			tx_ring_max <= tx_ring_level_i;
+		end else begin
+			if(rx_ring_level > rx_ring_max)
+				rx_ring_max <= rx_ring_level;
+			if(tx_ring_level_i > tx_ring_max)
+				tx_ring_max <= tx_ring_level_i;
+		end
+	end
+end
+
+	//all counters are latched in the same cycle
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		for(i = 0; i < NB_CNT; i = i + 1)
+			snap[i] <= 0;
+	end
+	else if(snapshot_i) begin
+		snap[0]  <= cycles;
+		snap[1]  <= rx_pkts;
+		snap[2]  <= rx_bytes;
+		snap[3]  <= tx_pkts;
+		snap[4]  <= tx_bytes;
+		snap[5]  <= rx_doorbells;
+		snap[6]  <= tx_doorbells;
+		snap[7]  <= arb_stall;
+		snap[8]  <= rx_backpressure;
+		snap[9]  <= tx_backpressure;
+		snap[10] <= {48'h0, rx_ring_max};
+		snap[11] <= {48'h0, tx_ring_max};
+		for(i = 12; i < 16; i = i + 1)
+			snap[i] <= 0;
+		for(i = 0; i < 16; i = i + 1)
+			snap[16 + i] <= state_cycles[i];
+	end
+end
+
+assign rd_data_o = rd_addr_i[0] ? snap[rd_addr_i[5:1]][63:32] : snap[rd_addr_i[5:1]][31:0];
+
+
+generate
+if(DEBUG_EN) begin
+
+	(* MARK_DEBUG="true" *) reg          snapshot_i_debug;
+	(* MARK_DEBUG="true" *) reg[3:0]     rx_poll_state_i_debug;
+	(* MARK_DEBUG="true" *) reg[15:0]    rx_ring_level_i_debug;
+	(* MARK_DEBUG="true" *) reg[15:0]    tx_ring_level_i_debug;
+
+	always @(posedge clk_i) begin
+		snapshot_i_debug      <= snapshot_i;
+		rx_poll_state_i_debug <= rx_poll_state0_i;
+		rx_ring_level_i_debug <= rx_ring_level;
+		tx_ring_level_i_debug <= tx_ring_level_i;
+	end
+
+end
+endgenerate
+
+endmodule
+`default_nettype wire
@@ -16,13 +16,38 @@ For further information regarding rx-handling please check 82599-10-gbe-controll
 	The rx descriptors are write locked by protocol to make sure only the NIC can write to the descriptors until it advances to the next descriptors.
 	These are the steps in the polling phase:
 		1. Poll dd-bit of current rx-descriptor (starting at 0)
-		2. Read packet length from rx-descriptor.
-		3. Signal new packet and packet length to output
+		2. Read packet length and EOP bit from rx-descriptor.
+		3. Signal new packet, packet length and EOP to output
 		4. Reset descriptor.
 		5. Wait until new packet has been handled by outside module.
 		5. Generate simple PCIe write transmission to advance rx tail pointer on NIC.
 		6. Go back to 1.
 
+	Frames longer than BUF_SIZE span several consecutive descriptors, only the last one has the EOP bit set.
+	Each descriptor is signaled on its own, pkt_eop_o marks the last buffer of a frame.
+
+	The steps above are the stop-and-wait engine of the 64 bit data width.
+	With 128 and 256 bit the engine is pipelined, the three parts run independently:
+		- polling reads DESC_PER_BEAT = DATA_WIDTH/128 descriptors per bram access, queues all of them with dd set
+		  and resets them in a single write. It only stalls when IN_FLIGHT buffers are queued.
+		- the queue hands the buffers to the packet handler, the next one is presented with the ack of the current one.
+		- the tail pointer follows the acknowledged buffers, one PCIe write covers all buffers acknowledged while the previous write was pending.
+	With 256 bit and 64 byte frames a descriptor pair takes 4 clock cycles, far below the 16 cycles per packet of 14.88 Mpps at 250 MHz.
+
+	With SNOOP the dd bits are not polled: rx_desc_snoop watches the NIC writes into the ring on the axi bus and reports
+	written back descriptors in desc_done_i once their write response has been sent, i.e. when they are in the bram.
+	The bram port stays disabled until the next descriptor is reported, its beat is then read once for length and EOP
+	and the taken descriptors are cleared in the bitmap with desc_clr_o.
+
+	With several rx queues each queue has its own rx_desc_ctrl with its own ring bram, its buffers start at BUF_OFFS in the shared
+	packet bram. rx_queue_arbiter merges the buffers of all queues for the packet handler.
+
+	pkt_ts_o is ts_i of latency_monitor when the dd bit of the descriptor has been read, it is handed on with the buffer.
+
+	With HAIRPIN the buffers are sent by tx_desc_ctrl directly from the rx packet bram. The tail pointer then does not follow
+	pkt_ack_i but buf_free_i, which tx_desc_ctrl pulses once the NIC has sent the buffer, so a buffer is only re-armed for
+	the NIC after its transmission. The buffers are sent and freed in the order they are handed out.
+
 	Note that the tail pointer must never be equal to the head pointer.
 	This would result in a dead lock.
 	To prevent this the tail pointer is always at least two units smaller than the head pointer.
@@ -33,6 +58,11 @@ For further information regarding rx-handling please check 82599-10-gbe-controll
 module rx_desc_ctrl #(
 	parameter NB_DESC = 64,
 	parameter DATA_WIDTH = 128,
+	parameter BUF_SIZE = 2048, //packet buffer per descriptor in bytes (1024, 2048, 4096, 9216), must match ext_ring.buf_size of the queue
+	parameter IN_FLIGHT = 8, //buffers queued for the packet handler ahead of their tail pointer update (128 and 256 bit), power of two below NB_DESC-2
+	parameter SNOOP = 0, //take completed descriptors from rx_desc_snoop instead of polling the dd bits (128 and 256 bit)
+	parameter BUF_OFFS = 0, //byte offset of the packet buffers of this queue in the rx packet bram, one rx_desc_ctrl per queue
+	parameter HAIRPIN = 0, //return the buffers to the NIC after their transmission (buf_free_i) instead of pkt_ack_i (128 and 256 bit)
 	// parameter M_AXI_ID_WIDTH = 3,
 	// parameter M_AXI_ADDR_WIDTH = 32,
 	// parameter M_AXI_TDATA_WIDTH = 64,
@@ -65,7 +95,7 @@ module rx_desc_ctrl #(
 	input wire                            start_i,
 	input wire                            init_i,
 
-	input wire[31:0]                      nic_base_addr_i,
+	input wire[63:0]                      nic_rdt_addr_i, //bus address of the RDT register of the queue
 	input wire[31:0]                      fpga_base_addr_i,
 	
 	//TODO: this is ugly
@@ -77,12 +107,20 @@ module rx_desc_ctrl #(
 
 	output reg[32-1:0]                    pkt_addr_o,
 	output reg[15:0]                      pkt_len_o,
+	output reg                            pkt_eop_o,
 	output reg                            pkt_addr_v_o,
-	input wire                            pkt_ack_i
-	);
+	input wire                            pkt_ack_i,
+	input wire                            buf_free_i, //buffer sent by tx_desc_ctrl (HAIRPIN)
+	input wire[31:0]                      ts_i, //cycle counter of latency_monitor
+	output reg[31:0]                      pkt_ts_o, //ts_i when the buffer was written back by the NIC
 
+	input wire[NB_DESC-1:0]               desc_done_i, //descriptors written back by the NIC, from rx_desc_snoop
+	output reg[NB_DESC-1:0]               desc_clr_o,
+
+	output wire[3:0]                      poll_state_o,  //for perf_counters
+	output wire[15:0]                     ring_level_o   //descriptors taken from the ring and not yet returned with the tail pointer
+	);
 
-localparam RDT_REG_OFFS = 64'h00000000_00001018;
 
 assign clk_o = clk_i;
 
@@ -96,7 +134,8 @@ localparam IDLE               = 1,
 		   READ_DESC          = 8, 
 		   RST_DESC_LO        = 9, RST_DESC = 9,
 		   RST_DESC_HI        = 10, 
-		   PCIE_WRITE_RDT_REG = 11; 
+		   PCIE_WRITE_RDT_REG = 11,
+		   SNOOP_WAIT         = 12; 
 		   
 
 reg init;
@@ -104,7 +143,7 @@ reg init_done;
 
 localparam DESC_IX_WIDTH = $clog2(NB_DESC);
 
-localparam RX_ADDR_AREA = 2048; //so we are always aligned inside 4k AXI boundary
+localparam RX_ADDR_AREA = BUF_SIZE; //with 1k and 2k buffers a packet is always aligned inside a 4k AXI boundary
 localparam RX_OFFS_WIDTH = $clog2(RX_ADDR_AREA*NB_DESC);
 
 reg[DESC_IX_WIDTH-1:0] poll_ix;
@@ -116,6 +155,13 @@ reg[7:0] burst_cnt;
 
 reg[127:0] rx_desc;
 
+wire[31:0] buf_base = fpga_base_addr_i + BUF_OFFS; //bus address of the first packet buffer of the queue
+wire[31:0] poll_pkt_addr = BUF_OFFS + poll_ix * RX_ADDR_AREA; //offset of the packet buffer of the current descriptor
+
+wire[DESC_IX_WIDTH-1:0] ring_level = poll_ix - tail_ix - 1'b1;
+assign poll_state_o = poll_state;
+assign ring_level_o = {{(16-DESC_IX_WIDTH){1'b0}}, ring_level};
+
 // 82599-10-gbe-controller datasheet 7.1.6.2 Advanced Receive Descriptors - Write-Back Format
 wire[3:0] rss_type                                         = rx_desc[3:0];
 wire[12:0] pkt_type                                        = rx_desc[16:4];
@@ -129,6 +175,7 @@ wire[15:0] pkt_len                                         = rx_desc[111:96];
 wire[15:0] vlan_tag                                        = rx_desc[127:112];
 
 wire dd_bit                                                = data_i[DATA_WIDTH-64]; //only works with 64 and 128 bit data widths
+wire eop_bit                                               = data_i[DATA_WIDTH-64+1];
 
 reg[31:0] pkt_in_counter = 0;
 reg[31:0] pkt_out_counter = 0;
@@ -146,6 +193,9 @@ end
 
 generate
 if(DATA_WIDTH==64) begin
+always @(posedge clk_i)
+	desc_clr_o <= 0; //no snooping in the stop-and-wait engine
+
 	//Init 
 always @(posedge clk_i) begin
 	if (~rst_i_n) begin
@@ -168,7 +218,7 @@ always @(posedge clk_i) begin
 		IDLE : begin  //1
 			addr_o            <= 0;
 			burst_cnt         <= NB_DESC*2-1;
-			nic_phys_addr_o   <= nic_base_addr_i + RDT_REG_OFFS;
+			nic_phys_addr_o   <= nic_rdt_addr_i;
 			rx_pkt_addr       <= 0;
 			poll_ix           <= 0;
 			tail_ix           <= NB_DESC-1; //this is set in ixgbe_dev_rx_queue_start() in ixgbe_rxtc.c (DPDK)
@@ -179,7 +229,7 @@ always @(posedge clk_i) begin
 			end
 		end
 		ADDR_INIT : begin  //2
-			data_o      <= fpga_base_addr_i + rx_pkt_addr;
+			data_o      <= buf_base + rx_pkt_addr;
 			wea_o       <= 8'hFF;
 			wren_o      <= 1'b1;
 			rx_pkt_addr <= rx_pkt_addr + RX_ADDR_AREA;
@@ -199,7 +249,7 @@ always @(posedge clk_i) begin
 		end
 		DESC_HDR_INIT : begin  //4
 			addr_o        <= addr_o + 8;
-			data_o        <= fpga_base_addr_i + rx_pkt_addr;
+			data_o        <= buf_base + rx_pkt_addr;
 			wea_o         <= 8'hFF;
 			wren_o      <= 1'b1;
 			rx_pkt_addr   <= rx_pkt_addr + RX_ADDR_AREA;
@@ -225,8 +275,10 @@ always @(posedge clk_i) begin
 				wren_o      <= 1'b1;
 				poll_ix               <= poll_ix + 1;
 				tail_ix               <= tail_ix + 1;
-				pkt_addr_o            <= { {(32-DESC_IX_WIDTH-11){1'b0}}, poll_ix,11'b0000000000};
+				pkt_addr_o            <= poll_pkt_addr;
 				pkt_len_o             <= data_i[47:32];
+				pkt_eop_o             <= eop_bit;
+				pkt_ts_o              <= ts_i;
 				nic_rx_tail_pointer_o <= {{(32-DESC_IX_WIDTH){1'b0}},tail_ix};
 				poll_state            <= RST_DESC_LO;
 			end
@@ -235,7 +287,7 @@ always @(posedge clk_i) begin
 			end
 		end
 		RST_DESC_LO : begin //6
-			data_o       <= fpga_base_addr_i + {poll_ix,11'b0000000000}; //*2048 //todo: parameter RX_ADDR_AREA
+			data_o       <= fpga_base_addr_i + poll_pkt_addr;
 			addr_o       <= addr_o - 8;
 			wea_o        <= 8'hFF;
 			wren_o      <= 1'b1;
@@ -277,55 +329,99 @@ end
 
 
 
-end else if(DATA_WIDTH==128) begin
+end else if(DATA_WIDTH==128 || DATA_WIDTH==256) begin
 
+// pipelined engine: each bram access covers DESC_PER_BEAT descriptors, up to IN_FLIGHT buffers are queued for the packet handler
+// and the tail pointer follows the acknowledged buffers independently of the polling
+localparam DESC_PER_BEAT = DATA_WIDTH/128;
+localparam FIFO_IX_WIDTH = $clog2(IN_FLIGHT);
 
+reg[31:0] fifo_addr[0:IN_FLIGHT-1];
+reg[15:0] fifo_len[0:IN_FLIGHT-1];
+reg       fifo_eop[0:IN_FLIGHT-1];
+reg[31:0] fifo_ts[0:IN_FLIGHT-1];
+reg[FIFO_IX_WIDTH:0] fifo_wr;
+reg[FIFO_IX_WIDTH:0] fifo_rd;
+wire[FIFO_IX_WIDTH:0] fifo_level = fifo_wr - fifo_rd;
 
-	//Init 
+reg[DESC_IX_WIDTH-1:0] ack_ix;     //tail pointer plus one after the buffers acknowledged by the packet handler
+reg[DESC_IX_WIDTH-1:0] written_ix; //ack_ix of the last tail pointer write
+
+wire[31:0] poll_beat_addr = (poll_ix / DESC_PER_BEAT) * (DATA_WIDTH/8);
+wire[DESC_IX_WIDTH-1:0] beat_first = poll_ix % DESC_PER_BEAT; //first descriptor of the beat not handled yet
+reg[DESC_PER_BEAT-1:0] dd_seen;
+wire[DESC_PER_BEAT-1:0] beat_snooped;
+
+// descriptors of the beat taken in this access: in ring order starting at beat_first, dd set in the POLL and the READ_DESC read
+wire[DESC_PER_BEAT-1:0] beat_dd;
+wire[DESC_PER_BEAT-1:0] beat_take;
+genvar d;
+for(d = 0; d < DESC_PER_BEAT; d = d + 1) begin : beat_desc
+	assign beat_dd[d] = data_i[d*128+64];
+	assign beat_snooped[d] = desc_done_i[poll_ix - beat_first + d];
+	if(d == 0) begin
+		assign beat_take[d] = beat_first == 0 & beat_dd[d] & dd_seen[d];
+	end else begin
+		assign beat_take[d] = (beat_first == d | beat_take[d-1]) & beat_dd[d] & dd_seen[d];
+	end
+end
+
+integer i, j;
+reg[DESC_IX_WIDTH-1:0] take_cnt;
+always @(*) begin
+	take_cnt = 0;
+	for(i = 0; i < DESC_PER_BEAT; i = i + 1)
+		take_cnt = take_cnt + beat_take[i];
+end
+
+	//Init and polling
 always @(posedge clk_i) begin
 	if (~rst_i_n) begin
 		poll_state          <= IDLE;
 		init_done           <= 1'b0;
-		pkt_addr_v_o        <= 1'b0;
-		pcie_rq_start_o     <= 1'b0;
 		en_o                <= 1'b0;
 		rst_o               <= 1'b0;
 		wea_o               <= 0;
 		wren_o              <= 1'b0;
+		fifo_wr             <= 0;
+		desc_clr_o          <= {NB_DESC{1'b1}};
 	end
 	else begin
 		init_done           <= 1'b0;
 		en_o                <= 1'b1;
 		rst_o               <= 1'b0;
-		wea_o               <= 16'h0000;
+		wea_o               <= 0;
 		wren_o              <= 1'b0;
+		desc_clr_o          <= 0;
 		case(poll_state)
 		IDLE : begin  //1
 			addr_o            <= 0;
-			burst_cnt         <= NB_DESC-1;
-			nic_phys_addr_o   <= nic_base_addr_i + RDT_REG_OFFS;
+			burst_cnt         <= NB_DESC/DESC_PER_BEAT-1;
+			nic_phys_addr_o   <= nic_rdt_addr_i;
 			rx_pkt_addr       <= 0;
 			poll_ix           <= 0;
-			tail_ix           <= NB_DESC-1; //this is set in ixgbe_dev_rx_queue_start() in ixgbe_rxtc.c (DPDK)
+			fifo_wr           <= 0;
+			desc_clr_o        <= {NB_DESC{1'b1}};
 			if(init) begin
 				pkt_in_counter      <= 0;
-				pkt_out_counter     <= 0;
 				poll_state          <= ADDR_INIT;
 			end
 		end
 		ADDR_INIT : begin  //2
-			data_o            <= {64'h0,fpga_base_addr_i + rx_pkt_addr};
-			wea_o             <= 16'hFFFF;
+			for(j = 0; j < DESC_PER_BEAT; j = j + 1)
+				data_o[j*128 +: 128] <= {64'h0,buf_base + rx_pkt_addr + j*RX_ADDR_AREA};
+			wea_o             <= {(DATA_WIDTH/8){1'b1}};
 			wren_o            <= 1'b1;
-			rx_pkt_addr       <= rx_pkt_addr + RX_ADDR_AREA;
+			rx_pkt_addr       <= rx_pkt_addr + DESC_PER_BEAT*RX_ADDR_AREA;
 			poll_state        <= DESC_INIT;
 		end
 		DESC_INIT : begin  //3
-			data_o      <= {64'h0,fpga_base_addr_i + rx_pkt_addr};
-			wea_o       <= 16'hFFFF;
-			wren_o            <= 1'b1;
-			rx_pkt_addr <= rx_pkt_addr + RX_ADDR_AREA;
-			addr_o      <= addr_o + 16;
+			for(j = 0; j < DESC_PER_BEAT; j = j + 1)
+				data_o[j*128 +: 128] <= {64'h0,buf_base + rx_pkt_addr + j*RX_ADDR_AREA};
+			wea_o       <= {(DATA_WIDTH/8){1'b1}};
+			wren_o      <= 1'b1;
+			rx_pkt_addr <= rx_pkt_addr + DESC_PER_BEAT*RX_ADDR_AREA;
+			addr_o      <= addr_o + DATA_WIDTH/8;
 			burst_cnt   <= burst_cnt - 1;
 			if(burst_cnt == 1) begin
 				init_done  <= 1'b1;
@@ -333,7 +429,7 @@ always @(posedge clk_i) begin
 			end
 		end
 		DESC_POLL: begin //5
-			addr_o     <= { {(32-DESC_IX_WIDTH-4){1'b0}}, poll_ix,4'h0};
+			addr_o     <= poll_beat_addr;
 			poll_state <= DESC_WAIT;
 		end
 		DESC_WAIT: begin  //6
@@ -341,31 +437,49 @@ always @(posedge clk_i) begin
 			if(init & ~init_done)
 				poll_state    <= IDLE;
 		end
-		POLL : begin // 7 
-			if(start_i & dd_bit)
-				poll_state <= READ_DESC;  //We read dd bit in two cycles to prevent read anomalies that can happen during simultaneous write and read into bram
-			
+		POLL : begin // 7
+			if(SNOOP) begin
+				// the bram stays disabled until the write-back of the next descriptor has been seen on the axi bus
+				dd_seen <= beat_snooped;
+				en_o    <= 1'b0;
+				if(start_i & beat_snooped[beat_first] & fifo_level <= IN_FLIGHT-DESC_PER_BEAT) begin
+					en_o       <= 1'b1;
+					poll_state <= SNOOP_WAIT;
+				end
+			end else begin
+				dd_seen <= beat_dd;
+				if(start_i & beat_dd[beat_first] & fifo_level <= IN_FLIGHT-DESC_PER_BEAT)
+					poll_state <= READ_DESC;  //We read dd bit in two cycles to prevent read anomalies that can happen during simultaneous write and read into bram
+			end
+
 			if(init & ~init_done)
 				poll_state    <= IDLE;
 		end
-		READ_DESC : begin  //8 
-			if(start_i & dd_bit) begin
-				pkt_in_counter        <= pkt_in_counter + 1;
-				
-				poll_ix               <= poll_ix + 1;
-				tail_ix               <= tail_ix + 1;
-				
-				rx_desc               <= data_i;
-				
-				pkt_addr_o            <= { {(32-DESC_IX_WIDTH-11){1'b0}}, poll_ix,11'b0000000000};
-				pkt_len_o             <= data_i[111:96];
-				pkt_addr_v_o          <= 1'b1;
-				
-				data_o                <= {64'h0,fpga_base_addr_i + {poll_ix,11'b0000000000} }; //*2048 //todo: parameter RX_ADDR_AREA
-				wea_o                 <= 16'hFFFF;
+		SNOOP_WAIT : begin  //12
+			poll_state <= READ_DESC;
+			if(init & ~init_done)
+				poll_state    <= IDLE;
+		end
+		READ_DESC : begin  //8
+			poll_state <= POLL;
+			if(start_i & beat_take[beat_first]) begin
+				pkt_in_counter <= pkt_in_counter + take_cnt;
+				poll_ix        <= poll_ix + take_cnt;
+				fifo_wr        <= fifo_wr + take_cnt;
+				rx_desc        <= data_i[beat_first*128 +: 128];
+				// queue the buffers and reset their descriptors in a single write
+				for(j = 0; j < DESC_PER_BEAT; j = j + 1) begin
+					if(beat_take[j]) begin
+						desc_clr_o[(poll_ix - beat_first + j) % NB_DESC] <= 1'b1;
+						fifo_addr[(fifo_wr + j - beat_first) % IN_FLIGHT] <= BUF_OFFS + (poll_ix - beat_first + j) * RX_ADDR_AREA;
+						fifo_len[(fifo_wr + j - beat_first) % IN_FLIGHT]  <= data_i[j*128+96 +: 16];
+						fifo_eop[(fifo_wr + j - beat_first) % IN_FLIGHT]  <= data_i[j*128+65];
+						fifo_ts[(fifo_wr + j - beat_first) % IN_FLIGHT]   <= ts_i;
+					end
+					data_o[j*128 +: 128]  <= {64'h0,buf_base + (poll_ix - beat_first + j) * RX_ADDR_AREA};
+					wea_o[j*16 +: 16]     <= {16{beat_take[j]}};
+				end
 				wren_o                <= 1'b1;
-
-				nic_rx_tail_pointer_o <= {{(32-DESC_IX_WIDTH){1'b0}},tail_ix};
 				poll_state            <= RST_DESC;
 			end
 			if(init & ~init_done) begin
@@ -373,27 +487,10 @@ always @(posedge clk_i) begin
 			end
 		end
 		RST_DESC : begin  //9
-			addr_o <= { {(32-DESC_IX_WIDTH-4){1'b0}}, poll_ix,4'h0};
-			if(pkt_ack_i) begin
-				pkt_out_counter     <= pkt_out_counter + 1;
-				pkt_addr_v_o        <= 1'b0;
-				pcie_rq_start_o     <= 1'b1; 
-				poll_state          <= PCIE_WRITE_RDT_REG;
-			end
-			if(init) begin
-				pkt_addr_v_o    <= 1'b0;
-				pcie_rq_start_o <= 1'b0;
-				poll_state      <= IDLE;
-			end
-
-		end
-		PCIE_WRITE_RDT_REG : begin  //10
-			if(pcie_rq_ack_i) begin
-				pcie_rq_start_o   <= 1'b0;
-				poll_state        <= POLL;
-				if(init)
-					poll_state <= IDLE;
-			end
+			addr_o     <= poll_beat_addr;
+			poll_state <= DESC_WAIT;
+			if(init)
+				poll_state <= IDLE;
 		end
 		default : begin
 			poll_state          <= IDLE;
@@ -401,6 +498,56 @@ always @(posedge clk_i) begin
 		endcase
 	end
 end
+
+	//hand the queued buffers to the packet handler, the next one is presented with the ack of the current one
+always @(posedge clk_i) begin
+	if (~rst_i_n || poll_state == IDLE) begin
+		pkt_addr_v_o <= 1'b0;
+		fifo_rd      <= 0;
+	end
+	else begin
+		if(pkt_ack_i)
+			pkt_addr_v_o <= 1'b0;
+		if((~pkt_addr_v_o | pkt_ack_i) & fifo_level != 0) begin
+			pkt_addr_o   <= fifo_addr[fifo_rd[FIFO_IX_WIDTH-1:0]];
+			pkt_len_o    <= fifo_len[fifo_rd[FIFO_IX_WIDTH-1:0]];
+			pkt_eop_o    <= fifo_eop[fifo_rd[FIFO_IX_WIDTH-1:0]];
+			pkt_ts_o     <= fifo_ts[fifo_rd[FIFO_IX_WIDTH-1:0]];
+			pkt_addr_v_o <= 1'b1;
+			fifo_rd      <= fifo_rd + 1;
+		end
+	end
+end
+
+	//tail pointer updates: one PCIe write covers all buffers acknowledged (or sent with HAIRPIN) since the last one
+wire buf_done = HAIRPIN ? buf_free_i : pkt_ack_i;
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		pcie_rq_start_o <= 1'b0;
+		ack_ix          <= NB_DESC-1; //this is set in ixgbe_dev_rx_queue_start() in ixgbe_rxtc.c (DPDK)
+		written_ix      <= NB_DESC-1;
+	end
+	else begin
+		if(buf_done) begin
+			pkt_out_counter <= pkt_out_counter + 1;
+			ack_ix          <= ack_ix + 1;
+		end
+		if(pcie_rq_start_o) begin
+			if(pcie_rq_ack_i)
+				pcie_rq_start_o <= 1'b0;
+		end else if(poll_state == IDLE) begin
+			pkt_out_counter <= 0;
+			ack_ix          <= NB_DESC-1;
+			written_ix      <= NB_DESC-1;
+		end else if(ack_ix != written_ix) begin
+			nic_rx_tail_pointer_o <= {{(32-DESC_IX_WIDTH){1'b0}},ack_ix - 1'b1}; //the tail stays two descriptors behind the head
+			written_ix            <= ack_ix;
+			pcie_rq_start_o       <= 1'b1;
+		end
+	end
+end
+always @(*) tail_ix = written_ix;
 end
 endgenerate
 
@@ -0,0 +1,246 @@
+/*
+This module watches the axi write channels into the rx ring bram controller and detects descriptor write-backs of the NIC.
+It sits between interconnect (s_axi) and bram controller (m_axi) and passes all channels through. Only the write address
+is held back while ADDR_DEPTH bursts wait for their write data, and the write data while ADDR_DEPTH bursts wait for their
+write response, so the queues below never overflow.
+
+Each write beat covers DATA_WIDTH/128 descriptors. A descriptor is written back if the strobe of its status byte is set
+and the dd bit (bit 64 of the descriptor) is written as 1. The re-armed descriptors of the host have a zero header address there.
+The written back descriptors of a burst are reported in desc_done_o with the write response of the burst,
+the bram controller has written the bram by then, so the descriptor can be read without polling.
+The consumer clears the bits of the descriptors it has handled with desc_clr_i.
+
+Only INCR bursts are decoded (single beats of any type as well), other bursts are reported as error in the simulation.
+The write data of a burst must not arrive before its address, this holds for the xilinx interconnect which
+routes the write data by the address channel.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module rx_desc_snoop #(
+	parameter NB_DESC = 64,
+	parameter DATA_WIDTH = 256, //data width of the bram controller axi port
+	parameter ADDR_WIDTH = 32,
+	parameter ID_WIDTH = 4 //id width of M_AXI_B of the xdma, passed through the interconnect
+)(
+(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axi:m_axi, ASSOCIATED_RESET rst_i_n" *)
+	input wire                             clk_i,
+(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 rst_i_n RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	input wire                             rst_i_n,
+
+	input wire[ID_WIDTH-1:0]               s_axi_awid,
+	input wire[ADDR_WIDTH-1:0]             s_axi_awaddr,
+	input wire[7:0]                        s_axi_awlen,
+	input wire[2:0]                        s_axi_awsize,
+	input wire[1:0]                        s_axi_awburst,
+	input wire                             s_axi_awlock,
+	input wire[3:0]                        s_axi_awcache,
+	input wire[2:0]                        s_axi_awprot,
+	input wire                             s_axi_awvalid,
+	output wire                            s_axi_awready,
+
+	input wire[DATA_WIDTH-1:0]             s_axi_wdata,
+	input wire[DATA_WIDTH/8-1:0]           s_axi_wstrb,
+	input wire                             s_axi_wlast,
+	input wire                             s_axi_wvalid,
+	output wire                            s_axi_wready,
+
+	output wire[ID_WIDTH-1:0]              s_axi_bid,
+	output wire[1:0]                       s_axi_bresp,
+	output wire                            s_axi_bvalid,
+	input wire                             s_axi_bready,
+
+	input wire[ID_WIDTH-1:0]               s_axi_arid,
+	input wire[ADDR_WIDTH-1:0]             s_axi_araddr,
+	input wire[7:0]                        s_axi_arlen,
+	input wire[2:0]                        s_axi_arsize,
+	input wire[1:0]                        s_axi_arburst,
+	input wire                             s_axi_arlock,
+	input wire[3:0]                        s_axi_arcache,
+	input wire[2:0]                        s_axi_arprot,
+	input wire                             s_axi_arvalid,
+	output wire                            s_axi_arready,
+
+	output wire[ID_WIDTH-1:0]              s_axi_rid,
+	output wire[DATA_WIDTH-1:0]            s_axi_rdata,
+	output wire[1:0]                       s_axi_rresp,
+	output wire                            s_axi_rlast,
+	output wire                            s_axi_rvalid,
+	input wire                             s_axi_rready,
+
+	output wire[ID_WIDTH-1:0]              m_axi_awid,
+	output wire[ADDR_WIDTH-1:0]            m_axi_awaddr,
+	output wire[7:0]                       m_axi_awlen,
+	output wire[2:0]                       m_axi_awsize,
+	output wire[1:0]                       m_axi_awburst,
+	output wire                            m_axi_awlock,
+	output wire[3:0]                       m_axi_awcache,
+	output wire[2:0]                       m_axi_awprot,
+	output wire                            m_axi_awvalid,
+	input wire                             m_axi_awready,
+
+	output wire[DATA_WIDTH-1:0]            m_axi_wdata,
+	output wire[DATA_WIDTH/8-1:0]          m_axi_wstrb,
+	output wire                            m_axi_wlast,
+	output wire                            m_axi_wvalid,
+	input wire                             m_axi_wready,
+
+	input wire[ID_WIDTH-1:0]               m_axi_bid,
+	input wire[1:0]                        m_axi_bresp,
+	input wire                             m_axi_bvalid,
+	output wire                            m_axi_bready,
+
+	output wire[ID_WIDTH-1:0]              m_axi_arid,
+	output wire[ADDR_WIDTH-1:0]            m_axi_araddr,
+	output wire[7:0]                       m_axi_arlen,
+	output wire[2:0]                       m_axi_arsize,
+	output wire[1:0]                       m_axi_arburst,
+	output wire                            m_axi_arlock,
+	output wire[3:0]                       m_axi_arcache,
+	output wire[2:0]                       m_axi_arprot,
+	output wire                            m_axi_arvalid,
+	input wire                             m_axi_arready,
+
+	input wire[ID_WIDTH-1:0]               m_axi_rid,
+	input wire[DATA_WIDTH-1:0]             m_axi_rdata,
+	input wire[1:0]                        m_axi_rresp,
+	input wire                             m_axi_rlast,
+	input wire                             m_axi_rvalid,
+	output wire                            m_axi_rready,
+
+	input wire[NB_DESC-1:0]                desc_clr_i,
+	output reg[NB_DESC-1:0]                desc_done_o
+	);
+
+localparam DESC_PER_BEAT = DATA_WIDTH/128;
+localparam DESC_IX_WIDTH = $clog2(NB_DESC);
+localparam BEAT_BYTES    = DATA_WIDTH/8;
+localparam BEAT_SHIFT    = $clog2(BEAT_BYTES);
+localparam ADDR_DEPTH    = 4; //bursts between write address and write data, and between write data and write response
+
+// addresses of bursts whose write data has not started yet
+reg[ADDR_WIDTH-1:0] aw_fifo[0:ADDR_DEPTH-1];
+reg[2:0] aw_wr;
+reg[2:0] aw_rd;
+wire[2:0] aw_level = aw_wr - aw_rd;
+wire aw_empty = aw_level == 0;
+wire aw_full  = aw_level == ADDR_DEPTH;
+
+// written back descriptors of the bursts waiting for their write response
+reg[NB_DESC-1:0] b_fifo[0:ADDR_DEPTH-1];
+reg[2:0] b_wr;
+reg[2:0] b_rd;
+wire[2:0] b_level = b_wr - b_rd;
+wire b_full = b_level == ADDR_DEPTH;
+
+assign m_axi_awid    = s_axi_awid;
+assign m_axi_awaddr  = s_axi_awaddr;
+assign m_axi_awlen   = s_axi_awlen;
+assign m_axi_awsize  = s_axi_awsize;
+assign m_axi_awburst = s_axi_awburst;
+assign m_axi_awlock  = s_axi_awlock;
+assign m_axi_awcache = s_axi_awcache;
+assign m_axi_awprot  = s_axi_awprot;
+assign m_axi_awvalid = s_axi_awvalid & ~aw_full;
+assign s_axi_awready = m_axi_awready & ~aw_full;
+
+assign m_axi_wdata   = s_axi_wdata;
+assign m_axi_wstrb   = s_axi_wstrb;
+assign m_axi_wlast   = s_axi_wlast;
+assign m_axi_wvalid  = s_axi_wvalid & ~b_full;
+assign s_axi_wready  = m_axi_wready & ~b_full;
+
+assign s_axi_bid     = m_axi_bid;
+assign s_axi_bresp   = m_axi_bresp;
+assign s_axi_bvalid  = m_axi_bvalid;
+assign m_axi_bready  = s_axi_bready;
+
+assign m_axi_arid    = s_axi_arid;
+assign m_axi_araddr  = s_axi_araddr;
+assign m_axi_arlen   = s_axi_arlen;
+assign m_axi_arsize  = s_axi_arsize;
+assign m_axi_arburst = s_axi_arburst;
+assign m_axi_arlock  = s_axi_arlock;
+assign m_axi_arcache = s_axi_arcache;
+assign m_axi_arprot  = s_axi_arprot;
+assign m_axi_arvalid = s_axi_arvalid;
+assign s_axi_arready = m_axi_arready;
+
+assign s_axi_rid     = m_axi_rid;
+assign s_axi_rdata   = m_axi_rdata;
+assign s_axi_rresp   = m_axi_rresp;
+assign s_axi_rlast   = m_axi_rlast;
+assign s_axi_rvalid  = m_axi_rvalid;
+assign m_axi_rready  = s_axi_rready;
+
+wire aw_hs = m_axi_awvalid & m_axi_awready;
+wire w_hs  = m_axi_wvalid & m_axi_wready;
+wire b_hs  = m_axi_bvalid & m_axi_bready;
+
+reg in_burst;
+reg[ADDR_WIDTH-1:0] beat_addr; //address of the next beat of the current burst
+
+wire w_first   = w_hs & ~in_burst;
+wire aw_bypass = w_first & aw_empty; //address and first data beat in the same cycle
+wire[ADDR_WIDTH-1:0] w_addr_raw = in_burst ? beat_addr : (aw_empty ? m_axi_awaddr : aw_fifo[aw_rd[1:0]]);
+wire[ADDR_WIDTH-1:0] w_addr = {w_addr_raw[ADDR_WIDTH-1:BEAT_SHIFT], {BEAT_SHIFT{1'b0}}};
+wire[DESC_IX_WIDTH-1:0] w_desc_ix = w_addr[DESC_IX_WIDTH+3:4]; //first descriptor of the beat
+
+// descriptors written back by the current beat
+reg[NB_DESC-1:0] beat_done;
+integer d;
+always @(*) begin
+	beat_done = 0;
+	for(d = 0; d < DESC_PER_BEAT; d = d + 1)
+		if(w_hs & m_axi_wstrb[d*16+8] & m_axi_wdata[d*128+64])
+			beat_done[(w_desc_ix + d) % NB_DESC] = 1'b1;
+end
+
+// written back descriptors of the current burst
+reg[NB_DESC-1:0] burst_done;
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		aw_wr       <= 0;
+		aw_rd       <= 0;
+		b_wr        <= 0;
+		b_rd        <= 0;
+		in_burst    <= 1'b0;
+		burst_done  <= 0;
+		desc_done_o <= 0;
+	end
+	else begin
+		if(aw_hs & ~aw_bypass) begin
+			aw_fifo[aw_wr[1:0]] <= m_axi_awaddr;
+			aw_wr               <= aw_wr + 1;
+		end
+		if(w_first & ~aw_empty)
+			aw_rd <= aw_rd + 1;
+
+		if(w_hs) begin
+			in_burst   <= ~m_axi_wlast;
+			beat_addr  <= w_addr + BEAT_BYTES;
+			burst_done <= burst_done | beat_done;
+			if(m_axi_wlast) begin
+				b_fifo[b_wr[1:0]] <= burst_done | beat_done;
+				b_wr              <= b_wr + 1;
+				burst_done        <= 0;
+			end
+		end
+
+		if(b_hs && b_wr != b_rd) begin
+			desc_done_o <= (desc_done_o | b_fifo[b_rd[1:0]]) & ~desc_clr_i;
+			b_rd        <= b_rd + 1;
+		end else begin
+			desc_done_o <= desc_done_o & ~desc_clr_i;
+		end
+	end
+end
+
+// synthesis translate_off
+always @(posedge clk_i)
+	if(rst_i_n & aw_hs & m_axi_awburst != 2'b01 & m_axi_awlen != 0)
+		$error("rx_desc_snoop: burst type %0d of %0d beats at 0x%h, only INCR bursts are decoded", m_axi_awburst, m_axi_awlen + 1, m_axi_awaddr);
+// synthesis translate_on
+
+endmodule
+`default_nettype wire
@@ -3,13 +3,17 @@ Authors: Ralf Kundel, Kadir Eryigit, 2020
 
 This module reads packets from bram and generates an axistream.
 New packets are signaled by a simple handhshake input with address and length signals.
+Frames spanning several rx buffers are signaled buffer by buffer, tlast is only set at the end of the buffer with pkt_eop_i.
 This axistream supports ready signalling. 
+The stream is 64 bit wide by default. With AXIS_WIDTH equal to DATA_WIDTH (128, 256 or 512 bit) one bram word is streamed per beat,
+tkeep of the last beat of a buffer masks the bytes behind pkt_len_i, all other beats are full.
 */
 `timescale 1ns / 1ps
 `default_nettype none
 
 module rx_packet_handler #(
 	parameter DATA_WIDTH = 128,
+	parameter AXIS_WIDTH = 64, //64 or DATA_WIDTH (up to 512)
 	parameter DEBUG_EN = 0
 	)(
 	(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 axi_clk CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF m_axis_eth, ASSOCIATED_RESET axi_aresetn" *)
@@ -17,15 +21,15 @@ module rx_packet_handler #(
 	(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 axi_aresetn RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
 	   input wire                            	 axi_aresetn,
 
-	   output reg[64-1:0]       			  m_axis_eth_tdata,		
+	   output reg[AXIS_WIDTH-1:0]   		  m_axis_eth_tdata,		
 	   output reg[7:0]                        m_axis_eth_tuser,
-	   output reg                             m_axis_eth_tlast,
-	   output reg[64/8-1:0]     			  m_axis_eth_tkeep,
+	   output wire                            m_axis_eth_tlast,
+	   output reg[AXIS_WIDTH/8-1:0] 		  m_axis_eth_tkeep,
 	   output reg                             m_axis_eth_tvalid,
 	   input wire                             m_axis_eth_tready,
 
     (* X_INTERFACE_INFO = "xilinx.com:interface:bram_rtl:1.0 MODE MASTER,NAME BRAM_PORT" *)
-    (* X_INTERFACE_PARAMETER = "MASTER_TYPE BRAM_CTRL, MEM_ECC NONE, MEM_WIDTH 128, MEM_SIZE 131072, READ_LATENCY 1" *) //READ_WRITE_MODE READ_WRITE
+    (* X_INTERFACE_PARAMETER = "MASTER_TYPE BRAM_CTRL, MEM_ECC NONE, MEM_SIZE 131072, READ_LATENCY 1" *) //MEM_WIDTH is DATA_WIDTH, set on the interface by U200.tcl
     (* X_INTERFACE_INFO = "xilinx.com:interface:bram:1.0 BRAM_PORT ADDR" *)
 	output reg[32-1:0]   addr_o, 
     (* X_INTERFACE_INFO = "xilinx.com:interface:bram:1.0 BRAM_PORT CLK" *) 
@@ -44,6 +48,7 @@ module rx_packet_handler #(
 
 	   input wire[32-1:0]                     pkt_addr_i,
 	   input wire[15:0]                       pkt_len_i, // in bytes
+	   input wire                             pkt_eop_i, // last buffer of the frame
 	   input wire                             pkt_addr_v_i,
 	   output reg                             pkt_ack_o
 
@@ -57,7 +62,9 @@ localparam  IDLE            = 1,
 			STREAM_SAVE2    = 6, 
 			STREAM_LAST     = 7;
 
-localparam AXIS_TDATA_WIDTH = 64;
+localparam AXIS_TDATA_WIDTH = AXIS_WIDTH;
+localparam BEAT_BYTES       = AXIS_TDATA_WIDTH/8;
+localparam BEAT_SHIFT       = $clog2(BEAT_BYTES);
 
 
 
@@ -69,8 +76,8 @@ reg[31:0] pkt_counter = 0;
 reg[1:0] read_shift; //cleanup only 2 bits needed
 reg      read_valid;
 reg[1:0] last_shift;
-reg[7:0] addr_cnt;
-reg[7:0] read_cnt;
+reg[12:0] addr_cnt; //beats of a buffer up to 16k
+reg[12:0] read_cnt;
 wire read_last = read_cnt == 0;
 reg read_last_64;
 
@@ -80,6 +87,10 @@ reg next_last;
 reg[15:0] last_keep_128;
 reg last_hi;
 
+reg seg_last; //end of the current buffer
+reg seg_eop;  //the current buffer ends the frame
+assign m_axis_eth_tlast = seg_last & seg_eop;
+
 reg[DATA_WIDTH-1:0] data_save;
 reg data_last_save;
 
@@ -89,7 +100,7 @@ reg data_last_save2;
 assign clk_o = axi_clk;
 
 generate
-	if(DATA_WIDTH==64) begin
+	if(DATA_WIDTH==AXIS_WIDTH) begin
 
 
 
@@ -119,20 +130,21 @@ generate
 			case(eth_stream_state)
 				IDLE : begin  //1
 					m_axis_eth_tuser <= 0;
-					m_axis_eth_tkeep <= 8'hFF;
+					m_axis_eth_tkeep <= {(AXIS_TDATA_WIDTH/8){1'b1}};
 					pkt_ack_o        <= 1'b0;
 					if(pkt_addr_v_i & ~pkt_ack_o)begin
-						addr_o           <= {pkt_addr_i[31:3], 3'b000};
+						addr_o           <= {pkt_addr_i[31:BEAT_SHIFT], {BEAT_SHIFT{1'b0}}};
+						seg_eop          <= pkt_eop_i;
 						read_shift[0]    <= 1'b1;
-						read_cnt         <= pkt_len_i/8 - 1 + (|pkt_len_i[2:0]);
-						addr_cnt         <= pkt_len_i/8 - 1 + (|pkt_len_i[2:0]);
-						last_shift[0]    <= pkt_len_i < 9;
+						read_cnt         <= pkt_len_i/BEAT_BYTES - 1 + (|pkt_len_i[BEAT_SHIFT-1:0]);
+						addr_cnt         <= pkt_len_i/BEAT_BYTES - 1 + (|pkt_len_i[BEAT_SHIFT-1:0]);
+						last_shift[0]    <= pkt_len_i <= BEAT_BYTES;
 						tkeep_last_reg   <= tkeep_last;
 						eth_stream_state <= STREAM_SET;
 					end
 				end
 				PKT_ADDR : begin  //2
-						addr_o           <= addr_o + 8;
+						addr_o           <= addr_o + BEAT_BYTES;
 						addr_cnt         <= addr_cnt - 1;
 						last_shift[1]    <= addr_cnt == 0;
 						last_shift[0]    <= addr_cnt == 1;
@@ -141,7 +153,7 @@ generate
 				end
 				STREAM_SET : begin //3
 					if(~|last_shift) begin
-						addr_o           <= addr_o + 8;
+						addr_o           <= addr_o + BEAT_BYTES;
 						addr_cnt         <= addr_cnt - 1;
 						last_shift[0]    <= addr_cnt == 1;
 						read_shift[0]    <= 1'b1;
@@ -149,7 +161,7 @@ generate
 					if(read_valid) begin
 						m_axis_eth_tdata  <= data_i; 
 						m_axis_eth_tvalid <= 1'b1; 
-						m_axis_eth_tlast  <= read_last_64;
+						seg_last          <= read_last_64;
 						// read_cnt          <= read_cnt - 1;
 						read_valid        <= read_shift[0];
 						eth_stream_state  <= STREAM_VALID;
@@ -169,14 +181,14 @@ generate
 					end
 					if(m_axis_eth_tready) begin
 						if(~|last_shift) begin
-							addr_o           <= addr_o + 8;
+							addr_o           <= addr_o + BEAT_BYTES;
 							addr_cnt         <= addr_cnt - 1;
 							last_shift[0]    <= addr_cnt == 1;
 							read_shift[0]     <= 1'b1;
 						end
 						m_axis_eth_tdata  <= data_i;
 						read_cnt          <= read_cnt - 1;
-						m_axis_eth_tlast  <= read_last_64;
+						seg_last          <= read_last_64;
 						read_valid        <= read_shift[0];
 
 						if(~read_valid) 
@@ -196,12 +208,12 @@ generate
 
 					if(m_axis_eth_tready) begin
 						m_axis_eth_tdata  <= data_save;
-						m_axis_eth_tlast  <= data_last_save;
+						seg_last          <= data_last_save;
 						m_axis_eth_tvalid <= 1'b1;
-						m_axis_eth_tkeep  <= 8'hFF;
+						m_axis_eth_tkeep  <= {(AXIS_TDATA_WIDTH/8){1'b1}};
 						read_cnt          <= read_cnt - 1;
 						if(~|last_shift) begin
-							addr_o           <= addr_o + 8;
+							addr_o           <= addr_o + BEAT_BYTES;
 							addr_cnt         <= addr_cnt - 1;
 							last_shift[0]    <= addr_cnt == 1;
 							read_shift[0]     <= 1'b1;
@@ -222,12 +234,12 @@ generate
 				STREAM_SAVE2 : begin
 					if(m_axis_eth_tready) begin
 						m_axis_eth_tdata  <= data_save;
-						m_axis_eth_tlast  <= data_last_save;
-						m_axis_eth_tkeep  <= 8'hFF;
+						seg_last          <= data_last_save;
+						m_axis_eth_tkeep  <= {(AXIS_TDATA_WIDTH/8){1'b1}};
 						data_save         <= data_save2;
 						data_last_save    <= data_last_save2;
 						if(~|last_shift) begin
-							addr_o           <= addr_o + 8;
+							addr_o           <= addr_o + BEAT_BYTES;
 							addr_cnt         <= addr_cnt - 1;
 							last_shift[0]    <= addr_cnt == 1;
 							read_shift[0]     <= 1'b1;
@@ -248,7 +260,7 @@ generate
 						pkt_ack_o         <= 1'b1;
 						read_valid        <= 1'b0;
 						m_axis_eth_tvalid <= 1'b0;
-						m_axis_eth_tlast  <= 1'b0;
+						seg_last          <= 1'b0;
 						eth_stream_state  <= IDLE;
 					end
 				end
@@ -263,7 +275,7 @@ generate
 
 
 
-	end else if(DATA_WIDTH==128) begin
+	end else if(DATA_WIDTH==128 && AXIS_WIDTH==64) begin
 
 
 
@@ -293,6 +305,7 @@ generate
 					pkt_ack_o        <= 1'b0;
 					if(pkt_addr_v_i & ~pkt_ack_o)begin
 						addr_o           <=  {pkt_addr_i[31:4],4'h0};
+						seg_eop          <= pkt_eop_i;
 						read_shift[0]    <= 1'b1;
 						first_beat       <= 1'b1;
 						read_cnt         <= pkt_len_i/16 -1 + (|pkt_len_i[3:0]);
@@ -320,7 +333,7 @@ generate
 						addr_o            <= addr_o + 16;
 						read_shift[0]    <= 1'b1;
 						m_axis_eth_tvalid <= 1'b1;
-						m_axis_eth_tlast  <= ~last_hi & read_last;
+						seg_last          <= ~last_hi & read_last;
 						read_valid        <= read_shift[0];
 						read_cnt          <= read_cnt - 1;
 					 	next_last         <= last_hi & read_last;
@@ -337,7 +350,7 @@ generate
 
 					if(m_axis_eth_tready) begin
 						m_axis_eth_tdata <= next_eth_tdata;
-						m_axis_eth_tlast <= next_last;
+						seg_last         <= next_last;
 						// addr_o           <= addr_o + 16;
 						// read_shift[0]    <= 1'b1;
 						eth_stream_state <= STREAM_SET_LO;
@@ -355,7 +368,7 @@ generate
 						m_axis_eth_tdata  <= data_save[63:0];
 						next_eth_tdata    <= data_save[127:64];
 						m_axis_eth_tvalid <= 1'b1;
-						m_axis_eth_tlast  <= ~last_hi & data_last_save;
+						seg_last          <= ~last_hi & data_last_save;
 						read_cnt          <= read_cnt - 1;
 					 	next_last         <= last_hi & data_last_save;
 						eth_stream_state  <= STREAM_WAIT_HI;
@@ -370,7 +383,7 @@ generate
 				STREAM_LAST : begin  //6
 					if(m_axis_eth_tready) begin
 						m_axis_eth_tvalid <= 1'b0;
-						m_axis_eth_tlast  <= 1'b0;
+						seg_last          <= 1'b0;
 						pkt_ack_o         <= 1'b1; //ack here because we need to read data safely
 						eth_stream_state  <= IDLE;
 					end
@@ -384,21 +397,20 @@ generate
 			end
 		end
 		
+	end else begin
+
+		$error("rx_packet_handler: DATA_WIDTH %0d with AXIS_WIDTH %0d, only AXIS_WIDTH equal to DATA_WIDTH or 64 with DATA_WIDTH 128 is implemented", DATA_WIDTH, AXIS_WIDTH);
+
 	end
 	
 endgenerate
 
+// bytes of the last beat, the stream is always byte aligned from the low lane
 always @(pkt_len_i) begin
-	case(pkt_len_i[2:0])
-		3'b000 : tkeep_last = 8'hFF;
-		3'b001 : tkeep_last = 8'h01;
-		3'b010 : tkeep_last = 8'h03;
-		3'b011 : tkeep_last = 8'h07;
-		3'b100 : tkeep_last = 8'h0F;
-		3'b101 : tkeep_last = 8'h1F;
-		3'b110 : tkeep_last = 8'h3F;
-		3'b111 : tkeep_last = 8'h7F;
-	endcase
+	if(pkt_len_i[BEAT_SHIFT-1:0] == 0)
+		tkeep_last = {(AXIS_TDATA_WIDTH/8){1'b1}};
+	else
+		tkeep_last = ~({(AXIS_TDATA_WIDTH/8){1'b1}} << pkt_len_i[BEAT_SHIFT-1:0]);
 end
 
 
@@ -0,0 +1,144 @@
+/*
+This module merges the received buffers of up to four rx queues (one rx_desc_ctrl per queue) for a single rx_packet_handler.
+Both sides use the buffer handshake of rx_desc_ctrl: pkt_addr_v is held with address, length and EOP until pkt_ack.
+The inputs are served round-robin per frame: once a buffer without EOP has been acknowledged the grant stays at the queue
+until the last buffer of the frame, so frames spanning several buffers are never interleaved on the ethernet stream.
+The grant only moves while the output is idle or with the acknowledgement of an EOP buffer, never while a buffer is presented.
+pkt_queue_o tells the queue of the current buffer, pkt_ts_o its rx timestamp.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module rx_queue_arbiter #(
+	parameter NB_QUEUES = 4, //1 to 4
+	parameter DEBUG_EN = 0
+)(
+(* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_RESET rst_i_n" *)
+	input wire                 clk_i,
+(* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 rst_i_n RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
+	input wire                 rst_i_n,
+
+	input wire[32-1:0]         pkt_addr0_i,
+	input wire[15:0]           pkt_len0_i,
+	input wire                 pkt_eop0_i,
+	input wire                 pkt_addr_v0_i,
+	output wire                pkt_ack0_o,
+	input wire[31:0]           pkt_ts0_i,
+
+	input wire[32-1:0]         pkt_addr1_i,
+	input wire[15:0]           pkt_len1_i,
+	input wire                 pkt_eop1_i,
+	input wire                 pkt_addr_v1_i,
+	output wire                pkt_ack1_o,
+	input wire[31:0]           pkt_ts1_i,
+
+	input wire[32-1:0]         pkt_addr2_i,
+	input wire[15:0]           pkt_len2_i,
+	input wire                 pkt_eop2_i,
+	input wire                 pkt_addr_v2_i,
+	output wire                pkt_ack2_o,
+	input wire[31:0]           pkt_ts2_i,
+
+	input wire[32-1:0]         pkt_addr3_i,
+	input wire[15:0]           pkt_len3_i,
+	input wire                 pkt_eop3_i,
+	input wire                 pkt_addr_v3_i,
+	output wire                pkt_ack3_o,
+	input wire[31:0]           pkt_ts3_i,
+
+	output reg[32-1:0]         pkt_addr_o,
+	output reg[15:0]           pkt_len_o,
+	output reg                 pkt_eop_o,
+	output reg                 pkt_addr_v_o,
+	input wire                 pkt_ack_i,
+	output wire[1:0]           pkt_queue_o,
+	output reg[31:0]           pkt_ts_o
+);
+
+reg[1:0] grant;
+reg      in_frame; //a buffer of the granted queue without EOP has been acknowledged
+
+wire[3:0] valid = {pkt_addr_v3_i & NB_QUEUES > 3, pkt_addr_v2_i & NB_QUEUES > 2, pkt_addr_v1_i & NB_QUEUES > 1, pkt_addr_v0_i};
+
+always @(*) begin
+	case(grant)
+		2'd0 : begin
+			pkt_addr_o   = pkt_addr0_i;
+			pkt_len_o    = pkt_len0_i;
+			pkt_eop_o    = pkt_eop0_i;
+			pkt_ts_o     = pkt_ts0_i;
+		end
+		2'd1 : begin
+			pkt_addr_o   = pkt_addr1_i;
+			pkt_len_o    = pkt_len1_i;
+			pkt_eop_o    = pkt_eop1_i;
+			pkt_ts_o     = pkt_ts1_i;
+		end
+		2'd2 : begin
+			pkt_addr_o   = pkt_addr2_i;
+			pkt_len_o    = pkt_len2_i;
+			pkt_eop_o    = pkt_eop2_i;
+			pkt_ts_o     = pkt_ts2_i;
+		end
+		default : begin
+			pkt_addr_o   = pkt_addr3_i;
+			pkt_len_o    = pkt_len3_i;
+			pkt_eop_o    = pkt_eop3_i;
+			pkt_ts_o     = pkt_ts3_i;
+		end
+	endcase
+	pkt_addr_v_o = valid[grant];
+end
+
+assign pkt_ack0_o  = pkt_ack_i & grant == 2'd0;
+assign pkt_ack1_o  = pkt_ack_i & grant == 2'd1;
+assign pkt_ack2_o  = pkt_ack_i & grant == 2'd2;
+assign pkt_ack3_o  = pkt_ack_i & grant == 2'd3;
+assign pkt_queue_o = grant;
+
+// next queue with a buffer in round-robin order behind the granted one, the granted one itself last
+reg[1:0] next;
+integer i;
+always @(*) begin
+	next = grant;
+	for(i = 3; i >= 1; i = i - 1)
+		if(valid[(grant + i) % 4])
+			next = (grant + i) % 4;
+end
+
+always @(posedge clk_i) begin
+	if (~rst_i_n) begin
+		grant    <= 0;
+		in_frame <= 1'b0;
+	end
+	else begin
+		if(pkt_ack_i) begin
+			in_frame <= ~pkt_eop_o;
+			if(pkt_eop_o)
+				grant <= next;
+		end else if(~pkt_addr_v_o & ~in_frame) begin
+			grant <= next;
+		end
+	end
+end
+
+
+generate
+if(DEBUG_EN) begin
+
+	(* MARK_DEBUG="true" *) reg[1:0]  grant_debug;
+	(* MARK_DEBUG="true" *) reg       in_frame_debug;
+	(* MARK_DEBUG="true" *) reg[3:0]  valid_debug;
+	(* MARK_DEBUG="true" *) reg       pkt_ack_i_debug;
+
+	always @(posedge clk_i) begin
+		grant_debug     <= grant;
+		in_frame_debug  <= in_frame;
+		valid_debug     <= valid;
+		pkt_ack_i_debug <= pkt_ack_i;
+	end
+
+end
+endgenerate
+
+endmodule
+`default_nettype wire
@@ -2,17 +2,25 @@
 Authors: Ralf Kundel, Kadir Eryigit, 2021
 
 This module delays tail pointer increases and batches them
+
+A doorbell is written after pkt_limit tail pointer updates or time_limit clock cycles, whichever comes first.
+With adaptive moderation (itr_cfg_i, from configuration_registers) the limits follow the update rate like the adaptive
+interrupt throttling of a NIC: every rate window the number of updates is compared to two thresholds.
+Above the high threshold the batch and the timeout are doubled up to their maxima (high throughput),
+below the low threshold they are halved down to their minima (low latency).
+Without adaptive moderation the maxima are used as static limits.
 */
 `timescale 1ns / 1ps
 `default_nettype none
-module tailpointer_delay #(
-    parameter MAX_TIME_CNT = 1000,//3 micro seconds
-    parameter MAX_PACKET_CNT = 8
-)(
+module tailpointer_delay (
 
 	input wire                            clk_i,
     input wire                            rstn_i,
 
+    //moderation policy: 15:0 timeout min, 31:16 timeout max, 47:32 batch min, 63:48 batch max,
+    //79:64 low rate threshold, 95:80 high rate threshold, 111:96 rate window, 112 adaptive
+    input wire[127:0]                     itr_cfg_i,
+
     //rx/tx_desc_ctrl side
 	input wire[63:0]                        s_phys_addr_i,
 	input wire[31:0]                        s_tail_pointer_i,
@@ -32,6 +40,24 @@ reg [63:0] addr_s;
 assign m_tail_pointer_o = last_tail_pointer_s;
 assign m_phys_addr_o = addr_s;
 
+wire[15:0] cfg_time_min    = itr_cfg_i[15:0];
+wire[15:0] cfg_time_max    = itr_cfg_i[31:16];
+wire[15:0] cfg_pkt_min     = itr_cfg_i[47:32];
+wire[15:0] cfg_pkt_max     = itr_cfg_i[63:48];
+wire[15:0] cfg_rate_low    = itr_cfg_i[79:64];
+wire[15:0] cfg_rate_high   = itr_cfg_i[95:80];
+wire[15:0] cfg_rate_window = itr_cfg_i[111:96];
+wire       cfg_adaptive    = itr_cfg_i[112];
+
+reg [15:0] time_limit;
+reg [15:0] pkt_limit;
+reg [15:0] window_cnt;
+reg [15:0] rate_cnt;
+wire[16:0] time_up   = {time_limit, 1'b0};
+wire[16:0] pkt_up    = {pkt_limit, 1'b0};
+wire[15:0] time_down = time_limit >> 1;
+wire[15:0] pkt_down  = pkt_limit >> 1;
+
 reg [31:0] time_cnt, next_time_cnt;
 reg [31:0] packet_cnt, next_packet_cnt;
 reg state, next_state;
@@ -60,6 +86,31 @@ always @(posedge clk_i) begin
     s_pcie_write_ack_o <= next_s_pcie_write_ack_o;
 end
 
+// adaptive moderation: the rate of tail pointer updates selects between low latency and high throughput limits
+always @(posedge clk_i) begin
+    if(!rstn_i || !cfg_adaptive) begin
+        time_limit <= cfg_time_max;
+        pkt_limit  <= cfg_pkt_max;
+        window_cnt <= 0;
+        rate_cnt   <= 0;
+    end else begin
+        window_cnt <= window_cnt + 1;
+        if(take_pointer_s && rate_cnt != 16'hFFFF)
+            rate_cnt <= rate_cnt + 1;
+        if(window_cnt >= cfg_rate_window) begin
+            window_cnt <= 0;
+            rate_cnt   <= 0;
+            if(rate_cnt > cfg_rate_high) begin
+                time_limit <= time_up > cfg_time_max ? cfg_time_max : time_up[15:0];
+                pkt_limit  <= pkt_up > cfg_pkt_max ? cfg_pkt_max : pkt_up[15:0];
+            end else if(rate_cnt < cfg_rate_low) begin
+                time_limit <= time_down < cfg_time_min ? cfg_time_min : time_down;
+                pkt_limit  <= pkt_down < cfg_pkt_min ? cfg_pkt_min : pkt_down;
+            end
+        end
+    end
+end
+
 always @(*) begin
     next_time_cnt = time_cnt;
     next_packet_cnt = packet_cnt;
@@ -72,13 +123,13 @@ always @(*) begin
     STATE_IDLE: begin
         take_pointer_s = s_pcie_write_i;        
         next_s_pcie_write_ack_o = 1'b1;
-        if(time_cnt != MAX_TIME_CNT) begin
+        if(time_cnt < time_limit) begin
             next_time_cnt = time_cnt+1;
         end
         if(s_pcie_write_i) begin
             next_packet_cnt = packet_cnt+1;
         end
-        if((time_cnt == MAX_TIME_CNT && next_packet_cnt!=0) || next_packet_cnt == MAX_PACKET_CNT) begin
+        if(next_packet_cnt != 0 && (time_cnt >= time_limit || next_packet_cnt >= pkt_limit)) begin
             next_state = STATE_WRITE;
             //m_pcie_write_o = 1'b1;   
             next_s_pcie_write_ack_o = 1'b0;
@@ -9,12 +9,27 @@ On the event of a new request the tx-descriptor is written on a local FPGA bram.
 The descriptor attributes are mostly static except the packet length.
 The NIC is informed of the new tx-descriptor by an increase of its tx-tail pointer.
 This module generates a simple pcie-request to increment the tail pointer on the NIC.
+
+Frames spanning several buffers are requested buffer by buffer, pkt_eop_i marks the last one.
+One descriptor is written per buffer, EOP is only set in the last one. Afterwards the first descriptor of the frame is rewritten
+with the length of the whole frame (PAYLEN) and the tail pointer is incremented once for all descriptors of the frame.
+
+With HEAD_WB the NIC writes its tx-head pointer to the bram word directly behind the ring (byte offset NB_DESC*16, TDWBAL/TDWBAH)
+instead of writing back the status of each descriptor. A descriptor is free as long as tail+1 != head.
+The driver has to set head_wb_iova of the tx queue to this word and the word has to be zeroed before the queue is started.
+
+With HAIRPIN the requests come from the rx queues (rx_queue_arbiter) instead of tx_packet_handler and the descriptors point
+directly at the rx buffers, the packets are sent from the rx packet bram without a copy. The rx queue of each descriptor is kept
+and once the NIC has moved its head past a descriptor the buffer is handed back to its queue with buf_free<q>_o,
+rx_desc_ctrl only returns it to the NIC with the next rx tail pointer update then. HAIRPIN requires HEAD_WB.
 */
 `timescale 1ns / 1ps
 `default_nettype none
 module tx_desc_ctrl #(
 	parameter NB_DESC = 64,
-	parameter DEBUG_EN = 0
+	parameter DEBUG_EN = 0,
+	parameter HEAD_WB = 0,
+	parameter HAIRPIN = 0 //send the rx buffers, needs HEAD_WB
 )(
 (* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 clk_i CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_RESET rst_i_n" *)
 	input wire                             clk_i,
@@ -43,37 +58,45 @@ module tx_desc_ctrl #(
 	input wire                            init_i,
 
 
-	input wire[31:0]                      nic_base_addr_i,
+	input wire[63:0]                      nic_tdt_addr_i, //bus address of the TDT register of the queue
 	input wire[31:0]                      fpga_base_addr_i,
 	// input wire[31:0]                      desc_base_addr_i,
 
 	input wire[31:0]                      pkt_addr_i,
 	input wire[15:0]                      pkt_len_i,
+	input wire                            pkt_eop_i,
 	input wire   						  xmit_req_i,
 	output reg                            xmit_ack_o,
+	input wire[1:0]                       pkt_queue_i, //rx queue of the buffer (HAIRPIN)
+
+	output reg                            buf_free0_o, //rx buffer of queue 0 sent by the NIC (HAIRPIN)
+	output reg                            buf_free1_o,
+	output reg                            buf_free2_o,
+	output reg                            buf_free3_o,
 
 	output reg[63:0]                      nic_phys_addr_o,
 	output reg[31:0]                      nic_tx_tail_pointer_o,
 	output reg                            pcie_rq_start_o,
-	input wire 							  pcie_rq_ack_i
+	input wire 							  pcie_rq_ack_i,
+
+	output reg[15:0]                      ring_level_o //descriptors queued for the nic, for perf_counters (HEAD_WB only)
 	);
 	
 // TODO enable writeback here
 //`define REPORT_STATUS
 
-localparam TDT_REG_OFFS = 64'h00000000_00006018; //see 8.2.3.9.9 in 82599-10-gbe-controller datasheet
-
 assign clk_o = clk_i;
 
 
-wire[31:0] pkt_base_addr = fpga_base_addr_i | (256*2048);
+wire[31:0] pkt_base_addr = HAIRPIN ? fpga_base_addr_i : fpga_base_addr_i | (256*2048); //rx or tx packet bram
 
 localparam 
            RESET              = 0,
            IDLE               = 1,
 		   WRITE_DESC_BEAT1   = 2,
 		   PCIE_WRITE_TDT_REG = 3,
-		   PCIE_WAIT_TDT_REG  = 4;
+		   PCIE_WAIT_TDT_REG  = 4,
+		   WRITE_DESC_FIRST   = 5;
 
 
 localparam DESC_IX_SZ = $clog2(NB_DESC);
@@ -82,11 +105,13 @@ reg[63:0] pkt_addr;
 reg[15:0] data_len;
 wire[1:0] mac   = 0; //not mac address
 wire[3:0] dtyp  = 4'b0011;
+reg desc_eop;
 `ifdef REPORT_STATUS
-    wire[7:0] dcmd  = 8'b0010_1011; //7:Transmit Segmentation Enable, 6: VLAN Packet Enable, 5: Descriptor Extension, 4: reserved, 3: Report Status (enabled by Ralf -2021-03-06), 2: reserved, 1: Insert FCS, 0:End of Packet
+    wire[7:0] dcmd_seg  = 8'b0010_1010; //7:Transmit Segmentation Enable, 6: VLAN Packet Enable, 5: Descriptor Extension, 4: reserved, 3: Report Status (enabled by Ralf -2021-03-06), 2: reserved, 1: Insert FCS, 0:End of Packet
 `else
-    wire[7:0] dcmd  = 8'b0010_0011;
+    wire[7:0] dcmd_seg  = HEAD_WB ? 8'b0010_1010 : 8'b0010_0010; //the head is only written back for descriptors with Report Status
 `endif
+wire[7:0] dcmd  = {dcmd_seg[7:1],desc_eop};
 wire[3:0] sta   = 0;
 wire[2:0] idx   = 0;
 wire cc         = 0;
@@ -95,8 +120,19 @@ reg[17:0] paylen;
 
 wire[127:0] tx_desc = {paylen,popts,cc,idx,sta,dcmd,dtyp,mac,2'b00,data_len,pkt_addr};
 
+// first descriptor of a frame spanning several buffers, rewritten with the frame length once the last buffer is known
+reg       in_frame;
+reg[63:0] first_pkt_addr;
+reg[15:0] first_data_len;
+wire[127:0] tx_desc_first = {paylen,popts,cc,idx,sta,dcmd_seg,dtyp,mac,2'b00,first_data_len,first_pkt_addr};
+
+// HAIRPIN: rx queue of each descriptor, the buffers are handed back in ring order up to the head of the NIC
+reg[1:0] pkt_queue;
+reg[1:0] desc_queue[0:NB_DESC-1];
+
 reg[2:0] tx_desc_state = RESET;
 reg[DESC_IX_SZ-1:0] tail_pointer;
+reg[DESC_IX_SZ-1:0] first_pointer;
 
 reg init;
 
@@ -117,11 +153,50 @@ assign descriptor_status_s = data_i[35+64:32+64];
 `else
 assign descriptor_status_s = 4'b0001;
 `endif
+
+localparam[31:0] HEAD_WB_ADDR = NB_DESC*16;
+wire[DESC_IX_SZ-1:0] tail_pointer_next = tail_pointer + 1;
+wire desc_free_s = HEAD_WB ? (data_i[DESC_IX_SZ-1:0] != tail_pointer_next) : descriptor_status_s[0];
+
+// the head is only known with HEAD_WB, it is sampled whenever a descriptor waits for a free slot
+always @(posedge clk_i) begin
+	if (init | ~HEAD_WB)
+		ring_level_o <= 0;
+	else if(tx_desc_state == WRITE_DESC_BEAT1)
+		ring_level_o <= {{(16-DESC_IX_SZ){1'b0}}, tail_pointer - data_i[DESC_IX_SZ-1:0]};
+end
+
+reg[DESC_IX_SZ-1:0] head;
+reg[DESC_IX_SZ-1:0] free_ix; //first descriptor whose buffer has not been handed back
+reg head_rd;                 //data_i holds the head write-back word
+
+always @(posedge clk_i) begin
+	head_rd <= en_o & ~wren_o & addr_o == HEAD_WB_ADDR;
+	buf_free0_o <= 1'b0;
+	buf_free1_o <= 1'b0;
+	buf_free2_o <= 1'b0;
+	buf_free3_o <= 1'b0;
+	if (init | ~HAIRPIN) begin
+		head    <= 0;
+		free_ix <= 0;
+	end else begin
+		if(head_rd)
+			head <= data_i[DESC_IX_SZ-1:0];
+		if(free_ix != head) begin
+			buf_free0_o <= desc_queue[free_ix] == 0;
+			buf_free1_o <= desc_queue[free_ix] == 1;
+			buf_free2_o <= desc_queue[free_ix] == 2;
+			buf_free3_o <= desc_queue[free_ix] == 3;
+			free_ix     <= free_ix + 1;
+		end
+	end
+end
   
 always @(posedge clk_i) begin
     if (init) begin
 		xmit_ack_o      <= 1'b0;
 		tail_pointer    <= 0;
+		in_frame        <= 1'b0;
 		pcie_rq_start_o <= 1'b0;
 		rst_o           <= 1'b1;
 		en_o            <= 1'b0;
@@ -151,14 +226,21 @@ always @(posedge clk_i) begin
 		IDLE : begin  //1
             wren_o <= 1'b0;
             wea_o  <= 16'h0000;
-            nic_phys_addr_o <= nic_base_addr_i + TDT_REG_OFFS;
-			addr_o     <= {  {(32-DESC_IX_SZ-4){1'b0}}, tail_pointer,4'b0000 }; //for reading the old status bit
+            nic_phys_addr_o <= nic_tdt_addr_i;
+			addr_o     <= HEAD_WB ? HEAD_WB_ADDR : {  {(32-DESC_IX_SZ-4){1'b0}}, tail_pointer,4'b0000 }; //for reading the head or the old status bit
 			if(xmit_req_i & start_i) begin
 				pkt_addr      <= {32'h0000_0000,pkt_addr_i | pkt_base_addr};
 				data_len      <= pkt_len_i;
-				paylen        <= {2'b00,pkt_len_i};
+				desc_eop      <= pkt_eop_i;
+				pkt_queue     <= pkt_queue_i;
+				paylen        <= in_frame ? paylen + pkt_len_i : {2'b00,pkt_len_i};
 				xmit_ack_o    <= 1'b1;
 				tx_desc_state <= WRITE_DESC_BEAT1;
+				if(~in_frame) begin
+					first_pointer  <= tail_pointer;
+					first_pkt_addr <= {32'h0000_0000,pkt_addr_i | pkt_base_addr};
+					first_data_len <= pkt_len_i;
+				end
 			end
 			
 		end
@@ -168,17 +250,31 @@ always @(posedge clk_i) begin
 			xmit_ack_o <= 1'b0;
 			tx_desc_state <= WRITE_DESC_BEAT1;
 			
-		    if (descriptor_status_s[0] == 1'b1) begin
+		    if (desc_free_s) begin
                 addr_o     <= {  {(32-DESC_IX_SZ-4){1'b0}}, tail_pointer,4'b0000 };
                 data_o     <= tx_desc;
                 wea_o      <= 16'hFFFF;
                 wren_o     <= 1'b1;
+                desc_queue[tail_pointer] <= pkt_queue;
     
                 tail_pointer  <= tail_pointer + 1;
                 tx_desc_state <= PCIE_WRITE_TDT_REG;
+                in_frame      <= ~desc_eop;
+                if(~desc_eop)
+                    tx_desc_state <= IDLE; //the frame continues in the next buffer, no tail pointer update yet
+                else if(in_frame)
+                    tx_desc_state <= WRITE_DESC_FIRST;
 			end
 			
 		end
+
+		WRITE_DESC_FIRST : begin  //5
+			addr_o        <= {  {(32-DESC_IX_SZ-4){1'b0}}, first_pointer,4'b0000 };
+			data_o        <= tx_desc_first;
+			wea_o         <= 16'hFFFF;
+			wren_o        <= 1'b1;
+			tx_desc_state <= PCIE_WRITE_TDT_REG;
+		end
 		
 		PCIE_WRITE_TDT_REG : begin
 			wea_o  <= 16'h0000;
@@ -199,6 +295,7 @@ always @(posedge clk_i) begin
 		default : begin
 			xmit_ack_o      <= 1'b0;
 			tail_pointer    <= 0;
+			in_frame        <= 1'b0;
 			pcie_rq_start_o <= 1'b0;
 			tx_desc_state <= IDLE;
 		end
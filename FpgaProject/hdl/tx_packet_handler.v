@@ -3,9 +3,13 @@ Authors: Ralf Kundel, Kadir Eryigit, 2020
 
 This module reads an axistream and writes the contents to a bram.
 Additionally packet length information is generated for each axistream and output with a simple handshake protocol.
-Each packet is also accompanied by a 2048byte aligned address.
+Each packet is also accompanied by a BUF_SIZE aligned address (2048 bytes by default).
 The axi-stream supports ready signalling.
 Each packet must be ackknowledged by the new packet output before a new axistream can be handled.
+Frames longer than BUF_SIZE are split: each full buffer is requested with pkt_eop_o low and the frame continues in the next buffer,
+the buffer holding the end of the frame is requested with pkt_eop_o high.
+The stream is 64 bit wide by default. With AXIS_WIDTH equal to DATA_WIDTH (128, 256 or 512 bit) each beat is written as one bram word,
+tkeep is the byte write enable, so partial beats must be filled from the low lane (as generated by rx_packet_handler).
 */
 `timescale 1ns / 1ps
 `default_nettype none
@@ -15,6 +19,8 @@ module tx_packet_handler #(
     // parameter M_AXI_TDATA_WIDTH = 64,
     parameter NB_TX_DESC = 64,
     parameter DATA_WIDTH = 128,
+    parameter AXIS_WIDTH = 64, //64 or DATA_WIDTH (up to 512)
+    parameter BUF_SIZE = 2048, //packet buffer per descriptor in bytes, the largest packet has to fit into it
     parameter DEBUG_EN = 0
     )(
     (* X_INTERFACE_INFO = "xilinx.com:signal:clock:1.0 axi_clk CLK" *) (* X_INTERFACE_PARAMETER = "ASSOCIATED_BUSIF s_axis_eth, ASSOCIATED_RESET axi_aresetn" *)
@@ -22,15 +28,15 @@ module tx_packet_handler #(
     (* X_INTERFACE_INFO = "xilinx.com:signal:reset:1.0 axi_aresetn RST" *) (* X_INTERFACE_PARAMETER = "POLARITY ACTIVE_LOW" *)
        input wire                                axi_aresetn,
 
-       input wire[64-1:0]                    s_axis_eth_tdata,      
+       input wire[AXIS_WIDTH-1:0]            s_axis_eth_tdata,      
        input wire[7:0]                       s_axis_eth_tuser,
        input wire                            s_axis_eth_tlast,
-       input wire[64/8-1:0]                  s_axis_eth_tkeep,
+       input wire[AXIS_WIDTH/8-1:0]          s_axis_eth_tkeep,
        input wire                            s_axis_eth_tvalid,
        output reg                            s_axis_eth_tready,
 
       (* X_INTERFACE_INFO = "xilinx.com:interface:bram_rtl:1.0 MODE MASTER,NAME BRAM_PORT" *)
-      (* X_INTERFACE_PARAMETER = "MASTER_TYPE BRAM_CTRL, MEM_ECC NONE, MEM_WIDTH 128, MEM_SIZE 131072, READ_LATENCY 1" *) //READ_WRITE_MODE READ_WRITE
+      (* X_INTERFACE_PARAMETER = "MASTER_TYPE BRAM_CTRL, MEM_ECC NONE, MEM_SIZE 131072, READ_LATENCY 1" *) //MEM_WIDTH is DATA_WIDTH, set on the interface by U200.tcl
       (* X_INTERFACE_INFO = "xilinx.com:interface:bram:1.0 BRAM_PORT ADDR" *)
       output reg[32-1:0]   addr_o, //addr is data width aligned
       (* X_INTERFACE_INFO = "xilinx.com:interface:bram:1.0 BRAM_PORT CLK" *) 
@@ -55,6 +61,7 @@ module tx_packet_handler #(
 
        output reg[32-1:0]                    pkt_addr_o,
        output reg[15:0]                      pkt_len_o, // in bytes
+       output reg                            pkt_eop_o, // last buffer of the frame
        output reg                            xmit_req_o,
        input wire                            xmit_ack_i
 
@@ -67,15 +74,16 @@ localparam IDLE          = 1,
            PKT_REQ       = 5;
 
      
-localparam AXIS_TDATA_WIDTH = 64;
+localparam AXIS_TDATA_WIDTH = AXIS_WIDTH;
 
 reg[3:0]                    axi_state = IDLE;
 
 localparam PKT_OFFS_WIDTH = $clog2(NB_TX_DESC);
 
 reg[PKT_OFFS_WIDTH-1:0] pkt_offset = 0;
+wire[31:0] pkt_offset_addr = pkt_offset * BUF_SIZE;
 reg[15:0]  byte_count = 0;
-reg[3:0]  add_bytes;
+reg[$clog2(AXIS_TDATA_WIDTH/8):0] add_bytes;
 
 reg init;
 reg init_done = 0;
@@ -97,7 +105,7 @@ end
 
 
 generate
-  if(DATA_WIDTH == 64) begin
+  if(DATA_WIDTH == AXIS_WIDTH) begin
 
 
     always @(posedge axi_clk) begin
@@ -114,7 +122,7 @@ generate
     end else begin
         en_o  <= 1'b1;
         rst_o <= 1'b0;
-        wea_o <= 16'h0000;
+        wea_o <= 0;
         wren_o            <= 1'b0;
 
         case(axi_state) 
@@ -133,18 +141,19 @@ generate
                 wren_o            <= |s_axis_eth_tkeep;
                 byte_count        <= add_bytes;
                 axi_state         <= DATA;
-                addr_o            <= { {(32- PKT_OFFS_WIDTH-11){1'b0}}  ,pkt_offset,11'b00000000000};
-                pkt_addr_o        <= { {(32- PKT_OFFS_WIDTH-11){1'b0}}  ,pkt_offset,11'b00000000000}; //add 2048 offset for each paket, so burst always stay inside 4k boundary(max packet length smaller than 2k);
+                addr_o            <= pkt_offset_addr;
+                pkt_addr_o        <= pkt_offset_addr; //add BUF_SIZE offset for each paket, with 2k the burst always stays inside 4k boundary(max packet length smaller than 2k);
                 pkt_offset        <= pkt_offset + 1;
                 if(s_axis_eth_tlast) begin
                   pkt_len_o         <= add_bytes;
+                  pkt_eop_o         <= 1'b1;
                   xmit_req_o        <= 1'b1;
                   s_axis_eth_tready <= 1'b0;
                   axi_state         <= PKT_REQ;
                 end
               end
               if(init)begin
-                wea_o             <= 8'h00;
+                wea_o             <= 0;
                 wren_o            <= 1'b0;
                 s_axis_eth_tready <= 1'b1;
                 axi_state         <= IDLE;
@@ -156,16 +165,17 @@ generate
                 wea_o             <= s_axis_eth_tkeep;
                 wren_o            <= |s_axis_eth_tkeep;
                 byte_count        <= add_bytes + byte_count;
-                addr_o            <= addr_o + 8;
-                if(s_axis_eth_tlast) begin
+                addr_o            <= addr_o + AXIS_TDATA_WIDTH/8;
+                if(s_axis_eth_tlast | (add_bytes + byte_count == BUF_SIZE)) begin //end of frame or buffer full, the frame continues in the next buffer
                   pkt_len_o         <= add_bytes + byte_count;
+                  pkt_eop_o         <= s_axis_eth_tlast;
                   xmit_req_o        <= 1'b1;
                   s_axis_eth_tready <= 1'b0;
                   axi_state         <= PKT_REQ;
                 end
               end
               if(init)begin
-                wea_o             <= 8'h00;
+                wea_o             <= 0;
                 wren_o            <= 1'b0;
                 s_axis_eth_tready <= 1'b1;
                 axi_state         <= IDLE;
@@ -192,7 +202,7 @@ end
 
 
 
-  end else if(DATA_WIDTH == 128) begin
+  end else if(DATA_WIDTH == 128 && AXIS_WIDTH == 64) begin
       
 
       always @(posedge axi_clk) begin
@@ -228,11 +238,12 @@ end
                     wren_o            <= |s_axis_eth_tkeep;
                     byte_count        <= add_bytes;
                     axi_state         <= DATA_HI;
-                    addr_o            <= { {(32- PKT_OFFS_WIDTH-11){1'b0}}  ,pkt_offset,11'b00000000000};
-                    pkt_addr_o        <= { {(32- PKT_OFFS_WIDTH-11){1'b0}}  ,pkt_offset,11'b00000000000}; //add 2048 offset for each paket, so burst always stay inside 4k boundary(max packet length smaller than 2k);
+                    addr_o            <= pkt_offset_addr;
+                    pkt_addr_o        <= pkt_offset_addr; //add BUF_SIZE offset for each paket, with 2k the burst always stays inside 4k boundary(max packet length smaller than 2k);
                     pkt_offset        <= pkt_offset + 1;
                     if(s_axis_eth_tlast) begin
                       pkt_len_o         <= add_bytes;
+                      pkt_eop_o         <= 1'b1;
                       xmit_req_o        <= 1'b1;
                       s_axis_eth_tready <= 1'b0;
                       axi_state         <= PKT_REQ;
@@ -252,8 +263,9 @@ end
                     wren_o              <= |s_axis_eth_tkeep;
                     byte_count          <= byte_count + add_bytes;
                     axi_state           <= DATA_LO;
-                    if(s_axis_eth_tlast) begin
+                    if(s_axis_eth_tlast | (byte_count + add_bytes == BUF_SIZE)) begin //end of frame or buffer full, the frame continues in the next buffer
                       pkt_len_o         <= byte_count + add_bytes;
+                      pkt_eop_o         <= s_axis_eth_tlast;
                       xmit_req_o        <= 1'b1;
                       s_axis_eth_tready <= 1'b0;
                       axi_state         <= PKT_REQ;
@@ -276,6 +288,7 @@ end
                     axi_state    <= DATA_HI;
                     if(s_axis_eth_tlast) begin
                       pkt_len_o         <= byte_count + add_bytes;
+                      pkt_eop_o         <= 1'b1;
                       xmit_req_o        <= 1'b1;
                       s_axis_eth_tready <= 1'b0;
                       axi_state         <= PKT_REQ;
@@ -313,23 +326,22 @@ end
 
 
 
+  end else begin
+
+    $error("tx_packet_handler: DATA_WIDTH %0d with AXIS_WIDTH %0d, only AXIS_WIDTH equal to DATA_WIDTH or 64 with DATA_WIDTH 128 is implemented", DATA_WIDTH, AXIS_WIDTH);
+
   end
   
 endgenerate
 
 
+// bytes of the beat up to the highest kept byte, partial beats are filled from the low lane
+integer k;
 always @(*) begin
-    casex(s_axis_eth_tkeep)
-        8'b1xxxxxxx: add_bytes = 8;
-        8'b01xxxxxx: add_bytes = 7;
-        8'b001xxxxx: add_bytes = 6;
-        8'b0001xxxx: add_bytes = 5;
-        8'b00001xxx: add_bytes = 4;
-        8'b000001xx: add_bytes = 3;
-        8'b0000001x: add_bytes = 2;
-        8'b00000001: add_bytes = 1;
-        default    : add_bytes = 0;
-    endcase
+    add_bytes = 0;
+    for(k = 0; k < AXIS_TDATA_WIDTH/8; k = k + 1)
+        if(s_axis_eth_tkeep[k])
+            add_bytes = k + 1;
 end
 
 
@@ -349,7 +361,7 @@ generate
       (* MARK_DEBUG="true" *) reg                            xmit_ack_i_debug;
       (* MARK_DEBUG="true" *) reg[PKT_OFFS_WIDTH-1:0]        pkt_offset_debug;
       (* MARK_DEBUG="true" *) reg[15:0]                      byte_count_debug;
-      (* MARK_DEBUG="true" *) reg[3:0]                       add_bytes_debug;
+      (* MARK_DEBUG="true" *) reg[$clog2(AXIS_TDATA_WIDTH/8):0] add_bytes_debug;
       (* MARK_DEBUG="true" *) reg[2:0]                       axi_state_debug;
       (* MARK_DEBUG="true" *) reg                            init_done_debug;
       (* MARK_DEBUG="true" *) reg[DATA_WIDTH-1:0]            data_o_debug;
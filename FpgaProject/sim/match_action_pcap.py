@@ -0,0 +1,398 @@
+#!/usr/bin/env python3
+# Test vectors of tb_match_action from a pcap file.
+# The frames of the pcap are run through a model of match_action.v with the table entries below, the testbench
+# loads the same entries into the module and compares its output with the expected frames.
+# Without a pcap file a set of frames is generated (written to <outdir>/match_action.pcap) which covers
+# drop, MAC and IPv4 rewrite, IPv4 options with the TCP/UDP checksum inside and behind the parsed header,
+# fragments, VLAN, IPv6 and frames longer than the header.
+#
+# ./match_action_pcap.py [-o outdir] [frames.pcap]
+# Output in outdir (read with $readmemh):
+#   ma_frames.hex  input frames, per frame length (2 bytes, big endian), tuser and the frame bytes, length 0 ends the list
+#   ma_expect.hex  expected output frames in the same format, dropped frames are left out
+#   ma_rules.hex   register writes {op, addr, data}: op 0 writes data, op 1 writes data | em_hash of the staged key, op 255 ends
+#   ma_counts.hex  expected counters: dropped frames, frames without hit, exact match hits, ternary hits, skipped rewrites
+import argparse
+import os
+import random
+import struct
+import sys
+
+HDR_BYTES = 64
+EM_ENTRIES = 256
+
+A_DROP, A_MAC, A_MAC_SRC, A_IP, A_IP_SRC, A_QUEUE, A_COUNT = 0, 1, 2, 3, 4, 5, 8
+
+# register word index of match_action.v
+R_KEY, R_MASK, R_ACT, R_MAC, R_IP, R_CMD, R_PARSER, R_DEFAULT = 0, 10, 20, 21, 23, 24, 25, 26
+CMD_TERNARY, CMD_VALID = 1 << 16, 1 << 17
+
+
+def ip(s):
+    return struct.unpack(">I", bytes(int(b) for b in s.split(".")))[0]
+
+
+def mac(s):
+    return int(s.replace(":", ""), 16)
+
+
+def make_key(sport=0, dport=0, ports=0, ipv6=0, ipv4=0, vlan=0, vid=0, proto=0, src=0, dst=0):
+    w0 = (sport << 16 | dport) if ports else 0
+    w1 = ports << 23 | ipv6 << 22 | ipv4 << 21 | vlan << 20 | vid << 8 | proto
+    return w0 | w1 << 32 | src << 64 | dst << 192
+
+
+def act(*bits, queue=0, counter=0):
+    a = queue << 6 | counter << 9
+    for b in bits:
+        a |= 1 << b
+    return a
+
+
+FULL = (1 << 320) - 1
+W1_IPV4 = 1 << 53
+W1_IPV6 = 1 << 54
+W1_VLAN = 1 << 52
+W1_VID = 0xFFF << 40
+W1_PROTO = 0xFF << 32
+W1_PORTS = 1 << 55
+DST_IPV4 = 0xFFFFFFFF << 192
+DPORT = 0xFFFF
+
+# exact match entries: key, action, mac, ip
+EM = [
+    (make_key(1234, 80, 1, ipv4=1, proto=6, src=ip("10.0.0.1"), dst=ip("10.0.0.2")), act(A_IP, A_COUNT, counter=1), 0, ip("192.168.1.2")),
+    (make_key(5000, 53, 1, ipv4=1, proto=17, src=ip("10.0.0.3"), dst=ip("10.0.0.4")), act(A_IP, A_IP_SRC), 0, ip("172.16.0.9")),
+    (make_key(99, 22, 1, ipv4=1, proto=6, src=ip("10.0.0.7"), dst=ip("10.0.0.8")), act(A_DROP), 0, 0),
+]
+# ternary entries, the lowest matching index wins: key, mask, action, mac, ip
+TC = [
+    (make_key(ipv4=1, dst=ip("10.0.0.66")), W1_IPV4 | DST_IPV4, act(A_DROP), 0, 0),
+    (make_key(0, 9, 1, ipv4=1, proto=17), W1_PORTS | W1_IPV4 | W1_PROTO | DPORT, act(A_DROP), 0, 0),
+    (make_key(vlan=1, vid=100), W1_VLAN | W1_VID, act(A_MAC, A_QUEUE, queue=1), mac("02:00:00:00:00:01"), 0),
+    (make_key(ipv4=1, dst=ip("10.0.0.5")), W1_IPV4 | DST_IPV4, act(A_IP, A_COUNT, counter=2), 0, ip("10.0.0.6")),
+    (make_key(ipv6=1), W1_IPV6, act(A_QUEUE, queue=2), 0, 0),
+    (make_key(src=ip("10.0.0.9")), 0xFFFFFFFF << 64, act(A_MAC, A_MAC_SRC), mac("02:00:00:00:00:99"), 0),
+]
+# the rewrite bits are ignored for frames without hit
+DEFAULT_ACT = act(A_COUNT, A_MAC, A_IP, counter=0)
+PARSE_CFG = 0xF
+
+
+def em_hash(key):
+    h = 0
+    for w in range(10):
+        h = ((h << 5 | h >> 27) & 0xFFFFFFFF) ^ (key >> (w * 32) & 0xFFFFFFFF)
+    h ^= h >> 16
+    h ^= h >> 8
+    return h & (EM_ENTRIES - 1)
+
+
+def csum_upd(hc, old, new):
+    """RFC 1624 incremental update for a changed 32 bit word"""
+    s = (~hc & 0xFFFF) + (~(old >> 16) & 0xFFFF) + (~old & 0xFFFF) + (new >> 16) + (new & 0xFFFF)
+    while s >> 16:
+        s = (s & 0xFFFF) + (s >> 16)
+    return ~s & 0xFFFF
+
+
+def csum(data):
+    if len(data) % 2:
+        data = data + b"\0"
+    s = sum(struct.unpack(">%dH" % (len(data) // 2), data))
+    while s >> 16:
+        s = (s & 0xFFFF) + (s >> 16)
+    return ~s & 0xFFFF
+
+
+class Model:
+    def __init__(self):
+        self.em = {}
+        for key, a, m, i in EM:
+            ix = em_hash(key)
+            if ix in self.em:
+                sys.exit("exact match entries collide at index %d" % ix)
+            self.em[ix] = (key, a, m, i)
+        self.counts = [0] * 5  # drops, misses, exact hits, ternary hits, skipped rewrites
+
+    def lookup(self, key):
+        e = self.em.get(em_hash(key))
+        if e and e[0] == key:
+            self.counts[2] += 1
+            return e[1:]
+        for k, m, a, mc, i in TC:
+            if key & m == k & m:
+                self.counts[3] += 1
+                return a, mc, i
+        self.counts[1] += 1
+        return DEFAULT_ACT & ~(1 << A_MAC | 1 << A_IP), 0, 0
+
+    def process(self, frame, tuser=0):
+        """returns (output frame, tuser), the frame is None if it is dropped"""
+        h = bytearray(frame[:HDR_BYTES].ljust(HDR_BYTES, b"\0"))
+
+        def hb(off):
+            off &= 0x7F
+            return h[off] if off < HDR_BYTES else 0
+
+        def hw(off, n):
+            v = 0
+            for i in range(n):
+                v = v << 8 | hb(off + i)
+            return v
+
+        eth_type = hw(12, 2)
+        vlan = PARSE_CFG & 1 and eth_type == 0x8100
+        vid = hw(14, 2) & 0xFFF if vlan else 0
+        if vlan:
+            eth_type = hw(16, 2)
+        l3 = 18 if vlan else 14
+        ipv4 = bool(PARSE_CFG & 2 and eth_type == 0x0800 and hb(l3) >> 4 == 4)
+        ipv6 = bool(PARSE_CFG & 4 and eth_type == 0x86DD and hb(l3) >> 4 == 6)
+        l4 = (l3 + (hb(l3) & 0xF) * 4 if ipv4 else l3 + 40) & 0x7F
+        proto = hb(l3 + 9) if ipv4 else hb(l3 + 6) if ipv6 else 0
+        frag = ipv4 and hw(l3 + 6, 2) & 0x1FFF != 0
+        l4_hdr = ipv4 and proto in (6, 17) and not frag
+        ports = bool(PARSE_CFG & 8 and (ipv4 or ipv6) and proto in (6, 17) and l4 + 4 <= HDR_BYTES and not frag)
+        src = dst = 0
+        if ipv4:
+            src, dst = hw(l3 + 12, 4), hw(l3 + 16, 4)
+        elif ipv6:
+            src, dst = hw(l3 + 8, 16), hw(l3 + 24, 16)
+        key = make_key(hw(l4, 2), hw(l4 + 2, 2), int(ports), int(ipv6), int(ipv4), int(bool(vlan)), vid, proto, src, dst)
+
+        a, rw_mac, rw_ip = self.lookup(key)
+        if a >> A_DROP & 1:
+            self.counts[0] += 1
+            return None, tuser
+        if a >> A_QUEUE & 1:
+            tuser = a >> 6 & 3
+
+        l4_csum_off = (l4 + (16 if proto == 6 else 6)) & 0x7F
+        l4_csum_in = l4_csum_off + 2 <= HDR_BYTES
+        ip_skip = a >> A_IP & 1 and ipv4 and l4_hdr and not l4_csum_in
+        if ip_skip:
+            self.counts[4] += 1
+        if a >> A_MAC & 1:
+            off = 6 if a >> A_MAC_SRC & 1 else 0
+            h[off:off + 6] = rw_mac.to_bytes(6, "big")
+        if a >> A_IP & 1 and ipv4 and not ip_skip:
+            ip_off = l3 + (12 if a >> A_IP_SRC & 1 else 16)
+            old = hw(ip_off, 4)
+            ip_csum = csum_upd(hw(l3 + 10, 2), old, rw_ip)
+            l4_csum = hw(l4_csum_off, 2)
+            l4_csum_v = l4_hdr and l4_csum_in and not (proto == 17 and l4_csum == 0)
+            h[ip_off:ip_off + 4] = rw_ip.to_bytes(4, "big")
+            h[l3 + 10:l3 + 12] = ip_csum.to_bytes(2, "big")
+            if l4_csum_v:
+                h[l4_csum_off:l4_csum_off + 2] = csum_upd(l4_csum, old, rw_ip).to_bytes(2, "big")
+        return bytes(h[:min(len(frame), HDR_BYTES)]) + frame[HDR_BYTES:], tuser
+
+
+def check_csums(frame):
+    """checks the IPv4 header and TCP/UDP checksums of a complete frame, returns an error or None"""
+    l3 = 14
+    eth_type = struct.unpack(">H", frame[12:14])[0]
+    if eth_type == 0x8100:
+        l3 = 18
+        eth_type = struct.unpack(">H", frame[16:18])[0]
+    if eth_type != 0x0800 or frame[l3] >> 4 != 4:
+        return None
+    ihl = (frame[l3] & 0xF) * 4
+    total = struct.unpack(">H", frame[l3 + 2:l3 + 4])[0]
+    if csum(frame[l3:l3 + ihl]) != 0:
+        return "ipv4 header checksum"
+    proto = frame[l3 + 9]
+    frag = struct.unpack(">H", frame[l3 + 6:l3 + 8])[0] & 0x3FFF
+    if proto not in (6, 17) or frag != 0:
+        return None
+    l4 = frame[l3 + ihl:l3 + total]
+    if proto == 17 and l4[6:8] == b"\0\0":
+        return None
+    pseudo = frame[l3 + 12:l3 + 20] + struct.pack(">HH", proto, len(l4))
+    if csum(pseudo + l4) != 0:
+        return "tcp/udp checksum"
+    return None
+
+
+#################################################### frame generation
+
+def eth(payload, eth_type, vid=None, dst="02:00:00:00:00:02", src="02:00:00:00:00:03"):
+    h = bytes.fromhex(dst.replace(":", "")) + bytes.fromhex(src.replace(":", ""))
+    if vid is not None:
+        h += struct.pack(">HH", 0x8100, vid)
+    f = h + struct.pack(">H", eth_type) + payload
+    return f.ljust(60, b"\0")
+
+
+def ipv4(src, dst, proto, l4, ihl=5, frag=0):
+    opts = bytes([1] * (ihl * 4 - 20))  # NOP options
+    h = struct.pack(">BBHHHBBH4s4s", 0x40 | ihl, 0, ihl * 4 + len(l4), 0x1234, frag, 64, proto, 0,
+                    ip(src).to_bytes(4, "big"), ip(dst).to_bytes(4, "big")) + opts
+    h = h[:10] + struct.pack(">H", csum(h)) + h[12:]
+    return h + l4
+
+
+def l4_csum(src, dst, proto, seg):
+    return csum(ip(src).to_bytes(4, "big") + ip(dst).to_bytes(4, "big") + struct.pack(">HH", proto, len(seg)) + seg)
+
+
+def tcp(src, dst, sport, dport, payload=b"", ihl=5, vid=None, frag=0):
+    seg = struct.pack(">HHIIHHHH", sport, dport, 1, 0, 0x5010, 1024, 0, 0) + payload
+    if not frag:
+        seg = seg[:16] + struct.pack(">H", l4_csum(src, dst, 6, seg)) + seg[18:]
+    return eth(ipv4(src, dst, 6, seg, ihl, frag), 0x0800, vid)
+
+
+def udp(src, dst, sport, dport, payload=b"", ihl=5, vid=None, use_csum=True):
+    seg = struct.pack(">HHHH", sport, dport, 8 + len(payload), 0) + payload
+    if use_csum:
+        c = l4_csum(src, dst, 17, seg) or 0xFFFF
+        seg = seg[:6] + struct.pack(">H", c) + seg[8:]
+    return eth(ipv4(src, dst, 17, seg, ihl), 0x0800, vid)
+
+
+def udp6(payload=b""):
+    src = bytes.fromhex("20010db8000000000000000000000001")
+    dst = bytes.fromhex("20010db8000000000000000000000002")
+    seg = struct.pack(">HHHH", 1000, 2000, 8 + len(payload), 0) + payload
+    c = csum(src + dst + struct.pack(">IxxxB", len(seg), 17) + seg) or 0xFFFF
+    seg = seg[:6] + struct.pack(">H", c) + seg[8:]
+    h = struct.pack(">IHBB", 0x60000000, len(seg), 17, 64) + src + dst
+    return eth(h + seg, 0x86DD)
+
+
+def gen_frames():
+    rnd = random.Random(1)
+
+    def data(n):
+        return bytes(rnd.getrandbits(8) for _ in range(n))
+
+    f = [
+        tcp("10.0.0.1", "10.0.0.2", 1234, 80),                            # exact match, destination rewrite
+        tcp("10.0.0.1", "10.0.0.2", 1234, 80, data(400)),                 # same, longer than the header
+        tcp("10.0.0.1", "10.0.0.2", 1234, 80, ihl=8),                     # options, checksum at byte 62
+        tcp("10.0.0.1", "10.0.0.2", 1234, 80, data(40), ihl=10),          # checksum behind the header, skipped
+        udp("10.0.0.3", "10.0.0.4", 5000, 53, data(10)),                  # source rewrite with udp checksum
+        udp("10.0.0.3", "10.0.0.4", 5000, 53, data(10), use_csum=False),  # udp checksum 0 stays 0
+        tcp("10.0.0.7", "10.0.0.8", 99, 22),                              # exact match drop
+        tcp("10.0.0.7", "10.0.0.8", 99, 22, data(200)),
+        eth(ipv4("10.0.0.1", "10.0.0.66", 1, data(20)), 0x0800),          # ternary drop
+        eth(ipv4("10.0.0.1", "10.0.0.66", 1, data(1000)), 0x0800),
+        udp("10.0.0.1", "10.0.0.20", 7, 9, data(30)),                     # ternary drop by port
+        tcp("10.0.0.1", "10.0.0.30", 1, 2, data(20), vid=100),            # MAC rewrite and queue
+        udp("10.0.0.1", "10.0.0.5", 1, 2, data(20), vid=200),             # ternary destination rewrite behind a VLAN tag
+        tcp("10.0.0.1", "10.0.0.5", 1, 2, ihl=7, vid=200),                # checksum at byte 62
+        tcp("10.0.0.1", "10.0.0.5", 1, 2, ihl=8, vid=200),                # checksum at byte 66, skipped
+        tcp("10.0.0.1", "10.0.0.5", 1, 2, data(100), ihl=15),             # ports behind the header, skipped
+        tcp("10.0.0.1", "10.0.0.5", 1, 2, data(40), frag=100),            # non-first fragment, no tcp header
+        udp6(data(100)),                                                  # queue
+        eth(data(28), 0x0806),                                            # default action
+        udp("10.0.0.9", "10.0.0.40", 1, 2, data(2)),                      # MAC source rewrite
+        udp("10.0.0.1", "10.0.0.5", 1, 2, data(1400)),
+    ]
+    # random traffic around the header size
+    dsts = ["10.0.0.5", "10.0.0.66", "10.0.0.50", "10.0.0.2"]
+    for i in range(300):
+        d = rnd.choice(dsts)
+        n = rnd.randrange(18, 120)
+        if rnd.getrandbits(1):
+            f.append(udp("10.0.0.1", d, rnd.randrange(1, 100), rnd.randrange(1, 100), data(n), ihl=rnd.choice([5, 5, 6, 9])))
+        else:
+            f.append(tcp("10.0.0.1", d, 1234, 80, data(n), ihl=rnd.choice([5, 5, 7, 11])))
+    for i in range(60, 70):
+        f.append(eth(data(i - 14), 0x88B5))                               # lengths around the header
+    return f
+
+
+#################################################### pcap
+
+def read_pcap(path):
+    with open(path, "rb") as fp:
+        d = fp.read()
+    magic = d[:4]
+    if magic in (b"\xd4\xc3\xb2\xa1", b"\x4d\x3c\xb2\xa1"):
+        e = "<"
+    elif magic in (b"\xa1\xb2\xc3\xd4", b"\xa1\xb2\x3c\x4d"):
+        e = ">"
+    else:
+        sys.exit("%s: not a pcap file (pcapng is not supported)" % path)
+    if struct.unpack(e + "I", d[20:24])[0] != 1:
+        sys.exit("%s: link type is not ethernet" % path)
+    frames, pos = [], 24
+    while pos + 16 <= len(d):
+        incl, orig = struct.unpack(e + "II", d[pos + 8:pos + 16])
+        if incl != orig:
+            sys.exit("%s: frame %d is truncated" % (path, len(frames)))
+        frames.append(d[pos + 16:pos + 16 + incl])
+        pos += 16 + incl
+    return frames
+
+
+def write_pcap(path, frames):
+    with open(path, "wb") as fp:
+        fp.write(struct.pack("<IHHiIII", 0xA1B2C3D4, 2, 4, 0, 0, 65535, 1))
+        for i, f in enumerate(frames):
+            fp.write(struct.pack("<IIII", i, 0, len(f), len(f)) + f)
+
+
+def write_frames(path, frames):
+    with open(path, "w") as fp:
+        for f, tuser in frames:
+            fp.write("%02x\n%02x\n%02x\n" % (len(f) >> 8, len(f) & 0xFF, tuser))
+            fp.write("".join("%02x\n" % b for b in f))
+        fp.write("00\n00\n")
+
+
+def write_rules(path):
+    w = []
+    for key, a, m, i in EM:
+        w += [(0, R_KEY + n, key >> (n * 32) & 0xFFFFFFFF) for n in range(10)]
+        w += [(0, R_ACT, a), (0, R_MAC, m & 0xFFFFFFFF), (0, R_MAC + 1, m >> 32), (0, R_IP, i), (1, R_CMD, CMD_VALID)]
+    for ix, (key, mask, a, m, i) in enumerate(TC):
+        w += [(0, R_KEY + n, key >> (n * 32) & 0xFFFFFFFF) for n in range(10)]
+        w += [(0, R_MASK + n, mask >> (n * 32) & 0xFFFFFFFF) for n in range(10)]
+        w += [(0, R_ACT, a), (0, R_MAC, m & 0xFFFFFFFF), (0, R_MAC + 1, m >> 32), (0, R_IP, i), (0, R_CMD, CMD_TERNARY | CMD_VALID | ix)]
+    w += [(0, R_PARSER, PARSE_CFG), (0, R_DEFAULT, DEFAULT_ACT), (255, 0, 0)]
+    with open(path, "w") as fp:
+        fp.write("".join("%02x%02x%08x\n" % r for r in w))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="test vectors of tb_match_action")
+    ap.add_argument("-o", "--outdir", default="build")
+    ap.add_argument("pcap", nargs="?")
+    args = ap.parse_args()
+    os.makedirs(args.outdir, exist_ok=True)
+
+    if args.pcap:
+        frames = read_pcap(args.pcap)
+    else:
+        frames = gen_frames()
+        write_pcap(os.path.join(args.outdir, "match_action.pcap"), frames)
+
+    model = Model()
+    expect = []
+    for n, f in enumerate(frames):
+        if len(f) < 14 or len(f) > 0xFFFF:
+            sys.exit("frame %d: length %d is not supported" % (n, len(f)))
+        out, tuser = model.process(f)
+        if out is None:
+            continue
+        # the generated frames are valid, so the model has to keep the checksums valid
+        err = None if args.pcap or check_csums(f) else check_csums(out)
+        if err:
+            sys.exit("frame %d: %s of the expected frame is wrong" % (n, err))
+        expect.append((out, tuser))
+
+    write_frames(os.path.join(args.outdir, "ma_frames.hex"), [(f, 0) for f in frames])
+    write_frames(os.path.join(args.outdir, "ma_expect.hex"), expect)
+    write_rules(os.path.join(args.outdir, "ma_rules.hex"))
+    with open(os.path.join(args.outdir, "ma_counts.hex"), "w") as fp:
+        fp.write("".join("%08x\n" % c for c in model.counts))
+    print("%d frames, %d forwarded, drops %d, misses %d, exact hits %d, ternary hits %d, skipped rewrites %d"
+          % ((len(frames), len(expect)) + tuple(model.counts)))
+
+
+if __name__ == "__main__":
+    main()
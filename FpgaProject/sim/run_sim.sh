@@ -0,0 +1,84 @@
+#!/bin/bash
+# runs the testbenches of the hdl modules with icarus verilog (iverilog 12 or newer)
+# ./run_sim.sh [testbench ...]    without arguments all testbenches are run
+# MA_PCAP=/path/frames.pcap ./run_sim.sh tb_match_action    match_action with the frames of a pcap file (absolute path)
+cd "$(dirname "$0")"
+mkdir -p build
+
+failed=0
+
+# sim <testbench> <sources> [iverilog options, e.g. -P<testbench>.<parameter>=<value>]
+sim() {
+	local tb=$1 src=$2
+	shift 2
+	echo "== $tb $*"
+	if ! iverilog -g2012 -Wall -I../hdl -s $tb -o build/$tb.vvp "$@" $src; then
+		failed=1
+		return
+	fi
+	vvp -n build/$tb.vvp | tee build/$tb.log
+	grep -q "^PASS" build/$tb.log || failed=1
+}
+
+tests=${@:-tb_rx_desc_ctrl tb_tx_desc_ctrl tb_rx_desc_snoop tb_packet_handlers tb_match_action tb_latency_monitor tb_ddr_buffer}
+
+for t in $tests; do
+	case $t in
+	tb_rx_desc_ctrl)
+		sim tb_rx_desc_ctrl "tb_rx_desc_ctrl.v ../hdl/rx_desc_ctrl.v"
+		sim tb_rx_desc_ctrl "tb_rx_desc_ctrl.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_ctrl.SNOOP=1
+		sim tb_rx_desc_ctrl "tb_rx_desc_ctrl.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_ctrl.DATA_WIDTH=128
+		# buffers returned with buf_free_i after their transmission instead of the ack
+		sim tb_rx_desc_ctrl "tb_rx_desc_ctrl.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_ctrl.HAIRPIN=1
+		sim tb_rx_desc_ctrl "tb_rx_desc_ctrl.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_ctrl.HAIRPIN=1 -Ptb_rx_desc_ctrl.SNOOP=1 -Ptb_rx_desc_ctrl.DATA_WIDTH=128 -Ptb_rx_desc_ctrl.FREE_LAT=200
+		;;
+	tb_tx_desc_ctrl)
+		sim tb_tx_desc_ctrl "tb_tx_desc_ctrl.v ../hdl/tx_desc_ctrl.v"
+		# small ring and a slow NIC, the ring runs full
+		sim tb_tx_desc_ctrl "tb_tx_desc_ctrl.v ../hdl/tx_desc_ctrl.v" -Ptb_tx_desc_ctrl.NB_DESC=16 -Ptb_tx_desc_ctrl.SEND_GAP=40 -Ptb_tx_desc_ctrl.REQ_PCT=100
+		sim tb_tx_desc_ctrl "tb_tx_desc_ctrl.v ../hdl/tx_desc_ctrl.v" -Ptb_tx_desc_ctrl.WB_PCT=2 -Ptb_tx_desc_ctrl.SEED=2
+		;;
+	tb_rx_desc_snoop)
+		sim tb_rx_desc_snoop "tb_rx_desc_snoop.v ../hdl/rx_desc_snoop.v ../hdl/rx_desc_ctrl.v"
+		sim tb_rx_desc_snoop "tb_rx_desc_snoop.v ../hdl/rx_desc_snoop.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_snoop.WB_DESC=4
+		# write addresses far ahead of their data, rx_desc_snoop has to hold back awready
+		sim tb_rx_desc_snoop "tb_rx_desc_snoop.v ../hdl/rx_desc_snoop.v ../hdl/rx_desc_ctrl.v" -Ptb_rx_desc_snoop.FRAME_GAP=2 -Ptb_rx_desc_snoop.W_DELAY=40
+		;;
+	tb_packet_handlers)
+		ph="tb_packet_handlers.v ../hdl/rx_packet_handler.v ../hdl/tx_packet_handler.v"
+		sim tb_packet_handlers "$ph"
+		sim tb_packet_handlers "$ph" -Ptb_packet_handlers.DATA_WIDTH=128 -Ptb_packet_handlers.AXIS_WIDTH=64
+		sim tb_packet_handlers "$ph" -Ptb_packet_handlers.DATA_WIDTH=128 -Ptb_packet_handlers.AXIS_WIDTH=128
+		sim tb_packet_handlers "$ph" -Ptb_packet_handlers.DATA_WIDTH=512 -Ptb_packet_handlers.AXIS_WIDTH=512 -Ptb_packet_handlers.SEED=2
+		sim tb_packet_handlers "$ph" -Ptb_packet_handlers.READY_PCT=100 -Ptb_packet_handlers.BUF_SIZE=1024 -Ptb_packet_handlers.MAX_LEN=3000
+		;;
+	tb_match_action)
+		if ! python3 match_action_pcap.py -o build $MA_PCAP; then
+			failed=1
+			continue
+		fi
+		sim tb_match_action "tb_match_action.v ../hdl/match_action.v"
+		sim tb_match_action "tb_match_action.v ../hdl/match_action.v" -Ptb_match_action.AXIS_WIDTH=256
+		sim tb_match_action "tb_match_action.v ../hdl/match_action.v" -Ptb_match_action.AXIS_WIDTH=512 -Ptb_match_action.READY_PCT=50
+		;;
+	tb_latency_monitor)
+		sim tb_latency_monitor "tb_latency_monitor.v ../hdl/latency_monitor.v"
+		sim tb_latency_monitor "tb_latency_monitor.v ../hdl/latency_monitor.v" -Ptb_latency_monitor.AXIS_WIDTH=256 -Ptb_latency_monitor.SEED=2
+		# without stamping the doorbells are matched in order, no frame may be dropped
+		sim tb_latency_monitor "tb_latency_monitor.v ../hdl/latency_monitor.v" -Ptb_latency_monitor.STAMP=0 -Ptb_latency_monitor.DROP_PCT=0
+		;;
+	tb_ddr_buffer)
+		sim tb_ddr_buffer "tb_ddr_buffer.v ../hdl/ddr_buffer.v"
+		# enough header entries that the ring bytes run out first, long read latency
+		sim tb_ddr_buffer "tb_ddr_buffer.v ../hdl/ddr_buffer.v" -Ptb_ddr_buffer.HDR_DEPTH=1024 -Ptb_ddr_buffer.RD_LAT=100
+		sim tb_ddr_buffer "tb_ddr_buffer.v ../hdl/ddr_buffer.v" -Ptb_ddr_buffer.AXIS_WIDTH=256 -Ptb_ddr_buffer.SEED=2
+		sim tb_ddr_buffer "tb_ddr_buffer.v ../hdl/ddr_buffer.v" -Ptb_ddr_buffer.AXIS_WIDTH=512 -Ptb_ddr_buffer.AXI_PCT=50 -Ptb_ddr_buffer.VALID_PCT=30
+		;;
+	*)
+		echo "unknown testbench $t"
+		failed=1
+		;;
+	esac
+done
+
+exit $failed
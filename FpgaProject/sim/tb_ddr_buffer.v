@@ -0,0 +1,420 @@
+/*
+Testbench of ddr_buffer with a model of the DDR4 behind the smartconnect.
+N_FRAMES frames of random length (60 byte up to MAX_LEN, half of them below 200 byte), content and tuser are streamed in
+with random gaps (VALID_PCT percent valid). The output ready is held low for STALL_LEN of every STALL_PERIOD cycles and
+random (READY_PCT percent high) otherwise, so the frames are passed through, spilled into the ring until it is full and
+drained again, several times around the ring.
+The memory model accepts address and data with random ready (AXI_PCT percent high), writes the bursts in order, sends the
+write response afterwards and returns read data RD_LAT cycles after the read address with random gaps. It checks
+that no burst crosses a 4KB boundary or leaves the ring, wlast, that no beat is overwritten before it is read and that
+every beat read back has been written and its write response given, and is read only once.
+The output is checked beat by beat: content of the kept bytes, tkeep filled from the low lane, tlast at the end of each
+frame, tuser and that it is held while not ready. At the end frames have to be bypassed and spilled, the input has to
+have waited for a full ring and the ring has to have wrapped.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_ddr_buffer #(
+	parameter AXIS_WIDTH = 64,
+	parameter RING_SHIFT = 16, //64KB ring
+	parameter HDR_DEPTH = 64,
+	parameter N_FRAMES = 2000,
+	parameter MAX_LEN = 2048, //also MAX_FRAME of ddr_buffer
+	parameter VALID_PCT = 50,
+	parameter READY_PCT = 90,
+	parameter STALL_PERIOD = 50000,
+	parameter STALL_LEN = 20000,
+	parameter AXI_PCT = 90,
+	parameter RD_LAT = 20,
+	parameter SEED = 1
+)();
+
+localparam BEAT_BYTES = AXIS_WIDTH/8;
+localparam RING_BASE  = 32'h0010_0000;
+localparam RING_BYTES = 1 << RING_SHIFT;
+localparam RING_BEATS = RING_BYTES/BEAT_BYTES;
+localparam EXP_SIZE   = 1 << 18; //bytes of the expected byte stream in flight
+localparam FRAMES     = 1024; //frames in flight
+localparam Q_SIZE     = 64; //bursts in the queues of the memory model
+localparam WF_SIZE    = 1024; //beats in the write data queue of the memory model
+
+reg clk = 1'b0;
+always #2 clk = ~clk;
+
+reg rst_n = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+// expected byte stream of all frames, the end and tuser of each frame in it
+reg[7:0] exp_mem[0:EXP_SIZE-1];
+integer  frame_end[0:FRAMES-1];
+reg[7:0] frame_tuser[0:FRAMES-1];
+integer  wr_pos = 0;
+integer  rx_pos = 0;
+integer  rx_frame = 0;
+integer  errors = 0;
+
+reg[AXIS_WIDTH-1:0]    s_tdata;
+reg[7:0]               s_tuser;
+reg                    s_tlast;
+reg[BEAT_BYTES-1:0]    s_tkeep;
+reg                    s_tvalid = 1'b0;
+wire                   s_tready;
+wire[AXIS_WIDTH-1:0]   m_tdata;
+wire[7:0]              m_tuser;
+wire                   m_tlast;
+wire[BEAT_BYTES-1:0]   m_tkeep;
+wire                   m_tvalid;
+reg                    m_tready = 1'b0;
+
+wire[33:0]             awaddr;
+wire[7:0]              awlen;
+wire                   awvalid;
+reg                    awready = 1'b0;
+wire[AXIS_WIDTH-1:0]   wdata;
+wire                   wlast;
+wire                   wvalid;
+reg                    wready = 1'b0;
+reg                    bvalid = 1'b0;
+wire                   bready;
+wire[33:0]             araddr;
+wire[7:0]              arlen;
+wire                   arvalid;
+reg                    arready = 1'b0;
+reg[AXIS_WIDTH-1:0]    rdata;
+reg                    rlast = 1'b0;
+reg                    rvalid = 1'b0;
+wire                   rready;
+
+ddr_buffer #(
+	.AXIS_WIDTH(AXIS_WIDTH),
+	.RING_BASE(RING_BASE),
+	.RING_SHIFT(RING_SHIFT),
+	.HDR_DEPTH(HDR_DEPTH),
+	.MAX_FRAME(MAX_LEN)
+) dut (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.s_axis_eth_tdata(s_tdata),
+	.s_axis_eth_tuser(s_tuser),
+	.s_axis_eth_tlast(s_tlast),
+	.s_axis_eth_tkeep(s_tkeep),
+	.s_axis_eth_tvalid(s_tvalid),
+	.s_axis_eth_tready(s_tready),
+	.m_axis_eth_tdata(m_tdata),
+	.m_axis_eth_tuser(m_tuser),
+	.m_axis_eth_tlast(m_tlast),
+	.m_axis_eth_tkeep(m_tkeep),
+	.m_axis_eth_tvalid(m_tvalid),
+	.m_axis_eth_tready(m_tready),
+	.m_axi_awid(),
+	.m_axi_awaddr(awaddr),
+	.m_axi_awlen(awlen),
+	.m_axi_awsize(),
+	.m_axi_awburst(),
+	.m_axi_awvalid(awvalid),
+	.m_axi_awready(awready),
+	.m_axi_wdata(wdata),
+	.m_axi_wstrb(),
+	.m_axi_wlast(wlast),
+	.m_axi_wvalid(wvalid),
+	.m_axi_wready(wready),
+	.m_axi_bid(1'b0),
+	.m_axi_bresp(2'b00),
+	.m_axi_bvalid(bvalid),
+	.m_axi_bready(bready),
+	.m_axi_arid(),
+	.m_axi_araddr(araddr),
+	.m_axi_arlen(arlen),
+	.m_axi_arsize(),
+	.m_axi_arburst(),
+	.m_axi_arvalid(arvalid),
+	.m_axi_arready(arready),
+	.m_axi_rid(1'b0),
+	.m_axi_rdata(rdata),
+	.m_axi_rresp(2'b00),
+	.m_axi_rlast(rlast),
+	.m_axi_rvalid(rvalid),
+	.m_axi_rready(rready)
+);
+
+	//DDR4 model
+reg[AXIS_WIDTH-1:0] mem[0:RING_BEATS-1];
+reg                 mem_ok[0:RING_BEATS-1]; //written and its write response given, not read since
+integer aw_ix[0:Q_SIZE-1];
+integer aw_len[0:Q_SIZE-1];
+integer b_ix[0:Q_SIZE-1];
+integer b_len[0:Q_SIZE-1];
+integer ar_ix[0:Q_SIZE-1];
+integer ar_len[0:Q_SIZE-1];
+integer ar_t[0:Q_SIZE-1];
+reg[AXIS_WIDTH-1:0] wf_data[0:WF_SIZE-1];
+reg                 wf_last[0:WF_SIZE-1];
+integer aw_in = 0, aw_out = 0, b_in = 0, b_out = 0, ar_in = 0, ar_out = 0, wf_in = 0, wf_out = 0;
+integer w_beat = 0;
+integer r_beat = 0;
+integer ix, m;
+
+// beat index of a burst in the ring, -1 if it is not aligned, crosses 4KB or leaves the ring
+function integer burst_ix(input [33:0] addr, input [7:0] len);
+	begin
+		burst_ix = (addr - RING_BASE) / BEAT_BYTES;
+		if(addr < RING_BASE || addr + (len + 1) * BEAT_BYTES > RING_BASE + RING_BYTES || addr % BEAT_BYTES != 0 ||
+		   addr % 4096 + (len + 1) * BEAT_BYTES > 4096)
+			burst_ix = -1;
+	end
+endfunction
+
+always @(posedge clk) begin
+	if(~rst_n) begin
+		awready <= 1'b0;
+		wready  <= 1'b0;
+		arready <= 1'b0;
+		bvalid  <= 1'b0;
+		rvalid  <= 1'b0;
+	end
+	else begin
+		awready <= rand_int(100) < AXI_PCT;
+		wready  <= rand_int(100) < AXI_PCT;
+		arready <= rand_int(100) < AXI_PCT;
+
+		if(awvalid & awready) begin
+			aw_ix[aw_in % Q_SIZE]  = burst_ix(awaddr, awlen);
+			aw_len[aw_in % Q_SIZE] = awlen;
+			if(aw_ix[aw_in % Q_SIZE] < 0) begin
+				if(errors < 10)
+					$display("write burst 0x%h len %0d is not aligned, crosses 4KB or leaves the ring", awaddr, awlen);
+				errors = errors + 1;
+				aw_ix[aw_in % Q_SIZE] = 0;
+			end
+			aw_in = aw_in + 1;
+		end
+		if(wvalid & wready) begin
+			wf_data[wf_in % WF_SIZE] = wdata;
+			wf_last[wf_in % WF_SIZE] = wlast;
+			wf_in = wf_in + 1;
+		end
+
+		// one beat per cycle into the memory, in the order of the write addresses
+		if(aw_in != aw_out && wf_in != wf_out) begin
+			ix = (aw_ix[aw_out % Q_SIZE] + w_beat) % RING_BEATS;
+			if(mem_ok[ix] === 1'b1) begin
+				if(errors < 10)
+					$display("write burst %0d: beat at 0x%h is overwritten before it is read", aw_out, RING_BASE + ix * BEAT_BYTES);
+				errors = errors + 1;
+			end
+			mem[ix]    = wf_data[wf_out % WF_SIZE];
+			mem_ok[ix] = 1'b0;
+			if(wf_last[wf_out % WF_SIZE] !== (w_beat == aw_len[aw_out % Q_SIZE])) begin
+				if(errors < 10)
+					$display("write burst %0d: wlast %b at beat %0d of %0d", aw_out, wf_last[wf_out % WF_SIZE], w_beat, aw_len[aw_out % Q_SIZE] + 1);
+				errors = errors + 1;
+			end
+			wf_out = wf_out + 1;
+			w_beat = w_beat + 1;
+			if(w_beat > aw_len[aw_out % Q_SIZE]) begin
+				b_ix[b_in % Q_SIZE]  = aw_ix[aw_out % Q_SIZE];
+				b_len[b_in % Q_SIZE] = aw_len[aw_out % Q_SIZE];
+				b_in   = b_in + 1;
+				aw_out = aw_out + 1;
+				w_beat = 0;
+			end
+		end
+
+		// write response once the burst is in the memory
+		if(bvalid & bready) begin
+			for(m = 0; m <= b_len[b_out % Q_SIZE]; m = m + 1)
+				mem_ok[(b_ix[b_out % Q_SIZE] + m) % RING_BEATS] = 1'b1;
+			b_out = b_out + 1;
+		end
+		if(~bvalid | bready)
+			bvalid <= b_in != b_out && rand_int(100) < AXI_PCT;
+
+		if(arvalid & arready) begin
+			ar_ix[ar_in % Q_SIZE]  = burst_ix(araddr, arlen);
+			ar_len[ar_in % Q_SIZE] = arlen;
+			ar_t[ar_in % Q_SIZE]   = cycle;
+			if(ar_ix[ar_in % Q_SIZE] < 0) begin
+				if(errors < 10)
+					$display("read burst 0x%h len %0d is not aligned, crosses 4KB or leaves the ring", araddr, arlen);
+				errors = errors + 1;
+				ar_ix[ar_in % Q_SIZE] = 0;
+			end
+			ar_in = ar_in + 1;
+		end
+
+		// read data RD_LAT cycles after the address, held until ready
+		if(rvalid & rready) begin
+			r_beat = r_beat + 1;
+			if(rlast) begin
+				r_beat = 0;
+				ar_out = ar_out + 1;
+			end
+		end
+		if(~rvalid | rready) begin
+			if(ar_in != ar_out && cycle - ar_t[ar_out % Q_SIZE] >= RD_LAT && rand_int(100) < AXI_PCT) begin
+				ix = (ar_ix[ar_out % Q_SIZE] + r_beat) % RING_BEATS;
+				if(mem_ok[ix] !== 1'b1) begin
+					if(errors < 10)
+						$display("read burst %0d: beat at 0x%h is read before its write response or twice", ar_out, RING_BASE + ix * BEAT_BYTES);
+					errors = errors + 1;
+				end
+				mem_ok[ix] = 1'b0;
+				rdata  <= mem[ix];
+				rlast  <= r_beat == ar_len[ar_out % Q_SIZE];
+				rvalid <= 1'b1;
+			end else begin
+				rvalid <= 1'b0;
+			end
+		end
+	end
+end
+
+	//output ready: stalled for STALL_LEN cycles of each STALL_PERIOD, random otherwise
+always @(posedge clk)
+	m_tready <= cycle % STALL_PERIOD < STALL_PERIOD - STALL_LEN && rand_int(100) < READY_PCT;
+
+	//output stream: content, tkeep from the low lane, tlast, tuser and held while not ready
+reg                  out_stall = 1'b0;
+reg[AXIS_WIDTH+BEAT_BYTES+8:0] out_q;
+integer b;
+integer n_keep;
+always @(posedge clk) begin
+	if(rst_n & out_stall & (~m_tvalid | {m_tdata, m_tkeep, m_tlast, m_tuser} !== out_q)) begin
+		if(errors < 10)
+			$display("frame %0d: output changed while not ready", rx_frame);
+		errors = errors + 1;
+	end
+	out_stall <= m_tvalid & ~m_tready;
+	out_q     <= {m_tdata, m_tkeep, m_tlast, m_tuser};
+
+	if(rst_n & m_tvalid & m_tready) begin
+		n_keep = 0;
+		for(b = 0; b < BEAT_BYTES; b = b + 1)
+			if(m_tkeep[b]) begin
+				if(m_tdata[b*8 +: 8] !== exp_mem[(rx_pos + n_keep) % EXP_SIZE]) begin
+					if(errors < 10)
+						$display("frame %0d: stream byte %0d is 0x%h, expected 0x%h", rx_frame, rx_pos + n_keep, m_tdata[b*8 +: 8], exp_mem[(rx_pos + n_keep) % EXP_SIZE]);
+					errors = errors + 1;
+				end
+				n_keep = n_keep + 1;
+			end
+		if(n_keep == 0 || m_tkeep !== ~({BEAT_BYTES{1'b1}} << n_keep)) begin
+			if(errors < 10)
+				$display("frame %0d: tkeep %b is not filled from the low lane", rx_frame, m_tkeep);
+			errors = errors + 1;
+		end
+		if(m_tuser !== frame_tuser[rx_frame % FRAMES]) begin
+			if(errors < 10)
+				$display("frame %0d: tuser 0x%h, expected 0x%h", rx_frame, m_tuser, frame_tuser[rx_frame % FRAMES]);
+			errors = errors + 1;
+		end
+		rx_pos = rx_pos + n_keep;
+		if(m_tlast !== (rx_pos == frame_end[rx_frame % FRAMES])) begin
+			if(errors < 10)
+				$display("frame %0d: tlast %b at byte %0d, the frame ends at %0d", rx_frame, m_tlast, rx_pos, frame_end[rx_frame % FRAMES]);
+			errors = errors + 1;
+		end
+		if(rx_pos >= frame_end[rx_frame % FRAMES])
+			rx_frame = rx_frame + 1;
+	end
+end
+
+	//what ddr_buffer did with the input frames
+integer n_bypass = 0;
+integer n_spill = 0;
+integer spill_bytes = 0;
+integer full_cycles = 0;
+always @(posedge clk) begin
+	if(rst_n & s_tvalid & s_tready & s_tlast) begin
+		if(dut.in_state == 1)
+			n_bypass = n_bypass + 1;
+		else
+			n_spill = n_spill + 1;
+	end
+	if(rst_n & s_tvalid & s_tready & dut.in_state == 2)
+		spill_bytes = spill_bytes + BEAT_BYTES;
+	if(rst_n & s_tvalid & dut.in_state == 0 & ~(dut.ring_empty & dut.m_ready_q) & ~dut.ring_space)
+		full_cycles = full_cycles + 1;
+end
+
+	//input frames
+integer n;
+integer len;
+integer off;
+integer k;
+integer last_frame;
+integer t_progress;
+reg[AXIS_WIDTH-1:0] beat_data;
+reg[BEAT_BYTES-1:0] beat_keep;
+initial begin
+	for(k = 0; k < RING_BEATS; k = k + 1)
+		mem_ok[k] = 1'b0;
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	repeat(10) @(posedge clk);
+	for(n = 0; n < N_FRAMES; n = n + 1) begin
+		if(rand_int(2))
+			len = 60 + rand_int(140);
+		else
+			len = 60 + rand_int(MAX_LEN - 59);
+		while(wr_pos + len - rx_pos > EXP_SIZE || n - rx_frame >= FRAMES)
+			@(posedge clk);
+		frame_end[n % FRAMES]   = wr_pos + len;
+		frame_tuser[n % FRAMES] = rand_int(256);
+		for(k = 0; k < len; k = k + 1)
+			exp_mem[(wr_pos + k) % EXP_SIZE] = rand_int(256);
+		for(off = 0; off < len; off = off + BEAT_BYTES) begin
+			while(rand_int(100) >= VALID_PCT)
+				@(posedge clk);
+			beat_data = 0;
+			beat_keep = 0;
+			for(k = 0; k < BEAT_BYTES && off + k < len; k = k + 1) begin
+				beat_data[k*8 +: 8] = exp_mem[(wr_pos + off + k) % EXP_SIZE];
+				beat_keep[k]        = 1'b1;
+			end
+			s_tdata  <= beat_data;
+			s_tkeep  <= beat_keep;
+			s_tlast  <= off + BEAT_BYTES >= len;
+			s_tuser  <= frame_tuser[n % FRAMES];
+			s_tvalid <= 1'b1;
+			@(posedge clk);
+			while(~s_tready)
+				@(posedge clk);
+			s_tvalid <= 1'b0;
+		end
+		wr_pos = wr_pos + len;
+		repeat(rand_int(4)) @(posedge clk);
+	end
+	last_frame = rx_frame;
+	t_progress = cycle;
+	while(rx_frame < N_FRAMES && cycle - t_progress < 4 * STALL_PERIOD) begin
+		@(posedge clk);
+		if(rx_frame != last_frame) begin
+			last_frame = rx_frame;
+			t_progress = cycle;
+		end
+	end
+	repeat(100) @(posedge clk);
+	if(dut.frames != 0 || aw_in != b_out || ar_in != ar_out) begin
+		$display("the ring is not empty: %0d frames, %0d write and %0d read bursts open", dut.frames, aw_in - b_out, ar_in - ar_out);
+		errors = errors + 1;
+	end
+
+	$display("tb_ddr_buffer AXIS_WIDTH %0d: %0d of %0d frames out, %0d bypassed, %0d spilled with %0d byte (ring %0d byte), %0d cycles waited for the ring, %0d errors",
+	         AXIS_WIDTH, rx_frame, N_FRAMES, n_bypass, n_spill, spill_bytes, RING_BYTES, full_cycles, errors);
+	if(rx_frame != N_FRAMES || errors != 0 || n_bypass == 0 || n_spill == 0 || full_cycles == 0 || spill_bytes <= RING_BYTES)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
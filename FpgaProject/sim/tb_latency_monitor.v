@@ -0,0 +1,425 @@
+/*
+Testbench of latency_monitor with a network function model between the rx and the tx stream.
+Frames of random length (one buffer each) come with a random rx timestamp, every fourth one is stale by up to 2^31 cycles so
+all stamp bytes and the upper histogram buckets are used. The network function drops DROP_PCT percent of the frames (with STAMP
+only, without stamping the doorbells are matched in order) and sends the others on the tx stream, the tx doorbell of a frame
+follows its last beat after a random delay. Both streams see random back-pressure.
+The stamp offset changes between the phases so that the 4 stamp bytes straddle a beat boundary at AXIS_WIDTH, every byte of the
+stamped rx stream is checked. Each doorbell is matched with the frame it belongs to and the measured residence times are compared
+with the ones expected from the frames (count, min, max, sum and histogram).
+Also checked:
+	- N_PHANTOM doorbells with an empty timestamp queue count as unmatched
+	- with the doorbells held back, the N_LOST frames beyond TS_DEPTH are lost and their doorbells unmatched
+	- a min / max clear written in the cycle of a doorbell: its frame has to start the new min / max
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_latency_monitor #(
+	parameter AXIS_WIDTH = 64,
+	parameter TS_DEPTH = 16,
+	parameter STAMP = 1,
+	parameter N_FRAMES = 200, //per phase
+	parameter DROP_PCT = 25,
+	parameter SEED = 1
+)();
+
+localparam BEAT       = AXIS_WIDTH/8;
+localparam N_PHASES   = 6;
+localparam N_LOST     = 5;
+localparam N_PHANTOM  = 3;
+localparam MAX_FRAMES = N_PHASES * N_FRAMES + TS_DEPTH + N_LOST;
+
+reg clk = 1'b0;
+always #2 clk = ~clk;
+
+reg rst_n = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+wire[31:0]           ts;
+reg[31:0]            rx_pkt_ts = 0;
+reg                  rx_pkt_ack = 1'b0;
+reg                  tx_db_valid = 1'b0;
+
+reg[AXIS_WIDTH-1:0]  rx_tdata = 0;
+reg                  rx_tlast = 1'b0;
+reg                  rx_tvalid = 1'b0;
+wire                 rx_tready;
+wire[AXIS_WIDTH-1:0] nf_tdata;
+wire                 nf_tlast;
+wire                 nf_tvalid;
+reg                  nf_tready = 1'b0;
+reg[AXIS_WIDTH-1:0]  tx_tdata = 0;
+reg                  tx_tlast = 1'b0;
+reg                  tx_tvalid = 1'b0;
+reg                  tx_tready = 1'b0;
+
+reg                  wr = 1'b0;
+reg[5:0]             wr_addr = 0;
+reg[31:0]            wr_data = 0;
+reg[5:0]             rd_addr = 0;
+wire[5:0]            reg_addr = wr ? wr_addr : rd_addr;
+wire[31:0]           rd_data;
+
+latency_monitor #(
+	.AXIS_WIDTH(AXIS_WIDTH),
+	.TS_DEPTH(TS_DEPTH)
+) dut (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.init_i(1'b0),
+	.ts_o(ts),
+	.rx_pkt_ts_i(rx_pkt_ts),
+	.rx_pkt_eop_i(1'b1),
+	.rx_pkt_ack_i(rx_pkt_ack),
+	.tx_db_valid_i(tx_db_valid),
+	.tx_db_ready_i(1'b1),
+	.s_axis_eth_tdata(rx_tdata),
+	.s_axis_eth_tuser(8'h0),
+	.s_axis_eth_tlast(rx_tlast),
+	.s_axis_eth_tkeep({BEAT{1'b1}}),
+	.s_axis_eth_tvalid(rx_tvalid),
+	.s_axis_eth_tready(rx_tready),
+	.m_axis_eth_tdata(nf_tdata),
+	.m_axis_eth_tuser(),
+	.m_axis_eth_tlast(nf_tlast),
+	.m_axis_eth_tkeep(),
+	.m_axis_eth_tvalid(nf_tvalid),
+	.m_axis_eth_tready(nf_tready),
+	.tx_mon_tdata(tx_tdata),
+	.tx_mon_tlast(tx_tlast),
+	.tx_mon_tvalid(tx_tvalid),
+	.tx_mon_tready(tx_tready),
+	.wr_i(wr),
+	.addr_i(reg_addr),
+	.wr_data_i(wr_data),
+	.rd_data_o(rd_data)
+);
+
+reg[31:0] frame_ts[0:MAX_FRAMES-1];
+integer   frame_len[0:MAX_FRAMES-1];
+reg       frame_lost[0:MAX_FRAMES-1];
+integer   stamp_offs = 0;
+integer   errors = 0;
+
+	//byte at pos of frame f, with stamped the rx timestamp is at stamp_offs (big endian)
+function [7:0] frame_byte(input integer f, input integer pos, input integer stamped);
+	if(stamped != 0 && pos >= stamp_offs && pos < stamp_offs + 4)
+		frame_byte = frame_ts[f] >> (3 - (pos - stamp_offs))*8;
+	else
+		frame_byte = f*7 + pos;
+endfunction
+
+function [AXIS_WIDTH-1:0] frame_beat(input integer f, input integer pos, input integer stamped);
+	integer k;
+	for(k = 0; k < BEAT; k = k + 1)
+		frame_beat[k*8 +: 8] = frame_byte(f, pos + k, stamped);
+endfunction
+
+	//stamp offset of each phase: straddling the first and the second beat boundary, last bytes of the first beat, 0 and mid-beat
+function integer phase_offs(input integer p);
+	case(p)
+		0 : phase_offs = BEAT - 2;
+		1 : phase_offs = BEAT - 1;
+		2 : phase_offs = 2*BEAT - 3;
+		3 : phase_offs = BEAT - 4;
+		4 : phase_offs = 0;
+		default : phase_offs = BEAT + 1;
+	endcase
+endfunction
+
+integer n_rx = 0;      //frames received
+integer rx_target = 0; //frames to receive, raised per phase
+integer n_nf = 0;      //frames taken by the network function
+integer n_drop = 0;
+integer n_fw = 0;      //frames forwarded
+integer fw_id[0:MAX_FRAMES-1];
+integer n_tx = 0;      //forwarded frames sent on the tx stream
+integer n_db = 0;      //doorbells of forwarded frames
+integer hold_db = 0;   //no doorbells and no limit of the frames in flight
+integer no_drop = 0;
+
+	//rx buffers: one per frame, acknowledged after its last beat, at most TS_DEPTH-2 frames without doorbell in flight
+integer rx_pos;
+integer rx_ack_f;
+always @(posedge clk) begin
+	rx_pkt_ack <= 1'b0;
+	if(rx_tvalid & rx_tready) begin
+		if(rx_tlast) begin
+			rx_tvalid  <= 1'b0;
+			rx_pkt_ack <= 1'b1;
+			rx_ack_f   <= n_rx;
+			n_rx       <= n_rx + 1;
+		end else begin
+			rx_pos = rx_pos + BEAT;
+			rx_tdata <= frame_beat(n_rx, rx_pos, 0);
+			rx_tlast <= rx_pos + BEAT >= frame_len[n_rx];
+		end
+	end else if(rst_n && ~rx_tvalid && ~rx_pkt_ack && n_rx < rx_target && (n_rx - n_drop - n_db < TS_DEPTH - 2 || hold_db) &&
+	            rand_int(100) < 50) begin
+		frame_len[n_rx]  = 2*BEAT + 8 + rand_int(300);
+		frame_ts[n_rx]   = ts - (rand_int(4) == 0 ? rand_int(32'h7fff_ffff) : rand_int(1000));
+		frame_lost[n_rx] = 1'b0;
+		rx_pkt_ts <= frame_ts[n_rx];
+		rx_pos = 0;
+		rx_tdata  <= frame_beat(n_rx, 0, 0);
+		rx_tlast  <= BEAT >= frame_len[n_rx];
+		rx_tvalid <= 1'b1;
+	end
+end
+
+	//network function: checks the stamped rx stream, drops DROP_PCT percent of the frames with stamping and forwards the others
+integer nf_pos = 0;
+always @(posedge clk) begin
+	nf_tready <= rand_int(100) < 80;
+	if(nf_tvalid & nf_tready) begin
+		if(nf_tdata !== frame_beat(n_nf, nf_pos, STAMP) || nf_tlast !== (nf_pos + BEAT >= frame_len[n_nf])) begin
+			if(errors < 10)
+				$display("frame %0d byte %0d, stamp offset %0d: %h last %b, expected %h last %b", n_nf, nf_pos, stamp_offs,
+				         nf_tdata, nf_tlast, frame_beat(n_nf, nf_pos, STAMP), nf_pos + BEAT >= frame_len[n_nf]);
+			errors = errors + 1;
+		end
+		if(nf_tlast) begin
+			if(STAMP == 0 || no_drop || rand_int(100) >= DROP_PCT) begin
+				fw_id[n_fw] = n_nf;
+				n_fw <= n_fw + 1;
+			end else begin
+				n_drop <= n_drop + 1;
+			end
+			n_nf  <= n_nf + 1;
+			nf_pos = 0;
+		end else begin
+			nf_pos = nf_pos + BEAT;
+		end
+	end
+end
+
+	//tx stream of the forwarded frames, carrying their stamp
+integer tx_pos;
+always @(posedge clk) begin
+	tx_tready <= rand_int(100) < 80;
+	if(tx_tvalid & tx_tready) begin
+		if(tx_tlast) begin
+			tx_tvalid <= 1'b0;
+			n_tx      <= n_tx + 1;
+		end else begin
+			tx_pos = tx_pos + BEAT;
+			tx_tdata <= frame_beat(fw_id[n_tx], tx_pos, STAMP);
+			tx_tlast <= tx_pos + BEAT >= frame_len[fw_id[n_tx]];
+		end
+	end else if(~tx_tvalid && n_tx < n_fw && rand_int(100) < 50) begin
+		tx_pos = 0;
+		tx_tdata  <= frame_beat(fw_id[n_tx], 0, STAMP);
+		tx_tlast  <= BEAT >= frame_len[fw_id[n_tx]];
+		tx_tvalid <= 1'b1;
+	end
+end
+
+	//tx doorbells after the last beat of their frame and register writes; the race doorbell comes with a min / max clear
+reg       cfg_req = 1'b0;
+reg[5:0]  cfg_addr;
+reg[31:0] cfg_data;
+integer   n_phantom = 0; //doorbells without a frame still to send
+integer   race_db = -1;
+integer   db_pause = 0;
+integer   db_f;
+reg       db_phantom;
+reg       db_race = 1'b0;
+always @(posedge clk) begin
+	wr          <= 1'b0;
+	tx_db_valid <= 1'b0;
+	db_race     <= 1'b0;
+	if(cfg_req) begin
+		wr      <= 1'b1;
+		wr_addr <= cfg_addr;
+		wr_data <= cfg_data;
+		cfg_req = 1'b0;
+	end else if(cycle < db_pause) begin
+	end else if(n_phantom != 0) begin
+		tx_db_valid <= 1'b1;
+		db_phantom  <= 1'b1;
+		n_phantom = n_phantom - 1;
+	end else if(n_db < n_tx && !hold_db && rand_int(100) < 30) begin
+		tx_db_valid <= 1'b1;
+		db_phantom  <= 1'b0;
+		db_f        <= fw_id[n_db];
+		n_db        <= n_db + 1;
+		if(n_db == race_db) begin
+			wr       <= 1'b1;
+			wr_addr  <= 0;
+			wr_data  <= 32'h4 | STAMP;
+			db_race  <= 1'b1;
+			db_pause <= cycle + 6;
+		end
+	end
+end
+
+	//expected timestamp queue and statistics, each doorbell is checked against the frame it belongs to
+integer   occ = 0;
+integer   occ_old;
+integer   push_f;
+integer   exp_cnt = 0;
+integer   exp_unmatched = 0;
+integer   exp_lost = 0;
+reg[63:0] exp_sum = 0;
+reg[31:0] exp_min = 32'hFFFF_FFFF;
+reg[31:0] exp_max = 0;
+integer   exp_hist[0:31];
+reg[31:0] lat_e;
+integer   bkt;
+integer   b;
+integer   race_chk = -1;
+reg[31:0] race_lat;
+integer   n_races = 0;
+always @(posedge clk) begin
+	if(rst_n) begin
+		if(STAMP)
+			push_f = tx_tvalid & tx_tready & tx_tlast ? fw_id[n_tx] : -1;
+		else
+			push_f = rx_pkt_ack ? rx_ack_f : -1;
+		occ_old = occ;
+		if(tx_db_valid) begin
+			if(occ_old == 0) begin
+				exp_unmatched = exp_unmatched + 1;
+				if(!db_phantom && !frame_lost[db_f]) begin
+					if(errors < 10)
+						$display("doorbell of frame %0d without a queued timestamp", db_f);
+					errors = errors + 1;
+				end
+			end else begin
+				occ = occ - 1;
+				if(db_phantom || frame_lost[db_f]) begin
+					if(errors < 10)
+						$display("doorbell without a timestamp (frame %0d, phantom %b) matched", db_f, db_phantom);
+					errors = errors + 1;
+				end
+				lat_e = ts - frame_ts[db_f];
+				if(db_race) begin
+					exp_min  = 32'hFFFF_FFFF;
+					exp_max  = 0;
+					race_lat = lat_e;
+					race_chk = cycle + 2;
+					n_races  = n_races + 1;
+				end
+				exp_cnt = exp_cnt + 1;
+				exp_sum = exp_sum + lat_e;
+				if(lat_e < exp_min)
+					exp_min = lat_e;
+				if(lat_e > exp_max)
+					exp_max = lat_e;
+				bkt = 0;
+				for(b = 1; b < 32; b = b + 1)
+					if(lat_e[b])
+						bkt = b;
+				exp_hist[bkt] = exp_hist[bkt] + 1;
+			end
+		end
+		if(push_f >= 0) begin
+			if(occ_old == TS_DEPTH) begin
+				exp_lost = exp_lost + 1;
+				frame_lost[push_f] = 1'b1;
+			end else begin
+				occ = occ + 1;
+			end
+		end
+		if(cycle == race_chk && (dut.lat_min !== race_lat || dut.lat_max !== race_lat)) begin
+			if(errors < 10)
+				$display("min / max clear with a doorbell: min %0d max %0d, expected %0d", dut.lat_min, dut.lat_max, race_lat);
+			errors = errors + 1;
+		end
+	end
+end
+
+task reg_write(input[5:0] addr, input[31:0] data);
+begin
+	cfg_addr = addr;
+	cfg_data = data;
+	cfg_req  = 1'b1;
+	while(cfg_req)
+		@(posedge clk);
+	@(posedge clk);
+end
+endtask
+
+task reg_check(input[5:0] addr, input[31:0] exp, input[8*12-1:0] name);
+begin
+	rd_addr = addr;
+	#1;
+	if(rd_data !== exp) begin
+		if(errors < 20)
+			$display("register %0d (%0s): %0d, expected %0d", addr, name, rd_data, exp);
+		errors = errors + 1;
+	end
+end
+endtask
+
+integer t_end;
+task wait_drained;
+begin
+	t_end = cycle + N_FRAMES * 2000;
+	while(!(n_rx == rx_target && n_nf == rx_target && n_tx == n_fw && n_db == n_fw && n_phantom == 0) && cycle < t_end)
+		@(posedge clk);
+	repeat(20) @(posedge clk);
+end
+endtask
+
+integer p;
+initial begin
+	for(b = 0; b < 32; b = b + 1)
+		exp_hist[b] = 0;
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	@(posedge clk);
+	for(p = 0; p < N_PHASES; p = p + 1) begin
+		stamp_offs = phase_offs(p);
+		reg_write(1, stamp_offs);
+		reg_write(0, STAMP);
+		if(p == 1 || p == 4)
+			race_db = n_db + N_FRAMES/3;
+		rx_target = rx_target + N_FRAMES;
+		wait_drained;
+		if(p == 0) begin
+			n_phantom = N_PHANTOM;
+			wait_drained;
+		end
+		if(p == 2) begin
+			no_drop = 1;
+			hold_db = 1;
+			rx_target = rx_target + TS_DEPTH + N_LOST;
+			t_end = cycle + N_FRAMES * 2000;
+			while(!(n_nf == rx_target && n_tx == n_fw) && cycle < t_end)
+				@(posedge clk);
+			hold_db = 0;
+			wait_drained;
+			no_drop = 0;
+		end
+	end
+
+	reg_check(2, exp_cnt, "frames");
+	reg_check(3, exp_min, "min");
+	reg_check(4, exp_max, "max");
+	reg_check(5, exp_sum[31:0], "sum low");
+	reg_check(6, exp_sum[63:32], "sum high");
+	reg_check(8, exp_unmatched, "unmatched");
+	reg_check(9, exp_lost, "lost");
+	for(b = 0; b < 32; b = b + 1)
+		reg_check(32 + b, exp_hist[b], "histogram");
+
+	$display("tb_latency_monitor AXIS_WIDTH %0d STAMP %0d: %0d of %0d frames, %0d dropped, %0d measured (min %0d max %0d), %0d unmatched, %0d lost, %0d min / max races, %0d errors",
+	         AXIS_WIDTH, STAMP, n_nf, rx_target, n_drop, exp_cnt, exp_min, exp_max, exp_unmatched, exp_lost, n_races, errors);
+	if(n_nf != rx_target || n_db != n_fw || exp_cnt != n_fw - N_LOST || exp_unmatched != N_PHANTOM + N_LOST || exp_lost != N_LOST ||
+	   n_races != 2 || (STAMP != 0 && DROP_PCT != 0 && n_drop == 0) || errors != 0)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
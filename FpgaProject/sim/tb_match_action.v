@@ -0,0 +1,292 @@
+/*
+Testbench of match_action with the test vectors of match_action_pcap.py (frames of a pcap file, table entries and the
+expected output of its model), run the script first (run_sim.sh does).
+The table entries are loaded over the register interface, the exact match index of each entry is read from the hash register.
+The frames are streamed in with random gaps (VALID_PCT percent valid) into a random ready (READY_PCT percent high),
+each output frame is compared with the expected one (length, content, tkeep from the low lane and tuser), dropped frames
+must not appear. Afterwards the counters of the module are compared with the model.
+In a second run N_TPUT frames of 60 byte are sent back to back without back-pressure, the rate has to reach
+MIN_MPPS (14.88 Mpps, 64 byte frames at 10G) at 250 MHz.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_match_action #(
+	parameter AXIS_WIDTH = 64,
+	parameter EM_ENTRIES = 256, //as in match_action_pcap.py
+	parameter TC_ENTRIES = 16,
+	parameter VALID_PCT = 90,
+	parameter READY_PCT = 80,
+	parameter N_TPUT = 256,
+	parameter MEM_BYTES = 1 << 21,
+	parameter SEED = 1,
+	parameter real CLK_NS = 4.0,
+	parameter real MIN_MPPS = 14.88
+)();
+
+localparam BEAT_BYTES = AXIS_WIDTH/8;
+
+reg clk = 1'b0;
+always #(CLK_NS/2) clk = ~clk;
+
+reg rst_n = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+reg[7:0]  in_mem[0:MEM_BYTES-1];
+reg[7:0]  exp_mem[0:MEM_BYTES-1];
+reg[47:0] rules[0:4095];
+reg[31:0] counts[0:4];
+
+reg[AXIS_WIDTH-1:0]   s_tdata;
+reg[7:0]              s_tuser;
+reg                   s_tlast;
+reg[BEAT_BYTES-1:0]   s_tkeep;
+reg                   s_tvalid = 1'b0;
+wire                  s_tready;
+wire[AXIS_WIDTH-1:0]  m_tdata;
+wire[7:0]             m_tuser;
+wire                  m_tlast;
+wire[BEAT_BYTES-1:0]  m_tkeep;
+wire                  m_tvalid;
+reg                   m_tready = 1'b0;
+reg                   wr = 1'b0;
+reg[6:0]              addr = 0;
+reg[31:0]             wr_data;
+wire[31:0]            rd_data;
+
+match_action #(
+	.AXIS_WIDTH(AXIS_WIDTH),
+	.EM_ENTRIES(EM_ENTRIES),
+	.TC_ENTRIES(TC_ENTRIES)
+) dut (
+	.axi_clk(clk),
+	.axi_aresetn(rst_n),
+	.s_axis_eth_tdata(s_tdata),
+	.s_axis_eth_tuser(s_tuser),
+	.s_axis_eth_tlast(s_tlast),
+	.s_axis_eth_tkeep(s_tkeep),
+	.s_axis_eth_tvalid(s_tvalid),
+	.s_axis_eth_tready(s_tready),
+	.m_axis_eth_tdata(m_tdata),
+	.m_axis_eth_tuser(m_tuser),
+	.m_axis_eth_tlast(m_tlast),
+	.m_axis_eth_tkeep(m_tkeep),
+	.m_axis_eth_tvalid(m_tvalid),
+	.m_axis_eth_tready(m_tready),
+	.init_i(1'b0),
+	.wr_i(wr),
+	.addr_i(addr),
+	.wr_data_i(wr_data),
+	.rd_data_o(rd_data)
+);
+
+task reg_wr(input [6:0] a, input [31:0] d);
+	begin
+		addr    <= a;
+		wr_data <= d;
+		wr      <= 1'b1;
+		@(posedge clk);
+		wr      <= 1'b0;
+		@(posedge clk);
+	end
+endtask
+
+task reg_rd(input [6:0] a, output [31:0] d);
+	begin
+		addr <= a;
+		@(posedge clk);
+		@(posedge clk);
+		d = rd_data;
+	end
+endtask
+
+// frames of the throughput run: 60 byte with an ethertype the parser does not know
+function [7:0] tput_byte(input integer f, input integer k);
+	tput_byte = k == 12 ? 8'h88 : k == 13 ? 8'hB5 : f + k;
+endfunction
+
+	//output: compared with the expected frames
+reg            tput = 1'b0;
+reg            ready_all = 1'b0;
+reg[7:0]       out_buf[0:65535];
+integer        out_len = 0;
+integer        exp_pos = 0;
+integer        exp_len;
+integer        n_out = 0;
+integer        n_tput_out = 0;
+integer        errors = 0;
+integer        t_last = 0;
+integer        b, n_keep, c;
+always @(posedge clk)
+	m_tready <= ready_all | rand_int(100) < READY_PCT;
+
+always @(posedge clk) begin
+	if(rst_n & m_tvalid & m_tready) begin
+		n_keep = 0;
+		for(b = 0; b < BEAT_BYTES; b = b + 1)
+			if(m_tkeep[b]) begin
+				out_buf[(out_len + n_keep) % 65536] = m_tdata[b*8 +: 8];
+				n_keep = n_keep + 1;
+			end
+		if(n_keep == 0 || m_tkeep !== ~({BEAT_BYTES{1'b1}} << n_keep) || ~m_tlast & n_keep != BEAT_BYTES) begin
+			if(errors < 10)
+				$display("output frame %0d: tkeep %b", n_out, m_tkeep);
+			errors = errors + 1;
+		end
+		if(m_tuser !== (tput ? 8'h0 : exp_mem[exp_pos + 2])) begin
+			if(errors < 10)
+				$display("output frame %0d: tuser %0d, expected %0d", n_out, m_tuser, exp_mem[exp_pos + 2]);
+			errors = errors + 1;
+		end
+		out_len = out_len + n_keep;
+		if(m_tlast) begin
+			if(tput) begin
+				if(out_len != 60)
+					errors = errors + 1;
+				for(c = 0; c < out_len && c < 60; c = c + 1)
+					if(out_buf[c] !== tput_byte(n_tput_out, c))
+						errors = errors + 1;
+				n_tput_out = n_tput_out + 1;
+				t_last     = cycle;
+			end else begin
+				exp_len = {exp_mem[exp_pos], exp_mem[exp_pos + 1]};
+				if(exp_len != out_len) begin
+					if(errors < 10)
+						$display("output frame %0d: %0d byte, expected %0d byte%s", n_out, out_len, exp_len, exp_len == 0 ? " (no more frames)" : "");
+					errors = errors + 1;
+				end else begin
+					for(c = 0; c < out_len; c = c + 1)
+						if(out_buf[c] !== exp_mem[exp_pos + 3 + c]) begin
+							if(errors < 10)
+								$display("output frame %0d: byte %0d is 0x%h, expected 0x%h", n_out, c, out_buf[c], exp_mem[exp_pos + 3 + c]);
+							errors = errors + 1;
+						end
+				end
+				if(exp_len != 0)
+					exp_pos = exp_pos + 3 + exp_len;
+				n_out = n_out + 1;
+			end
+			out_len = 0;
+		end
+	end
+end
+
+	//input
+task send_beat(input [AXIS_WIDTH-1:0] d, input [BEAT_BYTES-1:0] keep, input last, input [7:0] user, input gaps);
+	begin
+		while(gaps && rand_int(100) >= VALID_PCT)
+			@(posedge clk);
+		s_tdata  <= d;
+		s_tkeep  <= keep;
+		s_tlast  <= last;
+		s_tuser  <= user;
+		s_tvalid <= 1'b1;
+		@(posedge clk);
+		while(~s_tready)
+			@(posedge clk);
+		s_tvalid <= 1'b0;
+	end
+endtask
+
+integer r, pos, len, off, k, f;
+integer n_in = 0;
+integer n_exp = 0;
+integer t_start, t_first;
+reg[31:0] rd;
+reg[AXIS_WIDTH-1:0] beat_data;
+reg[BEAT_BYTES-1:0] beat_keep;
+real mpps;
+initial begin
+	$readmemh("build/ma_frames.hex", in_mem);
+	$readmemh("build/ma_expect.hex", exp_mem);
+	$readmemh("build/ma_rules.hex", rules);
+	$readmemh("build/ma_counts.hex", counts);
+	pos = 0;
+	while({exp_mem[pos], exp_mem[pos + 1]} != 0) begin
+		n_exp = n_exp + 1;
+		pos   = pos + 3 + {exp_mem[pos], exp_mem[pos + 1]};
+	end
+
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	repeat(10) @(posedge clk);
+
+	// table entries, op 1: the command gets the exact match index of the staged key
+	for(r = 0; rules[r][47:40] != 8'hFF; r = r + 1) begin
+		if(rules[r][47:40] == 1) begin
+			reg_rd(27, rd);
+			reg_wr(rules[r][38:32], rules[r][31:0] | rd);
+		end else begin
+			reg_wr(rules[r][38:32], rules[r][31:0]);
+		end
+	end
+
+	// frames of the pcap
+	pos     = 0;
+	t_start = cycle;
+	while({in_mem[pos], in_mem[pos + 1]} != 0) begin
+		len = {in_mem[pos], in_mem[pos + 1]};
+		for(off = 0; off < len; off = off + BEAT_BYTES) begin
+			beat_data = 0;
+			beat_keep = 0;
+			for(k = 0; k < BEAT_BYTES && off + k < len; k = k + 1) begin
+				beat_data[k*8 +: 8] = in_mem[pos + 3 + off + k];
+				beat_keep[k]        = 1'b1;
+			end
+			send_beat(beat_data, beat_keep, off + BEAT_BYTES >= len, in_mem[pos + 2], 1'b1);
+		end
+		pos  = pos + 3 + len;
+		n_in = n_in + 1;
+	end
+	while(n_out < n_exp && cycle - t_start < pos * 20 + 10000)
+		@(posedge clk);
+	repeat(100) @(posedge clk);
+
+	for(r = 0; r < 5; r = r + 1) begin
+		reg_rd(32 + r, rd);
+		if(rd !== counts[r]) begin
+			$display("counter %0d is %0d, expected %0d", 32 + r, rd, counts[r]);
+			errors = errors + 1;
+		end
+	end
+	$display("tb_match_action AXIS_WIDTH %0d: %0d frames in, %0d of %0d expected frames out, drops %0d, misses %0d, exact hits %0d, ternary hits %0d, skipped rewrites %0d",
+	         AXIS_WIDTH, n_in, n_out, n_exp, counts[0], counts[1], counts[2], counts[3], counts[4]);
+
+	// back to back 60 byte frames
+	tput      <= 1'b1;
+	ready_all <= 1'b1;
+	@(posedge clk);
+	t_first = cycle;
+	for(f = 0; f < N_TPUT; f = f + 1)
+		for(off = 0; off < 60; off = off + BEAT_BYTES) begin
+			beat_data = 0;
+			beat_keep = 0;
+			for(k = 0; k < BEAT_BYTES && off + k < 60; k = k + 1) begin
+				beat_data[k*8 +: 8] = tput_byte(f, off + k);
+				beat_keep[k]        = 1'b1;
+			end
+			send_beat(beat_data, beat_keep, off + BEAT_BYTES >= 60, 8'h0, 1'b0);
+		end
+	while(n_tput_out < N_TPUT && cycle - t_first < N_TPUT * 100)
+		@(posedge clk);
+	if(n_tput_out == 0)
+		t_last = t_first;
+	mpps = n_tput_out * 1000.0 / ((t_last - t_first + 1) * CLK_NS);
+	$display("  %0d of %0d back to back 60 byte frames in %0d cycles, %0.2f cycles per frame, %0.2f Mpps at %0.0f MHz",
+	         n_tput_out, N_TPUT, t_last - t_first + 1, (t_last - t_first + 1) * 1.0 / (n_tput_out + (n_tput_out == 0)), mpps, 1000.0 / CLK_NS);
+
+	if(n_out != n_exp || n_tput_out != N_TPUT || errors != 0 || mpps < MIN_MPPS)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
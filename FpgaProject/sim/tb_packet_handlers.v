@@ -0,0 +1,280 @@
+/*
+Testbench of rx_packet_handler and tx_packet_handler with random frame lengths.
+N_FRAMES frames of random length (60 byte up to MAX_LEN, half of them below 200 byte) and random content are written into
+the rx packet bram model buffer by buffer (BUF_SIZE each, the last buffer of a frame with EOP) and handed to rx_packet_handler
+like rx_queue_arbiter does. Its stream is looped back into tx_packet_handler, the ready between both is dropped
+randomly (READY_PCT percent high), the transmit requests are acknowledged after 1 to XMIT_LAT cycles.
+The stream is checked beat by beat: content of the kept bytes, tkeep filled from the low lane and tlast at the end of each frame.
+Each transmit request is checked for buffer address, length, EOP and the content of the tx packet bram model.
+The lengths run through all tkeep patterns of the last beat and frames across several buffers.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_packet_handlers #(
+	parameter DATA_WIDTH = 256,
+	parameter AXIS_WIDTH = 256, //64 (with DATA_WIDTH 128) or DATA_WIDTH
+	parameter BUF_SIZE = 2048,
+	parameter NB_TX_DESC = 64,
+	parameter N_FRAMES = 1000,
+	parameter MAX_LEN = 2*2048 + 200,
+	parameter READY_PCT = 70,
+	parameter XMIT_LAT = 8,
+	parameter SEED = 1
+)();
+
+localparam BEAT_BYTES = AXIS_WIDTH/8;
+localparam WORD_BYTES = DATA_WIDTH/8;
+localparam RX_SLOTS   = 8;
+localparam EXP_SIZE   = 1 << 16; //bytes of the expected byte stream in flight
+localparam FRAMES     = 1024; //frames in flight
+
+reg clk = 1'b0;
+always #2 clk = ~clk;
+
+reg rst_n = 1'b0;
+reg start = 1'b0;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+// expected byte stream of all frames and the end of each frame in it
+reg[7:0] exp_mem[0:EXP_SIZE-1];
+integer  frame_end[0:FRAMES-1];
+integer  wr_pos = 0;
+integer  rx_pos = 0;
+integer  tx_pos = 0;
+integer  rx_frame = 0;
+integer  tx_frame = 0;
+integer  errors = 0;
+
+reg[31:0]             pkt_addr;
+reg[15:0]             pkt_len;
+reg                   pkt_eop;
+reg                   pkt_v = 1'b0;
+wire                  pkt_ack;
+
+wire[31:0]            rx_addr;
+wire                  rx_en;
+reg[DATA_WIDTH-1:0]   rx_dout;
+
+wire[AXIS_WIDTH-1:0]  rx_tdata;
+wire[AXIS_WIDTH/8-1:0] rx_tkeep;
+wire                  rx_tlast;
+wire                  rx_tvalid;
+wire                  tx_tready;
+reg                   gate = 1'b0;
+wire                  rx_tready = tx_tready & gate;
+wire                  rx_hs = rx_tvalid & rx_tready;
+
+wire[31:0]            tx_addr;
+wire                  tx_en;
+wire[DATA_WIDTH-1:0]  tx_din;
+wire[DATA_WIDTH/8-1:0] tx_we;
+wire[31:0]            xmit_addr;
+wire[15:0]            xmit_len;
+wire                  xmit_eop;
+wire                  xmit_req;
+reg                   xmit_ack = 1'b0;
+
+rx_packet_handler #(
+	.DATA_WIDTH(DATA_WIDTH),
+	.AXIS_WIDTH(AXIS_WIDTH)
+) rx_dut (
+	.axi_clk(clk),
+	.axi_aresetn(rst_n),
+	.m_axis_eth_tdata(rx_tdata),
+	.m_axis_eth_tuser(),
+	.m_axis_eth_tlast(rx_tlast),
+	.m_axis_eth_tkeep(rx_tkeep),
+	.m_axis_eth_tvalid(rx_tvalid),
+	.m_axis_eth_tready(rx_tready),
+	.addr_o(rx_addr),
+	.clk_o(),
+	.data_o(),
+	.data_i(rx_dout),
+	.en_o(rx_en),
+	.rst_o(),
+	.wea_o(),
+	.wren_o(),
+	.pkt_addr_i(pkt_addr),
+	.pkt_len_i(pkt_len),
+	.pkt_eop_i(pkt_eop),
+	.pkt_addr_v_i(pkt_v),
+	.pkt_ack_o(pkt_ack)
+);
+
+tx_packet_handler #(
+	.NB_TX_DESC(NB_TX_DESC),
+	.DATA_WIDTH(DATA_WIDTH),
+	.AXIS_WIDTH(AXIS_WIDTH),
+	.BUF_SIZE(BUF_SIZE)
+) tx_dut (
+	.axi_clk(clk),
+	.axi_aresetn(rst_n),
+	.s_axis_eth_tdata(rx_tdata),
+	.s_axis_eth_tuser(8'h0),
+	.s_axis_eth_tlast(rx_tlast),
+	.s_axis_eth_tkeep(rx_tkeep),
+	.s_axis_eth_tvalid(rx_tvalid & gate),
+	.s_axis_eth_tready(tx_tready),
+	.addr_o(tx_addr),
+	.clk_o(),
+	.data_o(tx_din),
+	.data_i({DATA_WIDTH{1'b0}}),
+	.en_o(tx_en),
+	.rst_o(),
+	.wea_o(tx_we),
+	.wren_o(),
+	.init_i(1'b0),
+	.start_i(start),
+	.pkt_addr_o(xmit_addr),
+	.pkt_len_o(xmit_len),
+	.pkt_eop_o(xmit_eop),
+	.xmit_req_o(xmit_req),
+	.xmit_ack_i(xmit_ack)
+);
+
+	//packet brams, read latency 1
+reg[7:0] rx_mem[0:RX_SLOTS*BUF_SIZE-1];
+reg[7:0] tx_mem[0:NB_TX_DESC*BUF_SIZE-1];
+integer k;
+always @(posedge clk) begin
+	if(rx_en)
+		for(k = 0; k < WORD_BYTES; k = k + 1)
+			rx_dout[k*8 +: 8] <= rx_mem[(rx_addr / WORD_BYTES * WORD_BYTES + k) % (RX_SLOTS*BUF_SIZE)];
+	if(tx_en)
+		for(k = 0; k < WORD_BYTES; k = k + 1)
+			if(tx_we[k])
+				tx_mem[(tx_addr / WORD_BYTES * WORD_BYTES + k) % (NB_TX_DESC*BUF_SIZE)] <= tx_din[k*8 +: 8];
+end
+
+	//random ready between the packet handlers
+always @(posedge clk)
+	gate <= rand_int(100) < READY_PCT;
+
+	//rx stream: content, tkeep from the low lane and tlast at the end of the frame
+integer b;
+integer n_keep;
+always @(posedge clk) begin
+	if(rst_n & rx_hs) begin
+		n_keep = 0;
+		for(b = 0; b < BEAT_BYTES; b = b + 1)
+			if(rx_tkeep[b]) begin
+				if(rx_tdata[b*8 +: 8] !== exp_mem[(rx_pos + n_keep) % EXP_SIZE]) begin
+					if(errors < 10)
+						$display("frame %0d: stream byte %0d is 0x%h, expected 0x%h", rx_frame, rx_pos + n_keep, rx_tdata[b*8 +: 8], exp_mem[(rx_pos + n_keep) % EXP_SIZE]);
+					errors = errors + 1;
+				end
+				n_keep = n_keep + 1;
+			end
+		if(n_keep == 0 || rx_tkeep !== ~({BEAT_BYTES{1'b1}} << n_keep)) begin
+			if(errors < 10)
+				$display("frame %0d: tkeep %b is not filled from the low lane", rx_frame, rx_tkeep);
+			errors = errors + 1;
+		end
+		rx_pos = rx_pos + n_keep;
+		if(rx_tlast !== (rx_pos == frame_end[rx_frame % FRAMES])) begin
+			if(errors < 10)
+				$display("frame %0d: tlast %b at byte %0d, the frame ends at %0d", rx_frame, rx_tlast, rx_pos, frame_end[rx_frame % FRAMES]);
+			errors = errors + 1;
+		end
+		if(rx_pos >= frame_end[rx_frame % FRAMES])
+			rx_frame = rx_frame + 1;
+	end
+end
+
+	//transmit requests: acknowledged after 1 to XMIT_LAT cycles, the bram write of the last beat is done by then
+integer tx_slot = 0;
+integer tx_len;
+integer i;
+initial begin
+	forever begin
+		@(posedge clk);
+		if(xmit_req) begin
+			repeat(1 + rand_int(XMIT_LAT)) @(posedge clk);
+			tx_len = frame_end[tx_frame % FRAMES] - tx_pos;
+			if(tx_len > BUF_SIZE)
+				tx_len = BUF_SIZE;
+			if(xmit_addr !== tx_slot * BUF_SIZE || xmit_len !== tx_len || xmit_eop !== (tx_pos + tx_len == frame_end[tx_frame % FRAMES])) begin
+				if(errors < 10)
+					$display("frame %0d: tx buffer 0x%h len %0d eop %b, expected 0x%h len %0d eop %b", tx_frame, xmit_addr, xmit_len, xmit_eop,
+					         tx_slot * BUF_SIZE, tx_len, tx_pos + tx_len == frame_end[tx_frame % FRAMES]);
+				errors = errors + 1;
+			end
+			for(i = 0; i < tx_len; i = i + 1)
+				if(tx_mem[tx_slot * BUF_SIZE + i] !== exp_mem[(tx_pos + i) % EXP_SIZE]) begin
+					if(errors < 10)
+						$display("frame %0d: tx buffer byte %0d is 0x%h, expected 0x%h", tx_frame, i, tx_mem[tx_slot * BUF_SIZE + i], exp_mem[(tx_pos + i) % EXP_SIZE]);
+					errors = errors + 1;
+				end
+			tx_pos  = tx_pos + tx_len;
+			tx_slot = (tx_slot + 1) % NB_TX_DESC;
+			if(tx_pos == frame_end[tx_frame % FRAMES])
+				tx_frame = tx_frame + 1;
+			xmit_ack <= 1'b1;
+			@(posedge clk);
+			xmit_ack <= 1'b0;
+		end
+	end
+end
+
+	//frames into the rx buffers, one buffer at a time like rx_queue_arbiter
+integer n;
+integer len;
+integer rem;
+integer blen;
+integer j;
+integer rx_slot = 0;
+integer t_start;
+initial begin
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	repeat(10) @(posedge clk);
+	start <= 1'b1;
+	repeat(10) @(posedge clk);
+	t_start = $time;
+	for(n = 0; n < N_FRAMES; n = n + 1) begin
+		if(rand_int(2))
+			len = 60 + rand_int(140);
+		else
+			len = 60 + rand_int(MAX_LEN - 59);
+		while(wr_pos + len - tx_pos > EXP_SIZE || n - tx_frame >= FRAMES)
+			@(posedge clk);
+		frame_end[n % FRAMES] = wr_pos + len;
+		rem = len;
+		while(rem > 0) begin
+			blen = rem > BUF_SIZE ? BUF_SIZE : rem;
+			for(j = 0; j < blen; j = j + 1) begin
+				rx_mem[rx_slot * BUF_SIZE + j]  = rand_int(256);
+				exp_mem[(wr_pos + j) % EXP_SIZE] = rx_mem[rx_slot * BUF_SIZE + j];
+			end
+			wr_pos   = wr_pos + blen;
+			pkt_addr <= rx_slot * BUF_SIZE;
+			pkt_len  <= blen;
+			pkt_eop  <= blen == rem;
+			pkt_v    <= 1'b1;
+			@(posedge clk);
+			while(~pkt_ack)
+				@(posedge clk);
+			pkt_v   <= 1'b0;
+			rx_slot = (rx_slot + 1) % RX_SLOTS;
+			rem     = rem - blen;
+			repeat(rand_int(3)) @(posedge clk);
+		end
+	end
+	while(tx_frame < N_FRAMES && $time - t_start < N_FRAMES * 20000)
+		@(posedge clk);
+
+	$display("tb_packet_handlers DATA_WIDTH %0d AXIS_WIDTH %0d: %0d of %0d frames streamed, %0d transmitted, %0d bytes, ready %0d%%, %0d errors",
+	         DATA_WIDTH, AXIS_WIDTH, rx_frame, N_FRAMES, tx_frame, tx_pos, READY_PCT, errors);
+	if(rx_frame != N_FRAMES || tx_frame != N_FRAMES || errors != 0)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
@@ -0,0 +1,301 @@
+/*
+Testbench of the pipelined engine of rx_desc_ctrl (DATA_WIDTH 128 and 256).
+A NIC model writes back N_PKTS descriptors into the ring bram back to back (one every NIC_GAP+1 cycles) as long as the
+tail pointer leaves it descriptors, and takes the tail pointer writes of rx_desc_ctrl after PCIE_LAT cycles.
+The buffers are acknowledged like rx_packet_handler does (registered ack, at most one buffer every second cycle).
+Each buffer is checked for address, length and EOP in ring order, and the sustained rate from the first write-back
+to the last acknowledged buffer has to reach MIN_MPPS (14.88 Mpps, 64 byte frames at 10G) at 250 MHz.
+With SNOOP the written back descriptors are reported in desc_done SNOOP_LAT cycles after their bram write, like
+rx_desc_snoop does with the write response, and cleared with desc_clr.
+With HAIRPIN the buffers are freed with buf_free_i like tx_desc_ctrl does once the NIC has sent them: in the order they
+were acknowledged, each 1 to FREE_LAT cycles after its ack at the earliest.
+Every tail pointer write is checked against the buffers returned so far (acknowledged, or freed with HAIRPIN), the tail
+must never hand the NIC a descriptor whose buffer is still in use.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_rx_desc_ctrl #(
+	parameter DATA_WIDTH = 256, //128 or 256
+	parameter NB_DESC = 64,
+	parameter BUF_SIZE = 2048,
+	parameter BUF_OFFS = 0,
+	parameter IN_FLIGHT = 8,
+	parameter SNOOP = 0,
+	parameter SNOOP_LAT = 3, //cycles from the bram write of a descriptor to its desc_done bit, at least 1
+	parameter N_PKTS = 4096,
+	parameter NIC_GAP = 0, //idle cycles of the NIC model between two write-backs
+	parameter PCIE_LAT = 40, //cycles until a tail pointer write is acknowledged
+	parameter HAIRPIN = 0,
+	parameter FREE_LAT = 40, //max. cycles from the ack of a buffer to its buf_free_i pulse (HAIRPIN)
+	parameter SEED = 1,
+	parameter real CLK_NS = 4.0,
+	parameter real MIN_MPPS = 14.88
+)();
+
+localparam DESC_PER_BEAT = DATA_WIDTH/128;
+localparam DESC_IX_WIDTH = $clog2(NB_DESC);
+localparam BEAT_BYTES    = DATA_WIDTH/8;
+localparam WORDS         = NB_DESC/DESC_PER_BEAT;
+localparam POLL          = 7; //poll_state of rx_desc_ctrl once the ring is initialized
+
+reg clk = 1'b0;
+always #(CLK_NS/2) clk = ~clk;
+
+reg rst_n  = 1'b0;
+reg init   = 1'b0;
+reg start  = 1'b0;
+reg nic_en = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+// expected frames: the length runs through 60-123 bytes, every fifth buffer continues in the next one
+function [15:0] exp_len(input integer n);
+	exp_len = 60 + n % 64;
+endfunction
+function exp_eop(input integer n);
+	exp_eop = n % 5 != 4;
+endfunction
+
+wire[31:0]            b_addr;
+wire                  b_clk;
+wire[DATA_WIDTH-1:0]  b_din;
+reg[DATA_WIDTH-1:0]   b_dout;
+wire                  b_en;
+wire                  b_rst;
+wire[BEAT_BYTES-1:0]  b_we;
+wire                  b_wren;
+wire[DESC_IX_WIDTH-1:0] b_word = (b_addr / BEAT_BYTES) % WORDS;
+
+reg                   a_we = 1'b0;
+reg[DESC_IX_WIDTH-1:0] a_ix = 0;
+reg[127:0]            a_desc;
+
+wire                  pcie_start;
+reg                   pcie_ack;
+wire[31:0]            tail_ptr;
+wire[31:0]            pkt_addr;
+wire[15:0]            pkt_len;
+wire                  pkt_eop;
+wire                  pkt_v;
+reg                   pkt_ack;
+wire[NB_DESC-1:0]     desc_clr;
+reg[NB_DESC-1:0]      snoop_done;
+reg                   buf_free = 1'b0;
+wire[3:0]             poll_state;
+
+rx_desc_ctrl #(
+	.NB_DESC(NB_DESC),
+	.DATA_WIDTH(DATA_WIDTH),
+	.BUF_SIZE(BUF_SIZE),
+	.IN_FLIGHT(IN_FLIGHT),
+	.SNOOP(SNOOP),
+	.BUF_OFFS(BUF_OFFS),
+	.HAIRPIN(HAIRPIN)
+) dut (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.addr_o(b_addr),
+	.clk_o(b_clk),
+	.data_o(b_din),
+	.data_i(b_dout),
+	.en_o(b_en),
+	.rst_o(b_rst),
+	.wea_o(b_we),
+	.wren_o(b_wren),
+	.start_i(start),
+	.init_i(init),
+	.nic_rdt_addr_i(64'h0000_0000_f000_1018),
+	.fpga_base_addr_i(32'h0),
+	.nic_phys_addr_o(),
+	.nic_rx_tail_pointer_o(tail_ptr),
+	.pcie_rq_start_o(pcie_start),
+	.pcie_rq_ack_i(pcie_ack),
+	.pkt_addr_o(pkt_addr),
+	.pkt_len_o(pkt_len),
+	.pkt_eop_o(pkt_eop),
+	.pkt_addr_v_o(pkt_v),
+	.pkt_ack_i(pkt_ack),
+	.buf_free_i(buf_free),
+	.ts_i(cycle),
+	.pkt_ts_o(),
+	.desc_done_i(snoop_done),
+	.desc_clr_o(desc_clr),
+	.poll_state_o(poll_state),
+	.ring_level_o()
+);
+
+	//ring bram, port A is written by the NIC model, port B belongs to rx_desc_ctrl (read first)
+reg[DATA_WIDTH-1:0] ring[0:WORDS-1];
+integer k;
+always @(posedge clk) begin
+	if(b_en) begin
+		b_dout <= ring[b_word];
+		for(k = 0; k < BEAT_BYTES; k = k + 1)
+			if(b_we[k])
+				ring[b_word][k*8 +: 8] <= b_din[k*8 +: 8];
+	end
+	if(a_we)
+		ring[a_ix / DESC_PER_BEAT][(a_ix % DESC_PER_BEAT)*128 +: 128] <= a_desc;
+end
+
+	//NIC: writes back the descriptor at its head as long as the head has not reached the tail pointer
+reg[DESC_IX_WIDTH-1:0] nic_head;
+reg[DESC_IX_WIDTH-1:0] nic_tail;
+integer n_written;
+integer gap;
+integer t_first;
+always @(posedge clk) begin
+	a_we <= 1'b0;
+	if(~rst_n) begin
+		nic_head  <= 0;
+		n_written <= 0;
+		gap       <= 0;
+	end else if(nic_en && n_written < N_PKTS) begin
+		if(gap != 0) begin
+			gap <= gap - 1;
+		end else if(nic_head != nic_tail) begin
+			// 82599 advanced rx descriptor, write-back format: packet length, dd and eop
+			a_desc    <= {16'h0, exp_len(n_written), 12'h0, 18'h0, exp_eop(n_written), 1'b1, 64'h0};
+			a_ix      <= nic_head;
+			a_we      <= 1'b1;
+			nic_head  <= nic_head + 1'b1;
+			n_written <= n_written + 1;
+			gap       <= NIC_GAP;
+			if(n_written == 0)
+				t_first <= cycle;
+		end
+	end
+end
+
+	//tail pointer writes, the NIC takes the new tail after PCIE_LAT cycles
+	//the NIC may write back up to the descriptor before the tail, the buffer of each of them has to be returned
+integer pcie_cnt;
+integer n_doorbells;
+integer n_returned;
+integer tail_errors;
+wire[DESC_IX_WIDTH-1:0] tail_ahead = tail_ptr[DESC_IX_WIDTH-1:0] - nic_head;
+always @(posedge clk) begin
+	pcie_ack <= 1'b0;
+	if(~rst_n) begin
+		pcie_cnt    <= 0;
+		n_doorbells <= 0;
+		tail_errors <= 0;
+		nic_tail    <= NB_DESC-1; //set by the driver in ixgbe_dev_rx_queue_start()
+	end else if(pcie_start & ~pcie_ack) begin
+		pcie_cnt <= pcie_cnt + 1;
+		if(pcie_cnt == 0 && n_written + tail_ahead > n_returned + NB_DESC) begin
+			if(tail_errors < 10)
+				$display("tail pointer %0d passes buffer %0d, only %0d buffers are returned", tail_ptr[DESC_IX_WIDTH-1:0],
+				         n_written + tail_ahead - 1 - NB_DESC, n_returned);
+			tail_errors <= tail_errors + 1;
+		end
+		if(pcie_cnt == PCIE_LAT) begin
+			pcie_cnt    <= 0;
+			pcie_ack    <= 1'b1;
+			nic_tail    <= tail_ptr[DESC_IX_WIDTH-1:0];
+			n_doorbells <= n_doorbells + 1;
+		end
+	end
+end
+
+	//rx_desc_snoop: the written back descriptors are reported SNOOP_LAT cycles after their bram write
+reg[DESC_IX_WIDTH:0] snoop_dl[0:SNOOP_LAT-1]; //{valid, descriptor} of the bram writes
+wire[NB_DESC-1:0] snoop_set = {{(NB_DESC-1){1'b0}}, snoop_dl[SNOOP_LAT-1][DESC_IX_WIDTH]} << snoop_dl[SNOOP_LAT-1][DESC_IX_WIDTH-1:0];
+integer m;
+always @(posedge clk) begin
+	if(~rst_n) begin
+		for(m = 0; m < SNOOP_LAT; m = m + 1)
+			snoop_dl[m] <= 0;
+		snoop_done <= 0;
+	end else begin
+		snoop_dl[0] <= {a_we, a_ix};
+		for(m = 1; m < SNOOP_LAT; m = m + 1)
+			snoop_dl[m] <= snoop_dl[m-1];
+		snoop_done <= (snoop_done | snoop_set) & ~desc_clr;
+	end
+end
+
+	//HAIRPIN: the acknowledged buffers are freed in order, each 1 to FREE_LAT cycles after its ack at the earliest
+integer n_acked;
+integer n_freed;
+integer free_t[0:NB_DESC-1];
+always @(posedge clk) begin
+	buf_free <= 1'b0;
+	if(~rst_n) begin
+		n_freed <= 0;
+	end else begin
+		if(pkt_v & pkt_ack)
+			free_t[n_acked % NB_DESC] <= cycle + 1 + rand_int(FREE_LAT);
+		if(HAIRPIN && n_freed < n_acked && cycle >= free_t[n_freed % NB_DESC]) begin
+			buf_free <= 1'b1;
+			n_freed  <= n_freed + 1;
+		end
+	end
+end
+always @(*) n_returned = HAIRPIN ? n_freed : n_acked;
+
+	//packet handler: acknowledges each buffer one cycle after it is presented and checks it
+integer errors;
+integer t_last;
+always @(posedge clk) begin
+	if(~rst_n) begin
+		pkt_ack <= 1'b0;
+		n_acked <= 0;
+		errors  <= 0;
+	end else begin
+		pkt_ack <= pkt_v & ~pkt_ack;
+		if(pkt_v & pkt_ack) begin
+			if(pkt_addr !== BUF_OFFS + (n_acked % NB_DESC) * BUF_SIZE || pkt_len !== exp_len(n_acked) || pkt_eop !== exp_eop(n_acked)) begin
+				if(errors < 10)
+					$display("buffer %0d: addr 0x%h len %0d eop %b, expected 0x%h len %0d eop %b", n_acked, pkt_addr, pkt_len, pkt_eop,
+					         BUF_OFFS + (n_acked % NB_DESC) * BUF_SIZE, exp_len(n_acked), exp_eop(n_acked));
+				errors <= errors + 1;
+			end
+			n_acked <= n_acked + 1;
+			t_last  <= cycle;
+		end
+	end
+end
+
+integer w;
+integer t_start;
+real mpps;
+initial begin
+	for(w = 0; w < WORDS; w = w + 1)
+		ring[w] = 0;
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	repeat(10) @(posedge clk);
+	init <= 1'b1;
+	@(posedge clk);
+	init <= 1'b0;
+	wait(poll_state == POLL);
+	@(posedge clk);
+	start   <= 1'b1;
+	nic_en  <= 1'b1;
+	t_start = cycle;
+	while(n_acked < N_PKTS && cycle - t_start < N_PKTS * 64 + 10000)
+		@(posedge clk);
+
+	if(n_acked == 0) begin
+		t_first = 0;
+		t_last  = 0;
+	end
+	mpps = n_acked * 1000.0 / ((t_last - t_first + 1) * CLK_NS);
+	$display("tb_rx_desc_ctrl DATA_WIDTH %0d SNOOP %0d HAIRPIN %0d: %0d of %0d buffers in %0d cycles, %0.2f cycles per buffer, %0.2f Mpps at %0.0f MHz, %0d tail pointer writes, %0d tail pointers passing a buffer in use",
+	         DATA_WIDTH, SNOOP, HAIRPIN, n_acked, N_PKTS, t_last - t_first + 1, (t_last - t_first + 1) * 1.0 / (n_acked + (n_acked == 0)), mpps, 1000.0 / CLK_NS, n_doorbells, tail_errors);
+	if(n_acked != N_PKTS || errors != 0 || tail_errors != 0 || mpps < MIN_MPPS)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
@@ -0,0 +1,515 @@
+/*
+Testbench of rx_desc_snoop, compares the latency of snooping and polling in rx_desc_ctrl.
+Two copies of the rx ring path run side by side with the same traffic, rx_desc_ctrl polls the dd bits in the first (SNOOP 0)
+and takes the descriptors reported by rx_desc_snoop in the second (SNOOP 1). Each copy has:
+	- a NIC model, which receives a frame every FRAME_GAP cycles into the descriptor at its head (dropped if the ring is full)
+	  and writes back WB_DESC descriptors per INCR burst over axi. The write data of a burst follows its address after W_DELAY
+	  cycles, so with a large W_DELAY the write addresses queue up in front of rx_desc_snoop.
+	- rx_desc_snoop in front of a bram controller model, which accepts up to 16 write addresses and answers each burst
+	  B_LAT cycles after its last beat.
+	- rx_desc_ctrl on port B of the ring bram, the tail pointer writes take PCIE_LAT cycles, the buffers are acknowledged
+	  like rx_packet_handler does.
+The latency is counted from the bram write of a descriptor (last beat of its burst) to the cycle its buffer is handed out.
+Each buffer is checked for address, length and EOP. The write address queue of rx_desc_snoop must never exceed its depth.
+Snooping has to beat polling: its average latency has to be lower and its max latency must not be higher, although a
+descriptor is only reported with the write response of its burst.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_rx_desc_snoop #(
+	parameter DATA_WIDTH = 256,
+	parameter NB_DESC = 64,
+	parameter N_PKTS = 2048, //multiple of WB_DESC
+	parameter FRAME_GAP = 17, //cycles between two frames, 16.8 for 64 byte frames at 10G and 250 MHz
+	parameter WB_DESC = 1, //descriptors per write-back burst (1, 2 or 4)
+	parameter W_DELAY = 0,
+	parameter B_LAT = 2,
+	parameter PCIE_LAT = 40,
+	parameter real CLK_NS = 4.0
+)();
+
+reg clk = 1'b0;
+always #(CLK_NS/2) clk = ~clk;
+
+rx_ring_harness #(.SNOOP(0), .DATA_WIDTH(DATA_WIDTH), .NB_DESC(NB_DESC), .N_PKTS(N_PKTS), .FRAME_GAP(FRAME_GAP), .WB_DESC(WB_DESC),
+	.W_DELAY(W_DELAY), .B_LAT(B_LAT), .PCIE_LAT(PCIE_LAT)) h_poll (.clk(clk));
+rx_ring_harness #(.SNOOP(1), .DATA_WIDTH(DATA_WIDTH), .NB_DESC(NB_DESC), .N_PKTS(N_PKTS), .FRAME_GAP(FRAME_GAP), .WB_DESC(WB_DESC),
+	.W_DELAY(W_DELAY), .B_LAT(B_LAT), .PCIE_LAT(PCIE_LAT)) h_snoop (.clk(clk));
+
+initial begin
+	wait(h_poll.done & h_snoop.done);
+	$display("tb_rx_desc_snoop DATA_WIDTH %0d, frame every %0d cycles, %0d descriptors per write-back, write data %0d cycles behind the address",
+	         DATA_WIDTH, FRAME_GAP, WB_DESC, W_DELAY);
+	$display("  polling: %0d of %0d buffers, %0d dropped, latency avg %0.2f max %0d cycles",
+	         h_poll.n_acked, N_PKTS, h_poll.n_drops, h_poll.lat_sum * 1.0 / (h_poll.n_acked + (h_poll.n_acked == 0)), h_poll.lat_max);
+	$display("  snoop:   %0d of %0d buffers, %0d dropped, latency avg %0.2f max %0d cycles, write address queue max %0d, %0d cycles awready held back",
+	         h_snoop.n_acked, N_PKTS, h_snoop.n_drops, h_snoop.lat_sum * 1.0 / (h_snoop.n_acked + (h_snoop.n_acked == 0)), h_snoop.lat_max,
+	         h_snoop.aw_level_max, h_snoop.aw_stalls);
+	if(h_poll.n_acked != N_PKTS || h_snoop.n_acked != N_PKTS || h_poll.errors != 0 || h_snoop.errors != 0 ||
+	   h_poll.aw_level_max > 4 || h_snoop.aw_level_max > 4 ||
+	   h_snoop.lat_sum * h_poll.n_acked >= h_poll.lat_sum * h_snoop.n_acked || h_snoop.lat_max > h_poll.lat_max)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+
+
+module rx_ring_harness #(
+	parameter SNOOP = 0,
+	parameter DATA_WIDTH = 256,
+	parameter NB_DESC = 64,
+	parameter BUF_SIZE = 2048,
+	parameter N_PKTS = 2048,
+	parameter FRAME_GAP = 17,
+	parameter WB_DESC = 1,
+	parameter W_DELAY = 0,
+	parameter B_LAT = 2,
+	parameter PCIE_LAT = 40,
+	parameter RING_ADDR = 32'h0010_0000
+)(
+	input wire clk
+);
+
+localparam DESC_PER_BEAT = DATA_WIDTH/128;
+localparam DESC_IX_WIDTH = $clog2(NB_DESC);
+localparam BEAT_BYTES    = DATA_WIDTH/8;
+localparam WORDS         = NB_DESC/DESC_PER_BEAT;
+localparam N_BURSTS      = N_PKTS/WB_DESC;
+localparam POLL          = 7; //poll_state of rx_desc_ctrl once the ring is initialized
+
+reg rst_n  = 1'b0;
+reg init   = 1'b0;
+reg start  = 1'b0;
+reg nic_en = 1'b0;
+reg done   = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+function [15:0] exp_len(input integer n);
+	exp_len = 60 + n % 64;
+endfunction
+
+// first descriptor and number of beats of a write-back burst
+function integer burst_desc(input integer k);
+	burst_desc = (k * WB_DESC) % NB_DESC;
+endfunction
+function integer burst_beats(input integer k);
+	burst_beats = (burst_desc(k) + WB_DESC - 1) / DESC_PER_BEAT - burst_desc(k) / DESC_PER_BEAT + 1;
+endfunction
+
+	//axi between NIC and rx_desc_snoop (s) and between rx_desc_snoop and bram controller (m)
+reg                   s_awvalid;
+wire                  s_awready;
+reg[31:0]             s_awaddr;
+reg[7:0]              s_awlen;
+reg[DATA_WIDTH-1:0]   s_wdata;
+reg[BEAT_BYTES-1:0]   s_wstrb;
+reg                   s_wlast;
+reg                   s_wvalid;
+wire                  s_wready;
+wire[3:0]             s_bid;
+wire[1:0]             s_bresp;
+wire                  s_bvalid;
+wire[3:0]             s_rid;
+wire[DATA_WIDTH-1:0]  s_rdata;
+wire[1:0]             s_rresp;
+wire                  s_rlast;
+wire                  s_rvalid;
+wire                  s_arready;
+
+wire[3:0]             m_awid;
+wire[31:0]            m_awaddr;
+wire[7:0]             m_awlen;
+wire[2:0]             m_awsize;
+wire[1:0]             m_awburst;
+wire                  m_awlock;
+wire[3:0]             m_awcache;
+wire[2:0]             m_awprot;
+wire                  m_awvalid;
+wire                  m_awready;
+wire[DATA_WIDTH-1:0]  m_wdata;
+wire[BEAT_BYTES-1:0]  m_wstrb;
+wire                  m_wlast;
+wire                  m_wvalid;
+wire                  m_wready;
+wire                  m_bvalid;
+wire                  m_bready;
+wire[3:0]             m_arid;
+wire[31:0]            m_araddr;
+wire[7:0]             m_arlen;
+wire[2:0]             m_arsize;
+wire[1:0]             m_arburst;
+wire                  m_arlock;
+wire[3:0]             m_arcache;
+wire[2:0]             m_arprot;
+wire                  m_arvalid;
+wire                  m_rready;
+
+wire[NB_DESC-1:0]     desc_done;
+wire[NB_DESC-1:0]     desc_clr;
+
+rx_desc_snoop #(
+	.NB_DESC(NB_DESC),
+	.DATA_WIDTH(DATA_WIDTH)
+) snoop (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.s_axi_awid(4'h0),
+	.s_axi_awaddr(s_awaddr),
+	.s_axi_awlen(s_awlen),
+	.s_axi_awsize(3'd5),
+	.s_axi_awburst(2'b01),
+	.s_axi_awlock(1'b0),
+	.s_axi_awcache(4'h3),
+	.s_axi_awprot(3'h0),
+	.s_axi_awvalid(s_awvalid),
+	.s_axi_awready(s_awready),
+	.s_axi_wdata(s_wdata),
+	.s_axi_wstrb(s_wstrb),
+	.s_axi_wlast(s_wlast),
+	.s_axi_wvalid(s_wvalid),
+	.s_axi_wready(s_wready),
+	.s_axi_bid(s_bid),
+	.s_axi_bresp(s_bresp),
+	.s_axi_bvalid(s_bvalid),
+	.s_axi_bready(1'b1),
+	.s_axi_arid(4'h0),
+	.s_axi_araddr(32'h0),
+	.s_axi_arlen(8'h0),
+	.s_axi_arsize(3'd5),
+	.s_axi_arburst(2'b01),
+	.s_axi_arlock(1'b0),
+	.s_axi_arcache(4'h3),
+	.s_axi_arprot(3'h0),
+	.s_axi_arvalid(1'b0),
+	.s_axi_arready(s_arready),
+	.s_axi_rid(s_rid),
+	.s_axi_rdata(s_rdata),
+	.s_axi_rresp(s_rresp),
+	.s_axi_rlast(s_rlast),
+	.s_axi_rvalid(s_rvalid),
+	.s_axi_rready(1'b1),
+	.m_axi_awid(m_awid),
+	.m_axi_awaddr(m_awaddr),
+	.m_axi_awlen(m_awlen),
+	.m_axi_awsize(m_awsize),
+	.m_axi_awburst(m_awburst),
+	.m_axi_awlock(m_awlock),
+	.m_axi_awcache(m_awcache),
+	.m_axi_awprot(m_awprot),
+	.m_axi_awvalid(m_awvalid),
+	.m_axi_awready(m_awready),
+	.m_axi_wdata(m_wdata),
+	.m_axi_wstrb(m_wstrb),
+	.m_axi_wlast(m_wlast),
+	.m_axi_wvalid(m_wvalid),
+	.m_axi_wready(m_wready),
+	.m_axi_bid(4'h0),
+	.m_axi_bresp(2'b00),
+	.m_axi_bvalid(m_bvalid),
+	.m_axi_bready(m_bready),
+	.m_axi_arid(m_arid),
+	.m_axi_araddr(m_araddr),
+	.m_axi_arlen(m_arlen),
+	.m_axi_arsize(m_arsize),
+	.m_axi_arburst(m_arburst),
+	.m_axi_arlock(m_arlock),
+	.m_axi_arcache(m_arcache),
+	.m_axi_arprot(m_arprot),
+	.m_axi_arvalid(m_arvalid),
+	.m_axi_arready(1'b1),
+	.m_axi_rid(4'h0),
+	.m_axi_rdata({DATA_WIDTH{1'b0}}),
+	.m_axi_rresp(2'b00),
+	.m_axi_rlast(1'b0),
+	.m_axi_rvalid(1'b0),
+	.m_axi_rready(m_rready),
+	.desc_clr_i(desc_clr),
+	.desc_done_o(desc_done)
+);
+
+wire[31:0]            b_addr;
+wire                  b_clk;
+wire[DATA_WIDTH-1:0]  b_din;
+reg[DATA_WIDTH-1:0]   b_dout;
+wire                  b_en;
+wire                  b_rst;
+wire[BEAT_BYTES-1:0]  b_we;
+wire                  b_wren;
+wire[DESC_IX_WIDTH-1:0] b_word = (b_addr / BEAT_BYTES) % WORDS;
+wire                  pcie_start;
+reg                   pcie_ack;
+wire[31:0]            tail_ptr;
+wire[31:0]            pkt_addr;
+wire[15:0]            pkt_len;
+wire                  pkt_eop;
+wire                  pkt_v;
+reg                   pkt_ack;
+wire[3:0]             poll_state;
+
+rx_desc_ctrl #(
+	.NB_DESC(NB_DESC),
+	.DATA_WIDTH(DATA_WIDTH),
+	.BUF_SIZE(BUF_SIZE),
+	.SNOOP(SNOOP)
+) ctrl (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.addr_o(b_addr),
+	.clk_o(b_clk),
+	.data_o(b_din),
+	.data_i(b_dout),
+	.en_o(b_en),
+	.rst_o(b_rst),
+	.wea_o(b_we),
+	.wren_o(b_wren),
+	.start_i(start),
+	.init_i(init),
+	.nic_rdt_addr_i(64'h0000_0000_f000_1018),
+	.fpga_base_addr_i(32'h0),
+	.nic_phys_addr_o(),
+	.nic_rx_tail_pointer_o(tail_ptr),
+	.pcie_rq_start_o(pcie_start),
+	.pcie_rq_ack_i(pcie_ack),
+	.pkt_addr_o(pkt_addr),
+	.pkt_len_o(pkt_len),
+	.pkt_eop_o(pkt_eop),
+	.pkt_addr_v_o(pkt_v),
+	.pkt_ack_i(pkt_ack),
+	.buf_free_i(1'b0),
+	.ts_i(cycle),
+	.pkt_ts_o(),
+	.desc_done_i(desc_done),
+	.desc_clr_o(desc_clr),
+	.poll_state_o(poll_state),
+	.ring_level_o()
+);
+
+	//bram controller: queues up to 16 write addresses, writes the beats into port A of the ring bram, answers after B_LAT cycles
+reg[31:0] sq_addr[0:15];
+integer sq_wr;
+integer sq_rd;
+integer sq_beat;
+integer bq_t[0:15];
+integer bq_wr;
+integer bq_rd;
+assign m_awready = sq_wr - sq_rd < 16;
+assign m_wready  = sq_wr != sq_rd;
+assign m_bvalid  = bq_wr != bq_rd && cycle >= bq_t[bq_rd % 16];
+wire a_we = m_wvalid & m_wready;
+wire[DESC_IX_WIDTH-1:0] a_word = (sq_addr[sq_rd % 16] / BEAT_BYTES + sq_beat) % WORDS;
+
+always @(posedge clk) begin
+	if(~rst_n) begin
+		sq_wr   <= 0;
+		sq_rd   <= 0;
+		sq_beat <= 0;
+		bq_wr   <= 0;
+		bq_rd   <= 0;
+	end else begin
+		if(m_awvalid & m_awready) begin
+			sq_addr[sq_wr % 16] <= m_awaddr;
+			sq_wr               <= sq_wr + 1;
+		end
+		if(a_we) begin
+			sq_beat <= sq_beat + 1;
+			if(m_wlast) begin
+				sq_beat          <= 0;
+				sq_rd            <= sq_rd + 1;
+				bq_t[bq_wr % 16] <= cycle + B_LAT;
+				bq_wr            <= bq_wr + 1;
+			end
+		end
+		if(m_bvalid & m_bready)
+			bq_rd <= bq_rd + 1;
+	end
+end
+
+reg[DATA_WIDTH-1:0] ring[0:WORDS-1];
+integer k;
+always @(posedge clk) begin
+	if(b_en) begin
+		b_dout <= ring[b_word];
+		for(k = 0; k < BEAT_BYTES; k = k + 1)
+			if(b_we[k])
+				ring[b_word][k*8 +: 8] <= b_din[k*8 +: 8];
+	end
+	if(a_we)
+		for(k = 0; k < BEAT_BYTES; k = k + 1)
+			if(m_wstrb[k])
+				ring[a_word][k*8 +: 8] <= m_wdata[k*8 +: 8];
+end
+
+	//NIC: frames into the descriptor at the head, write-back bursts of WB_DESC descriptors
+reg[DESC_IX_WIDTH-1:0] nic_head;
+reg[DESC_IX_WIDTH-1:0] nic_tail;
+integer n_frames;
+integer n_drops;
+integer gap;
+always @(posedge clk) begin
+	if(~rst_n) begin
+		nic_head <= 0;
+		n_frames <= 0;
+		n_drops  <= 0;
+		gap      <= 0;
+	end else if(nic_en && n_frames < N_PKTS) begin
+		if(gap != 0) begin
+			gap <= gap - 1;
+		end else begin
+			gap <= FRAME_GAP - 1;
+			if(nic_head != nic_tail) begin
+				nic_head <= nic_head + 1'b1;
+				n_frames <= n_frames + 1;
+			end else begin
+				n_drops  <= n_drops + 1;
+			end
+		end
+	end
+end
+
+integer aw_issued;
+integer aw_k;
+integer t_aw[0:N_BURSTS-1];
+always @(posedge clk) begin
+	if(~rst_n) begin
+		s_awvalid <= 1'b0;
+		aw_issued <= 0;
+		aw_k      <= 0;
+	end else begin
+		if(s_awvalid & s_awready) begin
+			t_aw[aw_k] <= cycle;
+			aw_k       <= aw_k + 1;
+		end
+		if(~s_awvalid | s_awready) begin
+			s_awvalid <= 1'b0;
+			if(aw_issued < n_frames / WB_DESC) begin
+				s_awvalid <= 1'b1;
+				s_awaddr  <= RING_ADDR + burst_desc(aw_issued) * 16;
+				s_awlen   <= burst_beats(aw_issued) - 1;
+				aw_issued <= aw_issued + 1;
+			end
+		end
+	end
+end
+
+integer w_k;
+integer w_beat;
+integer nk;
+integer nb;
+integer l;
+integer ix;
+integer t_w[0:N_PKTS-1];
+always @(posedge clk) begin
+	if(~rst_n) begin
+		s_wvalid <= 1'b0;
+		w_k      <= 0;
+		w_beat   <= 0;
+	end else begin
+		nk = w_k;
+		nb = w_beat;
+		if(s_wvalid & s_wready) begin
+			s_wvalid <= 1'b0;
+			nb = w_beat + 1;
+			if(s_wlast) begin
+				for(l = 0; l < WB_DESC; l = l + 1)
+					t_w[w_k * WB_DESC + l] <= cycle;
+				nk = w_k + 1;
+				nb = 0;
+			end
+		end
+		if((~s_wvalid | s_wready) && nk < aw_k && cycle >= t_aw[nk] + W_DELAY) begin
+			// 82599 advanced rx descriptor, write-back format: packet length, dd and eop
+			for(l = 0; l < DESC_PER_BEAT; l = l + 1) begin
+				ix = (burst_desc(nk) / DESC_PER_BEAT + nb) * DESC_PER_BEAT + l;
+				s_wdata[l*128 +: 128] <= {16'h0, exp_len(nk * WB_DESC + ix - burst_desc(nk)), 12'h0, 18'h0, 1'b1, 1'b1, 64'h0};
+				s_wstrb[l*16 +: 16]   <= ix >= burst_desc(nk) && ix < burst_desc(nk) + WB_DESC ? 16'hFFFF : 16'h0000;
+			end
+			s_wlast  <= nb == burst_beats(nk) - 1;
+			s_wvalid <= 1'b1;
+		end
+		w_k    <= nk;
+		w_beat <= nb;
+	end
+end
+
+	//tail pointer writes, the NIC takes the new tail after PCIE_LAT cycles
+integer pcie_cnt;
+always @(posedge clk) begin
+	pcie_ack <= 1'b0;
+	if(~rst_n) begin
+		pcie_cnt <= 0;
+		nic_tail <= NB_DESC-1;
+	end else if(pcie_start & ~pcie_ack) begin
+		pcie_cnt <= pcie_cnt + 1;
+		if(pcie_cnt == PCIE_LAT) begin
+			pcie_cnt <= 0;
+			pcie_ack <= 1'b1;
+			nic_tail <= tail_ptr[DESC_IX_WIDTH-1:0];
+		end
+	end
+end
+
+	//packet handler: acknowledges each buffer one cycle after it is presented, the latency is taken when it is presented
+integer n_acked;
+integer errors;
+integer lat_sum;
+integer lat_max;
+integer aw_level_max;
+integer aw_stalls;
+always @(posedge clk) begin
+	if(~rst_n) begin
+		pkt_ack      <= 1'b0;
+		n_acked      <= 0;
+		errors       <= 0;
+		lat_sum      <= 0;
+		lat_max      <= 0;
+		aw_level_max <= 0;
+		aw_stalls    <= 0;
+	end else begin
+		pkt_ack <= pkt_v & ~pkt_ack;
+		if(pkt_v & pkt_ack) begin
+			if(pkt_addr !== (n_acked % NB_DESC) * BUF_SIZE || pkt_len !== exp_len(n_acked) || pkt_eop !== 1'b1) begin
+				if(errors < 10)
+					$display("%m buffer %0d: addr 0x%h len %0d eop %b, expected 0x%h len %0d", n_acked, pkt_addr, pkt_len, pkt_eop,
+					         (n_acked % NB_DESC) * BUF_SIZE, exp_len(n_acked));
+				errors <= errors + 1;
+			end
+			lat_sum <= lat_sum + cycle - 1 - t_w[n_acked];
+			if(cycle - 1 - t_w[n_acked] > lat_max)
+				lat_max <= cycle - 1 - t_w[n_acked];
+			n_acked <= n_acked + 1;
+		end
+		if(snoop.aw_level > aw_level_max)
+			aw_level_max <= snoop.aw_level;
+		if(s_awvalid & ~s_awready & m_awready)
+			aw_stalls <= aw_stalls + 1;
+	end
+end
+
+integer w;
+integer t_start;
+initial begin
+	for(w = 0; w < WORDS; w = w + 1)
+		ring[w] = 0;
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	repeat(10) @(posedge clk);
+	init <= 1'b1;
+	@(posedge clk);
+	init <= 1'b0;
+	wait(poll_state == POLL);
+	@(posedge clk);
+	start   <= 1'b1;
+	nic_en  <= 1'b1;
+	t_start = cycle;
+	while(n_acked < N_PKTS && cycle - t_start < N_PKTS * (FRAME_GAP + W_DELAY + 64) + 10000)
+		@(posedge clk);
+	done <= 1'b1;
+end
+
+endmodule
+`default_nettype wire
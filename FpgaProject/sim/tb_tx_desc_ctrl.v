@@ -0,0 +1,247 @@
+/*
+Testbench of tx_desc_ctrl with HEAD_WB and HAIRPIN, checks that the rx buffers are handed back to their queues in ring order.
+N_PKTS buffers of random rx queues (0-3) are requested like rx_queue_arbiter does (REQ_PCT percent of the idle cycles),
+every fourth buffer on average continues the frame in the next one. Each descriptor written into the ring bram is checked
+for its buffer address.
+A NIC model takes the tail pointer writes after PCIE_LAT cycles, sends one descriptor every 1 to SEND_GAP cycles up to
+the tail and writes its head into the word behind the ring once it has moved (WB_PCT percent per cycle), so tx_desc_ctrl
+sees the head word move in steps of one or several descriptors.
+The buf_free<q>_o pulses are checked: at most one per cycle, for the descriptors in ring order, each for the queue of its
+buffer and only once the written back head has passed the descriptor. At the end all buffers have to be freed.
+*/
+`timescale 1ns / 1ps
+`default_nettype none
+module tb_tx_desc_ctrl #(
+	parameter NB_DESC = 64,
+	parameter N_PKTS = 2048,
+	parameter REQ_PCT = 50,
+	parameter SEND_GAP = 4, //max. cycles per descriptor sent by the NIC
+	parameter WB_PCT = 20,
+	parameter PCIE_LAT = 40,
+	parameter SEED = 1
+)();
+
+localparam DESC_IX_WIDTH = $clog2(NB_DESC);
+localparam BASE_ADDR     = 32'hA000_0000;
+
+reg clk = 1'b0;
+always #2 clk = ~clk;
+
+reg rst_n = 1'b0;
+reg start = 1'b0;
+integer cycle = 0;
+always @(posedge clk)
+	cycle <= cycle + 1;
+
+integer seed = SEED;
+function integer rand_int(input integer n);
+	rand_int = ($random(seed) & 32'h7fff_ffff) % n;
+endfunction
+
+wire[31:0]  b_addr;
+wire[127:0] b_din;
+reg[127:0]  b_dout;
+wire        b_en;
+wire[15:0]  b_we;
+wire        b_wren;
+
+reg[31:0]   pkt_addr;
+reg[15:0]   pkt_len;
+reg         pkt_eop;
+reg[1:0]    pkt_queue;
+reg         xmit_req = 1'b0;
+wire        xmit_ack;
+wire[3:0]   buf_free;
+
+wire[31:0]  tail_ptr;
+wire        pcie_start;
+reg         pcie_ack;
+
+tx_desc_ctrl #(
+	.NB_DESC(NB_DESC),
+	.HEAD_WB(1),
+	.HAIRPIN(1)
+) dut (
+	.clk_i(clk),
+	.rst_i_n(rst_n),
+	.addr_o(b_addr),
+	.clk_o(),
+	.data_o(b_din),
+	.data_i(b_dout),
+	.en_o(b_en),
+	.rst_o(),
+	.wea_o(b_we),
+	.wren_o(b_wren),
+	.start_i(start),
+	.init_i(1'b0),
+	.nic_tdt_addr_i(64'h0000_0000_f000_6018),
+	.fpga_base_addr_i(BASE_ADDR),
+	.pkt_addr_i(pkt_addr),
+	.pkt_len_i(pkt_len),
+	.pkt_eop_i(pkt_eop),
+	.xmit_req_i(xmit_req),
+	.xmit_ack_o(xmit_ack),
+	.pkt_queue_i(pkt_queue),
+	.buf_free0_o(buf_free[0]),
+	.buf_free1_o(buf_free[1]),
+	.buf_free2_o(buf_free[2]),
+	.buf_free3_o(buf_free[3]),
+	.nic_phys_addr_o(),
+	.nic_tx_tail_pointer_o(tail_ptr),
+	.pcie_rq_start_o(pcie_start),
+	.pcie_rq_ack_i(pcie_ack),
+	.ring_level_o()
+);
+
+	//expected descriptors: buffer address and rx queue of each descriptor in the ring
+reg[31:0] exp_addr[0:NB_DESC-1];
+reg[1:0]  exp_queue[0:NB_DESC-1];
+integer   n_req = 0;
+integer   errors = 0;
+
+	//ring bram with the head write-back word behind the ring, port A belongs to the NIC model, read latency 1
+reg[127:0] ring[0:NB_DESC];
+reg        head_we = 1'b0;
+reg[DESC_IX_WIDTH-1:0] head_wb_val;
+wire[DESC_IX_WIDTH:0]  b_word = b_addr / 16;
+always @(posedge clk) begin
+	if(b_en) begin
+		b_dout <= ring[b_word];
+		if(b_we == 16'hFFFF) begin
+			ring[b_word] <= b_din;
+			if(b_word >= NB_DESC) begin
+				if(errors < 10)
+					$display("descriptor write into the head write-back word");
+				errors = errors + 1;
+			end else if(dut.tx_desc_state != 0 && b_din[63:0] !== {32'h0, exp_addr[b_word] | BASE_ADDR}) begin
+				if(errors < 10)
+					$display("descriptor %0d: buffer 0x%h, expected 0x%h", b_word, b_din[63:0], {32'h0, exp_addr[b_word] | BASE_ADDR});
+				errors = errors + 1;
+			end
+		end else if(b_we != 0) begin
+			if(errors < 10)
+				$display("descriptor %0d: partial write %h", b_word, b_we);
+			errors = errors + 1;
+		end
+	end
+	if(head_we)
+		ring[NB_DESC] <= {{(128-DESC_IX_WIDTH){1'b0}}, head_wb_val};
+end
+
+	//requests like rx_queue_arbiter: held until the ack, a frame stays on its queue
+reg in_frame = 1'b0;
+always @(posedge clk) begin
+	if(~rst_n) begin
+		xmit_req <= 1'b0;
+	end else if(xmit_ack) begin
+		xmit_req <= 1'b0;
+		exp_addr[n_req % NB_DESC]  <= pkt_addr;
+		exp_queue[n_req % NB_DESC] <= pkt_queue;
+		n_req    = n_req + 1;
+		in_frame <= ~pkt_eop;
+	end else if(start && ~xmit_req && n_req < N_PKTS && rand_int(100) < REQ_PCT) begin
+		if(~in_frame)
+			pkt_queue <= rand_int(4);
+		pkt_addr <= rand_int(64) * 2048;
+		pkt_len  <= 60 + rand_int(1400);
+		pkt_eop  <= n_req == N_PKTS - 1 || rand_int(4) != 0;
+		xmit_req <= 1'b1;
+	end
+end
+
+	//NIC: tail pointer writes after PCIE_LAT cycles, sends up to the tail and writes back its head now and then
+reg[DESC_IX_WIDTH-1:0] nic_head;
+reg[DESC_IX_WIDTH-1:0] nic_tail;
+integer pcie_cnt;
+integer n_sent;
+integer n_head_wb; //descriptors passed by the written back head
+integer send_gap;
+always @(posedge clk) begin
+	pcie_ack <= 1'b0;
+	head_we  <= 1'b0;
+	if(~rst_n) begin
+		pcie_cnt  <= 0;
+		nic_head  <= 0;
+		nic_tail  <= 0;
+		n_sent    <= 0;
+		n_head_wb <= 0;
+		send_gap  <= 0;
+	end else begin
+		if(pcie_start & ~pcie_ack) begin
+			pcie_cnt <= pcie_cnt + 1;
+			if(pcie_cnt == PCIE_LAT) begin
+				pcie_cnt <= 0;
+				pcie_ack <= 1'b1;
+				nic_tail <= tail_ptr[DESC_IX_WIDTH-1:0];
+			end
+		end
+		if(send_gap != 0) begin
+			send_gap <= send_gap - 1;
+		end else if(nic_head != nic_tail) begin
+			nic_head <= nic_head + 1'b1;
+			n_sent   <= n_sent + 1;
+			send_gap <= rand_int(SEND_GAP);
+		end
+		if(n_head_wb != n_sent && rand_int(100) < WB_PCT) begin
+			head_we     <= 1'b1;
+			head_wb_val <= nic_head;
+			n_head_wb   <= n_sent;
+		end
+	end
+end
+
+	//freed buffers: one per cycle, in ring order, for the queue of the buffer and only behind the written back head
+integer n_freed = 0;
+integer n_freed_q[0:3];
+integer q;
+always @(posedge clk) begin
+	if(rst_n & buf_free != 0) begin
+		if(buf_free != 4'b0001 && buf_free != 4'b0010 && buf_free != 4'b0100 && buf_free != 4'b1000) begin
+			if(errors < 10)
+				$display("buffer %0d: buf_free %b, more than one queue", n_freed, buf_free);
+			errors = errors + 1;
+		end else if(buf_free !== 4'b0001 << exp_queue[n_freed % NB_DESC]) begin
+			if(errors < 10)
+				$display("buffer %0d: freed for queue mask %b, it belongs to queue %0d", n_freed, buf_free, exp_queue[n_freed % NB_DESC]);
+			errors = errors + 1;
+		end
+		if(n_freed >= n_head_wb) begin
+			if(errors < 10)
+				$display("buffer %0d: freed before the written back head has passed it (%0d descriptors)", n_freed, n_head_wb);
+			errors = errors + 1;
+		end
+		for(q = 0; q < 4; q = q + 1)
+			if(buf_free[q])
+				n_freed_q[q] = n_freed_q[q] + 1;
+		n_freed = n_freed + 1;
+	end
+end
+
+integer n;
+integer t_start;
+initial begin
+	for(q = 0; q < 4; q = q + 1)
+		n_freed_q[q] = 0;
+	for(n = 0; n <= NB_DESC; n = n + 1)
+		ring[n] = 0; //the head write-back word is zeroed by the driver
+	repeat(10) @(posedge clk);
+	rst_n <= 1'b1;
+	wait(dut.tx_desc_state == 1); //IDLE once the ring is initialized
+	@(posedge clk);
+	start <= 1'b1;
+	t_start = cycle;
+	while(n_freed < N_PKTS && cycle - t_start < N_PKTS * (SEND_GAP + 100) + 10000)
+		@(posedge clk);
+	repeat(100) @(posedge clk);
+
+	$display("tb_tx_desc_ctrl NB_DESC %0d: %0d of %0d buffers requested, %0d sent, %0d freed (queues %0d %0d %0d %0d), %0d errors",
+	         NB_DESC, n_req, N_PKTS, n_sent, n_freed, n_freed_q[0], n_freed_q[1], n_freed_q[2], n_freed_q[3], errors);
+	if(n_req != N_PKTS || n_sent != N_PKTS || n_freed != N_PKTS || errors != 0)
+		$display("FAIL");
+	else
+		$display("PASS");
+	$finish;
+end
+
+endmodule
+`default_nettype wire
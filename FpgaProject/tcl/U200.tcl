@@ -3,16 +3,59 @@ set outputDir [pwd]/vivado_project_U200
 create_project DpdkHostBypassing $outputDir -part xcu200-fsgd2104-2-e -force
 set_property board_part xilinx.com:au200:part0:1.3 [current_project]
 
+# packet buffer per descriptor in bytes (1024, 2048, 4096 or 9216), must match FPGA_BUF_SIZE of the BypassApp
+set pkt_buf_size 2048
+
+# rx queues served by the fpga (1, 2 or 4), must match BYPASS_RINGS of the BypassApp. The NIC spreads the flows over them by RSS.
+# Each queue has its own ring bram and descriptor engine, the packet buffers of queue q start at q * rx_ring_size * pkt_buf_size
+set nb_rx_queues 4
+# descriptors per rx ring, must match RX_RING_SIZE of the BypassApp
+set rx_ring_size 64
+# width of the ethernet stream between the packet handlers and the network function (64 or 256 bit).
+# With 256 the packet handlers stream one packet bram word per beat, 64 splits each word into beats of 8 bytes.
+# The modules also implement 512 bit, but the packet brams and their controllers behind the 256 bit xdma are 256 bit wide.
+set axis_width 64
+# hairpin forwarding (0 or 1): the tx descriptors point directly at the rx buffers, packet handlers and network function are left out.
+# The rx buffers are returned to the NIC after their transmission, needs FPGA_HAIRPIN 1 in the BypassApp.
+set hairpin 0
+# match-action stage (0 or 1) in front of the network function: parser, exact match and ternary tables loaded by the host (not with hairpin).
+# The next header is captured while the previous one is sent, with the 64 bit stream a 64 byte frame takes 12 cycles (10G needs 16.8).
+set match_action 0
+# deep packet buffer (0 or 1) in the on-board DDR4 (C0) between rx_packet_handler and the network function (not with hairpin).
+# Frames are spilled into a 1GB ring while the network function back-pressures, so the rx buffers are not held back.
+set ddr_buffer 0
+if {[lsearch {64 256} $axis_width] < 0} {
+	error "axis_width must be 64 or 256"
+}
+if {$match_action && $hairpin} {
+	error "match_action needs the ethernet stream, it can not be used with hairpin"
+}
+if {$ddr_buffer && $hairpin} {
+	error "ddr_buffer needs the ethernet stream, it can not be used with hairpin"
+}
+if {[lsearch {1 2 4} $nb_rx_queues] < 0} {
+	error "nb_rx_queues must be 1, 2 or 4"
+}
+if {$nb_rx_queues * $rx_ring_size * $pkt_buf_size > 512 * 1024} {
+	error "the packet buffers of $nb_rx_queues rx queues do not fit into the 512KB rx packet bram"
+}
+
 # read verilog files
 read_verilog [pwd]/hdl/configuration_registers.v
 read_verilog [pwd]/hdl/rx_desc_ctrl.v
+read_verilog [pwd]/hdl/rx_desc_snoop.v
 read_verilog [pwd]/hdl/rx_packet_handler.v
+read_verilog [pwd]/hdl/rx_queue_arbiter.v
 read_verilog [pwd]/hdl/tailpointer_delay.v
 read_verilog [pwd]/hdl/tx_desc_ctrl.v
 read_verilog [pwd]/hdl/tx_packet_handler.v
 read_verilog [pwd]/hdl/pcie_core_init.v
 read_verilog [pwd]/hdl/pcie_req_arbiter.v
 read_verilog [pwd]/hdl/pcie_axi_requester.v
+read_verilog [pwd]/hdl/perf_counters.v
+read_verilog [pwd]/hdl/match_action.v
+read_verilog [pwd]/hdl/latency_monitor.v
+read_verilog [pwd]/hdl/ddr_buffer.v
 
 
 # create block design for combining the components
@@ -41,14 +84,23 @@ connect_bd_net [get_bd_pins pcie_core_init/rst_i_n] [get_bd_pins xdma_0/axi_ares
 ## create ring buffer brams, bram controllers, crossbar
 
 
-### create rx ring
-create_bd_cell -type ip -vlnv xilinx.com:ip:axi_bram_ctrl:4.1 axi_bram_ctrl_rx_ring
-set_property -dict [list CONFIG.DATA_WIDTH {256} CONFIG.SINGLE_PORT_BRAM {1} CONFIG.ECC_TYPE {0}] [get_bd_cells axi_bram_ctrl_rx_ring]
+### create rx rings, one per queue
+for {set q 0} {$q < $nb_rx_queues} {incr q} {
+	create_bd_cell -type ip -vlnv xilinx.com:ip:axi_bram_ctrl:4.1 axi_bram_ctrl_rx_ring_$q
+	set_property -dict [list CONFIG.DATA_WIDTH {256} CONFIG.SINGLE_PORT_BRAM {1} CONFIG.ECC_TYPE {0}] [get_bd_cells axi_bram_ctrl_rx_ring_$q]
+
+	create_bd_cell -type ip -vlnv xilinx.com:ip:blk_mem_gen:8.4 bram_rx_ring_$q
+	set_property -dict [list CONFIG.Memory_Type {True_Dual_Port_RAM} CONFIG.Assume_Synchronous_Clk {true} CONFIG.Enable_B {Use_ENB_Pin} CONFIG.Use_RSTB_Pin {true} CONFIG.Port_B_Clock {100} CONFIG.Port_B_Write_Rate {50} CONFIG.Port_B_Enable_Rate {100} CONFIG.EN_SAFETY_CKT {false}] [get_bd_cells bram_rx_ring_$q]
 
-create_bd_cell -type ip -vlnv xilinx.com:ip:blk_mem_gen:8.4 bram_rx_ring
-set_property -dict [list CONFIG.Memory_Type {True_Dual_Port_RAM} CONFIG.Assume_Synchronous_Clk {true} CONFIG.Enable_B {Use_ENB_Pin} CONFIG.Use_RSTB_Pin {true} CONFIG.Port_B_Clock {100} CONFIG.Port_B_Write_Rate {50} CONFIG.Port_B_Enable_Rate {100} CONFIG.EN_SAFETY_CKT {false}] [get_bd_cells bram_rx_ring]
+	connect_bd_intf_net [get_bd_intf_pins bram_rx_ring_$q/BRAM_PORTA] [get_bd_intf_pins axi_bram_ctrl_rx_ring_$q/BRAM_PORTA]
 
-connect_bd_intf_net [get_bd_intf_pins bram_rx_ring/BRAM_PORTA] [get_bd_intf_pins axi_bram_ctrl_rx_ring/BRAM_PORTA]
+	# descriptor write-backs of the NIC are taken from the axi bus of the rx ring instead of polling the bram
+	create_bd_cell -type module -reference rx_desc_snoop rx_desc_snoop_$q
+	set_property CONFIG.NB_DESC $rx_ring_size [get_bd_cells rx_desc_snoop_$q]
+	connect_bd_intf_net [get_bd_intf_pins rx_desc_snoop_$q/m_axi] [get_bd_intf_pins axi_bram_ctrl_rx_ring_$q/S_AXI]
+	connect_bd_net [get_bd_pins rx_desc_snoop_$q/clk_i] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins rx_desc_snoop_$q/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+}
 
 ### create tx ring
 create_bd_cell -type ip -vlnv xilinx.com:ip:axi_bram_ctrl:4.1 axi_bram_ctrl_tx_ring
@@ -94,7 +146,7 @@ connect_bd_net [get_bd_pins xdma_0/axi_aresetn] [get_bd_pins configuration_regis
 
 ### create axi interconnect
 create_bd_cell -type ip -vlnv xilinx.com:ip:axi_interconnect:2.1 axi_interconnect_0
-set_property -dict [list CONFIG.NUM_MI {5}] [get_bd_cells axi_interconnect_0]
+set_property -dict [list CONFIG.NUM_MI [expr 4 + $nb_rx_queues]] [get_bd_cells axi_interconnect_0]
 
 connect_bd_intf_net [get_bd_intf_pins xdma_0/M_AXI_B] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/S00_AXI]
 connect_bd_net [get_bd_pins xdma_0/axi_aclk] [get_bd_pins axi_interconnect_0/ACLK]
@@ -114,12 +166,21 @@ connect_bd_net [get_bd_pins xdma_0/axi_aresetn] [get_bd_pins axi_interconnect_0/
 
 connect_bd_intf_net -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M00_AXI] [get_bd_intf_pins axi_bram_ctrl_rx_buffer/S_AXI]
 connect_bd_intf_net -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M01_AXI] [get_bd_intf_pins axi_bram_ctrl_tx_buffer/S_AXI]
-connect_bd_intf_net [get_bd_intf_pins axi_bram_ctrl_rx_ring/S_AXI] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M02_AXI]
+connect_bd_intf_net [get_bd_intf_pins rx_desc_snoop_0/s_axi] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M02_AXI]
 connect_bd_intf_net [get_bd_intf_pins axi_bram_ctrl_tx_ring/S_AXI] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M03_AXI]
 connect_bd_intf_net [get_bd_intf_pins axi_bram_ctrl_configuration_registers/S_AXI] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/M04_AXI]
-
-connect_bd_net [get_bd_pins axi_bram_ctrl_rx_ring/s_axi_aclk] [get_bd_pins xdma_0/axi_aclk]
-connect_bd_net [get_bd_pins axi_bram_ctrl_rx_ring/s_axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+# rx rings of the queues 1-3 behind the configuration registers
+for {set q 1} {$q < $nb_rx_queues} {incr q} {
+	set mi [format "M%02d" [expr 4 + $q]]
+	connect_bd_net [get_bd_pins xdma_0/axi_aclk] [get_bd_pins axi_interconnect_0/${mi}_ACLK]
+	connect_bd_net [get_bd_pins xdma_0/axi_aresetn] [get_bd_pins axi_interconnect_0/${mi}_ARESETN]
+	connect_bd_intf_net [get_bd_intf_pins rx_desc_snoop_$q/s_axi] -boundary_type upper [get_bd_intf_pins axi_interconnect_0/${mi}_AXI]
+}
+
+for {set q 0} {$q < $nb_rx_queues} {incr q} {
+	connect_bd_net [get_bd_pins axi_bram_ctrl_rx_ring_$q/s_axi_aclk] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins axi_bram_ctrl_rx_ring_$q/s_axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+}
 connect_bd_net [get_bd_pins axi_bram_ctrl_tx_ring/s_axi_aclk] [get_bd_pins xdma_0/axi_aclk]
 connect_bd_net [get_bd_pins axi_bram_ctrl_tx_ring/s_axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
 connect_bd_net [get_bd_pins axi_bram_ctrl_rx_buffer/s_axi_aclk] [get_bd_pins xdma_0/axi_aclk]
@@ -154,68 +215,158 @@ connect_bd_intf_net [get_bd_intf_pins axi_dwidth_converter_0/M_AXI] [get_bd_intf
 
 ## create rx logic
 
-create_bd_cell -type module -reference rx_packet_handler rx_packet_handler_0
-create_bd_cell -type module -reference rx_desc_ctrl rx_desc_ctrl_0
-
-connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_ack_o] [get_bd_pins rx_desc_ctrl_0/pkt_ack_i]
-connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_addr_i] [get_bd_pins rx_desc_ctrl_0/pkt_addr_o]
-connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_len_i] [get_bd_pins rx_desc_ctrl_0/pkt_len_o]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/pkt_addr_v_o] [get_bd_pins rx_packet_handler_0/pkt_addr_v_i]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/clk_i] [get_bd_pins xdma_0/axi_aclk]
-connect_bd_net [get_bd_pins rx_packet_handler_0/axi_clk] [get_bd_pins xdma_0/axi_aclk]
-connect_bd_net [get_bd_pins rx_packet_handler_0/axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
-
-connect_bd_intf_net [get_bd_intf_pins rx_desc_ctrl_0/BRAM_PORT] [get_bd_intf_pins bram_rx_ring/BRAM_PORTB]
-connect_bd_intf_net [get_bd_intf_pins rx_packet_handler_0/BRAM_PORT] [get_bd_intf_pins bram_rx_buffer/BRAM_PORTB]
-
-create_bd_cell -type module -reference tailpointer_delay tailpointer_delay_rx
-connect_bd_net [get_bd_pins tailpointer_delay_rx/clk_i] [get_bd_pins xdma_0/axi_aclk]
-connect_bd_net [get_bd_pins tailpointer_delay_rx/rstn_i] [get_bd_pins xdma_0/axi_aresetn]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/nic_phys_addr_o] [get_bd_pins tailpointer_delay_rx/s_phys_addr_i]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/nic_rx_tail_pointer_o] [get_bd_pins tailpointer_delay_rx/s_tail_pointer_i]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/pcie_rq_start_o] [get_bd_pins tailpointer_delay_rx/s_pcie_write_i]
-connect_bd_net [get_bd_pins tailpointer_delay_rx/s_pcie_write_ack_o] [get_bd_pins rx_desc_ctrl_0/pcie_rq_ack_i]
-
-connect_bd_net [get_bd_pins tailpointer_delay_rx/m_phys_addr_o] [get_bd_pins pcie_req_arbiter/pcie_addr0_i]
-connect_bd_net [get_bd_pins tailpointer_delay_rx/m_tail_pointer_o] [get_bd_pins pcie_req_arbiter/pcie_data0_i]
-connect_bd_net [get_bd_pins tailpointer_delay_rx/m_pcie_write_o] [get_bd_pins pcie_req_arbiter/pcie_valid0_i]
-connect_bd_net [get_bd_pins pcie_req_arbiter/fifo_ready0_o] [get_bd_pins tailpointer_delay_rx/m_pcie_write_ack_i]
-
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/nic_base_addr_i] [get_bd_pins configuration_registers/nic_base_addr_reg_o]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/fpga_base_addr_i] [get_bd_pins configuration_registers/fpga_base_addr_reg_o]
-connect_bd_net [get_bd_pins rx_desc_ctrl_0/start_i] [get_bd_pins configuration_registers/start_o]
-connect_bd_net [get_bd_pins pcie_core_init/init_o] [get_bd_pins rx_desc_ctrl_0/init_i]
+# connects a tail pointer write source {cell addr_pin data_pin valid_pin ack_pin} to port 0 or 1 of a pcie_req_arbiter
+proc connect_doorbell {src arb port} {
+	lassign $src cell addr data valid ack
+	connect_bd_net [get_bd_pins $cell/$addr] [get_bd_pins $arb/pcie_addr${port}_i]
+	connect_bd_net [get_bd_pins $cell/$data] [get_bd_pins $arb/pcie_data${port}_i]
+	connect_bd_net [get_bd_pins $cell/$valid] [get_bd_pins $arb/pcie_valid${port}_i]
+	connect_bd_net [get_bd_pins $arb/fifo_ready${port}_o] [get_bd_pins $cell/$ack]
+}
+
+# the buffers of all queues are merged frame by frame for the packet handler (for tx_desc_ctrl with hairpin)
+create_bd_cell -type module -reference rx_queue_arbiter rx_queue_arbiter
+set_property CONFIG.NB_QUEUES $nb_rx_queues [get_bd_cells rx_queue_arbiter]
+connect_bd_net [get_bd_pins rx_queue_arbiter/clk_i] [get_bd_pins xdma_0/axi_aclk]
+connect_bd_net [get_bd_pins rx_queue_arbiter/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+
+# timestamps of the rx descriptors and residence time histogram, see the latency monitor section below
+create_bd_cell -type module -reference latency_monitor latency_monitor
+set_property CONFIG.AXIS_WIDTH $axis_width [get_bd_cells latency_monitor]
+connect_bd_net [get_bd_pins latency_monitor/clk_i] [get_bd_pins xdma_0/axi_aclk]
+connect_bd_net [get_bd_pins latency_monitor/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+
+if {!$hairpin} {
+	create_bd_cell -type module -reference rx_packet_handler rx_packet_handler_0
+	if {$axis_width != 64} {
+		set_property -dict [list CONFIG.DATA_WIDTH $axis_width CONFIG.AXIS_WIDTH $axis_width] [get_bd_cells rx_packet_handler_0]
+	}
+	# the bram port is as wide as the data width of the module
+	set_property CONFIG.MEM_WIDTH [get_property CONFIG.DATA_WIDTH [get_bd_cells rx_packet_handler_0]] [get_bd_intf_pins rx_packet_handler_0/BRAM_PORT]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/axi_clk] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+	connect_bd_intf_net [get_bd_intf_pins rx_packet_handler_0/BRAM_PORT] [get_bd_intf_pins bram_rx_buffer/BRAM_PORTB]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_ack_o] [get_bd_pins rx_queue_arbiter/pkt_ack_i]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_addr_i] [get_bd_pins rx_queue_arbiter/pkt_addr_o]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_len_i] [get_bd_pins rx_queue_arbiter/pkt_len_o]
+	connect_bd_net [get_bd_pins rx_packet_handler_0/pkt_eop_i] [get_bd_pins rx_queue_arbiter/pkt_eop_o]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_addr_v_o] [get_bd_pins rx_packet_handler_0/pkt_addr_v_i]
+}
+
+set rx_doorbells {}
+for {set q 0} {$q < $nb_rx_queues} {incr q} {
+	create_bd_cell -type module -reference rx_desc_ctrl rx_desc_ctrl_$q
+	set_property CONFIG.NB_DESC $rx_ring_size [get_bd_cells rx_desc_ctrl_$q]
+	set_property CONFIG.BUF_SIZE $pkt_buf_size [get_bd_cells rx_desc_ctrl_$q]
+	set_property CONFIG.BUF_OFFS [expr $q * $rx_ring_size * $pkt_buf_size] [get_bd_cells rx_desc_ctrl_$q]
+	set_property CONFIG.DATA_WIDTH {256} [get_bd_cells rx_desc_ctrl_$q]
+	set_property CONFIG.SNOOP {1} [get_bd_cells rx_desc_ctrl_$q]
+	set_property CONFIG.HAIRPIN $hairpin [get_bd_cells rx_desc_ctrl_$q]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/clk_i] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+	connect_bd_intf_net [get_bd_intf_pins rx_desc_ctrl_$q/BRAM_PORT] [get_bd_intf_pins bram_rx_ring_$q/BRAM_PORTB]
+
+	# rx_desc_snoop_$q sits in front of the bram controller of the ring, see the rx rings above
+	connect_bd_net [get_bd_pins rx_desc_snoop_$q/desc_done_o] [get_bd_pins rx_desc_ctrl_$q/desc_done_i]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/desc_clr_o] [get_bd_pins rx_desc_snoop_$q/desc_clr_i]
+
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_ack${q}_o] [get_bd_pins rx_desc_ctrl_$q/pkt_ack_i]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_addr${q}_i] [get_bd_pins rx_desc_ctrl_$q/pkt_addr_o]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_len${q}_i] [get_bd_pins rx_desc_ctrl_$q/pkt_len_o]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_eop${q}_i] [get_bd_pins rx_desc_ctrl_$q/pkt_eop_o]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/pkt_addr_v_o] [get_bd_pins rx_queue_arbiter/pkt_addr_v${q}_i]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/pkt_ts_o] [get_bd_pins rx_queue_arbiter/pkt_ts${q}_i]
+	connect_bd_net [get_bd_pins latency_monitor/ts_o] [get_bd_pins rx_desc_ctrl_$q/ts_i]
+
+	create_bd_cell -type module -reference tailpointer_delay tailpointer_delay_rx_$q
+	connect_bd_net [get_bd_pins tailpointer_delay_rx_$q/clk_i] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins tailpointer_delay_rx_$q/rstn_i] [get_bd_pins xdma_0/axi_aresetn]
+	connect_bd_net [get_bd_pins tailpointer_delay_rx_$q/itr_cfg_i] [get_bd_pins configuration_registers/itr_cfg_reg_o]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/nic_phys_addr_o] [get_bd_pins tailpointer_delay_rx_$q/s_phys_addr_i]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/nic_rx_tail_pointer_o] [get_bd_pins tailpointer_delay_rx_$q/s_tail_pointer_i]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/pcie_rq_start_o] [get_bd_pins tailpointer_delay_rx_$q/s_pcie_write_i]
+	connect_bd_net [get_bd_pins tailpointer_delay_rx_$q/s_pcie_write_ack_o] [get_bd_pins rx_desc_ctrl_$q/pcie_rq_ack_i]
+	lappend rx_doorbells [list tailpointer_delay_rx_$q m_phys_addr_o m_tail_pointer_o m_pcie_write_o m_pcie_write_ack_i]
+
+	if {$q == 0} {
+		connect_bd_net [get_bd_pins rx_desc_ctrl_$q/nic_rdt_addr_i] [get_bd_pins configuration_registers/nic_rdt_addr_reg_o]
+	} else {
+		connect_bd_net [get_bd_pins rx_desc_ctrl_$q/nic_rdt_addr_i] [get_bd_pins configuration_registers/nic_rdt_addr${q}_reg_o]
+	}
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/fpga_base_addr_i] [get_bd_pins configuration_registers/fpga_base_addr_reg_o]
+	connect_bd_net [get_bd_pins rx_desc_ctrl_$q/start_i] [get_bd_pins configuration_registers/start_o]
+	connect_bd_net [get_bd_pins pcie_core_init/init_o] [get_bd_pins rx_desc_ctrl_$q/init_i]
+}
+
+# the tail pointer writes of the rx queues are merged pairwise by a tree of pcie_req_arbiters into port 0 of pcie_req_arbiter
+set level 0
+while {[llength $rx_doorbells] > 1} {
+	set merged {}
+	for {set i 0} {$i < [llength $rx_doorbells]} {incr i 2} {
+		set arb pcie_req_arbiter_rx_${level}_[expr $i / 2]
+		create_bd_cell -type module -reference pcie_req_arbiter $arb
+		connect_bd_net [get_bd_pins $arb/clk_i] [get_bd_pins xdma_0/axi_aclk]
+		connect_bd_net [get_bd_pins $arb/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+		connect_doorbell [lindex $rx_doorbells $i] $arb 0
+		connect_doorbell [lindex $rx_doorbells [expr $i + 1]] $arb 1
+		lappend merged [list $arb pcie_addr_o pcie_data_o pcie_valid_o pcie_ack_i]
+	}
+	set rx_doorbells $merged
+	incr level
+}
+set rx_doorbell [lindex $rx_doorbells 0]
+connect_doorbell $rx_doorbell pcie_req_arbiter 0
 
 
 
 ## create tx logic
 create_bd_cell -type module -reference tx_desc_ctrl tx_desc_ctrl_0
-create_bd_cell -type module -reference tx_packet_handler tx_packet_handler_0
-
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/clk_i] [get_bd_pins xdma_0/axi_aclk]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
-connect_bd_net [get_bd_pins tx_packet_handler_0/axi_clk] [get_bd_pins xdma_0/axi_aclk]
-connect_bd_net [get_bd_pins tx_packet_handler_0/axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
-connect_bd_net [get_bd_pins tx_packet_handler_0/pkt_addr_o] [get_bd_pins tx_desc_ctrl_0/pkt_addr_i]
-connect_bd_net [get_bd_pins tx_desc_ctrl_0/pkt_len_i] [get_bd_pins tx_packet_handler_0/pkt_len_o]
-connect_bd_net [get_bd_pins tx_packet_handler_0/xmit_req_o] [get_bd_pins tx_desc_ctrl_0/xmit_req_i]
-connect_bd_net [get_bd_pins tx_packet_handler_0/xmit_ack_i] [get_bd_pins tx_desc_ctrl_0/xmit_ack_o]
 
+if {$hairpin} {
+	# the received buffers are sent from the rx packet bram and handed back to their rx queue once the NIC has sent them
+	set_property -dict [list CONFIG.HAIRPIN {1} CONFIG.HEAD_WB {1}] [get_bd_cells tx_desc_ctrl_0]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_addr_o] [get_bd_pins tx_desc_ctrl_0/pkt_addr_i]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_len_o] [get_bd_pins tx_desc_ctrl_0/pkt_len_i]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_eop_o] [get_bd_pins tx_desc_ctrl_0/pkt_eop_i]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_queue_o] [get_bd_pins tx_desc_ctrl_0/pkt_queue_i]
+	connect_bd_net [get_bd_pins rx_queue_arbiter/pkt_addr_v_o] [get_bd_pins tx_desc_ctrl_0/xmit_req_i]
+	connect_bd_net [get_bd_pins tx_desc_ctrl_0/xmit_ack_o] [get_bd_pins rx_queue_arbiter/pkt_ack_i]
+	for {set q 0} {$q < $nb_rx_queues} {incr q} {
+		connect_bd_net [get_bd_pins tx_desc_ctrl_0/buf_free${q}_o] [get_bd_pins rx_desc_ctrl_$q/buf_free_i]
+	}
+} else {
+	create_bd_cell -type module -reference tx_packet_handler tx_packet_handler_0
+	set_property CONFIG.BUF_SIZE $pkt_buf_size [get_bd_cells tx_packet_handler_0]
+	if {$axis_width != 64} {
+		set_property -dict [list CONFIG.DATA_WIDTH $axis_width CONFIG.AXIS_WIDTH $axis_width] [get_bd_cells tx_packet_handler_0]
+	}
+	# the bram port is as wide as the data width of the module
+	set_property CONFIG.MEM_WIDTH [get_property CONFIG.DATA_WIDTH [get_bd_cells tx_packet_handler_0]] [get_bd_intf_pins tx_packet_handler_0/BRAM_PORT]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/axi_clk] [get_bd_pins xdma_0/axi_aclk]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/pkt_addr_o] [get_bd_pins tx_desc_ctrl_0/pkt_addr_i]
+	connect_bd_net [get_bd_pins tx_desc_ctrl_0/pkt_len_i] [get_bd_pins tx_packet_handler_0/pkt_len_o]
+	connect_bd_net [get_bd_pins tx_desc_ctrl_0/pkt_eop_i] [get_bd_pins tx_packet_handler_0/pkt_eop_o]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/xmit_req_o] [get_bd_pins tx_desc_ctrl_0/xmit_req_i]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/xmit_ack_i] [get_bd_pins tx_desc_ctrl_0/xmit_ack_o]
+	connect_bd_intf_net [get_bd_intf_pins tx_packet_handler_0/BRAM_PORT] [get_bd_intf_pins bram_tx_buffer/BRAM_PORTB]
+	connect_bd_net [get_bd_pins configuration_registers/start_o] [get_bd_pins tx_packet_handler_0/start_i]
+	connect_bd_net [get_bd_pins tx_packet_handler_0/init_i] [get_bd_pins pcie_core_init/init_o]
+}
 
-connect_bd_intf_net [get_bd_intf_pins tx_packet_handler_0/BRAM_PORT] [get_bd_intf_pins bram_tx_buffer/BRAM_PORTB]
 connect_bd_intf_net [get_bd_intf_pins tx_desc_ctrl_0/BRAM_PORT] [get_bd_intf_pins bram_tx_ring/BRAM_PORTB]
 
-connect_bd_net [get_bd_pins tx_desc_ctrl_0/nic_base_addr_i] [get_bd_pins configuration_registers/nic_base_addr_reg_o]
+connect_bd_net [get_bd_pins tx_desc_ctrl_0/nic_tdt_addr_i] [get_bd_pins configuration_registers/nic_tdt_addr_reg_o]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/fpga_base_addr_i] [get_bd_pins configuration_registers/fpga_base_addr_reg_o]
-connect_bd_net [get_bd_pins configuration_registers/start_o] [get_bd_pins tx_packet_handler_0/start_i]
 connect_bd_net [get_bd_pins configuration_registers/start_o] [get_bd_pins tx_desc_ctrl_0/start_i]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/init_i] [get_bd_pins pcie_core_init/init_o]
-connect_bd_net [get_bd_pins tx_packet_handler_0/init_i] [get_bd_pins pcie_core_init/init_o]
 
 create_bd_cell -type module -reference tailpointer_delay tailpointer_delay_tx
 connect_bd_net [get_bd_pins tailpointer_delay_tx/clk_i] [get_bd_pins xdma_0/axi_aclk]
 connect_bd_net [get_bd_pins tailpointer_delay_tx/rstn_i] [get_bd_pins xdma_0/axi_aresetn]
+connect_bd_net [get_bd_pins tailpointer_delay_tx/itr_cfg_i] [get_bd_pins configuration_registers/itr_cfg_reg_o]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/nic_phys_addr_o] [get_bd_pins tailpointer_delay_tx/s_phys_addr_i]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/nic_tx_tail_pointer_o] [get_bd_pins tailpointer_delay_tx/s_tail_pointer_i]
 connect_bd_net [get_bd_pins tx_desc_ctrl_0/pcie_rq_start_o] [get_bd_pins tailpointer_delay_tx/s_pcie_write_i]
@@ -229,11 +380,122 @@ connect_bd_net [get_bd_pins pcie_req_arbiter/fifo_ready1_o] [get_bd_pins tailpoi
 
 ## sample network function
 
-create_bd_cell -type ip -vlnv xilinx.com:ip:axis_data_fifo:2.0 sample_network_function
-connect_bd_intf_net [get_bd_intf_pins rx_packet_handler_0/m_axis_eth] [get_bd_intf_pins sample_network_function/S_AXIS]
-connect_bd_intf_net [get_bd_intf_pins sample_network_function/M_AXIS] [get_bd_intf_pins tx_packet_handler_0/s_axis_eth]
-connect_bd_net [get_bd_pins sample_network_function/s_axis_aresetn] [get_bd_pins xdma_0/axi_aresetn]
-connect_bd_net [get_bd_pins sample_network_function/s_axis_aclk] [get_bd_pins xdma_0/axi_aclk]
+if {!$hairpin} {
+	create_bd_cell -type ip -vlnv xilinx.com:ip:axis_data_fifo:2.0 sample_network_function
+	connect_bd_intf_net [get_bd_intf_pins rx_packet_handler_0/m_axis_eth] [get_bd_intf_pins latency_monitor/s_axis_eth]
+	# the rx stream passes the optional stages in this order
+	set rx_stream latency_monitor/m_axis_eth
+	if {$ddr_buffer} {
+		create_bd_cell -type module -reference ddr_buffer ddr_buffer
+		set_property CONFIG.AXIS_WIDTH $axis_width [get_bd_cells ddr_buffer]
+		connect_bd_net [get_bd_pins ddr_buffer/clk_i] [get_bd_pins xdma_0/axi_aclk]
+		connect_bd_net [get_bd_pins ddr_buffer/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+		connect_bd_intf_net [get_bd_intf_pins $rx_stream] [get_bd_intf_pins ddr_buffer/s_axis_eth]
+		set rx_stream ddr_buffer/m_axis_eth
+
+		create_bd_cell -type ip -vlnv xilinx.com:ip:ddr4:2.2 ddr4_0
+		set_property -dict [list CONFIG.C0_DDR4_BOARD_INTERFACE {ddr4_sdram_c0} CONFIG.C0_CLOCK_BOARD_INTERFACE {default_300mhz_clk0}] [get_bd_cells ddr4_0]
+		make_bd_intf_pins_external  [get_bd_intf_pins ddr4_0/C0_DDR4]
+		make_bd_intf_pins_external  [get_bd_intf_pins ddr4_0/C0_SYS_CLK]
+		# sys_rst of the MIG is active high
+		create_bd_cell -type ip -vlnv xilinx.com:ip:util_vector_logic:2.0 ddr4_sys_rst
+		set_property -dict [list CONFIG.C_SIZE {1} CONFIG.C_OPERATION {not}] [get_bd_cells ddr4_sys_rst]
+		connect_bd_net [get_bd_pins ddr4_sys_rst/Op1] [get_bd_pins xdma_0/axi_aresetn]
+		connect_bd_net [get_bd_pins ddr4_sys_rst/Res] [get_bd_pins ddr4_0/sys_rst]
+		create_bd_cell -type ip -vlnv xilinx.com:ip:proc_sys_reset:5.0 ddr4_ui_rst
+		set_property CONFIG.C_EXT_RESET_HIGH {1} [get_bd_cells ddr4_ui_rst]
+		connect_bd_net [get_bd_pins ddr4_ui_rst/slowest_sync_clk] [get_bd_pins ddr4_0/c0_ddr4_ui_clk]
+		connect_bd_net [get_bd_pins ddr4_ui_rst/ext_reset_in] [get_bd_pins ddr4_0/c0_ddr4_ui_clk_sync_rst]
+		connect_bd_net [get_bd_pins ddr4_ui_rst/peripheral_aresetn] [get_bd_pins ddr4_0/c0_ddr4_aresetn]
+
+		# width and clock conversion from the ethernet stream to the 512 bit MIG port
+		create_bd_cell -type ip -vlnv xilinx.com:ip:smartconnect:1.0 ddr4_smartconnect
+		set_property -dict [list CONFIG.NUM_SI {1} CONFIG.NUM_MI {1} CONFIG.NUM_CLKS {2}] [get_bd_cells ddr4_smartconnect]
+		connect_bd_intf_net [get_bd_intf_pins ddr_buffer/m_axi] [get_bd_intf_pins ddr4_smartconnect/S00_AXI]
+		connect_bd_intf_net [get_bd_intf_pins ddr4_smartconnect/M00_AXI] [get_bd_intf_pins ddr4_0/C0_DDR4_S_AXI]
+		connect_bd_net [get_bd_pins ddr4_smartconnect/aclk] [get_bd_pins xdma_0/axi_aclk]
+		connect_bd_net [get_bd_pins ddr4_smartconnect/aclk1] [get_bd_pins ddr4_0/c0_ddr4_ui_clk]
+		connect_bd_net [get_bd_pins ddr4_smartconnect/aresetn] [get_bd_pins xdma_0/axi_aresetn]
+	}
+	if {$match_action} {
+		create_bd_cell -type module -reference match_action match_action
+		set_property CONFIG.AXIS_WIDTH $axis_width [get_bd_cells match_action]
+		connect_bd_net [get_bd_pins match_action/axi_clk] [get_bd_pins xdma_0/axi_aclk]
+		connect_bd_net [get_bd_pins match_action/axi_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+		connect_bd_net [get_bd_pins match_action/init_i] [get_bd_pins pcie_core_init/init_o]
+		connect_bd_net [get_bd_pins match_action/wr_i] [get_bd_pins configuration_registers/ma_wr_o]
+		connect_bd_net [get_bd_pins match_action/addr_i] [get_bd_pins configuration_registers/ma_addr_o]
+		connect_bd_net [get_bd_pins match_action/wr_data_i] [get_bd_pins configuration_registers/ma_data_o]
+		connect_bd_net [get_bd_pins match_action/rd_data_o] [get_bd_pins configuration_registers/ma_data_i]
+		connect_bd_intf_net [get_bd_intf_pins $rx_stream] [get_bd_intf_pins match_action/s_axis_eth]
+		set rx_stream match_action/m_axis_eth
+	}
+	connect_bd_intf_net [get_bd_intf_pins $rx_stream] [get_bd_intf_pins sample_network_function/S_AXIS]
+	connect_bd_intf_net [get_bd_intf_pins sample_network_function/M_AXIS] [get_bd_intf_pins tx_packet_handler_0/s_axis_eth]
+	connect_bd_net [get_bd_pins sample_network_function/s_axis_aresetn] [get_bd_pins xdma_0/axi_aresetn]
+	connect_bd_net [get_bd_pins sample_network_function/s_axis_aclk] [get_bd_pins xdma_0/axi_aclk]
+}
+
+
+## performance counters, read by the host behind the configuration registers
+
+create_bd_cell -type module -reference perf_counters perf_counters
+connect_bd_net [get_bd_pins perf_counters/clk_i] [get_bd_pins xdma_0/axi_aclk]
+connect_bd_net [get_bd_pins perf_counters/rst_i_n] [get_bd_pins xdma_0/axi_aresetn]
+connect_bd_net [get_bd_pins perf_counters/init_i] [get_bd_pins pcie_core_init/init_o]
+connect_bd_net [get_bd_pins perf_counters/snapshot_i] [get_bd_pins configuration_registers/perf_snapshot_o]
+connect_bd_net [get_bd_pins perf_counters/rd_addr_i] [get_bd_pins configuration_registers/perf_addr_o]
+connect_bd_net [get_bd_pins perf_counters/rd_data_o] [get_bd_pins configuration_registers/perf_data_i]
+
+connect_bd_net [get_bd_pins perf_counters/rx_pkt_len_i] [get_bd_pins rx_queue_arbiter/pkt_len_o]
+connect_bd_net [get_bd_pins perf_counters/rx_pkt_eop_i] [get_bd_pins rx_queue_arbiter/pkt_eop_o]
+set_property CONFIG.NB_QUEUES $nb_rx_queues [get_bd_cells perf_counters]
+for {set q 0} {$q < $nb_rx_queues} {incr q} {
+	connect_bd_net [get_bd_pins perf_counters/rx_poll_state${q}_i] [get_bd_pins rx_desc_ctrl_$q/poll_state_o]
+	connect_bd_net [get_bd_pins perf_counters/rx_ring_level${q}_i] [get_bd_pins rx_desc_ctrl_$q/ring_level_o]
+}
+
+connect_bd_net [get_bd_pins perf_counters/tx_xmit_ack_i] [get_bd_pins tx_desc_ctrl_0/xmit_ack_o]
+connect_bd_net [get_bd_pins perf_counters/tx_ring_level_i] [get_bd_pins tx_desc_ctrl_0/ring_level_o]
+
+connect_bd_net [get_bd_pins perf_counters/arb_valid0_i] [get_bd_pins [lindex $rx_doorbell 0]/[lindex $rx_doorbell 3]]
+connect_bd_net [get_bd_pins perf_counters/arb_ready0_i] [get_bd_pins pcie_req_arbiter/fifo_ready0_o]
+connect_bd_net [get_bd_pins perf_counters/arb_valid1_i] [get_bd_pins tailpointer_delay_tx/m_pcie_write_o]
+connect_bd_net [get_bd_pins perf_counters/arb_ready1_i] [get_bd_pins pcie_req_arbiter/fifo_ready1_o]
+
+# with hairpin the tx requests are the rx buffers, there are no ethernet streams
+if {$hairpin} {
+	connect_bd_net [get_bd_pins perf_counters/rx_pkt_ack_i] [get_bd_pins tx_desc_ctrl_0/xmit_ack_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_pkt_len_i] [get_bd_pins rx_queue_arbiter/pkt_len_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_pkt_eop_i] [get_bd_pins rx_queue_arbiter/pkt_eop_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_xmit_req_i] [get_bd_pins rx_queue_arbiter/pkt_addr_v_o]
+} else {
+	connect_bd_net [get_bd_pins perf_counters/rx_pkt_ack_i] [get_bd_pins rx_packet_handler_0/pkt_ack_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_pkt_len_i] [get_bd_pins tx_packet_handler_0/pkt_len_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_pkt_eop_i] [get_bd_pins tx_packet_handler_0/pkt_eop_o]
+	connect_bd_net [get_bd_pins perf_counters/tx_xmit_req_i] [get_bd_pins tx_packet_handler_0/xmit_req_o]
+	connect_bd_intf_net [get_bd_intf_pins perf_counters/S_AXIS_RX_MON] [get_bd_intf_pins rx_packet_handler_0/m_axis_eth]
+	connect_bd_intf_net [get_bd_intf_pins perf_counters/S_AXIS_TX_MON] [get_bd_intf_pins tx_packet_handler_0/s_axis_eth]
+}
+
+
+## latency monitor: residence time from the rx descriptor write-back to the tx doorbell of each frame
+
+connect_bd_net [get_bd_pins latency_monitor/init_i] [get_bd_pins pcie_core_init/init_o]
+connect_bd_net [get_bd_pins latency_monitor/wr_i] [get_bd_pins configuration_registers/lat_wr_o]
+connect_bd_net [get_bd_pins latency_monitor/addr_i] [get_bd_pins configuration_registers/lat_addr_o]
+connect_bd_net [get_bd_pins latency_monitor/wr_data_i] [get_bd_pins configuration_registers/lat_data_o]
+connect_bd_net [get_bd_pins latency_monitor/rd_data_o] [get_bd_pins configuration_registers/lat_data_i]
+connect_bd_net [get_bd_pins latency_monitor/rx_pkt_ts_i] [get_bd_pins rx_queue_arbiter/pkt_ts_o]
+connect_bd_net [get_bd_pins latency_monitor/rx_pkt_eop_i] [get_bd_pins rx_queue_arbiter/pkt_eop_o]
+connect_bd_net [get_bd_pins latency_monitor/tx_db_valid_i] [get_bd_pins tx_desc_ctrl_0/pcie_rq_start_o]
+connect_bd_net [get_bd_pins latency_monitor/tx_db_ready_i] [get_bd_pins tx_desc_ctrl_0/pcie_rq_ack_i]
+if {$hairpin} {
+	connect_bd_net [get_bd_pins latency_monitor/rx_pkt_ack_i] [get_bd_pins tx_desc_ctrl_0/xmit_ack_o]
+} else {
+	connect_bd_net [get_bd_pins latency_monitor/rx_pkt_ack_i] [get_bd_pins rx_packet_handler_0/pkt_ack_o]
+	connect_bd_intf_net [get_bd_intf_pins latency_monitor/S_AXIS_TX_MON] [get_bd_intf_pins tx_packet_handler_0/s_axis_eth]
+}
 
 ### asign addresses
 assign_bd_address [get_bd_addr_segs {xdma_0/S_AXI_B/BAR0 }]
@@ -250,9 +512,17 @@ assign_bd_address [get_bd_addr_segs {axi_bram_ctrl_rx_buffer/S_AXI/Mem0 }]
 set_property range 512K [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_rx_buffer_Mem0}]
 set_property offset 0x00000000 [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_rx_buffer_Mem0}]
 
-assign_bd_address [get_bd_addr_segs {axi_bram_ctrl_rx_ring/S_AXI/Mem0 }]
-set_property range 4K [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_rx_ring_Mem0}]
-set_property offset 0x00100000 [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_rx_ring_Mem0}]
+# rx ring of queue 0 at 0x100000, the rings of the queues 1-3 at 0x103000, 0x104000 and 0x105000 behind the configuration registers
+# rx_desc_snoop passes the bus address on, the ring has the same offset in its address space
+for {set q 0} {$q < $nb_rx_queues} {incr q} {
+	set offs [expr {$q == 0 ? 0x00100000 : 0x00102000 + $q * 0x1000}]
+	assign_bd_address [get_bd_addr_segs rx_desc_snoop_$q/s_axi/reg0]
+	set_property range 4K [get_bd_addr_segs xdma_0/M_AXI_B/SEG_rx_desc_snoop_${q}_reg0]
+	set_property offset [format "0x%08X" $offs] [get_bd_addr_segs xdma_0/M_AXI_B/SEG_rx_desc_snoop_${q}_reg0]
+	assign_bd_address [get_bd_addr_segs axi_bram_ctrl_rx_ring_$q/S_AXI/Mem0]
+	set_property range 4K [get_bd_addr_segs rx_desc_snoop_$q/m_axi/SEG_axi_bram_ctrl_rx_ring_${q}_Mem0]
+	set_property offset [format "0x%08X" $offs] [get_bd_addr_segs rx_desc_snoop_$q/m_axi/SEG_axi_bram_ctrl_rx_ring_${q}_Mem0]
+}
 
 assign_bd_address [get_bd_addr_segs {axi_bram_ctrl_tx_buffer/S_AXI/Mem0 }]
 set_property offset 0x00080000 [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_tx_buffer_Mem0}]
@@ -262,6 +532,13 @@ assign_bd_address [get_bd_addr_segs {axi_bram_ctrl_tx_ring/S_AXI/Mem0 }]
 set_property range 4K [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_tx_ring_Mem0}]
 set_property offset 0x00101000 [get_bd_addr_segs {xdma_0/M_AXI_B/SEG_axi_bram_ctrl_tx_ring_Mem0}]
 
+# the ring of ddr_buffer starts at 0 of the DDR4 (RING_BASE)
+if {$ddr_buffer} {
+	assign_bd_address [get_bd_addr_segs {ddr4_0/C0_DDR4_MEMORY_MAP/C0_DDR4_ADDRESS_BLOCK }]
+	set_property offset 0x000000000 [get_bd_addr_segs {ddr_buffer/m_axi/SEG_ddr4_0_C0_DDR4_ADDRESS_BLOCK}]
+	set_property range 16G [get_bd_addr_segs {ddr_buffer/m_axi/SEG_ddr4_0_C0_DDR4_ADDRESS_BLOCK}]
+}
+
 save_bd_design
 validate_bd_design
 regenerate_bd_layout
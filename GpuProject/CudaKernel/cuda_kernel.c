@@ -13,20 +13,16 @@
 #include <linux/slab.h>                 //kmalloc()
 #include <linux/uaccess.h>              //copy_to/from_user()
 #include <linux/ioctl.h>
+#include <linux/mm.h>                   //io_remap_pfn_range()
+#include <linux/mutex.h>
 
 #include "/usr/src/nvidia-460-460.32.03/nvidia/nv-p2p.h"
 
-struct ioctl_args {
-    u64 vaddr;
-    u64 size;
-    u32 bus;
-    u32 devfn;
-} args;
+#include "cuda_kernel.h"
 
-// ioctl commands
-#define PIN_MEM         _IOW('a',0,struct ioctl_args*)
-#define UNPIN_MEM       _IOW('a',1,void**)
-#define RD_ADDR         _IOR('a',2,u64**)
+struct ioctl_args args;
+struct ioctl_page_table page_table;
+struct ioctl_nic nic_addr;
 
 // for boundary alignment requirement
 #define GPU_BOUND_SHIFT   16
@@ -45,6 +41,7 @@ static struct cdev etx_cdev;
 static int      __init etx_driver_init(void);
 static void     __exit etx_driver_exit(void);
 static long     etx_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static int      etx_mmap(struct file *file, struct vm_area_struct *vma);
 
 /*
 ** File operation sturcture
@@ -52,6 +49,7 @@ static long     etx_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 static struct file_operations fops = {
         .owner          = THIS_MODULE,
         .unlocked_ioctl = etx_ioctl,
+        .mmap           = etx_mmap,
 };
 
 
@@ -62,80 +60,247 @@ struct gpu_mapping {
         nvidia_p2p_dma_mapping_t *mappings;
 };
 
+/* the pinned memory, NULL if nothing is pinned. Only read or replaced with gpu_lock held */
 struct gpu_mapping *m;
+static DEFINE_MUTEX(gpu_lock);
 
+/* address space of the device file, the user mappings of the pinned memory (etx_mmap) are zapped through it on unpin */
+static struct address_space *gpu_vm_mapping;
+
+/* removes the pinned memory from all processes that mapped it, later accesses get SIGBUS */
+static void zap_user_mappings(void) {
+        if(gpu_vm_mapping)
+                unmap_mapping_range(gpu_vm_mapping, 0, 0, 1);
+}
 
 /* this is called if the GPU needs to take back the memory for some reason, for example if the CUDA program crashes */
-static void force_release_gpu_mappings(struct gpu_mapping *m) {
-        nvidia_p2p_free_dma_mapping(m->mappings);
-        nvidia_p2p_free_page_table(m->pages);
-        kfree(m);
+static void force_release_gpu_mappings(void *data) {
+        struct gpu_mapping *cb_m = data;
+
+        mutex_lock(&gpu_lock);
+        if(m != cb_m){
+                /* already detached by UNPIN_MEM, clean_unmap releases it */
+                mutex_unlock(&gpu_lock);
+                return;
+        }
+        m = NULL;
+        zap_user_mappings();
+        mutex_unlock(&gpu_lock);
+
+        nvidia_p2p_free_dma_mapping(cb_m->mappings);
+        nvidia_p2p_free_page_table(cb_m->pages);
+        pci_dev_put(cb_m->pdev);
+        kfree(cb_m);
 }
 
-/* you should ideally rely on this for cleaning up mappings and unpinning GPU memory */
+/* you should ideally rely on this for cleaning up mappings and unpinning GPU memory, m must already be detached */
 void clean_unmap(struct gpu_mapping *m) {
         nvidia_p2p_dma_unmap_pages(m->pdev, m->pages, m->mappings);
         nvidia_p2p_put_pages(0, 0, m->vaddr, m->pages);
+        pci_dev_put(m->pdev);
         kfree(m);
 }
 
+/* returns the pinned and dma mapped memory or an ERR_PTR, takes over the reference to pdev on success */
 struct gpu_mapping* create_mappings(struct pci_dev *pdev, u64 device_pointer_address, size_t size) {
         int ret;
         struct gpu_mapping *m;
-        /* …. */
+
         m = kmalloc(sizeof(*m), GFP_KERNEL);
+        if(m == NULL)
+                return ERR_PTR(-ENOMEM);
 
         m->vaddr = device_pointer_address; /* same value as attrs.devicePointer */
+        m->pdev = pdev; /* pdev should be the pci_dev representation of your NIC */
         /* tells the CUDA driver to pin memory and make it available as device memory */
         ret = nvidia_p2p_get_pages(
         0, /* deprecated */
         0, /* deprecated */
         m->vaddr, size, /* aligned to 64 KB */ 
         &m->pages,
-        (void (*)(void*)) force_release_gpu_mappings,
+        force_release_gpu_mappings,
         m);
-        printk(KERN_INFO "get_pages return: %d", ret);
-
-        m->pdev = pdev; /* pdev should be the pci_dev representation of your NIC */
+        if(ret){
+                printk(KERN_INFO "get_pages failed: %d", ret);
+                kfree(m);
+                return ERR_PTR(ret);
+        }
 
         /* make the memory addresses available for a third-party device */
         ret = nvidia_p2p_dma_map_pages(pdev, m->pages, &m->mappings);
-        printk(KERN_INFO "map_pages return: %d", ret);
+        if(ret){
+                printk(KERN_INFO "map_pages failed: %d", ret);
+                nvidia_p2p_put_pages(0, 0, m->vaddr, m->pages);
+                kfree(m);
+                return ERR_PTR(ret);
+        }
 
         /* the I/O addresses are in m->mappings->dma_addresses[ i ] */
-
-        /* ….. */
         return m;
 }
 
+static u64 gpu_page_size(struct gpu_mapping *m) {
+        switch(m->pages->page_size) {
+                case NVIDIA_P2P_PAGE_SIZE_4KB:
+                        return 4 * 1024;
+                case NVIDIA_P2P_PAGE_SIZE_128KB:
+                        return 128 * 1024;
+                case NVIDIA_P2P_PAGE_SIZE_64KB:
+                default:
+                        return GPU_BOUND_SIZE;
+        }
+}
+
+/* the pages are only inserted by etx_mmap, after they have been zapped on unpin an access is not refilled */
+static vm_fault_t gpu_vm_fault(struct vm_fault *vmf) {
+        return VM_FAULT_SIGBUS;
+}
+
+static const struct vm_operations_struct gpu_vm_ops = {
+        .fault = gpu_vm_fault,
+};
+
+/*
+** Maps the pinned gpu memory into the calling process through the BAR1 aperture of the gpu (like GDRCopy).
+** The host can then access descriptor rings and counters with plain loads and stores.
+** Reads are uncached and slow compared to host memory, writes are write-combined.
+** The mapping is zapped when the memory is unpinned or taken back by the nvidia driver.
+*/
+static int etx_mmap(struct file *file, struct vm_area_struct *vma) {
+        u64 page_size;
+        unsigned long size = vma->vm_end - vma->vm_start;
+        unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+        unsigned long mapped = 0;
+        u32 i;
+        int ret = 0;
+
+        mutex_lock(&gpu_lock);
+        if(m==NULL){
+                printk(KERN_INFO "no memory mapped");
+                ret = -ENOMEM;
+                goto out;
+        }
+        page_size = gpu_page_size(m);
+        if(offset % page_size != 0 || size % page_size != 0 || offset + size > m->pages->entries * page_size){
+                printk(KERN_INFO "invalid mmap range offset %lx size %lx", offset, size);
+                ret = -EINVAL;
+                goto out;
+        }
+
+        vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+        vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+        vma->vm_ops = &gpu_vm_ops;
+        gpu_vm_mapping = file->f_mapping;
+
+        for(i = offset / page_size; mapped < size; i++){
+                ret = io_remap_pfn_range(vma, vma->vm_start + mapped,
+                        m->pages->pages[i]->physical_address >> PAGE_SHIFT,
+                        page_size, vma->vm_page_prot);
+                if(ret){
+                        printk(KERN_INFO "io_remap_pfn_range failed: %d", ret);
+                        goto out;
+                }
+                mapped += page_size;
+        }
+out:
+        mutex_unlock(&gpu_lock);
+        return ret;
+}
+
 /*
 ** This fuction will be called when we write IOCTL on the Device file
 */
 static long etx_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+        struct gpu_mapping *new_m;
+        struct gpu_mapping *old_m;
+        struct pci_dev *nic;
+        long ret = 0;
+
+        mutex_lock(&gpu_lock);
         switch(cmd) {
                 case PIN_MEM:
-                        copy_from_user(&args ,(char*) arg, sizeof(args));
-                        struct pci_dev *nic;
+                        if(m!=NULL){
+                                printk(KERN_INFO "memory already mapped");
+                                ret = -EBUSY;
+                                break;
+                        }
+                        if(copy_from_user(&args ,(char*) arg, sizeof(args))){
+                                ret = -EFAULT;
+                                break;
+                        }
                         nic = pci_get_domain_bus_and_slot(0x0000, args.bus, args.devfn);
                         if(nic==NULL){
                                 printk(KERN_INFO "nic not found");
-                                return 0;
+                                ret = -ENODEV;
+                                break;
+                        }
+                        new_m = create_mappings(nic, args.vaddr, args.size);
+                        if(IS_ERR(new_m)){
+                                pci_dev_put(nic);
+                                ret = PTR_ERR(new_m);
+                                break;
                         }
-                        m = create_mappings(nic, args.vaddr, args.size);
-                        printk(KERN_INFO "addr = %llx\n", m->mappings->dma_addresses[0]);
+                        m = new_m;
+                        printk(KERN_INFO "addr = %llx, pages = %u\n", m->mappings->dma_addresses[0], m->mappings->entries);
                         break;
                 case UNPIN_MEM:
-                        clean_unmap(m);
-                        break;
+                        if(m==NULL){
+                                printk(KERN_INFO "no memory mapped");
+                                ret = -ENOMEM;
+                                break;
+                        }
+                        old_m = m;
+                        m = NULL;
+                        zap_user_mappings();
+                        /* put_pages waits for a running free callback, which must be able to take the lock */
+                        mutex_unlock(&gpu_lock);
+                        clean_unmap(old_m);
+                        return 0;
                 case RD_ADDR:
                         if(m==NULL){
                                 printk(KERN_INFO "no memory mapped");
-                        }else{
-                                copy_to_user((u64*) arg, &m->mappings->dma_addresses[0], sizeof(u64));
+                                ret = -ENOMEM;
+                        }else if(copy_to_user((u64*) arg, &m->mappings->dma_addresses[0], sizeof(u64))){
+                                ret = -EFAULT;
                         }
                         break;
+                case RD_PAGES:
+                        if(m==NULL){
+                                printk(KERN_INFO "no memory mapped");
+                                ret = -ENOMEM;
+                                break;
+                        }
+                        if(copy_from_user(&page_table, (char*) arg, sizeof(page_table))){
+                                ret = -EFAULT;
+                                break;
+                        }
+                        page_table.page_size = gpu_page_size(m);
+                        if(page_table.max_entries > m->mappings->entries)
+                                page_table.max_entries = m->mappings->entries;
+                        if(page_table.max_entries > 0 &&
+                           copy_to_user((u64*) page_table.addrs, m->mappings->dma_addresses, page_table.max_entries * sizeof(u64))){
+                                ret = -EFAULT;
+                                break;
+                        }
+                        page_table.entries = m->mappings->entries;
+                        if(copy_to_user((char*) arg, &page_table, sizeof(page_table)))
+                                ret = -EFAULT;
+                        break;
+                case RD_NIC:
+                        if(m==NULL){
+                                printk(KERN_INFO "no memory mapped");
+                                ret = -ENOMEM;
+                                break;
+                        }
+                        nic_addr.domain = pci_domain_nr(m->pdev->bus);
+                        nic_addr.bus = m->pdev->bus->number;
+                        nic_addr.devfn = m->pdev->devfn;
+                        if(copy_to_user((char*) arg, &nic_addr, sizeof(nic_addr)))
+                                ret = -EFAULT;
+                        break;
         }
-        return 0;
+        mutex_unlock(&gpu_lock);
+        return ret;
 }
  
 /*
@@ -182,6 +347,15 @@ r_class:
 ** Module exit function
 */
 static void __exit etx_driver_exit(void) {
+        struct gpu_mapping *old_m;
+
+        mutex_lock(&gpu_lock);
+        old_m = m;
+        m = NULL;
+        zap_user_mappings();
+        mutex_unlock(&gpu_lock);
+        if(old_m)
+                clean_unmap(old_m);
         device_destroy(dev_class,dev);
         class_destroy(dev_class);
         cdev_del(&etx_cdev);
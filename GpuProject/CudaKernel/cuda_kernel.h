@@ -0,0 +1,44 @@
+// ioctl interface of cuda_kernel.ko, shared by the kernel module and the userspace applications
+#ifndef CUDA_KERNEL_H
+#define CUDA_KERNEL_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define CUDA_KERNEL_DEVICE "/dev/etx_device"
+
+struct ioctl_args {
+    __u64 vaddr;
+    __u64 size;
+    __u32 bus;
+    __u32 devfn;
+};
+
+/*
+ * page table of the pinned gpu memory as seen by the nic.
+ * The caller provides an array of max_entries bus addresses in addrs,
+ * the module fills in up to max_entries addresses and always reports the total number of pages in entries.
+ * Calling with max_entries = 0 only queries the number of pages.
+ */
+struct ioctl_page_table {
+    __u64 page_size;    // out: size of a single gpu page in bytes
+    __u32 max_entries;  // in:  capacity of addrs
+    __u32 entries;      // out: number of pinned pages
+    __u64 addrs;        // in:  userspace pointer to a __u64 array receiving the bus address of each page
+};
+
+/* pci address of the nic the memory is pinned for, as used by pci_get_domain_bus_and_slot() */
+struct ioctl_nic {
+    __u32 domain;
+    __u32 bus;
+    __u32 devfn;
+};
+
+// ioctl commands
+#define PIN_MEM         _IOW('a',0,struct ioctl_args*)
+#define UNPIN_MEM       _IOW('a',1,void**)
+#define RD_ADDR         _IOR('a',2,__u64**)
+#define RD_PAGES        _IOWR('a',3,struct ioctl_page_table*)
+#define RD_NIC          _IOR('a',4,struct ioctl_nic*)
+
+#endif
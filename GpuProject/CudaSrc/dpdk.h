@@ -35,6 +35,14 @@ union ixgbe_adv_rx_desc {
 	} wb;  /* writeback */
 };
 
+/* Context descriptors - Advanced */
+struct ixgbe_adv_tx_context_desc {
+	__le32 vlan_macip_lens;
+	__le32 seqnum_seed;
+	__le32 type_tucmd_mlhl;
+	__le32 mss_l4len_idx;
+};
+
 /* Transmit Descriptor - Advanced */
 union ixgbe_adv_tx_desc {
 	struct {
@@ -0,0 +1,89 @@
+//Authors: Leonard Anderweit, Ralf Kundel
+//2022
+
+/*
+The pinned gpu memory is only contiguous within a single gpu page (64KB).
+This layout engine reads the page list of the pinned region from the cuda kernel module
+and translates offsets inside the region into bus addresses the nic can use in its descriptors.
+Packet slots must not cross a page boundary: each page holds page_size / stride slots,
+a stride that does not divide the page size (e.g. 9216 byte jumbo buffers) leaves the rest of each page unused.
+This is the same layout as SLOT_OFFS() in settings.h, which the kernels use to find a slot in their mapping.
+*/
+#ifndef GPU_LAYOUT_H
+#define GPU_LAYOUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+
+#include "../CudaKernel/cuda_kernel.h"
+
+struct gpu_layout {
+    uint64_t page_size;
+    uint32_t entries;
+    uint64_t *bus_addrs;
+};
+
+/* reads the page list of the currently pinned memory, returns 0 on success */
+static int gpu_layout_load(struct gpu_layout *layout, int fd){
+    struct ioctl_page_table page_table;
+
+    page_table.max_entries = 0;
+    page_table.addrs = 0;
+    if(ioctl(fd, RD_PAGES, &page_table) < 0 || page_table.entries == 0){
+        printf("reading gpu page table failed\n");
+        return -1;
+    }
+
+    layout->bus_addrs = (uint64_t*) malloc(page_table.entries * sizeof(uint64_t));
+    if(layout->bus_addrs == NULL)
+        return -1;
+    page_table.max_entries = page_table.entries;
+    page_table.addrs = (uint64_t) (uintptr_t) layout->bus_addrs;
+    if(ioctl(fd, RD_PAGES, &page_table) < 0){
+        printf("reading gpu page table failed\n");
+        free(layout->bus_addrs);
+        layout->bus_addrs = NULL;
+        return -1;
+    }
+    layout->page_size = page_table.page_size;
+    layout->entries = page_table.entries;
+    return 0;
+}
+
+static void gpu_layout_free(struct gpu_layout *layout){
+    free(layout->bus_addrs);
+    layout->bus_addrs = NULL;
+    layout->entries = 0;
+}
+
+/* bus address of a byte offset inside the pinned region, 0 if the offset is not pinned */
+static inline uint64_t gpu_layout_bus_addr(const struct gpu_layout *layout, uint64_t offset){
+    uint64_t page = offset / layout->page_size;
+    if(page >= layout->entries)
+        return 0;
+    return layout->bus_addrs[page] + offset % layout->page_size;
+}
+
+/*
+ * fills pkt_addrs with the bus address of nb_pkts slots of stride bytes starting at the page aligned offset.
+ * This is the value written to pkt_addr/buffer_addr of the descriptors for each packet position.
+ */
+static int gpu_layout_build_pkt_addrs(const struct gpu_layout *layout, uint64_t *pkt_addrs, uint32_t nb_pkts, uint64_t offset, uint32_t stride){
+    if(stride > layout->page_size || offset % layout->page_size != 0){
+        printf("packet stride %u or offset %lu does not fit gpu page size %lu\n", stride, (unsigned long) offset, (unsigned long) layout->page_size);
+        return -1;
+    }
+    uint64_t slots_per_page = layout->page_size / stride;
+    for(uint32_t i = 0; i < nb_pkts; i++){
+        pkt_addrs[i] = gpu_layout_bus_addr(layout, offset + i / slots_per_page * layout->page_size + i % slots_per_page * stride);
+        if(pkt_addrs[i] == 0){
+            printf("packet %u is outside of the pinned gpu memory\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#endif
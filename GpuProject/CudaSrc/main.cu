@@ -12,38 +12,76 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 
 #include <cuda.h>
 #include <cuda_runtime.h>
 #include <device_launch_parameters.h>
 
 #include "dpdk.h"
+#include "gpu_layout.h"
+#include "../gpu_mmap.h"
+#include "../doorbell_table.h"
+#include "../pci_discovery.h"
 #include "../settings.h"
 
-#define PIN_MEM     _IOW('a',0,struct ioctl_args*)
-#define UNPIN_MEM   _IOW('a',1,void**)
-#define RD_ADDR     _IOR('a',2,void**)
-
 #define IXGBE_ADV_TX_DESC_DTYP_DATA 3<<20
 #define IXGBE_ADV_TX_DESC_DCMD_EOP 1<<24
 #define IXGBE_ADV_TX_DESC_DCMD_INS_FCS 1<<25
 #define IXGBE_ADV_TX_DESC_DCMD_RS 1<<27
 #define IXGBE_ADV_TX_DESC_DCMD_ADVD 1<<29
 #define IXGBE_ADV_TX_PAYLEN_SHIFT 14
-
-
-struct ioctl_args {
-    uint64_t vaddr;
-    uint64_t size;
-    uint32_t bus;
-    uint32_t devfn;
-};
+#define IXGBE_ADV_TX_DESC_DCMD_TSE (1u<<31)
+#define IXGBE_ADV_TX_POPTS_IXSM (1<<8)
+#define IXGBE_ADV_TX_POPTS_TXSM (1<<9)
+#define IXGBE_ADV_TX_CTXT_DTYP (2<<20)
+#define IXGBE_ADV_TX_CTXT_TUCMD_IPV4 (1<<10)
+#define IXGBE_ADV_TX_CTXT_TUCMD_L4T_TCP (1<<11)
+#define IXGBE_ADV_TX_CTXT_MACLEN_SHIFT 9
+#define IXGBE_ADV_TX_CTXT_L4LEN_SHIFT 8
+#define IXGBE_ADV_TX_CTXT_MSS_SHIFT 16
+
+#define IXGBE_RXDADV_STAT_DD 1<<0
+#define IXGBE_RXDADV_STAT_EOP 1<<1
+#define IXGBE_RXDADV_NEXTP_MASK 0x000FFFF0
+#define IXGBE_RXDADV_NEXTP_SHIFT 4
+#define IXGBE_RXDADV_RSCCNT_MASK 0x001E0000
+#define IXGBE_RXDADV_HDRBUFLEN_MASK 0x00007FE0
+#define IXGBE_RXDADV_HDRBUFLEN_SHIFT 5
+#define CHAIN_NONE 0xFFFFFFFF
 
 struct pkt_info {
-    uint16_t position; //within the packet buffer mem
+    uint32_t position; //within the packet buffer mem, first buffer of the packet
     uint16_t length; //in bytes
+    uint16_t segs; //number of buffers, the following ones are chained through seg_next (RSC, SCATTER)
+    uint16_t rsc; //the buffers are coalesced tcp segments rather than a single frame
+    uint16_t hdr_len; //header split: bytes in the header buffer of the position, the payload follows the headroom
 };
 
+// per-ring counters located in the pinned memory at GPU_STATS_OFFS, written by the kernels and read by the host
+struct ring_stats {
+    uint64_t rx_pkts;
+    uint64_t tx_pkts;
+    uint64_t rx_no_mem;
+    uint64_t rx_rsc_pkts; //coalesced packets spanning more than one buffer, sent again with segmentation offload (TSO)
+    uint64_t rx_rsc_drops; //coalesced packets without tcp over ipv4/ipv6 headers the nic could segment
+};
+
+__device__ uint64_t pkt_bus_addr[PKT_BUFFER_SIZE*RINGS]; //bus address of each packet position, built by the layout engine on the host
+__device__ uint32_t seg_next[PKT_BUFFER_SIZE*RINGS]; //next buffer of a packet spanning several buffers, indexed by position
+__device__ uint16_t buf_len[PKT_BUFFER_SIZE*RINGS]; //bytes the nic wrote into each buffer, coalesced buffers are not filled completely
+#if HDR_SPLIT
+__device__ uint64_t hdr_bus_addr[PKT_BUFFER_SIZE*RINGS]; //bus address of the header buffer of each packet position
+#endif
+
+
+// set by the host on SIGINT, the persistent receive and send kernels return so the memory can be unpinned and freed
+__device__ int gpu_stop;
+
+__device__ __forceinline__ bool
+stop_requested(){
+    return *(volatile int*) &gpu_stop;
+}
 
 __device__ volatile pkt_info malloc_empty_desc[PKT_BUFFER_SIZE*RINGS];
 __device__ volatile uint32_t malloc_empty_desc_head[RINGS];
@@ -60,48 +98,91 @@ init_empty_desc(){
     for(int i = 0; i<PKT_BUFFER_SIZE*RINGS; i++){
         malloc_empty_desc[i].position = i;
         malloc_empty_desc[i].length = 0;
+        malloc_empty_desc[i].segs = 1;
+        malloc_empty_desc[i].rsc = 0;
     }
 }
 
 
+// waits until the DpdkDriver has published the doorbells and returns the register at bus address iova inside the mapping of the nic registers
+__device__ uint32_t*
+doorbell_reg(volatile doorbell_table *doorbells, volatile uint64_t *iova, uint8_t *nic_regs, uint64_t nic_reg_addr){
+    while(doorbells->magic != DOORBELL_TABLE_MAGIC)
+        if(stop_requested())
+            return NULL;
+    uint64_t addr = *iova;
+    if(addr < nic_reg_addr || addr - nic_reg_addr >= NIC_REG_SIZE){
+        printf("doorbell 0x%lx is outside of the nic registers\n", (unsigned long) addr);
+        return NULL;
+    }
+    return (uint32_t*) (nic_regs + (addr - nic_reg_addr));
+}
+
+// hands the buffers of packet position pos to the nic
+__device__ void
+rx_desc_arm(volatile union ixgbe_adv_rx_desc *desc, uint32_t pos){
+    #if HDR_SPLIT
+    desc->read.hdr_addr = hdr_bus_addr[pos];
+    desc->read.pkt_addr = pkt_bus_addr[pos] + HDR_BUF_SIZE;
+    #else
+    desc->read.hdr_addr = 0;
+    desc->read.pkt_addr = pkt_bus_addr[pos];
+    #endif
+}
+
 __global__ void
-receive(uint64_t *rx_desc_base_virt, uint32_t* rdt_reg){ // rdt receive descriptor tail
+receive(uint64_t *rx_desc_base_virt, uint8_t *nic_regs, uint64_t nic_reg_addr, volatile doorbell_table *doorbells, volatile ring_stats *stats){
     int index = threadIdx.x; // receive ring separator
     
-    uint16_t rx_desc_cp[RX_RING_SIZE]; //local copy of mem address in rings
+    uint32_t rx_desc_cp[RX_RING_SIZE]; //local copy of mem address in rings
+    #if RSC || SCATTER
+    // partial chains, indexed by the descriptor the nic continues them in (NEXTP for RSC, the next descriptor otherwise)
+    uint32_t chain_head[RX_RING_SIZE]; //position of the first buffer, CHAIN_NONE if no chain continues here
+    uint32_t chain_tail[RX_RING_SIZE]; //position of the last buffer
+    uint32_t chain_len[RX_RING_SIZE];
+    uint16_t chain_segs[RX_RING_SIZE];
+    bool chain_rsc[RX_RING_SIZE];
+    for(uint32_t i = 0; i<RX_RING_SIZE; i++)
+        chain_head[i] = CHAIN_NONE;
+    #endif
     
     //initialize
     malloc_received_desc_head[index] = 0;
     
     int buf_offset = index * PKT_BUFFER_SIZE;
     volatile union ixgbe_adv_rx_desc* desc_mem = (volatile union ixgbe_adv_rx_desc*) (rx_desc_base_virt + index * RX_RING_SIZE * DESC_SIZE/8); //RX_RING_SIZE ==256, DESC_SIZE==16
-    uint16_t pos;
+    uint32_t pos;
     malloc_empty_desc_tail[index] = 1;
     
 	for(uint32_t i = 0; i<RX_RING_SIZE;i++){ //init the first RX_RING_SIZE descriptors for receiving
         pos = malloc_empty_desc[i+buf_offset].position;
-		desc_mem[i].read.pkt_addr = GPU_PKT_BUFFER_MEM_ADDR + MEM_PER_PKT * pos;
-		desc_mem[i].read.hdr_addr = 0;
+		rx_desc_arm(&desc_mem[i], pos);
         rx_desc_cp[i] = pos;
         malloc_empty_desc_tail[index]++;
 	}
 	
-	uint32_t counter[8];
-    
+    uint32_t* rdt_reg = doorbell_reg(doorbells, &doorbells->rdt_iova[index], nic_regs, nic_reg_addr); // rdt receive descriptor tail
+    if(rdt_reg == NULL)
+        return;
     //end initialize
     
 
     volatile union ixgbe_adv_rx_desc *rx_ring = (volatile union ixgbe_adv_rx_desc* ) (rx_desc_base_virt + index * RX_RING_SIZE * DESC_SIZE/8);
 	volatile union ixgbe_adv_rx_desc *rx_desc;
 	uint32_t staterr;
-    uint16_t new_pos;
+    uint32_t new_pos;
     uint16_t length;
     uint32_t rx_pkt_index = 0;
+    uint32_t pkt_pos;
+    uint32_t pkt_len;
+    uint16_t pkt_segs;
+    bool pkt_rsc;
+    bool eop;
 	
-	while(true){
+	while(!stop_requested()){
 		rx_desc = &rx_ring[rx_pkt_index];
 	    staterr = rx_desc->wb.upper.status_error;
-	    if(staterr&1) { //check for DD bit
+	    if(staterr & IXGBE_RXDADV_STAT_DD) { //check for DD bit
             length = rx_desc->wb.upper.length;
             #if DEBUG
             printf("index%d checking pkt at:%u len:%u\n", index, rx_pkt_index, length);
@@ -117,24 +198,66 @@ receive(uint64_t *rx_desc_base_virt, uint32_t* rdt_reg){ // rdt receive descript
                 
                 if(malloc_empty_desc_tail[index] != malloc_empty_desc_head[index]){ // check for new empty memory
                 
-                    counter[index]++;
-                
-                    malloc_received_desc[malloc_received_desc_head[index]+buf_offset].position = rx_desc_cp[rx_pkt_index];
-                    malloc_received_desc[malloc_received_desc_head[index]+buf_offset].length = length;
-                    malloc_received_desc_head[index] = (malloc_received_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_received_desc_head[index]+1;
+                    pkt_pos = rx_desc_cp[rx_pkt_index];
+                    pkt_len = length;
+                    buf_len[pkt_pos] = length;
+                    pkt_segs = 1;
+                    pkt_rsc = false;
+                    eop = true;
+                    #if RSC || SCATTER
+                    #if RSC
+                    pkt_rsc = (rx_desc->wb.lower.lo_dword.data & IXGBE_RXDADV_RSCCNT_MASK) != 0;
+                    #endif
+                    // append the buffer to the chain the nic continues in this descriptor
+                    if(chain_head[rx_pkt_index] != CHAIN_NONE){
+                        seg_next[chain_tail[rx_pkt_index]] = pkt_pos;
+                        pkt_pos = chain_head[rx_pkt_index];
+                        pkt_len += chain_len[rx_pkt_index];
+                        pkt_segs += chain_segs[rx_pkt_index];
+                        pkt_rsc |= chain_rsc[rx_pkt_index];
+                        chain_head[rx_pkt_index] = CHAIN_NONE;
+                    }
+                    if(!(staterr & IXGBE_RXDADV_STAT_EOP)){
+                        // the packet continues in the descriptor given by NEXTP (RSC) or in the next one (SCATTER).
+                        // Chains of different flows interleave in the ring, so the packet is only passed on with its last buffer
+                        uint32_t next;
+                        if(rx_desc->wb.lower.lo_dword.data & IXGBE_RXDADV_RSCCNT_MASK)
+                            next = (staterr & IXGBE_RXDADV_NEXTP_MASK) >> IXGBE_RXDADV_NEXTP_SHIFT;
+                        else
+                            next = (rx_pkt_index >= RX_RING_SIZE-1)? 0 : rx_pkt_index+1;
+                        chain_head[next] = pkt_pos;
+                        chain_tail[next] = rx_desc_cp[rx_pkt_index];
+                        chain_len[next] = pkt_len;
+                        chain_segs[next] = pkt_segs;
+                        chain_rsc[next] = pkt_rsc;
+                        eop = false;
+                    }
+                    #endif
+                    if(eop){
+                        stats[index].rx_pkts++;
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].position = pkt_pos;
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].length = pkt_len;
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].segs = pkt_segs;
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].rsc = pkt_rsc;
+                        #if HDR_SPLIT
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].hdr_len = (rx_desc->wb.lower.lo_dword.hs_rss.hdr_info & IXGBE_RXDADV_HDRBUFLEN_MASK) >> IXGBE_RXDADV_HDRBUFLEN_SHIFT;
+                        #else
+                        malloc_received_desc[malloc_received_desc_head[index]+buf_offset].hdr_len = 0;
+                        #endif
+                        malloc_received_desc_head[index] = (malloc_received_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_received_desc_head[index]+1;
+                    }
                     // write new desc
                     new_pos = malloc_empty_desc[malloc_empty_desc_tail[index]+buf_offset].position;
-		            rx_desc->read.hdr_addr = 0;
-		            rx_desc->read.pkt_addr = GPU_PKT_BUFFER_MEM_ADDR + MEM_PER_PKT * new_pos;
+		            rx_desc_arm(rx_desc, new_pos);
                     rx_desc_cp[rx_pkt_index] = new_pos;
                     malloc_empty_desc_tail[index] = (malloc_empty_desc_tail[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_empty_desc_tail[index]+1;
-                    rdt_reg[index*NIC_POINTER_OFFS/4] = rx_pkt_index;
+                    *rdt_reg = rx_pkt_index;
                     rx_pkt_index = (rx_pkt_index >= RX_RING_SIZE-1)? 0 : rx_pkt_index+1;
                     //printf("index %d\n", index);
                     
                     #if DEBUG
-                    if (counter[index]%10000 == 0){
-                        printf("counter index: %d, counter: %d \n", index, counter[index]);
+                    if (stats[index].rx_pkts%10000 == 0){
+                        printf("counter index: %d, counter: %lu \n", index, stats[index].rx_pkts);
                     }
                     #endif
                 } else{
@@ -142,7 +265,7 @@ receive(uint64_t *rx_desc_base_virt, uint32_t* rdt_reg){ // rdt receive descript
                     #if DEBUG
                     printf("shit; no mem\n");
                     #endif
-                    printf("shit; no mem\n");
+                    stats[index].rx_no_mem++;
                     continue;
                 }
             
@@ -156,14 +279,67 @@ receive(uint64_t *rx_desc_base_virt, uint32_t* rdt_reg){ // rdt receive descript
     
 }
 
+#if RSC
+/*
+ * prepares the headers of a coalesced tcp packet for segmentation by the nic (TSO): the ipv4 checksum is cleared and the
+ * tcp checksum is seeded with the pseudo header sum without length, the nic fills in lengths and checksums of each segment.
+ * Returns false if the packet is not tcp over ipv4/ipv6 without extension headers.
+ */
+__device__ bool
+tso_prepare(uint8_t *pkt, uint32_t *l2_len, uint32_t *l3_len, uint32_t *l4_len, bool *ipv4){
+    uint32_t l2 = 14;
+    uint32_t l3;
+    uint16_t type = pkt[12] << 8 | pkt[13];
+    uint32_t sum = 6; //IPPROTO_TCP
+    if(type == 0x8100){
+        l2 = 18;
+        type = pkt[16] << 8 | pkt[17];
+    }
+    uint8_t *ip = pkt + l2;
+    if(type == 0x0800){
+        l3 = (ip[0] & 0xf) * 4;
+        if(ip[9] != 6)
+            return false;
+        ip[10] = 0;
+        ip[11] = 0;
+        for(int i = 12; i < 20; i += 2)
+            sum += ip[i] << 8 | ip[i+1];
+        *ipv4 = true;
+    }else if(type == 0x86DD){
+        l3 = 40;
+        if(ip[6] != 6)
+            return false;
+        for(int i = 8; i < 40; i += 2)
+            sum += ip[i] << 8 | ip[i+1];
+        *ipv4 = false;
+    }else{
+        return false;
+    }
+    uint8_t *tcp = ip + l3;
+    while(sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    tcp[16] = sum >> 8;
+    tcp[17] = sum & 0xff;
+    *l2_len = l2;
+    *l3_len = l3;
+    *l4_len = (tcp[12] >> 4) * 4;
+    return true;
+}
+#endif
+
 __global__ void
-send(uint64_t *tx_desc_base_virt, uint32_t* tdt_reg){ // tdt transmit descriptor tail
+send(uint64_t *tx_desc_base_virt, uint8_t *nic_regs, uint64_t nic_reg_addr, volatile doorbell_table *doorbells, volatile uint32_t *tx_head_wb, uint8_t *pkt_buf, uint8_t *hdr_buf, volatile ring_stats *stats){
     int index = threadIdx.x;
     
     /* initialize */
     uint32_t tx_pkt_index = 0;
+    #if HEAD_WB
+    uint32_t tx_head = 0; // last tx head written back by the nic
+    volatile uint32_t *head_wb = tx_head_wb + index * TX_HEAD_WB_STRIDE/4;
+    #endif
     malloc_received_desc_tail[index] = 0;
-    uint16_t tx_desc_cp[RX_RING_SIZE]; //local copy of mem address in rings
+    uint32_t tx_desc_cp[RX_RING_SIZE]; //local copy of mem address in rings, CHAIN_NONE for a context descriptor
+    bool tx_ctx[TX_RING_SIZE]; //the slot holds a context descriptor, which the nic does not write back
     
     int buf_offset = index * PKT_BUFFER_SIZE;
     volatile union ixgbe_adv_tx_desc* tx_desc_ring = (volatile union ixgbe_adv_tx_desc*) (tx_desc_base_virt + index * TX_RING_SIZE * DESC_SIZE/8);
@@ -175,51 +351,148 @@ send(uint64_t *tx_desc_base_virt, uint32_t* tdt_reg){ // tdt transmit descriptor
         tx_desc_ring[i].wb.nxtseq_seed = 0;
         tx_desc_ring[i].wb.status = 1;
         tx_desc_cp[i] = malloc_empty_desc[i+buf_offset+PKT_BUFFER_SIZE-TX_RING_SIZE].position;
+        tx_ctx[i] = false;
     }
 
+    uint32_t* tdt_reg = doorbell_reg(doorbells, &doorbells->tdt_iova[index], nic_regs, nic_reg_addr); // tdt transmit descriptor tail
+    if(tdt_reg == NULL)
+        return;
     /* end initialize */
     
     
 
     uint16_t pkt_len;
-    uint16_t new_pos;
+    uint16_t seg_len;
+    uint16_t segs;
+    uint16_t slots;
+    bool tso = false;
+    uint32_t new_pos;
+    uint64_t buffer_addr;
+    uint32_t cmd_type_len;
+    uint32_t cmd_tso;
+    uint32_t olinfo_status;
     
-    while(true)
+    while(!stop_requested())
     if(malloc_received_desc_head[index] != malloc_received_desc_tail[index]){
+        segs = malloc_received_desc[malloc_received_desc_tail[index]+buf_offset].segs;
+        #if RSC
+        // coalesced tcp segments exceed the mtu, the nic cuts them into segments again (TSO) as given by a context descriptor
+        tso = segs > 1 && (!SCATTER || malloc_received_desc[malloc_received_desc_tail[index]+buf_offset].rsc);
+        #endif
+        slots = segs + tso;
         #if DEBUG
         printf("index%d nxt %x, stat %x at %u\n", index, tx_desc_ring[tx_pkt_index].wb.nxtseq_seed, tx_desc_ring[tx_pkt_index].wb.status, tx_pkt_index);
         #endif
         #if WB
-        if(tx_desc_ring[tx_pkt_index].wb.status & 1){
+        // a frame spanning several buffers needs slots free slots from the tail on.
+        // A context descriptor is not written back, it is done once the descriptor behind it is
+        bool tx_free = true;
+        for(uint16_t i = 0; i<slots; i++){
+            uint32_t slot = (tx_pkt_index+i) % TX_RING_SIZE;
+            if(tx_ctx[slot])
+                slot = (slot+1) % TX_RING_SIZE;
+            if(!(tx_desc_ring[slot].wb.status & 1))
+                tx_free = false;
+        }
+        if(tx_free){
+        #elif HEAD_WB
+        // the slots from the tail up to the head are free. The head is only read from memory when the cached value says there are
+        // fewer than slots, which frees all descriptors sent since the last read at once
+        if((tx_head + TX_RING_SIZE - tx_pkt_index - 1) % TX_RING_SIZE < slots)
+            tx_head = *head_wb;
+        if((tx_head + TX_RING_SIZE - tx_pkt_index - 1) % TX_RING_SIZE >= slots){
         #endif
             #if DEBUG
             printf("index%d send pkt %u\n", index, tx_pkt_index);
             #endif
         
-            malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].position = tx_desc_cp[tx_pkt_index];
-            malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].length = 0;
-        
             pkt_len = malloc_received_desc[malloc_received_desc_tail[index]+buf_offset].length;
             new_pos = malloc_received_desc[malloc_received_desc_tail[index]+buf_offset].position;
-            tx_desc_ring[tx_pkt_index].read.buffer_addr   = GPU_PKT_BUFFER_MEM_ADDR + MEM_PER_PKT * new_pos;
-            #if WB
-            tx_desc_ring[tx_pkt_index].read.cmd_type_len  = (pkt_len) | IXGBE_ADV_TX_DESC_DTYP_DATA | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_DESC_DCMD_EOP | IXGBE_ADV_TX_DESC_DCMD_INS_FCS | IXGBE_ADV_TX_DESC_DCMD_RS;
+            #if HDR_SPLIT
+            // the headers are copied from the header buffer back into the headroom, so the packet is sent from a single buffer
+            uint16_t hdr_len = malloc_received_desc[malloc_received_desc_tail[index]+buf_offset].hdr_len;
+            uint8_t *pkt_start = pkt_buf + SLOT_OFFS(new_pos, MEM_PER_PKT) + HDR_BUF_SIZE - hdr_len;
+            const uint8_t *hdr = hdr_buf + SLOT_OFFS(new_pos, HDR_BUF_SIZE);
+            for(uint16_t i = 0; i<hdr_len; i++)
+                pkt_start[i] = hdr[i];
+            buffer_addr = pkt_bus_addr[new_pos] + HDR_BUF_SIZE - hdr_len;
+            pkt_len += hdr_len;
             #else
-            tx_desc_ring[tx_pkt_index].read.cmd_type_len  = (pkt_len) | IXGBE_ADV_TX_DESC_DTYP_DATA | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_DESC_DCMD_EOP | IXGBE_ADV_TX_DESC_DCMD_INS_FCS;
+            buffer_addr = pkt_bus_addr[new_pos];
             #endif
-            tx_desc_ring[tx_pkt_index].read.olinfo_status = (pkt_len) << IXGBE_ADV_TX_PAYLEN_SHIFT;
-            tx_desc_cp[tx_pkt_index] = new_pos;
-            #if DEBUG
-            printf("index%d nxt %x, stat %x at %u\n", index, tx_desc_ring[tx_pkt_index].wb.nxtseq_seed, tx_desc_ring[tx_pkt_index].wb.status, tx_pkt_index);
+            cmd_tso = 0;
+            olinfo_status = (pkt_len) << IXGBE_ADV_TX_PAYLEN_SHIFT;
+            #if RSC
+            if(tso){
+                uint32_t l2_len, l3_len, l4_len;
+                bool ipv4;
+                if(!tso_prepare(pkt_buf + SLOT_OFFS(new_pos, MEM_PER_PKT), &l2_len, &l3_len, &l4_len, &ipv4)){
+                    // the nic can not segment it, the buffers go back to the empty list
+                    for(uint16_t i = 0; i<segs; i++){
+                        malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].position = new_pos;
+                        malloc_empty_desc_head[index] = (malloc_empty_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_empty_desc_head[index]+1;
+                        new_pos = seg_next[new_pos];
+                    }
+                    stats[index].rx_rsc_drops++;
+                    malloc_received_desc_tail[index] = (malloc_received_desc_tail[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_received_desc_tail[index]+1;
+                    continue;
+                }
+                // the segments are cut to the mtu of the port, PAYLEN is the tcp payload of the whole packet
+                volatile struct ixgbe_adv_tx_context_desc *ctx = (volatile struct ixgbe_adv_tx_context_desc*) &tx_desc_ring[tx_pkt_index];
+                ctx->vlan_macip_lens = l3_len | (l2_len << IXGBE_ADV_TX_CTXT_MACLEN_SHIFT);
+                ctx->seqnum_seed = 0;
+                ctx->type_tucmd_mlhl = IXGBE_ADV_TX_CTXT_DTYP | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_CTXT_TUCMD_L4T_TCP | (ipv4 ? IXGBE_ADV_TX_CTXT_TUCMD_IPV4 : 0);
+                ctx->mss_l4len_idx = ((MAX_PKT_LEN - 4 - l2_len - l3_len - l4_len) << IXGBE_ADV_TX_CTXT_MSS_SHIFT) | (l4_len << IXGBE_ADV_TX_CTXT_L4LEN_SHIFT);
+                if(tx_desc_cp[tx_pkt_index] != CHAIN_NONE){
+                    malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].position = tx_desc_cp[tx_pkt_index];
+                    malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].length = 0;
+                    malloc_empty_desc_head[index] = (malloc_empty_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_empty_desc_head[index]+1;
+                }
+                tx_desc_cp[tx_pkt_index] = CHAIN_NONE;
+                tx_ctx[tx_pkt_index] = true;
+                tx_pkt_index = (tx_pkt_index >= TX_RING_SIZE-1)? 0 : tx_pkt_index+1;
+                cmd_tso = IXGBE_ADV_TX_DESC_DCMD_TSE;
+                olinfo_status = ((pkt_len - l2_len - l3_len - l4_len) << IXGBE_ADV_TX_PAYLEN_SHIFT) | IXGBE_ADV_TX_POPTS_TXSM | (ipv4 ? IXGBE_ADV_TX_POPTS_IXSM : 0);
+                stats[index].rx_rsc_pkts++;
+            }
             #endif
+            // one descriptor per buffer, a frame spanning several buffers (SCATTER, RSC) is only sent by the nic with its EOP descriptor.
+            // PAYLEN is the length of the whole frame in every descriptor, RS is set on each one so the status of every slot is written back
+            for(uint16_t i = 0; i<segs; i++){
+                if(i > 0){
+                    new_pos = seg_next[new_pos];
+                    buffer_addr = pkt_bus_addr[new_pos];
+                }
+                seg_len = (segs == 1)? pkt_len : buf_len[new_pos];
+                if(tx_desc_cp[tx_pkt_index] != CHAIN_NONE){
+                    malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].position = tx_desc_cp[tx_pkt_index];
+                    malloc_empty_desc[malloc_empty_desc_head[index]+buf_offset].length = 0;
+                    malloc_empty_desc_head[index] = (malloc_empty_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_empty_desc_head[index]+1;
+                }
+
+                cmd_type_len = (seg_len) | IXGBE_ADV_TX_DESC_DTYP_DATA | IXGBE_ADV_TX_DESC_DCMD_ADVD | IXGBE_ADV_TX_DESC_DCMD_INS_FCS | cmd_tso;
+                if(i == segs-1)
+                    cmd_type_len |= IXGBE_ADV_TX_DESC_DCMD_EOP;
+                #if WB || HEAD_WB
+                cmd_type_len |= IXGBE_ADV_TX_DESC_DCMD_RS;
+                #endif
+                tx_desc_ring[tx_pkt_index].read.buffer_addr   = buffer_addr;
+                tx_desc_ring[tx_pkt_index].read.cmd_type_len  = cmd_type_len;
+                tx_desc_ring[tx_pkt_index].read.olinfo_status = olinfo_status;
+                tx_desc_cp[tx_pkt_index] = new_pos;
+                tx_ctx[tx_pkt_index] = false;
+                #if DEBUG
+                printf("index%d nxt %x, stat %x at %u\n", index, tx_desc_ring[tx_pkt_index].wb.nxtseq_seed, tx_desc_ring[tx_pkt_index].wb.status, tx_pkt_index);
+                #endif
 
-            // increase tx tail pointer
-            tx_pkt_index = (tx_pkt_index >= TX_RING_SIZE-1)? 0 : tx_pkt_index+1;
+                // increase tx tail pointer
+                tx_pkt_index = (tx_pkt_index >= TX_RING_SIZE-1)? 0 : tx_pkt_index+1;
+            }
             //__threadfence_block(); --> crashes when multiple rings
-            tdt_reg[index*NIC_POINTER_OFFS/4] = tx_pkt_index; // tail in nic
+            *tdt_reg = tx_pkt_index; // tail in nic, once per frame
+            stats[index].tx_pkts++;
             malloc_received_desc_tail[index] = (malloc_received_desc_tail[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_received_desc_tail[index]+1;
-            malloc_empty_desc_head[index] = (malloc_empty_desc_head[index] >= PKT_BUFFER_SIZE-1)? 0 : malloc_empty_desc_head[index]+1;
-        #if WB
+        #if WB || HEAD_WB
         }else{
             printf("break send\n");
             continue;
@@ -229,9 +502,9 @@ send(uint64_t *tx_desc_base_virt, uint32_t* tdt_reg){ // tdt transmit descriptor
 }
 
 
-int pin_mem(uint64_t address, uint64_t size){
+int pin_mem(uint64_t address, uint64_t size, uint32_t nic_bus, uint32_t nic_devfn){
     int fd;
-    fd = open("/dev/etx_device", O_RDWR);
+    fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
     if(fd < 0) {
         printf("Cannot open device file...\n");
         return -1;
@@ -239,26 +512,88 @@ int pin_mem(uint64_t address, uint64_t size){
     struct ioctl_args args;
     args.vaddr = address;
     args.size = size;
-    args.bus = NIC_BUS;
-    args.devfn = NIC_DEVFN;
-    ioctl(fd, PIN_MEM, &args);
+    args.bus = nic_bus;
+    args.devfn = nic_devfn;
+    if(ioctl(fd, PIN_MEM, &args) != 0){
+        printf("pinning gpu memory failed errno:%s\n",strerror(errno));
+        close(fd);
+        return -1;
+    }
     close(fd);
     return 0 ;
 }
 
 int unpin_mem(uint64_t address){
     int fd;
-    fd = open("/dev/etx_device", O_RDWR);
+    fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
     if(fd < 0) {
         printf("Cannot open device file...\n");
         return -1;
     }
-    ioctl(fd, UNPIN_MEM, 0);
+    if(ioctl(fd, UNPIN_MEM, 0) != 0){
+        printf("unpinning gpu memory failed errno:%s\n",strerror(errno));
+        close(fd);
+        return -1;
+    }
     close(fd);
     return 0 ;
 }
 
-int* init_gpu(){
+/*
+ * builds the bus address of every packet position from the page list of the pinned memory
+ * and copies it to the gpu. The packet buffers do not need to be contiguous on the bus.
+ */
+int init_pkt_addrs(){
+    int fd;
+    struct gpu_layout layout;
+    static uint64_t pkt_addrs[PKT_BUFFER_SIZE*RINGS];
+
+    fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
+    if(fd < 0) {
+        printf("Cannot open device file...\n");
+        return -1;
+    }
+    if(gpu_layout_load(&layout, fd) != 0){
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    printf("pinned %u gpu pages of %lu bytes\n", layout.entries, (unsigned long) layout.page_size);
+    if(layout.page_size != GPU_PAGE_SIZE){
+        printf("gpu page size differs from GPU_PAGE_SIZE %d, the kernels would address other buffers than the nic\n", GPU_PAGE_SIZE);
+        gpu_layout_free(&layout);
+        return -1;
+    }
+
+    if(gpu_layout_build_pkt_addrs(&layout, pkt_addrs, PKT_BUFFER_SIZE*RINGS, GPU_PKT_BUFFER_OFFS, MEM_PER_PKT) != 0){
+        gpu_layout_free(&layout);
+        return -1;
+    }
+    cudaError_t err = cudaMemcpyToSymbol(pkt_bus_addr, pkt_addrs, sizeof(pkt_addrs));
+    if(err!=cudaSuccess){
+        printf("copying packet addresses failed!! err:%d\n",err);
+        gpu_layout_free(&layout);
+        return -1;
+    }
+
+    #if HDR_SPLIT
+    // the header buffers are laid out like the packet buffers, with a stride of HDR_BUF_SIZE
+    if(gpu_layout_build_pkt_addrs(&layout, pkt_addrs, PKT_BUFFER_SIZE*RINGS, GPU_HDR_OFFS, HDR_BUF_SIZE) != 0){
+        gpu_layout_free(&layout);
+        return -1;
+    }
+    err = cudaMemcpyToSymbol(hdr_bus_addr, pkt_addrs, sizeof(pkt_addrs));
+    if(err!=cudaSuccess){
+        printf("copying header addresses failed!! err:%d\n",err);
+        gpu_layout_free(&layout);
+        return -1;
+    }
+    #endif
+    gpu_layout_free(&layout);
+    return 0;
+}
+
+int* init_gpu(uint32_t nic_bus, uint32_t nic_devfn){
 
     int *d_pointer;
     //extern __shared__ int tmp[MEM_SIZE/4];  //shared memory cannot be pinned
@@ -268,10 +603,56 @@ int* init_gpu(){
     cudaPointerGetAttributes(&attrs, d_pointer);
     unsigned int flag = 1;
     CUresult status = cuPointerSetAttribute(&flag, CU_POINTER_ATTRIBUTE_SYNC_MEMOPS, (CUdeviceptr)attrs.devicePointer);
-    pin_mem((uint64_t) attrs.devicePointer, MEM_SIZE);
+    if(pin_mem((uint64_t) attrs.devicePointer, MEM_SIZE, nic_bus, nic_devfn) != 0){
+        cudaFree(d_pointer);
+        return NULL;
+    }
     return d_pointer;
 }
 
+// unpins and frees the gpu memory of init_gpu and releases the mapping of the nic registers, the kernels must have returned
+void release_gpu(void *d_pointer, void *mem){
+    cudaPointerAttributes attrs;
+    cudaPointerGetAttributes(&attrs, d_pointer);
+    unpin_mem((uint64_t) attrs.devicePointer);
+    cudaFree(d_pointer);
+    cudaHostUnregister(mem);
+    munmap(mem, NIC_REG_SIZE);
+}
+
+static volatile sig_atomic_t host_stop = 0;
+
+static void handle_sigint(int sig){
+    host_stop = 1;
+}
+
+
+/*
+ * prints the per-ring counters once per second. The counters are read with plain loads
+ * through the cpu mapping of the pinned gpu memory, no kernel launch or cudaMemcpy is involved.
+ */
+void monitor_loop(){
+    struct gpu_mmap map;
+    uint64_t rx_old[RINGS] = {0};
+    uint64_t tx_old[RINGS] = {0};
+
+    if(gpu_mmap_open(&map, GPU_MMAP_DRIVER, GPU_PKT_BUFFER_OFFS) != 0){
+        printf("monitoring not available\n");
+        return;
+    }
+    volatile ring_stats *stats = (volatile ring_stats*) gpu_mmap_ptr(&map, GPU_STATS_OFFS);
+    while(!host_stop){
+        sleep(1);
+        for(int i = 0; i<RINGS; i++){
+            uint64_t rx = stats[i].rx_pkts;
+            uint64_t tx = stats[i].tx_pkts;
+            printf("ring %d: rx %lu (%lu pps), tx %lu (%lu pps), rx no mem %lu, rx coalesced %lu (dropped %lu)\n", i, rx, rx - rx_old[i], tx, tx - tx_old[i], stats[i].rx_no_mem, stats[i].rx_rsc_pkts, stats[i].rx_rsc_drops);
+            rx_old[i] = rx;
+            tx_old[i] = tx;
+        }
+    }
+    gpu_mmap_close(&map);
+}
 
 int main(int argc, char *argv[]){
     int deviceId = 0; //1; //TODO dirty, if multiple GPUs are in a single system, this must be adapted manually
@@ -283,8 +664,23 @@ int main(int argc, char *argv[]){
     cudaDeviceReset();
     cudaSetDevice(deviceId);
     cudaError_t err;
-    uint32_t* rdt_reg;
-    uint32_t* tdt_reg;
+
+    // the nic of DPDK port 0 of the DpdkDriver: first argument, or the only network controller bound to a DPDK kernel module.
+    // The DpdkDriver refuses to start if its port is another device than the one the memory is pinned for
+    char nic_bdf[PATH_MAX];
+    uint64_t nic_reg_addr;
+    uint32_t nic_bus, nic_devfn;
+    if(argc > 1){
+        snprintf(nic_bdf, sizeof(nic_bdf), "%s", argv[1]);
+    }else if(find_dpdk_nic(nic_bdf, sizeof(nic_bdf)) != 0){
+        printf("no unique nic bound to a dpdk kernel module found, pass the pci address of dpdk port 0 as first argument\n");
+        return -1;
+    }
+    if(parse_bdf(nic_bdf, &nic_bus, &nic_devfn) != 0 || sysfs_read_bar(nic_bdf, 0, &nic_reg_addr) != 0){
+        printf("couldn't read bar 0 of nic %s\n", nic_bdf);
+        return -1;
+    }
+    printf("nic %s: bus %x, devfn %x, bar 0 at %lx\n", nic_bdf, nic_bus, nic_devfn, nic_reg_addr);
 
     // make nic tailpointer accessible for gpu
     int fd = open("/dev/mem",O_RDWR);
@@ -292,21 +688,15 @@ int main(int argc, char *argv[]){
 		printf("couldn't open mem resource\n");
 		return -1;
 	}
-	void* mem = mmap(NULL, NIC_REG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, NIC_REG_ADDR);
+	void* mem = mmap(NULL, NIC_REG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, nic_reg_addr);
 	close(fd);
 	if( mem==MAP_FAILED){
 		printf("mmap failed errno:%s\n",strerror(errno));
 		return -1;
 	}
 
-    rdt_reg = (uint32_t*) mem + (NIC_RDT_OFFS)/4;
-    tdt_reg = (uint32_t*) mem + (NIC_TDT_OFFS)/4;
-
-    err = cudaHostRegister((void*)rdt_reg,512,cudaHostRegisterIoMemory);
-    if(err!=cudaSuccess){
-        printf("hostRegister failed!! err:%d\n",err);
-    }
-    err = cudaHostRegister((void*)tdt_reg,512,cudaHostRegisterIoMemory);
+    // the whole register space is registered, the tail registers of the rings are only known once the DpdkDriver has set up the queues
+    err = cudaHostRegister(mem,NIC_REG_SIZE,cudaHostRegisterIoMemory);
     if(err!=cudaSuccess){
         printf("hostRegister failed!! err:%d\n",err);
     }
@@ -315,10 +705,27 @@ int main(int argc, char *argv[]){
     cudaDeviceGetAttribute(&ret, cudaDevAttrCanUseHostPointerForRegisteredMem, 0);
     printf("cudaDevAttrCanUseHostPointerForRegisteredMem: %d\n",ret); // needs to be 1 for code to work
 
-    void *d_pointer = init_gpu(); // virtuelle adresse gpu memory
+    void *d_pointer = init_gpu(nic_bus, nic_devfn); // virtuelle adresse gpu memory
+    if(d_pointer == NULL){
+        printf("init_gpu failed\n");
+        cudaHostUnregister(mem);
+        munmap(mem, NIC_REG_SIZE);
+        return -1;
+    }
+    if(init_pkt_addrs() != 0){
+        printf("init_pkt_addrs failed\n");
+        release_gpu(d_pointer, mem);
+        return -1;
+    }
 
     static uint64_t* rx_desc_base_virt = (uint64_t*) d_pointer;
     static uint64_t* tx_desc_base_virt = (uint64_t*) d_pointer + 8*4096/8; //4096 byte per ring, up to 8 rx rings
+    ring_stats* stats = (ring_stats*) ((uint8_t*) d_pointer + GPU_STATS_OFFS);
+    cudaMemset(stats, 0, RINGS * sizeof(ring_stats));
+    uint32_t* tx_head_wb = (uint32_t*) ((uint8_t*) d_pointer + GPU_TX_HEAD_OFFS);
+    cudaMemset(tx_head_wb, 0, RINGS * TX_HEAD_WB_STRIDE);
+    doorbell_table* doorbells = (doorbell_table*) ((uint8_t*) d_pointer + GPU_DOORBELL_OFFS);
+    cudaMemset(doorbells, 0, sizeof(doorbell_table));
 
     printf("RINGS: %d\n",RINGS);
 
@@ -332,19 +739,32 @@ int main(int argc, char *argv[]){
     cudaStream_t stream1, stream2;
     cudaStreamCreateWithFlags(&stream1, cudaStreamNonBlocking); 
     cudaStreamCreateWithFlags(&stream2, cudaStreamNonBlocking);
-    receive<<<1,RINGS, 0, stream1>>>(rx_desc_base_virt, rdt_reg);
-    send<<<1,RINGS, 0, stream2>>>(tx_desc_base_virt, tdt_reg);
+    receive<<<1,RINGS, 0, stream1>>>(rx_desc_base_virt, (uint8_t*) mem, nic_reg_addr, doorbells, stats);
+    uint8_t* pkt_buf = (uint8_t*) d_pointer + GPU_PKT_BUFFER_OFFS;
+    uint8_t* hdr_buf = (uint8_t*) d_pointer + GPU_HDR_OFFS;
+    send<<<1,RINGS, 0, stream2>>>(tx_desc_base_virt, (uint8_t*) mem, nic_reg_addr, doorbells, tx_head_wb, pkt_buf, hdr_buf, stats);
+    printf("waiting for the DpdkDriver to publish the doorbells\n");
     
-
-    printf("Press ENTER key to terminate (Currently not working)\n");
-    getchar(); 
+    signal(SIGINT, handle_sigint);
+    printf("Press Ctrl-C to terminate\n");
+    #if MONITOR
+    monitor_loop();
+    #endif
+    while(!host_stop)
+        sleep(1);
     printf("stop\n");
 
-    cudaPointerAttributes attrs;
-    cudaPointerGetAttributes(&attrs, d_pointer);
-    unpin_mem((uint64_t) attrs.devicePointer);
-    cudaFree(&d_pointer);
-    cudaHostUnregister((void*)rdt_reg);
-    cudaHostUnregister((void*)tdt_reg);
+    // the kernels run in non-blocking streams, the flag is written from a third one while they are still running
+    cudaStream_t stream3;
+    int stop = 1;
+    cudaStreamCreateWithFlags(&stream3, cudaStreamNonBlocking);
+    cudaMemcpyToSymbolAsync(gpu_stop, &stop, sizeof(stop), 0, cudaMemcpyHostToDevice, stream3);
+    cudaStreamSynchronize(stream3);
+    err = cudaDeviceSynchronize();
+    if(err!=cudaSuccess){
+        printf("kernels failed!! err:%d\n",err);
+    }
+
+    release_gpu(d_pointer, mem);
     return 0;
 }
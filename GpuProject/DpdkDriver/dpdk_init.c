@@ -16,12 +16,23 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <rte_flow.h>
 
 #include "../../drivers/net/ixgbe/ixgbe_ethdev.h"
 #include "../../drivers/net/ixgbe/base/ixgbe_osdep.h"
 #include "../../drivers/net/ixgbe/base/ixgbe_type.h"
+#include "../../drivers/net/ixgbe/ixgbe_rxtx.h"
 #include "rte_ethdev_driver.h"
 #include "../settings.h"
+#include "../pci_discovery.h"
+#include "../bypass_flow.h"
+#include "../CudaSrc/gpu_layout.h"
+#include "../gpu_mmap.h"
+#include "../doorbell_table.h"
 
 #define NUM_MBUFS 8191
 #define MBUF_CACHE_SIZE 250
@@ -35,21 +46,161 @@ static const struct rte_eth_conf port_conf_default = {
 
 static uint64_t rx_desc_base_phy;
 static uint64_t tx_desc_base_phy;
+static uint64_t tx_head_wb_base_phy; // 0 if HEAD_WB is disabled
+
+/*
+ * Host Bypassing: mixed placement on one port, see bypass_flow.h.
+ * The queues 0..RINGS-1 are bypass queues with their rings in gpu memory, the queues RINGS..RINGS+HOST_RINGS-1
+ * are normal host queues. A flow is given as "-f proto,src_ip,dst_ip,src_port,dst_port,queue", e.g. "-f udp,10.0.0.1,10.0.0.2,1234,5678,0"
+ */
+static struct bypass_flow bypass_flows[MAX_BYPASS_FLOWS];
+static unsigned int nb_bypass_flows;
+#if HOST_RINGS > 0
+static uint64_t host_pkts;
+#endif
+
+#if RETA_BALANCE
+/*
+ * Occupancy driven RSS balancing between the gpu rings and the host queues.
+ * Every bucket of the redirection table has a home gpu ring and starts there. The backlog of all queues is
+ * sampled every RETA_BALANCE_INTERVAL_US with rte_eth_rx_queue_count(), for gpu rings the PMD computes it
+ * from the head and tail registers. A gpu ring above RETA_HIGH_WATERMARK hands one of its buckets to the
+ * least loaded host queue, a gpu ring below RETA_LOW_WATERMARK takes one of its buckets back.
+ * Moving one bucket per interval and the gap between the watermarks keep the table from oscillating,
+ * packets of a moved bucket may be reordered once. Flow director rules are not affected.
+ */
+static uint16_t reta_size;
+static uint16_t reta_queue[ETH_RSS_RETA_SIZE_512]; // current queue of each bucket
+static uint64_t reta_moves;
+
+static inline uint16_t reta_home(uint16_t bucket){
+	return bucket % RINGS;
+}
+
+/* points a single bucket to a queue, the other entries are left untouched */
+static int reta_move(uint16_t port, uint16_t bucket, uint16_t queue){
+	struct rte_eth_rss_reta_entry64 reta_conf[ETH_RSS_RETA_SIZE_512 / RTE_RETA_GROUP_SIZE];
+	int retval;
+
+	memset(reta_conf, 0, sizeof(reta_conf));
+	reta_conf[bucket / RTE_RETA_GROUP_SIZE].mask = 1ULL << (bucket % RTE_RETA_GROUP_SIZE);
+	reta_conf[bucket / RTE_RETA_GROUP_SIZE].reta[bucket % RTE_RETA_GROUP_SIZE] = queue;
+	retval = rte_eth_dev_rss_reta_update(port, reta_conf, reta_size);
+	if(retval != 0)
+		return retval;
+	reta_queue[bucket] = queue;
+	reta_moves++;
+	return 0;
+}
+
+/* points all redirection table entries to their home gpu ring */
+static int reta_to_gpu_queues(uint16_t port, uint16_t size){
+	struct rte_eth_rss_reta_entry64 reta_conf[ETH_RSS_RETA_SIZE_512 / RTE_RETA_GROUP_SIZE];
+
+	if(size > ETH_RSS_RETA_SIZE_512)
+		return -EINVAL;
+	reta_size = size;
+	memset(reta_conf, 0, sizeof(reta_conf));
+	for(uint16_t i = 0; i < reta_size; i++){
+		reta_queue[i] = reta_home(i);
+		reta_conf[i / RTE_RETA_GROUP_SIZE].mask |= 1ULL << (i % RTE_RETA_GROUP_SIZE);
+		reta_conf[i / RTE_RETA_GROUP_SIZE].reta[i % RTE_RETA_GROUP_SIZE] = reta_queue[i];
+	}
+	return rte_eth_dev_rss_reta_update(port, reta_conf, reta_size);
+}
+
+static void reta_balance(uint16_t port){
+	uint32_t backlog[RINGS + HOST_RINGS];
+	uint16_t host = RINGS;
+	uint16_t q, b;
+	int count;
+
+	for(q = 0; q < RINGS + HOST_RINGS; q++){
+		count = rte_eth_rx_queue_count(port, q);
+		backlog[q] = count < 0 ? 0 : count;
+		if(q >= RINGS && backlog[q] < backlog[host])
+			host = q;
+	}
+
+	for(q = 0; q < RINGS; q++){
+		if(backlog[q] > RETA_HIGH_WATERMARK){
+			for(b = 0; b < reta_size; b++)
+				if(reta_queue[b] == q)
+					break;
+			if(b < reta_size)
+				reta_move(port, b, host);
+		} else if(backlog[q] < RETA_LOW_WATERMARK){
+			for(b = 0; b < reta_size; b++)
+				if(reta_home(b) == q && reta_queue[b] != q)
+					break;
+			if(b < reta_size)
+				reta_move(port, b, q);
+		}
+	}
+}
+
+/* number of buckets currently on their home gpu ring */
+static uint16_t reta_on_gpu(void){
+	uint16_t n = 0;
+	for(uint16_t b = 0; b < reta_size; b++)
+		if(reta_queue[b] == reta_home(b))
+			n++;
+	return n;
+}
+#endif
+
+/*
+ * Writes the tail register addresses of the RINGS gpu queues of the port to the doorbell table in gpu memory.
+ * The kernels of the cuda application wait for the table before they write to the nic.
+ */
+static int
+publish_doorbells(uint16_t port)
+{
+	struct rte_eth_dev *dev = eth_dev_get(port);
+	struct ixgbe_queue_regs rx_regs, tx_regs;
+	struct gpu_mmap map;
+	uint16_t q;
+
+	if (gpu_mmap_open(&map, GPU_MMAP_DRIVER, GPU_PKT_BUFFER_OFFS) != 0)
+		return -1;
+	volatile struct doorbell_table *doorbells = gpu_mmap_ptr(&map, GPU_DOORBELL_OFFS);
+
+	for (q = 0; q < RINGS; q++) {
+		if (ixgbe_dev_rx_queue_regs(dev, q, &rx_regs) != 0 ||
+		    ixgbe_dev_tx_queue_regs(dev, q, &tx_regs) != 0) {
+			gpu_mmap_close(&map);
+			return -1;
+		}
+		doorbells->rdt_iova[q] = rx_regs.tail_iova;
+		doorbells->tdt_iova[q] = tx_regs.tail_iova;
+		printf("ring %u: rdt 0x%"PRIx64", tdt 0x%"PRIx64"\n", q, rx_regs.tail_iova, tx_regs.tail_iova);
+	}
+	rte_wmb();
+	doorbells->magic = DOORBELL_TABLE_MAGIC;
+
+	gpu_mmap_close(&map);
+	return 0;
+}
 
 /*
  * Initializes a given port using global settings and with the RX buffers
  * coming from the mbuf_pool passed as a parameter.
+ * If bypass is set, the descriptor rings of the RINGS bypass queues are placed in gpu memory,
+ * one ring after another starting at rx_desc_base_phy/tx_desc_base_phy. The HOST_RINGS host queues behind them
+ * keep their rings in host memory and the bypass flows are steered to their queues.
  */
 static inline int
-port_init(uint16_t port, struct rte_mempool *mbuf_pool) {
+port_init(uint16_t port, struct rte_mempool *mbuf_pool, bool bypass) {
 	struct rte_eth_conf port_conf = port_conf_default;
-	const uint16_t rx_rings = RINGS, tx_rings = RINGS;
+	const uint16_t rx_rings = RINGS + HOST_RINGS, tx_rings = RINGS + HOST_RINGS;
 	uint16_t nb_rxd = RX_RING_SIZE;
 	uint16_t nb_txd = TX_RING_SIZE;
 	int retval;
 	uint16_t q;
 	struct rte_eth_dev_info dev_info;
 	struct rte_eth_txconf txconf;
+	struct rte_eth_rxconf rxconf;
+	struct rte_eth_ext_ring_conf ext_ring;
 
 	printf("RX-ring size: %d, TX-ring size %d\n",RX_RING_SIZE,TX_RING_SIZE );
 	if (!rte_eth_dev_is_valid_port(port))
@@ -66,6 +217,27 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool) {
 	port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP | ETH_RSS_TCP | ETH_RSS_UDP | ETH_RSS_SCTP;
 	port_conf.rx_adv_conf.rss_conf.rss_hf &= dev_info.flow_type_rss_offloads;
 
+	// frames longer than MEM_PER_PKT span several gpu buffers (SCATTER), host queues fall back to scattered rx
+	if (MAX_PKT_LEN > RTE_ETHER_MAX_LEN) {
+		port_conf.rxmode.offloads |= DEV_RX_OFFLOAD_JUMBO_FRAME;
+		port_conf.rxmode.max_rx_pkt_len = MAX_PKT_LEN;
+	}
+
+#if RSC
+	// tcp segments are coalesced on all queues of the port, the gpu rings follow the descriptor chains (NEXTP)
+	if (!(dev_info.rx_offload_capa & DEV_RX_OFFLOAD_TCP_LRO))
+		return -ENOTSUP;
+	port_conf.rxmode.offloads |= DEV_RX_OFFLOAD_TCP_LRO;
+	// the gpu sends the coalesced packets with segmentation offload
+	if ((dev_info.tx_offload_capa & DEV_TX_OFFLOAD_TCP_TSO) == 0)
+		return -ENOTSUP;
+	port_conf.txmode.offloads |= DEV_TX_OFFLOAD_TCP_TSO | DEV_TX_OFFLOAD_TCP_CKSUM | DEV_TX_OFFLOAD_IPV4_CKSUM;
+#endif
+
+	// the bypass flows are matched by flow director perfect filters, which take precedence over RSS
+	if (bypass && nb_bypass_flows > 0)
+		port_conf.fdir_conf.mode = RTE_FDIR_MODE_PERFECT;
+
 	/* Configure the Ethernet device. */
 	retval = rte_eth_dev_configure(port, rx_rings, tx_rings, &port_conf);
 	if (retval != 0)
@@ -75,12 +247,26 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool) {
 	if (retval != 0)
 		return retval;
 
-	/* Allocate and set up 1 RX queue per Ethernet port. */
+	/* Allocate and set up RINGS bypass and HOST_RINGS host RX queues per Ethernet port. */
+	rxconf = dev_info.default_rxconf;
+	rxconf.offloads = port_conf.rxmode.offloads;
 	for (q = 0; q < rx_rings; q++) {
+		rxconf.ext_ring = NULL;
+		if (bypass && q < RINGS) {
+			memset(&ext_ring, 0, sizeof(ext_ring));
+			ext_ring.ring_iova = rx_desc_base_phy + q * RX_RING_SIZE * DESC_SIZE;
+			ext_ring.buf_size = RX_BUF_SIZE; // behind the headroom with HDR_SPLIT
+			ext_ring.hdr_buf_size = HDR_SPLIT ? HDR_BUF_SIZE : 0;
+			rxconf.ext_ring = &ext_ring;
+		}
 		retval = rte_eth_rx_queue_setup(port, q, nb_rxd,
-				rte_eth_dev_socket_id(port), NULL, mbuf_pool);
+				rte_eth_dev_socket_id(port), &rxconf,
+				rxconf.ext_ring != NULL ? NULL : mbuf_pool);
 		if (retval < 0)
 			return retval;
+		if (rxconf.ext_ring != NULL)
+			printf("rx queue %u: ring 0x%"PRIx64", doorbell 0x%"PRIx64"\n",
+				q, ext_ring.ring_iova, ext_ring.doorbell_iova);
 	}
 
 	txconf = dev_info.default_txconf;
@@ -94,12 +280,22 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool) {
 	printf("hthresh: %d\n",txconf.tx_thresh.hthresh);
 	printf("wthresh: %d\n",txconf.tx_thresh.wthresh);
 	printf("rxmode.mq_mode: %x\n",port_conf.rxmode.mq_mode);
-	/* Allocate and set up 1 TX queue per Ethernet port. */
+	/* Allocate and set up RINGS bypass and HOST_RINGS host TX queues per Ethernet port. */
 	for (q = 0; q < tx_rings; q++) {
+		txconf.ext_ring = NULL;
+		if (bypass && q < RINGS) {
+			memset(&ext_ring, 0, sizeof(ext_ring));
+			ext_ring.ring_iova = tx_desc_base_phy + q * TX_RING_SIZE * DESC_SIZE;
+			ext_ring.head_wb_iova = tx_head_wb_base_phy ? tx_head_wb_base_phy + q * TX_HEAD_WB_STRIDE : 0;
+			txconf.ext_ring = &ext_ring;
+		}
 		retval = rte_eth_tx_queue_setup(port, q, nb_txd,
 				rte_eth_dev_socket_id(port), &txconf);
 		if (retval < 0)
 			return retval;
+		if (txconf.ext_ring != NULL)
+			printf("tx queue %u: ring 0x%"PRIx64", doorbell 0x%"PRIx64"\n",
+				q, ext_ring.ring_iova, ext_ring.doorbell_iova);
 	}
 
 	/* Start the Ethernet port. */
@@ -120,6 +316,23 @@ port_init(uint16_t port, struct rte_mempool *mbuf_pool) {
 	/* Enable RX in promiscuous mode for the Ethernet device. */
 	rte_eth_promiscuous_enable(port);
 
+	if (!bypass)
+		return 0;
+#if RETA_BALANCE
+	retval = reta_to_gpu_queues(port, dev_info.reta_size);
+	if (retval != 0)
+		return retval;
+#elif HOST_RINGS > 0
+	retval = reta_to_host_queues(port, dev_info.reta_size, RINGS, HOST_RINGS);
+	if (retval != 0)
+		return retval;
+#endif
+	for (unsigned int i = 0; i < nb_bypass_flows; i++) {
+		retval = add_bypass_flow(port, &bypass_flows[i]);
+		if (retval != 0)
+			return retval;
+	}
+
 	return 0;
 }
 
@@ -161,11 +374,38 @@ static void print_tail_head_regs(void){
 }
 
 /**
-* This function is for monitoring/debugging only
+* This function is for monitoring/debugging only.
+* With host queues it also runs the host path of the port and the RSS balancing.
 **/
-static void hardware_loop(void){
+static void hardware_loop(uint16_t port){
+	uint64_t hz = rte_get_timer_hz();
+	uint64_t next = rte_get_timer_cycles() + hz;
+#if RETA_BALANCE
+	uint64_t balance_interval = hz * RETA_BALANCE_INTERVAL_US / 1000000;
+	uint64_t next_balance = rte_get_timer_cycles() + balance_interval;
+#endif
+
 	while(1){
-		 sleep(1);
+#if HOST_RINGS > 0
+		host_pkts += host_poll(port, RINGS, HOST_RINGS);
+#if RETA_BALANCE
+		if(rte_get_timer_cycles() >= next_balance){
+			next_balance += balance_interval;
+			reta_balance(port);
+		}
+#endif
+		if(rte_get_timer_cycles() < next)
+			continue;
+		next += hz;
+		printf("host queues: %"PRIu64" pkts\n", host_pkts);
+#if RETA_BALANCE
+		printf("rss buckets on gpu rings: %u/%u, %"PRIu64" moves\n", reta_on_gpu(), reta_size, reta_moves);
+#endif
+#else
+		RTE_SET_USED(port);
+		RTE_SET_USED(next);
+		sleep(1);
+#endif
 		print_tail_head_regs();
 	}
 }
@@ -184,12 +424,16 @@ int main(int argc, char *argv[]) {
 
 	uint16_t port_id = 0;
 
-	struct ixgbe_hw     *hw;
-
-	struct rte_eth_dev* dev = eth_dev_get(port_id);
-	const struct rte_memzone *rz;
+	argc -= ret;
+	argv += ret;
 
-    hw = IXGBE_DEV_PRIVATE_TO_HW(dev->data->dev_private);
+	int opt;
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		if (opt != 'f' || nb_bypass_flows == MAX_BYPASS_FLOWS ||
+		    parse_bypass_flow(optarg, &bypass_flows[nb_bypass_flows], true, RINGS) != 0)
+			rte_exit(EXIT_FAILURE, "usage: %s [EAL options] -- [-f proto,src_ip,dst_ip,src_port,dst_port,queue]...\n", argv[0]);
+		nb_bypass_flows++;
+	}
 
     /* Check that there is an even number of ports to send/receive on. */
     nb_ports = rte_eth_dev_count_avail();
@@ -203,33 +447,50 @@ int main(int argc, char *argv[]) {
 	if (mbuf_pool == NULL)
 		rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
 
-	rz = rte_eth_dma_zone_reserve(dev, "custom_mem", 0,
-		512*1024,
-		128, rte_eth_dev_socket_id(0));
-
-	rx_desc_base_phy  = GPU_RX_DESC_ADDR; 
-	tx_desc_base_phy  = GPU_TX_DESC_ADDR;
-
-    hw->custom_addr_enable  = true;
-	hw->custom_rx_desc_addr = rx_desc_base_phy;
-	hw->custom_tx_desc_addr = tx_desc_base_phy;
-	hw->custom_desc_addr_offset = RX_RING_SIZE*DESC_SIZE;
+	/* the gpu memory is pinned for the nic given to the cuda application, it must be this port */
+	char port_bdf[PATH_MAX];
+	char nic_bdf[PATH_MAX];
+	uint64_t gpu_mem_addr;
+	if (port_pci_addr(port_id, port_bdf, sizeof(port_bdf)) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot get pci address of port %"PRIu16"\n", port_id);
+	if (read_pinned_nic(nic_bdf, sizeof(nic_bdf)) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot read the nic of the gpu memory, start the cuda application first\n");
+	if (strcmp(nic_bdf, port_bdf) != 0)
+		rte_exit(EXIT_FAILURE, "port %"PRIu16" is %s but the gpu memory is pinned for %s, start the cuda application with %s\n",
+			port_id, port_bdf, nic_bdf, port_bdf);
+	if (read_gpu_mem_addr(&gpu_mem_addr) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot read gpu memory address, start the cuda application first\n");
+	printf("port %"PRIu16": %s, gpu memory at 0x%"PRIx64"\n", port_id, port_bdf, gpu_mem_addr);
+
+	rx_desc_base_phy  = gpu_mem_addr + GPU_RX_DESC_OFFS; 
+	tx_desc_base_phy  = gpu_mem_addr + GPU_TX_DESC_OFFS;
+
+#if HEAD_WB
+	/* the head write-back slots are in the second gpu page, take its bus address from the page list */
+	struct gpu_layout layout;
+	int fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
+	if (fd < 0 || gpu_layout_load(&layout, fd) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot read gpu page list\n");
+	close(fd);
+	tx_head_wb_base_phy = gpu_layout_bus_addr(&layout, GPU_TX_HEAD_OFFS);
+	gpu_layout_free(&layout);
+	printf("tx head write-back at 0x%"PRIx64"\n", tx_head_wb_base_phy);
+#endif
 
 
-	
-
-	printf("rz_iova : 0x%"PRIx64"\n", rz->iova );
-	printf("rz_addr : %p\n", rz->addr );
 	/* Initialize all ports. */
 	RTE_ETH_FOREACH_DEV(portid)
-		if (port_init(portid, mbuf_pool) != 0)
+		if (port_init(portid, mbuf_pool, portid == port_id) != 0)
 			rte_exit(EXIT_FAILURE, "Cannot init port %"PRIu16 "\n",
 					portid);
 
+	if (publish_doorbells(port_id) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot publish the doorbells to the gpu\n");
+
 	if (rte_lcore_count() > 1)
 		printf("\nWARNING: Too many lcores enabled. Only 1 used.\n");
 
-	if(true)hardware_loop();
+	if(true)hardware_loop(port_id);
 
 	printf("Press ENTER key to Continue\n");
     getchar(); 
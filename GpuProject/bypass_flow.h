@@ -0,0 +1,152 @@
+/*
+Mixed placement of host and bypass queues on one port, shared by the DpdkDriver and the BypassApp of the DpdkProject.
+The queues 0..nb_bypass-1 are bypass queues with their rings in gpu or fpga memory, the queues behind them are normal
+host queues. Selected flows are steered to a bypass queue by a 5-tuple flow director rule, all other traffic
+(control, exceptions) is spread over the host queues by the RSS redirection table.
+A flow is given as "proto,src_ip,dst_ip,src_port,dst_port,queue", e.g. "udp,10.0.0.1,10.0.0.2,1234,5678,0".
+Only available to DPDK applications.
+*/
+#ifndef BYPASS_FLOW_H
+#define BYPASS_FLOW_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_flow.h>
+#include <rte_mbuf.h>
+
+#define MAX_BYPASS_FLOWS 64
+#define HOST_POLL_BURST 32
+
+struct bypass_flow {
+	uint8_t proto;     // IPPROTO_UDP or IPPROTO_TCP
+	uint32_t src_ip;   // network byte order
+	uint32_t dst_ip;
+	uint16_t src_port; // network byte order
+	uint16_t dst_port;
+	uint16_t queue;    // bypass queue index
+};
+
+/* with_queue 0 parses a flow without the queue (e.g. a drop flow), the queue has to be below nb_bypass */
+static inline int parse_bypass_flow(const char *arg, struct bypass_flow *f, bool with_queue, uint16_t nb_bypass){
+	char proto[4];
+	char src_ip[INET_ADDRSTRLEN];
+	char dst_ip[INET_ADDRSTRLEN];
+	unsigned int src_port, dst_port, queue = 0;
+
+	if(sscanf(arg, "%3[a-z],%15[0-9.],%15[0-9.],%u,%u,%u", proto, src_ip, dst_ip, &src_port, &dst_port, &queue) != (with_queue ? 6 : 5))
+		return -1;
+	if(strcmp(proto, "udp") == 0)
+		f->proto = IPPROTO_UDP;
+	else if(strcmp(proto, "tcp") == 0)
+		f->proto = IPPROTO_TCP;
+	else
+		return -1;
+	if(inet_pton(AF_INET, src_ip, &f->src_ip) != 1 || inet_pton(AF_INET, dst_ip, &f->dst_ip) != 1)
+		return -1;
+	if(src_port > UINT16_MAX || dst_port > UINT16_MAX || queue >= nb_bypass)
+		return -1;
+	f->src_port = rte_cpu_to_be_16(src_port);
+	f->dst_port = rte_cpu_to_be_16(dst_port);
+	f->queue = queue;
+	return 0;
+}
+
+/* installs a perfect match flow director rule steering the flow to its bypass queue */
+static inline int add_bypass_flow(uint16_t port, const struct bypass_flow *f){
+	struct rte_flow_attr attr = { .ingress = 1 };
+	struct rte_flow_item pattern[4];
+	struct rte_flow_action action[2];
+	struct rte_flow_item_ipv4 ip_spec, ip_mask;
+	struct rte_flow_item_udp udp_spec, udp_mask;
+	struct rte_flow_item_tcp tcp_spec, tcp_mask;
+	struct rte_flow_action_queue queue = { .index = f->queue };
+	struct rte_flow_error error;
+
+	memset(pattern, 0, sizeof(pattern));
+	memset(action, 0, sizeof(action));
+	memset(&ip_spec, 0, sizeof(ip_spec));
+	memset(&ip_mask, 0, sizeof(ip_mask));
+	ip_spec.hdr.src_addr = f->src_ip;
+	ip_spec.hdr.dst_addr = f->dst_ip;
+	ip_mask.hdr.src_addr = UINT32_MAX;
+	ip_mask.hdr.dst_addr = UINT32_MAX;
+
+	pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
+	pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+	pattern[1].spec = &ip_spec;
+	pattern[1].mask = &ip_mask;
+	if(f->proto == IPPROTO_UDP){
+		memset(&udp_spec, 0, sizeof(udp_spec));
+		memset(&udp_mask, 0, sizeof(udp_mask));
+		udp_spec.hdr.src_port = f->src_port;
+		udp_spec.hdr.dst_port = f->dst_port;
+		udp_mask.hdr.src_port = UINT16_MAX;
+		udp_mask.hdr.dst_port = UINT16_MAX;
+		pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+		pattern[2].spec = &udp_spec;
+		pattern[2].mask = &udp_mask;
+	} else {
+		memset(&tcp_spec, 0, sizeof(tcp_spec));
+		memset(&tcp_mask, 0, sizeof(tcp_mask));
+		tcp_spec.hdr.src_port = f->src_port;
+		tcp_spec.hdr.dst_port = f->dst_port;
+		tcp_mask.hdr.src_port = UINT16_MAX;
+		tcp_mask.hdr.dst_port = UINT16_MAX;
+		pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
+		pattern[2].spec = &tcp_spec;
+		pattern[2].mask = &tcp_mask;
+	}
+	pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
+
+	action[0].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+	action[0].conf = &queue;
+	action[1].type = RTE_FLOW_ACTION_TYPE_END;
+
+	if(rte_flow_create(port, &attr, pattern, action, &error) == NULL){
+		printf("flow rule for bypass queue %u failed: %s\n", f->queue,
+			error.message ? error.message : "(no stated reason)");
+		return -1;
+	}
+	return 0;
+}
+
+/* points all redirection table entries to the nb_host host queues behind the nb_bypass bypass queues, so only the flow director rules reach the bypass queues */
+static inline int reta_to_host_queues(uint16_t port, uint16_t reta_size, uint16_t nb_bypass, uint16_t nb_host){
+	struct rte_eth_rss_reta_entry64 reta_conf[ETH_RSS_RETA_SIZE_512 / RTE_RETA_GROUP_SIZE];
+
+	if(reta_size > ETH_RSS_RETA_SIZE_512 || nb_host == 0)
+		return -EINVAL;
+	memset(reta_conf, 0, sizeof(reta_conf));
+	for(uint16_t i = 0; i < reta_size; i++){
+		reta_conf[i / RTE_RETA_GROUP_SIZE].mask |= 1ULL << (i % RTE_RETA_GROUP_SIZE);
+		reta_conf[i / RTE_RETA_GROUP_SIZE].reta[i % RTE_RETA_GROUP_SIZE] = nb_bypass + i % nb_host;
+	}
+	return rte_eth_dev_rss_reta_update(port, reta_conf, reta_size);
+}
+
+/* host path: receives the traffic of the host queues and sends it back on the same queue, returns the received packets */
+static inline uint64_t host_poll(uint16_t port, uint16_t nb_bypass, uint16_t nb_host){
+	struct rte_mbuf *bufs[HOST_POLL_BURST];
+	uint16_t nb_rx, nb_tx;
+	uint64_t pkts = 0;
+
+	for(uint16_t q = nb_bypass; q < nb_bypass + nb_host; q++){
+		nb_rx = rte_eth_rx_burst(port, q, bufs, HOST_POLL_BURST);
+		if(nb_rx == 0)
+			continue;
+		pkts += nb_rx;
+		nb_tx = rte_eth_tx_burst(port, q, bufs, nb_rx);
+		for(uint16_t i = nb_tx; i < nb_rx; i++)
+			rte_pktmbuf_free(bufs[i]);
+	}
+	return pkts;
+}
+
+#endif
@@ -0,0 +1,25 @@
+//Authors: Leonard Anderweit, Ralf Kundel
+//2022
+
+/*
+Doorbell (tail register) addresses of the gpu rings, located in the pinned gpu memory at GPU_DOORBELL_OFFS.
+The DpdkDriver takes them from the ixgbe PMD (ixgbe_dev_rx_queue_regs/ixgbe_dev_tx_queue_regs) after the queues are set up
+and publishes them here, the kernels of the cuda application wait for the table and translate the bus addresses
+into their mapping of the nic registers. This replaces fixed register offsets, which only hold for the first 64 queues of an 82599.
+*/
+#ifndef DOORBELL_TABLE_H
+#define DOORBELL_TABLE_H
+
+#include <stdint.h>
+
+#include "settings.h"
+
+#define DOORBELL_TABLE_MAGIC 0x44424c31 // "DBL1", written last by the DpdkDriver
+
+struct doorbell_table {
+    uint64_t rdt_iova[RINGS]; // bus address of the RDT register of each gpu ring
+    uint64_t tdt_iova[RINGS]; // bus address of the TDT register of each gpu ring
+    uint32_t magic;
+};
+
+#endif
@@ -0,0 +1,82 @@
+//Authors: Leonard Anderweit, Ralf Kundel
+//2022
+
+/*
+CPU-side mapping of the pinned gpu memory (GDRCopy-style).
+With the driver backend the memory pinned by cuda_kernel.ko is mapped through the BAR1 aperture of the gpu,
+so control plane and monitoring threads can read descriptor rings and counters with plain loads instead of cudaMemcpy.
+The mock backend places the same layout in host memory, which allows testing the host side without a gpu.
+*/
+#ifndef GPU_MMAP_H
+#define GPU_MMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "CudaKernel/cuda_kernel.h"
+
+enum gpu_mmap_backend {
+    GPU_MMAP_DRIVER = 0, // pinned gpu memory through the gpu BAR1 aperture
+    GPU_MMAP_MOCK   = 1  // zero-initialized host memory
+};
+
+struct gpu_mmap {
+    enum gpu_mmap_backend backend;
+    volatile void *addr;
+    uint64_t size;
+};
+
+/* maps size bytes of the pinned region, size must be a multiple of the gpu page size. returns 0 on success */
+static int gpu_mmap_open(struct gpu_mmap *map, enum gpu_mmap_backend backend, uint64_t size){
+    void *addr;
+
+    map->backend = backend;
+    map->size = size;
+    map->addr = NULL;
+
+    if(backend == GPU_MMAP_MOCK){
+        if(posix_memalign(&addr, 64*1024, size) != 0){
+            printf("mock gpu memory allocation failed\n");
+            return -1;
+        }
+        memset(addr, 0, size);
+        map->addr = (volatile void*) addr;
+        return 0;
+    }
+
+    int fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
+    if(fd < 0) {
+        printf("Cannot open device file...\n");
+        return -1;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED){
+        printf("gpu mmap failed\n");
+        return -1;
+    }
+    map->addr = (volatile void*) addr;
+    return 0;
+}
+
+static void gpu_mmap_close(struct gpu_mmap *map){
+    if(map->addr == NULL)
+        return;
+    if(map->backend == GPU_MMAP_MOCK)
+        free((void*) map->addr);
+    else
+        munmap((void*) map->addr, map->size);
+    map->addr = NULL;
+}
+
+/* host pointer to a byte offset inside the pinned region */
+static inline volatile void* gpu_mmap_ptr(const struct gpu_mmap *map, uint64_t offset){
+    return (volatile uint8_t*) map->addr + offset;
+}
+
+#endif
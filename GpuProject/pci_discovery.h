@@ -0,0 +1,182 @@
+//Authors: Leonard Anderweit, Ralf Kundel
+//2022
+
+/*
+Address discovery for the host bypassing bring-up, shared by the CUDA application, the DpdkDriver and the BypassApp of the DpdkProject.
+Replaces the hard-coded bus numbers and bar addresses per machine:
+- the nic is the network controller bound to a DPDK kernel module (or given by its pci address),
+- its register base address is read from the sysfs resource file,
+- the bus address of the pinned gpu memory and the nic it is pinned for are read from the cuda kernel module.
+port_pci_addr() is only available to DPDK applications, which include rte_ethdev.h and rte_bus_pci.h before this header.
+*/
+#ifndef PCI_DISCOVERY_H
+#define PCI_DISCOVERY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "CudaKernel/cuda_kernel.h"
+
+#define SYSFS_PCI_DEVICES "/sys/bus/pci/devices"
+#define SYSFS_PCI_DRIVERS "/sys/bus/pci/drivers"
+#define PCI_CLASS_NETWORK 0x02
+
+static const char *dpdk_drivers[] = {"igb_uio", "vfio-pci", "uio_pci_generic"};
+
+/* reads the physical start address of a pci bar from sysfs. each line of the resource file is "start end flags" */
+static inline int sysfs_read_bar(const char *bdf, int bar, uint64_t *addr){
+    char path[PATH_MAX];
+    unsigned long long start, end, flags;
+    int ret = -1;
+
+    snprintf(path, sizeof(path), SYSFS_PCI_DEVICES "/%s/resource", bdf);
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        printf("couldn't open %s\n", path);
+        return -1;
+    }
+    for(int i = 0; i <= bar; i++){
+        if(fscanf(f, "%llx %llx %llx", &start, &end, &flags) != 3)
+            break;
+        if(i == bar && start != 0){
+            *addr = start;
+            ret = 0;
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+/* reads a hex id (vendor, device, class) of a pci device from sysfs */
+static inline int sysfs_read_id(const char *bdf, const char *file, unsigned int *id){
+    char path[PATH_MAX];
+    int ret;
+
+    snprintf(path, sizeof(path), SYSFS_PCI_DEVICES "/%s/%s", bdf, file);
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+        return -1;
+    ret = fscanf(f, "%x", id) == 1 ? 0 : -1;
+    fclose(f);
+    return ret;
+}
+
+/* searches sysfs for the first pci device with the given vendor and device id, the pci address is written to bdf, e.g. "0000:65:00.0" */
+static inline int sysfs_find_device(unsigned int vendor, unsigned int device, char *bdf, size_t len){
+    unsigned int id;
+    int ret = -1;
+
+    DIR *dir = opendir(SYSFS_PCI_DEVICES);
+    if(dir == NULL)
+        return -1;
+    struct dirent *e;
+    while((e = readdir(dir)) != NULL){
+        if(e->d_name[0] == '.')
+            continue;
+        if(sysfs_read_id(e->d_name, "vendor", &id) != 0 || id != vendor)
+            continue;
+        if(sysfs_read_id(e->d_name, "device", &id) != 0 || id != device)
+            continue;
+        snprintf(bdf, len, "%s", e->d_name);
+        ret = 0;
+        break;
+    }
+    closedir(dir);
+    return ret;
+}
+
+/*
+ * finds the network controller bound to a DPDK kernel module and writes its pci address to bdf.
+ * Fails if there are several, which one is the DPDK port is then only known to DPDK and the pci address has to be given.
+ */
+static inline int find_dpdk_nic(char *bdf, size_t len){
+    char path[PATH_MAX];
+    unsigned int pci_class;
+    int found = 0;
+
+    for(size_t d = 0; d < sizeof(dpdk_drivers)/sizeof(dpdk_drivers[0]); d++){
+        snprintf(path, sizeof(path), SYSFS_PCI_DRIVERS "/%s", dpdk_drivers[d]);
+        DIR *dir = opendir(path);
+        if(dir == NULL)
+            continue;
+        struct dirent *e;
+        while((e = readdir(dir)) != NULL){
+            if(strchr(e->d_name, ':') == NULL) //skip bind, unbind, new_id, ...
+                continue;
+            if(sysfs_read_id(e->d_name, "class", &pci_class) != 0 || (pci_class >> 16) != PCI_CLASS_NETWORK)
+                continue;
+            if(found++ == 0)
+                snprintf(bdf, len, "%s", e->d_name);
+        }
+        closedir(dir);
+    }
+    if(found > 1)
+        printf("%d network controllers are bound to a DPDK kernel module\n", found);
+    return found == 1 ? 0 : -1;
+}
+
+/* splits a pci address "dddd:bb:dd.f" into bus and devfn as used by pci_get_domain_bus_and_slot() */
+static inline int parse_bdf(const char *bdf, uint32_t *bus, uint32_t *devfn){
+    unsigned int domain, b, dev, fn;
+    if(sscanf(bdf, "%x:%x:%x.%x", &domain, &b, &dev, &fn) != 4)
+        return -1;
+    *bus = b;
+    *devfn = (dev << 3) | fn;
+    return 0;
+}
+
+/* bus address of the first page of the gpu memory pinned by the cuda kernel module */
+static inline int read_gpu_mem_addr(uint64_t *addr){
+    int fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
+    if(fd < 0){
+        printf("Cannot open device file...\n");
+        return -1;
+    }
+    *addr = 0;
+    ioctl(fd, RD_ADDR, addr);
+    close(fd);
+    return *addr != 0 ? 0 : -1;
+}
+
+/* pci address of the nic the gpu memory is pinned for by the cuda kernel module */
+static inline int read_pinned_nic(char *bdf, size_t len){
+    struct ioctl_nic nic;
+    int fd = open(CUDA_KERNEL_DEVICE, O_RDWR);
+    if(fd < 0){
+        printf("Cannot open device file...\n");
+        return -1;
+    }
+    if(ioctl(fd, RD_NIC, &nic) != 0){
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    snprintf(bdf, len, "%04x:%02x:%02x.%x", nic.domain, nic.bus, nic.devfn >> 3, nic.devfn & 7);
+    return 0;
+}
+
+#ifdef _RTE_ETHDEV_H_
+/* pci address of the device behind a DPDK port */
+static inline int port_pci_addr(uint16_t port_id, char *bdf, size_t len){
+    struct rte_eth_dev_info dev_info;
+    const struct rte_pci_device *pci_dev;
+    const struct rte_bus *bus;
+
+    if(rte_eth_dev_info_get(port_id, &dev_info) != 0 || dev_info.device == NULL)
+        return -1;
+    bus = rte_bus_find_by_device(dev_info.device);
+    if(bus == NULL || strcmp(bus->name, "pci") != 0)
+        return -1;
+    pci_dev = RTE_DEV_TO_PCI(dev_info.device);
+    rte_pci_device_name(&pci_dev->addr, bdf, len);
+    return 0;
+}
+#endif
+
+#endif
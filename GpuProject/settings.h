@@ -1,65 +1,87 @@
 #define DEBUG 1
-#define P4STA 1
-#define SWITCH 1
 #define WB 1  //kostet bisschen performance
-#define E810 1
+#define HEAD_WB 0 //tx head write-back: the nic writes its tx head index to GPU_TX_HEAD_OFFS instead of the descriptor status. Replaces WB, set WB to 0
+#define MONITOR 1 //print per-ring counters every second through the cpu mapping of the gpu memory
+#define HDR_SPLIT 0 //header split: the nic writes the L2-L4 headers to a dense header array at GPU_HDR_OFFS and the rest of the packet to the packet buffers
+#define HDR_BUF_SIZE 128 //bytes per header buffer, multiple of 64. With HDR_SPLIT the packet buffers keep this as headroom in front of the payload
+#define RSC 0 //receive side coalescing: the nic merges tcp segments of a flow into one packet spanning up to 16 buffers, sent again with TSO (see CudaSrc/main.cu)
 
 #define RX_RING_SIZE 256
 #define TX_RING_SIZE 256
 
 // up to 32KB for tx/rx-descriptor-rings each e.g. 8 rings with 256 ring-size or 32 rings with 64 ring-size
 #define RINGS 1
+// additional queues on the same port with rings in host memory for control and exception traffic.
+// Only the flows given to the DpdkDriver with -f are steered to the gpu rings then (see DpdkDriver/dpdk_init.c)
+#define HOST_RINGS 0
+// with HOST_RINGS > 0: hashed traffic goes to the gpu rings, the DpdkDriver moves RSS buckets of a backlogged gpu ring
+// to the host queues and back again (see DpdkDriver/dpdk_init.c)
+#define RETA_BALANCE 0
+#define RETA_BALANCE_INTERVAL_US 10000
+#define RETA_HIGH_WATERMARK (RX_RING_SIZE / 2) //received descriptors not yet returned by the gpu
+#define RETA_LOW_WATERMARK (RX_RING_SIZE / 8)
 
 #define PKT_BUFFER_MULTIPLIER 16
 
 #define PKT_BUFFER_SIZE (RX_RING_SIZE + TX_RING_SIZE) * PKT_BUFFER_MULTIPLIER 
 
+// packet buffer per position and nic rx buffer size of the gpu rings (ext_ring.buf_size): 1024, 2048, 4096 or 9216 for jumbo frames in a single buffer
 #define MEM_PER_PKT 2048
+// largest frame received on the gpu rings. Frames longer than MEM_PER_PKT span several buffers, e.g. 9018 for jumbo frames in 2048 byte buffers
+#define MAX_PKT_LEN 1518
+#define SCATTER (MAX_PKT_LEN > MEM_PER_PKT)
+// nic rx buffer size of the gpu rings (ext_ring.buf_size). With HDR_SPLIT the buffer starts behind the headroom, the nic takes it in 1KB steps
+#define RX_BUF_SIZE (HDR_SPLIT ? (MEM_PER_PKT - HDR_BUF_SIZE) / 1024 * 1024 : MEM_PER_PKT)
 
-#define MEM_SIZE RINGS * PKT_BUFFER_SIZE * MEM_PER_PKT + 16 * 4096 //64kb aligned - up to 8 rx and 8 tx rings each 4096 byte
+// packet and header buffers never cross a gpu page, a page holds GPU_PAGE_SIZE / stride buffers (7 jumbo buffers, the rest of the page stays unused)
+#define GPU_PAGE_SIZE (64 * 1024)
+#define SLOTS_PER_PAGE(stride) (GPU_PAGE_SIZE / (stride))
+#define SLOT_OFFS(i, stride) ((uint64_t) (i) / SLOTS_PER_PAGE(stride) * GPU_PAGE_SIZE + (uint64_t) (i) % SLOTS_PER_PAGE(stride) * (stride))
+#define SLOTS_SIZE(n, stride) (((uint64_t) (n) + SLOTS_PER_PAGE(stride) - 1) / SLOTS_PER_PAGE(stride) * GPU_PAGE_SIZE)
+
+#define MEM_SIZE SLOTS_SIZE(RINGS * PKT_BUFFER_SIZE, MEM_PER_PKT) + HDR_SPLIT * SLOTS_SIZE(RINGS * PKT_BUFFER_SIZE, HDR_BUF_SIZE) + 32 * 4096 //64kb aligned - up to 8 rx and 8 tx rings each 4096 byte + 64kb counters
+
+// offsets inside the pinned gpu memory. The descriptor rings fill exactly the first 64KB gpu page and are therefore contiguous on the bus.
+// The packet buffers may span many gpu pages, their bus addresses are taken from the page list of the cuda kernel module (see CudaSrc/gpu_layout.h)
+#define GPU_RX_DESC_OFFS 0
+#define GPU_TX_DESC_OFFS 8 * 4096
+#define GPU_STATS_OFFS 16 * 4096 //per-ring counters, readable by the host through the cpu mapping (see gpu_mmap.h)
+#define GPU_DOORBELL_OFFS 20 * 4096 //nic tail register addresses of the rings, published by the DpdkDriver (see doorbell_table.h)
+#define GPU_TX_HEAD_OFFS 24 * 4096 //tx head write-back, one TX_HEAD_WB_STRIDE slot per ring
+#define TX_HEAD_WB_STRIDE 64
+#define GPU_PKT_BUFFER_OFFS 32 * 4096
+#define GPU_HDR_OFFS (GPU_PKT_BUFFER_OFFS + SLOTS_SIZE(RINGS * PKT_BUFFER_SIZE, MEM_PER_PKT)) //header split: one HDR_BUF_SIZE buffer per packet position behind the packet buffers
 
 #define DESC_SIZE 16
 
-#if SWITCH
-    #define GPU_MEM_ADDR 0x384000560000
-#else
-    #define GPU_MEM_ADDR 0x38ffe0560000
+#define NIC_REG_SIZE 512*1024
+
+// the nic pci address, its register base address and the bus address of the gpu memory are discovered at startup (see pci_discovery.h)
+
+#if WB && HEAD_WB
+#error "WB and HEAD_WB are exclusive"
 #endif
 
-#define GPU_RX_DESC_ADDR GPU_MEM_ADDR
-#define GPU_TX_DESC_ADDR GPU_MEM_ADDR + 8 * 4096
-#define GPU_PKT_BUFFER_MEM_ADDR GPU_MEM_ADDR + 16 * 4096
+#if HDR_SPLIT && RSC
+#error "HDR_SPLIT and RSC are exclusive, coalesced buffers would overflow into the next packet buffer behind the headroom"
+#endif
 
-#define NIC_RDT_OFFS 0x1018
-#define NIC_TDT_OFFS 0x6018
-#define NIC_REG_SIZE 512*1024
-#define NIC_POINTER_OFFS 0x40
-
-#if SWITCH
-    #if P4STA
-        #if E810
-            #define NIC_BUS 0x1a
-            #define NIC_DEVFN 0
-            #define NIC_REG_ADDR 0x384018000000
-        #else
-            #define NIC_BUS 0x1b
-            #define NIC_DEVFN 0
-            #define NIC_REG_ADDR 0xaca00000
-        #endif
-
-    #else
-        #define NIC_BUS 0x1b
-        #define NIC_DEVFN 1
-        #define NIC_REG_ADDR 0xaca80000
-    #endif
-#else
-    #if P4STA
-        #define NIC_BUS 0x65
-        #define NIC_DEVFN 0
-        #define NIC_REG_ADDR 0xc6000000
-    #else
-        #define NIC_BUS 0x65
-        #define NIC_DEVFN 1
-        #define NIC_REG_ADDR 0xc6080000
-    #endif
+#if HDR_SPLIT && SCATTER
+#error "HDR_SPLIT needs MAX_PKT_LEN <= MEM_PER_PKT, the payload would not fit behind the headroom"
+#endif
+
+#if HDR_SPLIT && MAX_PKT_LEN > MEM_PER_PKT - HDR_BUF_SIZE
+#error "HDR_SPLIT needs MAX_PKT_LEN <= MEM_PER_PKT - HDR_BUF_SIZE, a frame would overrun the next packet buffer behind the headroom"
+#endif
+
+#if HDR_SPLIT && MAX_PKT_LEN > RX_BUF_SIZE
+#error "HDR_SPLIT needs MAX_PKT_LEN <= RX_BUF_SIZE, the rx buffer behind the headroom is rounded down to 1KB (e.g. MEM_PER_PKT 4096 for 1518 byte frames)"
+#endif
+
+#if MEM_PER_PKT % 1024 != 0 || MEM_PER_PKT > 16384
+#error "MEM_PER_PKT must be a multiple of 1024 up to 16384, the nic rx buffer size has 1KB resolution"
+#endif
+
+#if RETA_BALANCE && HOST_RINGS == 0
+#error "RETA_BALANCE needs HOST_RINGS > 0"
 #endif